@@ -19,9 +19,20 @@ namespace vks
 	* @param offset (Optional) Byte offset from beginning
 	* 
 	* @return VkResult of the buffer mapping call
+	*
+	* @note Arena backed buffers live in persistently mapped memory, so no map call is made for them
 	*/
 	VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset)
 	{
+		if (allocation.arena)
+		{
+			if (!allocation.mapped)
+			{
+				return VK_ERROR_MEMORY_MAP_FAILED;
+			}
+			mapped = static_cast<uint8_t*>(allocation.mapped) + offset;
+			return VK_SUCCESS;
+		}
 		return vkMapMemory(device, memory, offset, size, 0, &mapped);
 	}
 
@@ -34,7 +45,11 @@ namespace vks
 	{
 		if (mapped)
 		{
-			vkUnmapMemory(device, memory);
+			// The arena page stays mapped for other buffers
+			if (!allocation.arena)
+			{
+				vkUnmapMemory(device, memory);
+			}
 			mapped = nullptr;
 		}
 	}
@@ -48,7 +63,7 @@ namespace vks
 	*/
 	VkResult Buffer::bind(VkDeviceSize offset)
 	{
-		return vkBindBufferMemory(device, buffer, memory, offset);
+		return vkBindBufferMemory(device, buffer, memory, allocation.offset + offset);
 	}
 
 	/**
@@ -93,8 +108,13 @@ namespace vks
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 		mappedRange.memory = memory;
-		mappedRange.offset = offset;
+		mappedRange.offset = allocation.offset + offset;
 		mappedRange.size = size;
+		// VK_WHOLE_SIZE would reach to the end of the arena page
+		if (allocation.arena && (size == VK_WHOLE_SIZE))
+		{
+			mappedRange.size = allocation.size - offset;
+		}
 		return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
@@ -113,8 +133,13 @@ namespace vks
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 		mappedRange.memory = memory;
-		mappedRange.offset = offset;
+		mappedRange.offset = allocation.offset + offset;
 		mappedRange.size = size;
+		// VK_WHOLE_SIZE would reach to the end of the arena page
+		if (allocation.arena && (size == VK_WHOLE_SIZE))
+		{
+			mappedRange.size = allocation.size - offset;
+		}
 		return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
@@ -127,7 +152,13 @@ namespace vks
 		{
 			vkDestroyBuffer(device, buffer, nullptr);
 		}
-		if (memory)
+		if (allocation.arena)
+		{
+			allocation.arena->free(allocation);
+			memory = VK_NULL_HANDLE;
+			mapped = nullptr;
+		}
+		else if (memory)
 		{
 			vkFreeMemory(device, memory, nullptr);
 		}
@@ -14,6 +14,7 @@
 
 #include "vulkan/vulkan.h"
 #include "VulkanTools.h"
+#include "VulkanMemoryArena.h"
 
 namespace vks
 {	
@@ -34,6 +35,8 @@ namespace vks
 		VkBufferUsageFlags usageFlags;
 		/** @brief Memory property flags to be filled by external source at buffer creation (to query at some later point) */
 		VkMemoryPropertyFlags memoryPropertyFlags;
+		/** @brief Range of the device's memory arena backing this buffer (memory is set to the arena page, empty if the memory is owned by the buffer) */
+		MemoryAllocation allocation;
 		VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		void unmap();
 		VkResult bind(VkDeviceSize offset = 0);
@@ -13,6 +13,8 @@
 #define VK_ENABLE_BETA_EXTENSIONS
 #endif
 #include <VulkanDevice.h>
+#include "VulkanTextureStreamer.h"
+#include "jobsystem.hpp"
 #include <unordered_set>
 
 namespace vks
@@ -64,12 +66,19 @@ namespace vks
 	*/
 	VulkanDevice::~VulkanDevice()
 	{
+		jobSystem.reset();
 		if (commandPool)
 		{
 			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
 		}
 		if (logicalDevice)
 		{
+			if (textureStreamer)
+			{
+				textureStreamer->destroy();
+			}
+			uploadManager.destroy();
+			memoryArena.destroy();
 			vkDestroyDevice(logicalDevice, nullptr);
 		}
 	}
@@ -291,6 +300,7 @@ namespace vks
 		}
 
 		this->enabledFeatures = enabledFeatures;
+		this->enabledExtensions.assign(deviceExtensions.begin(), deviceExtensions.end());
 
 		VkResult result = vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &logicalDevice);
 		if (result != VK_SUCCESS) 
@@ -301,6 +311,23 @@ namespace vks
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
 
+		memoryArena.create(logicalDevice, memoryProperties, properties.limits);
+
+		// Upload submissions are tracked with a timeline semaphore if the application enabled them, otherwise with fences
+		bool timelineSemaphore = false;
+		for (auto feature = static_cast<const VkBaseInStructure*>(pNextChain); feature != nullptr; feature = feature->pNext)
+		{
+			if (feature->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES)
+			{
+				timelineSemaphore |= reinterpret_cast<const VkPhysicalDeviceVulkan12Features*>(feature)->timelineSemaphore == VK_TRUE;
+			}
+			if (feature->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES)
+			{
+				timelineSemaphore |= reinterpret_cast<const VkPhysicalDeviceTimelineSemaphoreFeatures*>(feature)->timelineSemaphore == VK_TRUE;
+			}
+		}
+		uploadManager.create(this, timelineSemaphore);
+
 		return result;
 	}
 
@@ -312,12 +339,19 @@ namespace vks
 	* @param size Size of the buffer in byes
 	* @param buffer Pointer to the buffer handle acquired by the function
 	* @param memory Pointer to the memory handle acquired by the function
-	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over), staged through the upload manager if the memory is not host visible
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
 	*/
 	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data)
 	{
+		// Data for memory that can't be mapped (e.g. device local only) is uploaded through the upload manager's staging ring
+		const bool stagedUpload = (data != nullptr) && ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0);
+		if (stagedUpload)
+		{
+			usageFlags |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		}
+
 		// Create the buffer handle
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -340,7 +374,7 @@ namespace vks
 		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, memory));
 			
 		// If a pointer to the buffer data has been passed, map the buffer and copy over the data
-		if (data != nullptr)
+		if ((data != nullptr) && !stagedUpload)
 		{
 			void *mapped;
 			VK_CHECK_RESULT(vkMapMemory(logicalDevice, *memory, 0, size, 0, &mapped));
@@ -360,6 +394,11 @@ namespace vks
 		// Attach the memory to the buffer object
 		VK_CHECK_RESULT(vkBindBufferMemory(logicalDevice, *buffer, *memory, 0));
 
+		if (stagedUpload)
+		{
+			uploadManager.uploadBuffer(*buffer, 0, data, size);
+		}
+
 		return VK_SUCCESS;
 	}
 
@@ -370,7 +409,7 @@ namespace vks
 	* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
 	* @param buffer Pointer to a vk::Vulkan buffer object
 	* @param size Size of the buffer in bytes
-	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over), staged through the upload manager if the memory is not host visible
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
 	*/
@@ -378,25 +417,30 @@ namespace vks
 	{
 		buffer->device = logicalDevice;
 
+		// Data for memory that can't be mapped (e.g. device local only) is uploaded through the upload manager's staging ring
+		const bool stagedUpload = (data != nullptr) && ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0);
+		if (stagedUpload)
+		{
+			usageFlags |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		}
+
 		// Create the buffer handle
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
 
-		// Create the memory backing up the buffer handle
+		// Sub-allocate the memory backing up the buffer handle from the memory arena
 		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
 		// Find a memory type index that fits the properties of the buffer
-		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+		uint32_t memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
 		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
-		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
+		// The arena keeps separate pages for such allocations
+		VkMemoryAllocateFlags allocateFlags = 0;
 		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-			memAlloc.pNext = &allocFlagsInfo;
+			allocateFlags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
 		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+		VK_CHECK_RESULT(memoryArena.allocate(memReqs, memoryTypeIndex, true, &buffer->allocation, allocateFlags));
+		buffer->memory = buffer->allocation.memory;
 
 		buffer->alignment = memReqs.alignment;
 		buffer->size = size;
@@ -404,7 +448,7 @@ namespace vks
 		buffer->memoryPropertyFlags = memoryPropertyFlags;
 
 		// If a pointer to the buffer data has been passed, map the buffer and copy over the data
-		if (data != nullptr)
+		if ((data != nullptr) && !stagedUpload)
 		{
 			VK_CHECK_RESULT(buffer->map());
 			memcpy(buffer->mapped, data, size);
@@ -418,7 +462,34 @@ namespace vks
 		buffer->setupDescriptor();
 
 		// Attach the memory to the buffer object
-		return buffer->bind();
+		VkResult result = buffer->bind();
+		if ((result == VK_SUCCESS) && stagedUpload)
+		{
+			uploadManager.uploadBuffer(buffer->buffer, 0, data, size);
+		}
+		return result;
+	}
+
+	/**
+	* Allocate memory for an image from the device's memory arena and bind it
+	*
+	* @param image Image to allocate and bind the memory for
+	* @param memoryPropertyFlags Memory properties for the image memory (usually device local)
+	* @param allocation Pointer to the allocation that receives the memory range, to be released with MemoryArena::free
+	* @param (Optional) linear True for linear tiled images (defaults to false)
+	*
+	* @return VK_SUCCESS if the memory has been allocated and bound to the image
+	*/
+	VkResult VulkanDevice::allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, vks::MemoryAllocation *allocation, bool linear)
+	{
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(logicalDevice, image, &memReqs);
+		VkResult result = memoryArena.allocate(memReqs, getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags), linear, allocation);
+		if (result != VK_SUCCESS)
+		{
+			return result;
+		}
+		return vkBindImageMemory(logicalDevice, image, allocation->memory, allocation->offset);
 	}
 
 	/**
@@ -430,12 +501,12 @@ namespace vks
 	* @param copyRegion (Optional) Pointer to a copy region, if NULL, the whole buffer is copied
 	*
 	* @note Source and destination pointers must have the appropriate transfer usage flags set (TRANSFER_SRC / TRANSFER_DST)
+	* @note Inside of an upload manager batch the copy is only executed once the batch ends, so the source buffer has to stay valid until then
 	*/
 	void VulkanDevice::copyBuffer(vks::Buffer *src, vks::Buffer *dst, VkQueue queue, VkBufferCopy *copyRegion)
 	{
 		assert(dst->size <= src->size);
 		assert(src->buffer);
-		VkCommandBuffer copyCmd = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 		VkBufferCopy bufferCopy{};
 		if (copyRegion == nullptr)
 		{
@@ -446,9 +517,8 @@ namespace vks
 			bufferCopy = *copyRegion;
 		}
 
-		vkCmdCopyBuffer(copyCmd, src->buffer, dst->buffer, 1, &bufferCopy);
-
-		flushCommandBuffer(copyCmd, queue);
+		// Recorded into the upload manager's current batch if there is one, submitted and waited for right away otherwise
+		uploadManager.copyBuffer(src->buffer, dst->buffer, bufferCopy, queue);
 	}
 
 	/** 
@@ -555,6 +625,18 @@ namespace vks
 		return (std::find(supportedExtensions.begin(), supportedExtensions.end(), extension) != supportedExtensions.end());
 	}
 
+	/**
+	* Check if an extension has been enabled for the logical device
+	*
+	* @param extension Name of the extension to check
+	*
+	* @return True if the extension was passed to (or added by) createLogicalDevice
+	*/
+	bool VulkanDevice::extensionEnabled(std::string extension)
+	{
+		return (std::find(enabledExtensions.begin(), enabledExtensions.end(), extension) != enabledExtensions.end());
+	}
+
 	/**
 	* Select the best-fit depth format for this device from a list of possible depth (and stencil) formats
 	*
@@ -586,4 +668,37 @@ namespace vks
 		throw std::runtime_error("Could not find a matching depth format");
 	}
 
+	/**
+	* Get the texture streamer shared by all asset loads on this device, so its decode threads and staging ring are only created once
+	*
+	* @param graphicsQueue Queue the streamed textures are used on, only the queue passed to the first call is used
+	*
+	* @return Streamer that stays valid until the device is destroyed
+	*/
+	TextureStreamer& VulkanDevice::getTextureStreamer(VkQueue graphicsQueue)
+	{
+		if (!textureStreamer)
+		{
+			textureStreamer.reset(new TextureStreamer());
+			textureStreamer->create(this, graphicsQueue);
+		}
+		return *textureStreamer;
+	}
+
+	/**
+	* Get the job system shared by all asset loads on this device, so loading several models doesn't start new threads for each of them
+	*
+	* @return Job system that stays valid until the device is destroyed
+	*
+	* @note Jobs may only be scheduled from the thread that made the first call, which also has to be the thread that destroys the device
+	*/
+	JobSystem& VulkanDevice::getJobSystem()
+	{
+		if (!jobSystem)
+		{
+			jobSystem.reset(new JobSystem());
+		}
+		return *jobSystem;
+	}
+
 };
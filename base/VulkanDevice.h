@@ -12,13 +12,18 @@
 
 #include "VulkanBuffer.h"
 #include "VulkanTools.h"
+#include "VulkanUploadManager.h"
 #include "vulkan/vulkan.h"
 #include <algorithm>
 #include <assert.h>
 #include <exception>
+#include <memory>
 
 namespace vks
 {
+class JobSystem;
+class TextureStreamer;
+
 struct VulkanDevice
 {
 	/** @brief Physical device representation */
@@ -37,6 +42,8 @@ struct VulkanDevice
 	std::vector<VkQueueFamilyProperties> queueFamilyProperties;
 	/** @brief List of extensions supported by the device */
 	std::vector<std::string> supportedExtensions;
+	/** @brief List of extensions that have been enabled for the logical device */
+	std::vector<std::string> enabledExtensions;
 	/** @brief Default command pool for the graphics queue family index */
 	VkCommandPool commandPool = VK_NULL_HANDLE;
 	/** @brief Contains queue family indices */
@@ -46,6 +53,14 @@ struct VulkanDevice
 		uint32_t compute;
 		uint32_t transfer;
 	} queueFamilyIndices;
+	/** @brief Sub-allocator for buffer and image memory created through this device */
+	MemoryArena memoryArena;
+	/** @brief Staging ring and batched submissions for one-shot uploads (buffer contents, textures) */
+	UploadManager uploadManager;
+	/** @brief Texture streamer shared by all asset loads on this device, created by the first call to getTextureStreamer */
+	std::unique_ptr<TextureStreamer> textureStreamer;
+	/** @brief Job system shared by all asset loads on this device, created by the first call to getJobSystem */
+	std::unique_ptr<JobSystem> jobSystem;
 	operator VkDevice() const
 	{
 		return logicalDevice;
@@ -57,6 +72,7 @@ struct VulkanDevice
 	VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char *> enabledExtensions, void *pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
 	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr);
 	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr);
+	VkResult        allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, vks::MemoryAllocation *allocation, bool linear = false);
 	void            copyBuffer(vks::Buffer *src, vks::Buffer *dst, VkQueue queue, VkBufferCopy *copyRegion = nullptr);
 	VkCommandPool   createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, VkCommandPool pool, bool begin = false);
@@ -64,6 +80,9 @@ struct VulkanDevice
 	void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, VkCommandPool pool, bool free = true);
 	void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free = true);
 	bool            extensionSupported(std::string extension);
+	bool            extensionEnabled(std::string extension);
 	VkFormat        getSupportedDepthFormat(bool checkSamplingSupport);
+	TextureStreamer& getTextureStreamer(VkQueue graphicsQueue);
+	JobSystem&       getJobSystem();
 };
 }        // namespace vks
@@ -197,23 +197,6 @@ namespace vks
 
 			// Generate Vulkan buffers
 
-			vks::Buffer vertexStaging, indexStaging;
-
-			// Create staging buffers
-			device->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&vertexStaging,
-				vertexBufferSize,
-				vertices);
-
-			device->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&indexStaging,
-				indexBufferSize,
-				indices);
-
 			// Device local (target) buffer
 			device->createBuffer(
 				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
@@ -227,33 +210,15 @@ namespace vks
 				&indexBuffer,
 				indexBufferSize);
 
-			// Copy from staging buffers
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-			VkBufferCopy copyRegion = {};
-
-			copyRegion.size = vertexBufferSize;
-			vkCmdCopyBuffer(
-				copyCmd,
-				vertexStaging.buffer,
-				vertexBuffer.buffer,
-				1,
-				&copyRegion);
-
-			copyRegion.size = indexBufferSize;
-			vkCmdCopyBuffer(
-				copyCmd,
-				indexStaging.buffer,
-				indexBuffer.buffer,
-				1,
-				&copyRegion);
-
-			device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-			vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+			// Upload vertices and indices through the staging ring with a single submission
+			device->uploadManager.begin(copyQueue);
+			device->uploadManager.uploadBuffer(vertexBuffer.buffer, 0, vertices, vertexBufferSize);
+			device->uploadManager.uploadBuffer(indexBuffer.buffer, 0, indices, indexBufferSize);
+			device->uploadManager.end();
+
+			// The data has been copied into the staging ring
+			delete[] vertices;
+			delete[] indices;
 		}
 	};
 }
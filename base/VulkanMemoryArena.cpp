@@ -0,0 +1,297 @@
+/*
+* Vulkan device memory arena
+*
+* Sub-allocates buffer and image memory from large device memory pages to keep the number of vkAllocateMemory calls low
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMemoryArena.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* Setup the arena for the given logical device
+	*
+	* @param device Logical device to allocate memory from
+	* @param memoryProperties Memory types and heaps of the physical device
+	* @param limits Physical device limits (used for the nonCoherentAtomSize)
+	*/
+	void MemoryArena::create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkPhysicalDeviceLimits& limits)
+	{
+		this->device = device;
+		this->memoryProperties = memoryProperties;
+		nonCoherentAtomSize = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+	}
+
+	/**
+	* Release all device memory held by the arena
+	*
+	* @note All resources bound to arena memory must have been destroyed before calling this
+	*/
+	void MemoryArena::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& page : pages) {
+			if (page.memory) {
+				vkFreeMemory(device, page.memory, nullptr);
+			}
+		}
+		pages.clear();
+		stats = Stats();
+	}
+
+	bool MemoryArena::isNonCoherent(uint32_t memoryTypeIndex) const
+	{
+		const VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+		return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+
+	VkResult MemoryArena::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkMemoryAllocateFlags allocateFlags, VkDeviceMemory* memory, void** mapped)
+	{
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = size;
+		memAlloc.memoryTypeIndex = memoryTypeIndex;
+		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
+		if (allocateFlags != 0) {
+			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
+			allocFlagsInfo.flags = allocateFlags;
+			memAlloc.pNext = &allocFlagsInfo;
+		}
+		VkResult result = vkAllocateMemory(device, &memAlloc, nullptr, memory);
+		if (result != VK_SUCCESS) {
+			return result;
+		}
+		// Host visible memory is mapped once for its whole lifetime, so mapping a buffer is only a pointer offset
+		*mapped = nullptr;
+		if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			result = vkMapMemory(device, *memory, 0, VK_WHOLE_SIZE, 0, mapped);
+			if (result != VK_SUCCESS) {
+				vkFreeMemory(device, *memory, nullptr);
+				*memory = VK_NULL_HANDLE;
+				return result;
+			}
+		}
+		stats.bytesReserved += size;
+		stats.deviceAllocationCount++;
+		return VK_SUCCESS;
+	}
+
+	/** First fit search over the free ranges of a page */
+	bool MemoryArena::allocateFromPage(Page& page, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset)
+	{
+		for (auto it = page.freeRanges.begin(); it != page.freeRanges.end(); ++it) {
+			const VkDeviceSize rangeStart = it->first;
+			const VkDeviceSize rangeEnd = it->first + it->second;
+			const VkDeviceSize alignedStart = vks::tools::alignedVkSize(rangeStart, alignment);
+			if (alignedStart + size > rangeEnd) {
+				continue;
+			}
+			page.freeRanges.erase(it);
+			if (alignedStart > rangeStart) {
+				page.freeRanges[rangeStart] = alignedStart - rangeStart;
+			}
+			if (alignedStart + size < rangeEnd) {
+				page.freeRanges[alignedStart + size] = rangeEnd - (alignedStart + size);
+			}
+			*offset = alignedStart;
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	* Allocate a range of device memory
+	*
+	* @param memoryRequirements Requirements of the resource the memory is to be bound to
+	* @param memoryTypeIndex Memory type to allocate from (see VulkanDevice::getMemoryType)
+	* @param linear True for buffers and linear tiled images, false for optimal tiled images
+	* @param allocation Pointer to the allocation that receives memory handle, offset and host pointer
+	* @param (Optional) allocateFlags Flags passed via VkMemoryAllocateFlagsInfo (e.g. VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT)
+	*
+	* @return VkResult of the underlying vkAllocateMemory call, VK_SUCCESS if the request could be served from an existing page
+	*/
+	VkResult MemoryArena::allocate(const VkMemoryRequirements& memoryRequirements, uint32_t memoryTypeIndex, bool linear, MemoryAllocation* allocation, VkMemoryAllocateFlags allocateFlags)
+	{
+		assert(device);
+		std::lock_guard<std::mutex> lock(mutex);
+
+		VkDeviceSize size = memoryRequirements.size;
+		VkDeviceSize alignment = std::max<VkDeviceSize>(memoryRequirements.alignment, 1);
+		// Flushes and invalidates work on nonCoherentAtomSize granularity, so ranges in non-coherent memory must not share an atom
+		if (isNonCoherent(memoryTypeIndex)) {
+			alignment = std::max(alignment, nonCoherentAtomSize);
+			size = vks::tools::alignedVkSize(size, nonCoherentAtomSize);
+		}
+
+		*allocation = MemoryAllocation();
+		allocation->arena = this;
+		allocation->memoryTypeIndex = memoryTypeIndex;
+		allocation->size = size;
+
+		// Large resources don't benefit from sub-allocation and would only waste page space
+		if (size > pageSize / 2) {
+			VkResult result = allocateDeviceMemory(size, memoryTypeIndex, allocateFlags, &allocation->memory, &allocation->mapped);
+			if (result != VK_SUCCESS) {
+				*allocation = MemoryAllocation();
+				return result;
+			}
+			stats.dedicatedAllocationCount++;
+			stats.allocationCount++;
+			stats.bytesUsed += size;
+			return VK_SUCCESS;
+		}
+
+		uint32_t pageIndex = UINT32_MAX;
+		VkDeviceSize offset = 0;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(pages.size()); i++) {
+			Page& page = pages[i];
+			if ((page.memory == VK_NULL_HANDLE) || (page.memoryTypeIndex != memoryTypeIndex) || (page.linear != linear) || (page.allocateFlags != allocateFlags) || (page.size - page.used < size)) {
+				continue;
+			}
+			if (allocateFromPage(page, size, alignment, &offset)) {
+				pageIndex = i;
+				break;
+			}
+		}
+
+		if (pageIndex == UINT32_MAX) {
+			// No page with enough contiguous space, reserve a new one (reusing the slot of a released page if possible)
+			for (uint32_t i = 0; i < static_cast<uint32_t>(pages.size()); i++) {
+				if (pages[i].memory == VK_NULL_HANDLE) {
+					pageIndex = i;
+					break;
+				}
+			}
+			if (pageIndex == UINT32_MAX) {
+				pageIndex = static_cast<uint32_t>(pages.size());
+				pages.push_back(Page());
+			}
+			Page& page = pages[pageIndex];
+			page = Page();
+			VkResult result = allocateDeviceMemory(pageSize, memoryTypeIndex, allocateFlags, &page.memory, &page.mapped);
+			if (result != VK_SUCCESS) {
+				*allocation = MemoryAllocation();
+				return result;
+			}
+			page.size = pageSize;
+			page.memoryTypeIndex = memoryTypeIndex;
+			page.allocateFlags = allocateFlags;
+			page.linear = linear;
+			page.freeRanges[0] = pageSize;
+			stats.pageCount++;
+			allocateFromPage(page, size, alignment, &offset);
+		}
+
+		Page& page = pages[pageIndex];
+		page.used += size;
+		page.allocationCount++;
+		stats.allocationCount++;
+		stats.bytesUsed += size;
+
+		allocation->memory = page.memory;
+		allocation->offset = offset;
+		allocation->page = pageIndex;
+		if (page.mapped) {
+			allocation->mapped = static_cast<uint8_t*>(page.mapped) + offset;
+		}
+		return VK_SUCCESS;
+	}
+
+	/**
+	* Return an allocation to the arena
+	*
+	* @param allocation Allocation to release, reset to an empty allocation afterwards
+	*
+	* @note Pages that become empty are released back to the driver unless they are the last page for their memory type
+	*/
+	void MemoryArena::free(MemoryAllocation& allocation)
+	{
+		if (allocation.memory == VK_NULL_HANDLE) {
+			return;
+		}
+		assert(allocation.arena == this);
+		std::lock_guard<std::mutex> lock(mutex);
+
+		stats.allocationCount--;
+		stats.bytesUsed -= allocation.size;
+
+		if (allocation.page == UINT32_MAX) {
+			vkFreeMemory(device, allocation.memory, nullptr);
+			stats.bytesReserved -= allocation.size;
+			stats.deviceAllocationCount--;
+			stats.dedicatedAllocationCount--;
+			allocation = MemoryAllocation();
+			return;
+		}
+
+		Page& page = pages[allocation.page];
+		assert(page.memory == allocation.memory);
+		page.used -= allocation.size;
+		page.allocationCount--;
+
+		// Insert the range and merge it with its neighbours
+		VkDeviceSize offset = allocation.offset;
+		VkDeviceSize size = allocation.size;
+		auto next = page.freeRanges.lower_bound(offset);
+		if (next != page.freeRanges.begin()) {
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == offset) {
+				offset = prev->first;
+				size += prev->second;
+				page.freeRanges.erase(prev);
+			}
+		}
+		if ((next != page.freeRanges.end()) && (offset + size == next->first)) {
+			size += next->second;
+			page.freeRanges.erase(next);
+		}
+		page.freeRanges[offset] = size;
+
+		if (page.allocationCount == 0) {
+			bool hasSibling = false;
+			for (const auto& other : pages) {
+				if ((&other != &page) && (other.memory != VK_NULL_HANDLE) && (other.memoryTypeIndex == page.memoryTypeIndex) && (other.linear == page.linear) && (other.allocateFlags == page.allocateFlags)) {
+					hasSibling = true;
+					break;
+				}
+			}
+			if (hasSibling) {
+				vkFreeMemory(device, page.memory, nullptr);
+				stats.bytesReserved -= page.size;
+				stats.deviceAllocationCount--;
+				stats.pageCount--;
+				page = Page();
+			}
+		}
+
+		allocation = MemoryAllocation();
+	}
+
+	/**
+	* Get the current allocation statistics of the arena
+	*/
+	MemoryArena::Stats MemoryArena::getStats()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		VkDeviceSize totalFree = 0;
+		VkDeviceSize largestFree = 0;
+		for (const auto& page : pages) {
+			if (page.memory == VK_NULL_HANDLE) {
+				continue;
+			}
+			VkDeviceSize pageLargest = 0;
+			for (const auto& range : page.freeRanges) {
+				totalFree += range.second;
+				pageLargest = std::max(pageLargest, range.second);
+			}
+			largestFree += pageLargest;
+		}
+		Stats result = stats;
+		result.fragmentation = (totalFree > 0) ? 1.0f - static_cast<float>(largestFree) / static_cast<float>(totalFree) : 0.0f;
+		return result;
+	}
+}
@@ -0,0 +1,103 @@
+/*
+* Vulkan device memory arena
+*
+* Sub-allocates buffer and image memory from large device memory pages to keep the number of vkAllocateMemory calls low
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	class MemoryArena;
+
+	/** @brief Range of device memory handed out by a memory arena */
+	struct MemoryAllocation
+	{
+		/** @brief Arena the allocation belongs to, null if the memory is not owned by an arena */
+		MemoryArena* arena = nullptr;
+		/** @brief Device memory object the allocation lives in (shared with other allocations unless dedicated) */
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		/** @brief Byte offset of the allocation inside the memory object, to be passed to vkBind*Memory */
+		VkDeviceSize offset = 0;
+		/** @brief Size of the allocation in bytes (rounded up to nonCoherentAtomSize for non-coherent host visible memory) */
+		VkDeviceSize size = 0;
+		/** @brief Host pointer to the start of the allocation if the memory type is host visible (persistently mapped) */
+		void* mapped = nullptr;
+		uint32_t memoryTypeIndex = 0;
+		/** @brief Index of the arena page the range has been taken from, UINT32_MAX for dedicated allocations */
+		uint32_t page = UINT32_MAX;
+	};
+
+	/**
+	* @brief Sub-allocator for device memory owned by the VulkanDevice
+	* @note Memory is reserved in pages per memory type, allocation flags and resource kind (linear buffers vs. optimal images, which keeps bufferImageGranularity out of the picture)
+	* @note Requests larger than half a page get a dedicated allocation
+	*/
+	class MemoryArena
+	{
+	public:
+		/** @brief Runtime statistics of the arena */
+		struct Stats
+		{
+			/** @brief Bytes allocated from the driver (pages and dedicated allocations) */
+			VkDeviceSize bytesReserved = 0;
+			/** @brief Bytes handed out to resources */
+			VkDeviceSize bytesUsed = 0;
+			/** @brief Number of live allocations handed out by the arena */
+			uint32_t allocationCount = 0;
+			/** @brief Number of live vkAllocateMemory allocations backing the arena */
+			uint32_t deviceAllocationCount = 0;
+			uint32_t pageCount = 0;
+			uint32_t dedicatedAllocationCount = 0;
+			/** @brief Free space fragmentation across all pages (0 = all free space in one block per page, towards 1 = heavily fragmented) */
+			float fragmentation = 0.0f;
+		};
+
+		/** @brief Size of the memory pages reserved from the driver */
+		VkDeviceSize pageSize = 64 * 1024 * 1024;
+
+		void     create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkPhysicalDeviceLimits& limits);
+		void     destroy();
+		VkResult allocate(const VkMemoryRequirements& memoryRequirements, uint32_t memoryTypeIndex, bool linear, MemoryAllocation* allocation, VkMemoryAllocateFlags allocateFlags = 0);
+		void     free(MemoryAllocation& allocation);
+		Stats    getStats();
+
+	private:
+		struct Page
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			VkDeviceSize used = 0;
+			void* mapped = nullptr;
+			uint32_t memoryTypeIndex = 0;
+			VkMemoryAllocateFlags allocateFlags = 0;
+			bool linear = true;
+			uint32_t allocationCount = 0;
+			/** @brief Free ranges of the page sorted by offset (offset -> size), adjacent ranges are merged on free */
+			std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		VkDeviceSize nonCoherentAtomSize = 1;
+		std::vector<Page> pages;
+		Stats stats;
+		std::mutex mutex;
+
+		VkResult allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkMemoryAllocateFlags allocateFlags, VkDeviceMemory* memory, void** mapped);
+		bool     allocateFromPage(Page& page, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset);
+		bool     isNonCoherent(uint32_t memoryTypeIndex) const;
+	};
+}
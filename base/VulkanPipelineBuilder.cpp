@@ -0,0 +1,316 @@
+/*
+* Vulkan parallel pipeline builder
+*
+* Compiles batches of graphics and compute pipelines as jobs on the device's job system, each of its threads uses its own pipeline cache
+* that is merged back into the application's pipeline cache
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPipelineBuilder.h"
+#include "VulkanDevice.h"
+#include "VulkanShaderRegistry.h"
+#include "VulkanTools.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace vks
+{
+	namespace
+	{
+		template<typename T>
+		const T* copyArray(std::vector<T>& storage, const T* source, uint32_t count)
+		{
+			if ((source == nullptr) || (count == 0)) {
+				storage.clear();
+				return nullptr;
+			}
+			storage.assign(source, source + count);
+			return storage.data();
+		}
+	}
+
+	void PipelineBuilder::PipelineState::copyStages(const VkPipelineShaderStageCreateInfo* sourceStages, uint32_t count)
+	{
+		// Sized up front, the stages point into these vectors
+		stages.assign(sourceStages, sourceStages + count);
+		entryPoints.resize(count);
+		specializationInfos.resize(count);
+		specializationMapEntries.resize(count);
+		specializationData.resize(count);
+		for (uint32_t i = 0; i < count; i++) {
+			entryPoints[i] = stages[i].pName;
+			stages[i].pName = entryPoints[i].c_str();
+			const VkSpecializationInfo* specializationInfo = stages[i].pSpecializationInfo;
+			if (specializationInfo) {
+				specializationInfos[i] = *specializationInfo;
+				specializationInfos[i].pMapEntries = copyArray(specializationMapEntries[i], specializationInfo->pMapEntries, specializationInfo->mapEntryCount);
+				const uint8_t* data = static_cast<const uint8_t*>(specializationInfo->pData);
+				specializationInfos[i].pData = copyArray(specializationData[i], data, static_cast<uint32_t>(specializationInfo->dataSize));
+				stages[i].pSpecializationInfo = &specializationInfos[i];
+			}
+		}
+	}
+
+	void PipelineBuilder::PipelineState::copy(const VkGraphicsPipelineCreateInfo& createInfo)
+	{
+		bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		graphics = createInfo;
+		copyStages(createInfo.pStages, createInfo.stageCount);
+		graphics.pStages = stages.data();
+
+		if (createInfo.pVertexInputState) {
+			vertexInputState = *createInfo.pVertexInputState;
+			vertexInputState.pVertexBindingDescriptions = copyArray(vertexBindings, vertexInputState.pVertexBindingDescriptions, vertexInputState.vertexBindingDescriptionCount);
+			vertexInputState.pVertexAttributeDescriptions = copyArray(vertexAttributes, vertexInputState.pVertexAttributeDescriptions, vertexInputState.vertexAttributeDescriptionCount);
+			graphics.pVertexInputState = &vertexInputState;
+		}
+		if (createInfo.pInputAssemblyState) {
+			inputAssemblyState = *createInfo.pInputAssemblyState;
+			graphics.pInputAssemblyState = &inputAssemblyState;
+		}
+		if (createInfo.pTessellationState) {
+			tessellationState = *createInfo.pTessellationState;
+			graphics.pTessellationState = &tessellationState;
+		}
+		if (createInfo.pViewportState) {
+			viewportState = *createInfo.pViewportState;
+			// Viewports and scissors are usually dynamic, the arrays are then null
+			viewportState.pViewports = copyArray(viewports, viewportState.pViewports, viewportState.viewportCount);
+			viewportState.pScissors = copyArray(scissors, viewportState.pScissors, viewportState.scissorCount);
+			graphics.pViewportState = &viewportState;
+		}
+		if (createInfo.pRasterizationState) {
+			rasterizationState = *createInfo.pRasterizationState;
+			graphics.pRasterizationState = &rasterizationState;
+		}
+		if (createInfo.pMultisampleState) {
+			multisampleState = *createInfo.pMultisampleState;
+			const uint32_t sampleMaskWords = (static_cast<uint32_t>(multisampleState.rasterizationSamples) + 31) / 32;
+			multisampleState.pSampleMask = copyArray(sampleMask, multisampleState.pSampleMask, sampleMaskWords);
+			graphics.pMultisampleState = &multisampleState;
+		}
+		if (createInfo.pDepthStencilState) {
+			depthStencilState = *createInfo.pDepthStencilState;
+			graphics.pDepthStencilState = &depthStencilState;
+		}
+		if (createInfo.pColorBlendState) {
+			colorBlendState = *createInfo.pColorBlendState;
+			colorBlendState.pAttachments = copyArray(colorBlendAttachments, colorBlendState.pAttachments, colorBlendState.attachmentCount);
+			graphics.pColorBlendState = &colorBlendState;
+		}
+		if (createInfo.pDynamicState) {
+			dynamicState = *createInfo.pDynamicState;
+			dynamicState.pDynamicStates = copyArray(dynamicStates, dynamicState.pDynamicStates, dynamicState.dynamicStateCount);
+			graphics.pDynamicState = &dynamicState;
+		}
+	}
+
+	void PipelineBuilder::PipelineState::copy(const VkComputePipelineCreateInfo& createInfo)
+	{
+		bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+		compute = createInfo;
+		copyStages(&createInfo.stage, 1);
+		compute.stage = stages[0];
+	}
+
+	PipelineBuilder::~PipelineBuilder()
+	{
+		destroy();
+	}
+
+	void PipelineBuilder::create(vks::VulkanDevice* device, VkPipelineCache pipelineCache, ShaderModuleRegistry* shaderRegistry)
+	{
+		this->device = device;
+		this->pipelineCache = pipelineCache;
+		this->shaderRegistry = shaderRegistry;
+		statistics = Statistics();
+	}
+
+	void PipelineBuilder::createThreadCaches()
+	{
+		jobSystem = &device->getJobSystem();
+		// Threads start out with the contents of the application's cache (e.g. loaded from disk), so previously built pipelines are still cache hits
+		std::vector<uint8_t> initialData;
+		if (pipelineCache != VK_NULL_HANDLE) {
+			size_t dataSize = 0;
+			VK_CHECK_RESULT(vkGetPipelineCacheData(device->logicalDevice, pipelineCache, &dataSize, nullptr));
+			initialData.resize(dataSize);
+			if (dataSize > 0) {
+				VK_CHECK_RESULT(vkGetPipelineCacheData(device->logicalDevice, pipelineCache, &dataSize, initialData.data()));
+			}
+		}
+		VkPipelineCacheCreateInfo pipelineCacheCreateInfo{};
+		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		pipelineCacheCreateInfo.initialDataSize = initialData.size();
+		pipelineCacheCreateInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+		threadCaches.resize(jobSystem->getThreadCount());
+		for (auto& threadCache : threadCaches) {
+			VK_CHECK_RESULT(vkCreatePipelineCache(device->logicalDevice, &pipelineCacheCreateInfo, nullptr, &threadCache));
+		}
+	}
+
+	void PipelineBuilder::destroy()
+	{
+		if (device == nullptr) {
+			return;
+		}
+		mergeCaches();
+		for (auto& threadCache : threadCaches) {
+			vkDestroyPipelineCache(device->logicalDevice, threadCache, nullptr);
+		}
+		threadCaches.clear();
+		jobSystem = nullptr;
+		device = nullptr;
+		pipelineCache = VK_NULL_HANDLE;
+	}
+
+	PipelineBuilder::Future PipelineBuilder::enqueue(std::unique_ptr<PipelineState> state)
+	{
+		if (jobSystem == nullptr) {
+			createThreadCaches();
+		}
+		Request request;
+		request.state = std::move(state);
+		Future future = request.promise.get_future().share();
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			requestQueue.push_back(std::move(request));
+			statistics.submitted++;
+		}
+		// Each job builds whichever pipeline is queued first, so pipelines are built in the order they were queued
+		jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [this](const vks::JobHandle& job) { return jobSystem->isDone(job); }), jobs.end());
+		jobs.push_back(jobSystem->schedule([this]() { buildNext(); }));
+		return future;
+	}
+
+	PipelineBuilder::Future PipelineBuilder::build(const VkGraphicsPipelineCreateInfo& createInfo)
+	{
+		std::unique_ptr<PipelineState> state(new PipelineState());
+		state->copy(createInfo);
+		return enqueue(std::move(state));
+	}
+
+	PipelineBuilder::Future PipelineBuilder::build(const VkComputePipelineCreateInfo& createInfo)
+	{
+		std::unique_ptr<PipelineState> state(new PipelineState());
+		state->copy(createInfo);
+		return enqueue(std::move(state));
+	}
+
+	std::vector<PipelineBuilder::Future> PipelineBuilder::build(const std::vector<VkGraphicsPipelineCreateInfo>& createInfos)
+	{
+		std::vector<Future> futures;
+		futures.reserve(createInfos.size());
+		for (const auto& createInfo : createInfos) {
+			futures.push_back(build(createInfo));
+		}
+		return futures;
+	}
+
+	std::vector<PipelineBuilder::Future> PipelineBuilder::build(const std::vector<VkComputePipelineCreateInfo>& createInfos)
+	{
+		std::vector<Future> futures;
+		futures.reserve(createInfos.size());
+		for (const auto& createInfo : createInfos) {
+			futures.push_back(build(createInfo));
+		}
+		return futures;
+	}
+
+	void PipelineBuilder::wait()
+	{
+		for (const vks::JobHandle& job : jobs) {
+			jobSystem->wait(job);
+		}
+		jobs.clear();
+	}
+
+	void PipelineBuilder::mergeCaches()
+	{
+		wait();
+		if ((pipelineCache != VK_NULL_HANDLE) && !threadCaches.empty()) {
+			// Source caches must not be in use during the merge, which is guaranteed as all jobs have finished
+			VK_CHECK_RESULT(vkMergePipelineCaches(device->logicalDevice, pipelineCache, static_cast<uint32_t>(threadCaches.size()), threadCaches.data()));
+		}
+	}
+
+	uint32_t PipelineBuilder::getPendingCount() const
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		return static_cast<uint32_t>(requestQueue.size()) + activeRequests;
+	}
+
+	uint32_t PipelineBuilder::getThreadCount() const
+	{
+		return static_cast<uint32_t>(threadCaches.size());
+	}
+
+	PipelineBuilder::Statistics PipelineBuilder::getStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		return statistics;
+	}
+
+	bool PipelineBuilder::isReady(const Future& future)
+	{
+		return future.valid() && (future.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+	}
+
+	VkPipeline PipelineBuilder::getOr(const Future& future, VkPipeline fallback)
+	{
+		if (!isReady(future)) {
+			return fallback;
+		}
+		const VkPipeline pipeline = future.get();
+		return (pipeline != VK_NULL_HANDLE) ? pipeline : fallback;
+	}
+
+	void PipelineBuilder::buildNext()
+	{
+		Request request;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			request = std::move(requestQueue.front());
+			requestQueue.pop_front();
+			activeRequests++;
+		}
+
+		const VkPipelineCache threadCache = threadCaches[jobSystem->getThreadIndex()];
+		auto tStart = std::chrono::high_resolution_clock::now();
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkResult result;
+		if (request.state->bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS) {
+			if (shaderRegistry) {
+				result = shaderRegistry->createGraphicsPipeline(threadCache, request.state->graphics, &pipeline);
+			}
+			else {
+				result = vkCreateGraphicsPipelines(device->logicalDevice, threadCache, 1, &request.state->graphics, nullptr, &pipeline);
+			}
+		}
+		else {
+			result = vkCreateComputePipelines(device->logicalDevice, threadCache, 1, &request.state->compute, nullptr, &pipeline);
+		}
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		if (result != VK_SUCCESS) {
+			std::cerr << "Error: Pipeline creation failed: " << vks::tools::errorString(result) << "\n";
+			pipeline = VK_NULL_HANDLE;
+		}
+		request.promise.set_value(pipeline);
+
+		std::lock_guard<std::mutex> lock(queueMutex);
+		activeRequests--;
+		if (result == VK_SUCCESS) {
+			statistics.built++;
+		}
+		else {
+			statistics.failed++;
+		}
+		statistics.buildTime += std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+	}
+}
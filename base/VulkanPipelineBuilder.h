@@ -0,0 +1,156 @@
+/*
+* Vulkan parallel pipeline builder
+*
+* Compiles batches of graphics and compute pipelines as jobs on the device's job system, each of its threads uses its own pipeline cache
+* that is merged back into the application's pipeline cache
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "jobsystem.hpp"
+
+namespace vks
+{
+	struct VulkanDevice;
+	class ShaderModuleRegistry;
+
+	/**
+	* @brief Builds pipelines asynchronously as jobs on the device's shared job system
+	* @note Create infos (including all state structures, shader stages and specialization data) are copied, so they don't have to outlive the call
+	* @note pNext chains are not copied, extension structures have to stay valid until the pipeline has been built
+	* @note Shader modules, layouts, render passes and base pipelines referenced by a create info have to stay valid until the pipeline has been built
+	* @note Pipelines are owned by the caller once built, pipelines that failed to build are returned as VK_NULL_HANDLE
+	* @note The per-thread caches (and the device's job system) are only created with the first build request, so a builder that is never used costs nothing
+	* @note Pipelines have to be queued and waited for from the thread that created the device's job system
+	*/
+	class PipelineBuilder
+	{
+	public:
+		typedef std::shared_future<VkPipeline> Future;
+
+		struct Statistics {
+			uint32_t submitted = 0;
+			uint32_t built = 0;
+			uint32_t failed = 0;
+			/** @brief Time spent in pipeline creation in milliseconds, summed over all threads */
+			double buildTime = 0.0;
+		};
+
+		PipelineBuilder() = default;
+		~PipelineBuilder();
+		PipelineBuilder(const PipelineBuilder&) = delete;
+		PipelineBuilder& operator=(const PipelineBuilder&) = delete;
+
+		/**
+		* Set up the builder, the per-thread caches are created on the first build request
+		*
+		* @param device Device to create the pipelines on, its job system builds them
+		* @param pipelineCache Cache the per-thread caches are initialized from and merged into (may be VK_NULL_HANDLE)
+		* @param shaderRegistry Registry the shader modules were loaded from (optional), graphics pipelines are then created through it so they can be built from shader module identifiers
+		*/
+		void create(vks::VulkanDevice* device, VkPipelineCache pipelineCache, ShaderModuleRegistry* shaderRegistry = nullptr);
+		/** @brief Wait for all pending pipelines, merge the per-thread caches and release them (if they have been created) */
+		void destroy();
+
+		/** @brief Queue a graphics pipeline for compilation */
+		Future build(const VkGraphicsPipelineCreateInfo& createInfo);
+		/** @brief Queue a compute pipeline for compilation */
+		Future build(const VkComputePipelineCreateInfo& createInfo);
+		/** @brief Queue a batch of graphics pipelines, the batch is spread across all threads of the job system */
+		std::vector<Future> build(const std::vector<VkGraphicsPipelineCreateInfo>& createInfos);
+		/** @brief Queue a batch of compute pipelines, the batch is spread across all threads of the job system */
+		std::vector<Future> build(const std::vector<VkComputePipelineCreateInfo>& createInfos);
+
+		/** @brief Block until all queued pipelines have been built, the calling thread helps executing jobs meanwhile */
+		void wait();
+		/**
+		* Wait for all queued pipelines and merge the per-thread caches into the pipeline cache passed to create()
+		* @note The destination cache must not be used by other threads during the merge
+		*/
+		void mergeCaches();
+
+		/** @return Number of pipelines that have been queued but not finished yet */
+		uint32_t getPendingCount() const;
+		/** @return Number of threads that build the pipelines, 0 until the first pipeline has been queued */
+		uint32_t getThreadCount() const;
+		Statistics getStatistics() const;
+
+		/** @return True if the pipeline of the future has been built (or failed to build), never blocks */
+		static bool isReady(const Future& future);
+		/** @return The pipeline of the future if it has been built, the fallback otherwise (never blocks), e.g. to render with a generic pipeline while specialized variants are compiled */
+		static VkPipeline getOr(const Future& future, VkPipeline fallback);
+
+	private:
+		/** @brief Deep copy of a pipeline create info, pointers of the copied create info point into the state's own storage */
+		struct PipelineState {
+			VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			VkGraphicsPipelineCreateInfo graphics{};
+			VkComputePipelineCreateInfo compute{};
+
+			std::vector<VkPipelineShaderStageCreateInfo> stages;
+			std::vector<std::string> entryPoints;
+			std::vector<VkSpecializationInfo> specializationInfos;
+			std::vector<std::vector<VkSpecializationMapEntry>> specializationMapEntries;
+			std::vector<std::vector<uint8_t>> specializationData;
+
+			VkPipelineVertexInputStateCreateInfo vertexInputState{};
+			std::vector<VkVertexInputBindingDescription> vertexBindings;
+			std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+			VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{};
+			VkPipelineTessellationStateCreateInfo tessellationState{};
+			VkPipelineViewportStateCreateInfo viewportState{};
+			std::vector<VkViewport> viewports;
+			std::vector<VkRect2D> scissors;
+			VkPipelineRasterizationStateCreateInfo rasterizationState{};
+			VkPipelineMultisampleStateCreateInfo multisampleState{};
+			std::vector<VkSampleMask> sampleMask;
+			VkPipelineDepthStencilStateCreateInfo depthStencilState{};
+			VkPipelineColorBlendStateCreateInfo colorBlendState{};
+			std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments;
+			VkPipelineDynamicStateCreateInfo dynamicState{};
+			std::vector<VkDynamicState> dynamicStates;
+
+			void copyStages(const VkPipelineShaderStageCreateInfo* sourceStages, uint32_t count);
+			void copy(const VkGraphicsPipelineCreateInfo& createInfo);
+			void copy(const VkComputePipelineCreateInfo& createInfo);
+		};
+
+		struct Request {
+			std::unique_ptr<PipelineState> state;
+			std::promise<VkPipeline> promise;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		ShaderModuleRegistry* shaderRegistry = nullptr;
+		vks::JobSystem* jobSystem = nullptr;
+		/** @brief One cache per job system thread, so threads don't contend for the lock of a shared cache */
+		std::vector<VkPipelineCache> threadCaches;
+		/** @brief Jobs of the queued pipelines, only accessed by the thread that queues pipelines */
+		std::vector<vks::JobHandle> jobs;
+
+		mutable std::mutex queueMutex;
+		std::deque<Request> requestQueue;
+		uint32_t activeRequests = 0;
+		Statistics statistics;
+
+		/** @brief Get the device's job system and create the per-thread caches */
+		void createThreadCaches();
+		Future enqueue(std::unique_ptr<PipelineState> state);
+		/** @brief Build the oldest queued pipeline, executed as a job */
+		void buildNext();
+	};
+}
@@ -0,0 +1,181 @@
+/*
+* Vulkan pipeline cache persistence
+*
+* Stores the contents of a VkPipelineCache on disk so pipelines don't have to be recompiled from SPIR-V on every start
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPipelineCache.h"
+#include "VulkanTools.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace vks
+{
+	/** FNV-1a hash used to detect truncated or otherwise corrupted cache files */
+	uint64_t PipelineCacheFile::hash(const uint8_t* data, size_t size)
+	{
+		uint64_t value = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++) {
+			value ^= data[i];
+			value *= 1099511628211ull;
+		}
+		return value;
+	}
+
+	bool PipelineCacheFile::readData(const VkPhysicalDeviceProperties& deviceProperties, std::vector<uint8_t>& data) const
+	{
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			return false;
+		}
+		const std::streamoff fileSize = file.tellg();
+		file.seekg(0, std::ios::beg);
+
+		Header header{};
+		if ((fileSize < static_cast<std::streamoff>(sizeof(Header))) || !file.read(reinterpret_cast<char*>(&header), sizeof(Header))) {
+			std::cout << "Pipeline cache file \"" << filename << "\" is truncated, ignoring it\n";
+			return false;
+		}
+		if ((header.magic != magic) || (header.version != version)) {
+			std::cout << "Pipeline cache file \"" << filename << "\" has an unknown format, ignoring it\n";
+			return false;
+		}
+		// Cache data is only valid for the device and driver it has been created with
+		if ((header.vendorID != deviceProperties.vendorID) || (header.deviceID != deviceProperties.deviceID) || (header.driverVersion != deviceProperties.driverVersion) || (memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)) {
+			std::cout << "Pipeline cache file \"" << filename << "\" has been created for a different device or driver, ignoring it\n";
+			return false;
+		}
+		if (header.dataSize != static_cast<uint64_t>(fileSize) - sizeof(Header)) {
+			std::cout << "Pipeline cache file \"" << filename << "\" is truncated, ignoring it\n";
+			return false;
+		}
+
+		data.resize(static_cast<size_t>(header.dataSize));
+		if (!file.read(reinterpret_cast<char*>(data.data()), data.size()) || (hash(data.data(), data.size()) != header.dataHash)) {
+			std::cout << "Pipeline cache file \"" << filename << "\" is corrupted, ignoring it\n";
+			data.clear();
+			return false;
+		}
+
+		// Check the header Vulkan puts in front of the cache data, some drivers don't cope well with invalid data
+		VkPipelineCacheHeaderVersionOne cacheHeader{};
+		if (data.size() < sizeof(cacheHeader)) {
+			data.clear();
+			return false;
+		}
+		memcpy(&cacheHeader, data.data(), sizeof(cacheHeader));
+		if ((cacheHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) || (cacheHeader.vendorID != deviceProperties.vendorID) || (cacheHeader.deviceID != deviceProperties.deviceID) || (memcmp(cacheHeader.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)) {
+			std::cout << "Pipeline cache file \"" << filename << "\" contains incompatible data, ignoring it\n";
+			data.clear();
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	* Create a pipeline cache, initialized with the data stored in the cache file if that is valid for the current device
+	*
+	* @param device Logical device to create the pipeline cache for
+	* @param deviceProperties Properties of the physical device (used to validate the cache file)
+	* @param pipelineCache Pointer to the pipeline cache handle to create
+	*
+	* @return VkResult of the pipeline cache creation
+	*/
+	VkResult PipelineCacheFile::create(VkDevice device, const VkPhysicalDeviceProperties& deviceProperties, VkPipelineCache* pipelineCache) const
+	{
+		std::vector<uint8_t> data;
+		if (!filename.empty()) {
+			readData(deviceProperties, data);
+		}
+
+		VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		pipelineCacheCreateInfo.initialDataSize = data.size();
+		pipelineCacheCreateInfo.pInitialData = data.empty() ? nullptr : data.data();
+		VkResult result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, pipelineCache);
+		if ((result != VK_SUCCESS) && !data.empty()) {
+			// The driver rejected the data, start with an empty cache that will replace the file on shutdown
+			std::cout << "Pipeline cache data from \"" << filename << "\" was rejected by the driver, starting with an empty cache\n";
+			pipelineCacheCreateInfo.initialDataSize = 0;
+			pipelineCacheCreateInfo.pInitialData = nullptr;
+			result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, pipelineCache);
+		}
+		return result;
+	}
+
+	/**
+	* Write the contents of a pipeline cache to the cache file
+	*
+	* @param device Logical device the pipeline cache belongs to
+	* @param deviceProperties Properties of the physical device (stored in the file header)
+	* @param pipelineCache Pipeline cache to save
+	*
+	* @return True if the file has been written
+	*
+	* @note Data is written to a temporary file that then replaces the cache file, so an interrupted write never leaves a partial cache file behind
+	*/
+	bool PipelineCacheFile::save(VkDevice device, const VkPhysicalDeviceProperties& deviceProperties, VkPipelineCache pipelineCache) const
+	{
+		if (filename.empty() || (pipelineCache == VK_NULL_HANDLE)) {
+			return false;
+		}
+
+		size_t dataSize = 0;
+		if ((vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS) || (dataSize == 0)) {
+			return false;
+		}
+		std::vector<uint8_t> data(dataSize);
+		if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+			return false;
+		}
+		data.resize(dataSize);
+
+		Header header{};
+		header.magic = magic;
+		header.version = version;
+		header.vendorID = deviceProperties.vendorID;
+		header.deviceID = deviceProperties.deviceID;
+		header.driverVersion = deviceProperties.driverVersion;
+		memcpy(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+		header.dataSize = data.size();
+		header.dataHash = hash(data.data(), data.size());
+
+		const std::string tempFilename = filename + ".tmp";
+		{
+			std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				std::cerr << "Could not write pipeline cache file \"" << tempFilename << "\"\n";
+				return false;
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+			file.write(reinterpret_cast<const char*>(data.data()), data.size());
+			if (!file.good()) {
+				file.close();
+				std::remove(tempFilename.c_str());
+				return false;
+			}
+		}
+
+#if defined(_WIN32)
+		const bool renamed = MoveFileExA(tempFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		const bool renamed = std::rename(tempFilename.c_str(), filename.c_str()) == 0;
+#endif
+		if (!renamed) {
+			std::cerr << "Could not replace pipeline cache file \"" << filename << "\"\n";
+			std::remove(tempFilename.c_str());
+		}
+		return renamed;
+	}
+}
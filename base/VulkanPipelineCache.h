@@ -0,0 +1,51 @@
+/*
+* Vulkan pipeline cache persistence
+*
+* Stores the contents of a VkPipelineCache on disk so pipelines don't have to be recompiled from SPIR-V on every start
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	/**
+	* @brief Loads and saves pipeline cache data from/to a file
+	* @note The file starts with a header identifying the device and driver the data has been created with, mismatching or corrupted files are ignored
+	*/
+	class PipelineCacheFile
+	{
+	private:
+		/** @brief Header written in front of the pipeline cache data */
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+			uint64_t dataSize;
+			uint64_t dataHash;
+		};
+		static const uint32_t magic = 0x43505356; // "VSPC"
+		static const uint32_t version = 1;
+
+		static uint64_t hash(const uint8_t* data, size_t size);
+		bool readData(const VkPhysicalDeviceProperties& deviceProperties, std::vector<uint8_t>& data) const;
+	public:
+		/** @brief Path of the cache file, empty to disable persistence */
+		std::string filename;
+
+		VkResult create(VkDevice device, const VkPhysicalDeviceProperties& deviceProperties, VkPipelineCache* pipelineCache) const;
+		bool     save(VkDevice device, const VkPhysicalDeviceProperties& deviceProperties, VkPipelineCache pipelineCache) const;
+	};
+}
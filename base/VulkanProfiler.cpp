@@ -0,0 +1,176 @@
+/*
+* Vulkan GPU profiler
+*
+* Measures the GPU execution time of render passes (or any other range of commands) using timestamp queries
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanProfiler.h"
+#include "VulkanTools.h"
+
+#include <cstring>
+
+namespace vks
+{
+	GpuProfiler::Scope::Scope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, uint32_t frame, const char* name) : profiler(profiler), commandBuffer(commandBuffer), frame(frame)
+	{
+		index = profiler.beginScope(commandBuffer, frame, name);
+	}
+
+	GpuProfiler::Scope::~Scope()
+	{
+		profiler.endScope(commandBuffer, frame, index);
+	}
+
+	/**
+	* Create the timestamp query pools
+	*
+	* @param device Device to create the query pools on
+	* @param queue Graphics queue the profiled command buffers are submitted to (used to reset the query pools)
+	* @param frameCount Number of frames (draw command buffers) that are profiled independently
+	*
+	* @note Does nothing if the graphics queue doesn't support timestamps
+	*/
+	void GpuProfiler::create(vks::VulkanDevice* device, VkQueue queue, uint32_t frameCount)
+	{
+		destroy();
+		this->device = device;
+
+		const VkPhysicalDeviceLimits& limits = device->properties.limits;
+		const uint32_t validBits = device->queueFamilyProperties[device->queueFamilyIndices.graphics].timestampValidBits;
+		if ((validBits == 0) || (limits.timestampPeriod == 0.0f)) {
+			return;
+		}
+		timestampPeriod = limits.timestampPeriod;
+		timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+
+		frames.resize(frameCount);
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = maxScopes * 2;
+		for (auto& frame : frames) {
+			VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolInfo, nullptr, &frame.queryPool));
+			frame.scopes.reserve(maxScopes);
+		}
+
+		// Queries have to be reset before their results may be read, even if they never have been written
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (auto& frame : frames) {
+			vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, maxScopes * 2);
+		}
+		device->flushCommandBuffer(commandBuffer, queue);
+
+		queryData.resize(maxScopes * 4);
+		results.reserve(maxScopes);
+	}
+
+	/** Release all query pools */
+	void GpuProfiler::destroy()
+	{
+		for (auto& frame : frames) {
+			vkDestroyQueryPool(device->logicalDevice, frame.queryPool, nullptr);
+		}
+		frames.clear();
+		results.clear();
+		names.clear();
+	}
+
+	/** @return True if timestamps are supported and the query pools have been created */
+	bool GpuProfiler::supported() const
+	{
+		return !frames.empty();
+	}
+
+	/**
+	* Reset the queries of a frame, must be called outside of a render pass before recording any scopes into the frame's command buffer
+	*
+	* @param commandBuffer Command buffer the frame is recorded to
+	* @param frame Index of the frame (draw command buffer)
+	*/
+	void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frame)
+	{
+		if (frame >= frames.size()) {
+			return;
+		}
+		vkCmdResetQueryPool(commandBuffer, frames[frame].queryPool, 0, maxScopes * 2);
+		frames[frame].scopes.clear();
+	}
+
+	uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, uint32_t frame, const char* name)
+	{
+		if ((frame >= frames.size()) || (frames[frame].scopes.size() >= maxScopes)) {
+			return UINT32_MAX;
+		}
+		const uint32_t index = static_cast<uint32_t>(frames[frame].scopes.size());
+		frames[frame].scopes.push_back(getNameIndex(name));
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frames[frame].queryPool, index * 2);
+		return index;
+	}
+
+	void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t index)
+	{
+		if (index == UINT32_MAX) {
+			return;
+		}
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frames[frame].queryPool, index * 2 + 1);
+	}
+
+	/** @return Index of the name in the list of scope names, the name is only copied the first time it's used */
+	uint32_t GpuProfiler::getNameIndex(const char* name)
+	{
+		// Only a handful of distinct scopes are profiled, so a linear search is fine
+		for (size_t i = 0; i < names.size(); i++) {
+			if (strcmp(names[i].c_str(), name) == 0) {
+				return static_cast<uint32_t>(i);
+			}
+		}
+		names.push_back(name);
+		return static_cast<uint32_t>(names.size() - 1);
+	}
+
+	/**
+	* Read back the timestamps of a frame and update the results
+	*
+	* @param frame Index of the frame (draw command buffer) whose last submission has finished executing
+	*
+	* @return True if the results have been updated, false if the frame has no scopes or its queries are not yet available
+	*
+	* @note Doesn't wait for the GPU, call this after the frame's fence has been signaled (or the queue is idle)
+	*/
+	bool GpuProfiler::resolve(uint32_t frame)
+	{
+		if ((frame >= frames.size()) || frames[frame].scopes.empty()) {
+			return false;
+		}
+		const std::vector<uint32_t>& scopes = frames[frame].scopes;
+		const uint32_t queryCount = static_cast<uint32_t>(scopes.size()) * 2;
+		// Each query returns its timestamp followed by its availability
+		VkResult result = vkGetQueryPoolResults(device->logicalDevice, frames[frame].queryPool, 0, queryCount, queryCount * 2 * sizeof(uint64_t), queryData.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if (result != VK_SUCCESS) {
+			return false;
+		}
+		for (uint32_t i = 0; i < queryCount; i++) {
+			if (queryData[i * 2 + 1] == 0) {
+				return false;
+			}
+		}
+		results.resize(scopes.size());
+		for (size_t i = 0; i < scopes.size(); i++) {
+			const uint64_t begin = queryData[i * 4] & timestampMask;
+			const uint64_t end = queryData[i * 4 + 2] & timestampMask;
+			results[i].name = names[scopes[i]].c_str();
+			results[i].time = static_cast<double>((end - begin) & timestampMask) * timestampPeriod / 1000000.0;
+		}
+		return true;
+	}
+
+	/** @return GPU times of the scopes of the last resolved frame, in the order they were recorded */
+	const std::vector<GpuProfiler::Result>& GpuProfiler::getResults() const
+	{
+		return results;
+	}
+}
@@ -0,0 +1,88 @@
+/*
+* Vulkan GPU profiler
+*
+* Measures the GPU execution time of render passes (or any other range of commands) using timestamp queries
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	/**
+	* @brief Timestamp query based GPU profiler
+	* @note Uses one query pool per frame (draw command buffer), so results of a frame can be read back once the GPU has finished it without stalling on other frames
+	* @note Call beginFrame outside of a render pass at the start of a command buffer, then wrap the commands to measure in Scope objects
+	* @note Scope names are stored once when first seen, recording and resolving scopes doesn't allocate memory after that
+	*/
+	class GpuProfiler
+	{
+	public:
+		/** @brief GPU time of a profiled scope */
+		struct Result
+		{
+			/** @brief Name the scope was recorded with, stays valid as long as the profiler exists */
+			const char* name = nullptr;
+			/** @brief Execution time in milliseconds */
+			double time = 0.0;
+		};
+
+		/**
+		* @brief Measures the GPU time between its construction and destruction
+		* @note Scopes may be nested, but not overlap
+		*/
+		class Scope
+		{
+		public:
+			Scope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, uint32_t frame, const char* name);
+			~Scope();
+		private:
+			GpuProfiler& profiler;
+			VkCommandBuffer commandBuffer;
+			uint32_t frame;
+			uint32_t index;
+		};
+
+		/** @brief Maximum number of scopes that can be profiled per frame, additional scopes are ignored */
+		uint32_t maxScopes = 32;
+
+		void create(vks::VulkanDevice* device, VkQueue queue, uint32_t frameCount);
+		void destroy();
+		bool supported() const;
+		void beginFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+		bool resolve(uint32_t frame);
+		const std::vector<Result>& getResults() const;
+
+	private:
+		struct Frame
+		{
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			/** @brief Indices into names of the scopes recorded for this frame, scope i uses the queries 2 * i and 2 * i + 1 */
+			std::vector<uint32_t> scopes;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		std::vector<Frame> frames;
+		std::vector<Result> results;
+		/** @brief Names of all scopes recorded so far, a deque so results can point at them while new names are added */
+		std::deque<std::string> names;
+		std::vector<uint64_t> queryData;
+		/** @brief Nanoseconds per timestamp tick */
+		double timestampPeriod = 1.0;
+		uint64_t timestampMask = ~0ull;
+
+		uint32_t beginScope(VkCommandBuffer commandBuffer, uint32_t frame, const char* name);
+		void     endScope(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t index);
+		uint32_t getNameIndex(const char* name);
+	};
+}
@@ -0,0 +1,248 @@
+/*
+* Vulkan pipelined image readback
+*
+* Copies images into a ring of persistently mapped, host cached buffers at the end of a frame's command buffer
+* and hands the data to a consumer once the GPU has finished the copy, without waiting for the queue
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanReadback.h"
+#include "VulkanTools.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vks
+{
+	void ReadbackRing::create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t width, uint32_t height, VkFormat format, uint32_t slotCount)
+	{
+		assert(slotCount > 0);
+		this->device = device;
+		this->width = width;
+		this->height = height;
+		this->format = format;
+
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+		const VkDeviceSize atomSize = std::max<VkDeviceSize>(deviceProperties.limits.nonCoherentAtomSize, 1);
+
+		slots.resize(slotCount);
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_DST_BIT, static_cast<VkDeviceSize>(width) * height * 4);
+		VkMemoryRequirements memReqs{};
+		for (auto& slot : slots) {
+			VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &slot.buffer));
+		}
+		vkGetBufferMemoryRequirements(device, slots[0].buffer, &memReqs);
+		// Slot ranges have to be invalidated separately, so they must not share a non-coherent atom
+		const VkDeviceSize alignment = std::max(memReqs.alignment, atomSize);
+		slotSize = (memReqs.size + alignment - 1) / alignment * alignment;
+
+		// Prefer host cached memory, reading from uncached (write combined) memory on the CPU is very slow
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		auto findMemoryType = [&](VkMemoryPropertyFlags properties) -> int32_t {
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+				if ((memReqs.memoryTypeBits & (1u << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
+					return static_cast<int32_t>(i);
+				}
+			}
+			return -1;
+		};
+		int32_t memoryType = findMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+		if (memoryType < 0) {
+			memoryType = findMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		}
+		if (memoryType < 0) {
+			vks::tools::exitFatal("Could not find a host visible memory type for image readback", -1);
+		}
+		hostCoherent = (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = slotSize * slotCount;
+		memAlloc.memoryTypeIndex = static_cast<uint32_t>(memoryType);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &memory));
+		VK_CHECK_RESULT(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&mapped)));
+
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
+		for (uint32_t i = 0; i < slotCount; i++) {
+			slots[i].offset = slotSize * i;
+			VK_CHECK_RESULT(vkBindBufferMemory(device, slots[i].buffer, memory, slots[i].offset));
+			VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &slots[i].fence));
+		}
+		submitted.clear();
+		nextSlot = 0;
+		captureCount = 0;
+		droppedCount = 0;
+	}
+
+	void ReadbackRing::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		for (auto& slot : slots) {
+			if (slot.state == SlotState::Submitted) {
+				VK_CHECK_RESULT(vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+			}
+			vkDestroyFence(device, slot.fence, nullptr);
+			vkDestroyBuffer(device, slot.buffer, nullptr);
+		}
+		slots.clear();
+		submitted.clear();
+		if (memory != VK_NULL_HANDLE) {
+			vkUnmapMemory(device, memory);
+			vkFreeMemory(device, memory, nullptr);
+		}
+		memory = VK_NULL_HANDLE;
+		mapped = nullptr;
+		device = VK_NULL_HANDLE;
+	}
+
+	int32_t ReadbackRing::beginCapture(Consumer consumer)
+	{
+		poll();
+		// Slots are released in submission order, so the next slot in the ring is the one that has been free the longest
+		for (uint32_t i = 0; i < slots.size(); i++) {
+			const uint32_t index = (nextSlot + i) % static_cast<uint32_t>(slots.size());
+			Slot& slot = slots[index];
+			if (slot.state == SlotState::Free) {
+				slot.state = SlotState::Recording;
+				slot.consumer = std::move(consumer);
+				slot.captureIndex = captureCount++;
+				nextSlot = (index + 1) % static_cast<uint32_t>(slots.size());
+				return static_cast<int32_t>(index);
+			}
+		}
+		droppedCount++;
+		return -1;
+	}
+
+	void ReadbackRing::recordCopy(int32_t slot, VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask)
+	{
+		assert((slot >= 0) && (slots[slot].state == SlotState::Recording));
+		const VkImageSubresourceRange subresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		// Also makes the writes to the image available to the copy if it's already in the transfer source layout
+		vks::tools::insertImageMemoryBarrier(
+			commandBuffer,
+			image,
+			srcAccessMask,
+			VK_ACCESS_TRANSFER_READ_BIT,
+			oldLayout,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			srcStageMask,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			subresourceRange);
+
+		VkBufferImageCopy copyRegion{};
+		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.imageSubresource.layerCount = 1;
+		copyRegion.imageExtent = { width, height, 1 };
+		vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slots[slot].buffer, 1, &copyRegion);
+
+		if (newLayout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+			vks::tools::insertImageMemoryBarrier(
+				commandBuffer,
+				image,
+				VK_ACCESS_TRANSFER_READ_BIT,
+				0,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				newLayout,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				subresourceRange);
+		}
+
+		// Make the copied data visible to host reads once the fence has been signaled
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = slots[slot].buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+	}
+
+	void ReadbackRing::endCapture(int32_t slot, VkQueue queue)
+	{
+		assert((slot >= 0) && (slots[slot].state == SlotState::Recording));
+		// A submission without command buffers still signals its fence, once all work submitted before it has completed
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 0, nullptr, slots[slot].fence));
+		slots[slot].state = SlotState::Submitted;
+		submitted.push_back(static_cast<uint32_t>(slot));
+	}
+
+	void ReadbackRing::cancelCapture(int32_t slot)
+	{
+		assert((slot >= 0) && (slots[slot].state == SlotState::Recording));
+		slots[slot].state = SlotState::Free;
+		slots[slot].consumer = nullptr;
+	}
+
+	void ReadbackRing::deliver(uint32_t slotIndex)
+	{
+		Slot& slot = slots[slotIndex];
+		if (!hostCoherent) {
+			VkMappedMemoryRange range = vks::initializers::mappedMemoryRange();
+			range.memory = memory;
+			range.offset = slot.offset;
+			range.size = slotSize;
+			VK_CHECK_RESULT(vkInvalidateMappedMemoryRanges(device, 1, &range));
+		}
+		if (slot.consumer) {
+			Frame frame;
+			frame.data = mapped + slot.offset;
+			frame.width = width;
+			frame.height = height;
+			frame.rowPitch = width * 4;
+			frame.format = format;
+			frame.captureIndex = slot.captureIndex;
+			slot.consumer(frame);
+		}
+		VK_CHECK_RESULT(vkResetFences(device, 1, &slot.fence));
+		slot.consumer = nullptr;
+		slot.state = SlotState::Free;
+	}
+
+	uint32_t ReadbackRing::poll()
+	{
+		uint32_t delivered = 0;
+		// Captures are delivered in order, a later capture can't finish before an earlier one on the same queue anyway
+		while (!submitted.empty()) {
+			const uint32_t slotIndex = submitted.front();
+			const VkResult result = vkGetFenceStatus(device, slots[slotIndex].fence);
+			if (result == VK_NOT_READY) {
+				break;
+			}
+			VK_CHECK_RESULT(result);
+			submitted.pop_front();
+			deliver(slotIndex);
+			delivered++;
+		}
+		return delivered;
+	}
+
+	void ReadbackRing::flush()
+	{
+		while (!submitted.empty()) {
+			const uint32_t slotIndex = submitted.front();
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &slots[slotIndex].fence, VK_TRUE, UINT64_MAX));
+			submitted.pop_front();
+			deliver(slotIndex);
+		}
+	}
+
+	uint32_t ReadbackRing::getPendingCount() const
+	{
+		return static_cast<uint32_t>(submitted.size());
+	}
+
+	uint64_t ReadbackRing::getDroppedCount() const
+	{
+		return droppedCount;
+	}
+}
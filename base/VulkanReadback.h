@@ -0,0 +1,129 @@
+/*
+* Vulkan pipelined image readback
+*
+* Copies images into a ring of persistently mapped, host cached buffers at the end of a frame's command buffer
+* and hands the data to a consumer once the GPU has finished the copy, without waiting for the queue
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	/**
+	* @brief Ring of readback buffers for capturing rendered images (screenshots, frame sequences) without stalling the render queue
+	* @note Usage per captured frame: beginCapture(), recordCopy() into a command buffer, submit that command buffer, then endCapture() with the same queue
+	* @note Consumers are called from poll() (and flush()) on the calling thread, once the frame's copy has finished on the GPU, usually a few frames later
+	* @note Only supports color formats with four bytes per pixel
+	*/
+	class ReadbackRing
+	{
+	public:
+		/** @brief Captured image data passed to the consumer, only valid for the duration of the call */
+		struct Frame
+		{
+			const uint8_t* data = nullptr;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			/** @brief Rows are tightly packed (width * 4 bytes) */
+			uint32_t rowPitch = 0;
+			/** @brief Format of the source image, e.g. to check if color components have to be swizzled */
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			/** @brief Running number of the capture, increments with every successful beginCapture() */
+			uint64_t captureIndex = 0;
+		};
+		typedef std::function<void(const Frame& frame)> Consumer;
+
+		/**
+		* Create the readback buffers
+		*
+		* @param physicalDevice Physical device used to select the memory type
+		* @param device Logical device
+		* @param width Width of the captured images
+		* @param height Height of the captured images
+		* @param format Format of the captured images
+		* @param slotCount Number of captures that can be in flight at once, should be larger than the number of frames in flight
+		*/
+		void     create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t width, uint32_t height, VkFormat format, uint32_t slotCount = 3);
+		/** @brief Release all resources, pending captures are discarded (call flush() first to receive them) */
+		void     destroy();
+		/**
+		* Reserve a slot for a capture, delivers finished captures first
+		*
+		* @param consumer Called with the captured image once the copy has finished
+		*
+		* @return Index of the slot to pass to recordCopy() and endCapture(), or -1 if all slots are still in flight (the capture is dropped instead of stalling)
+		*/
+		int32_t  beginCapture(Consumer consumer);
+		/**
+		* Record the copy of an image into the slot's buffer
+		*
+		* @param slot Slot returned by beginCapture()
+		* @param commandBuffer Command buffer to record into, usually at the end of the frame's command buffer
+		* @param image Image to copy, has to be created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+		* @param oldLayout Layout of the image when the copy is executed
+		* @param newLayout Layout the image is transitioned to after the copy
+		* @param srcStageMask Pipeline stages that wrote the image
+		* @param srcAccessMask Accesses that wrote the image
+		*/
+		void     recordCopy(int32_t slot, VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+			VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VkAccessFlags srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+		/**
+		* Mark the capture as submitted, has to be called after the command buffer containing the copy has been submitted to the queue
+		* @note Submits the slot's fence to the queue without any work, it signals once all previously submitted work has finished
+		*/
+		void     endCapture(int32_t slot, VkQueue queue);
+		/** @brief Release a slot returned by beginCapture() if the frame is not submitted after all (e.g. swapchain out of date) */
+		void     cancelCapture(int32_t slot);
+		/** @brief Deliver all captures whose copy has finished (in capture order) without waiting, returns the number of delivered captures */
+		uint32_t poll();
+		/** @brief Wait for all submitted captures and deliver them */
+		void     flush();
+		/** @return Number of captures submitted but not yet delivered */
+		uint32_t getPendingCount() const;
+		/** @return Number of captures dropped by beginCapture() because all slots were in flight */
+		uint64_t getDroppedCount() const;
+
+	private:
+		enum class SlotState { Free, Recording, Submitted };
+
+		struct Slot
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			SlotState state = SlotState::Free;
+			Consumer consumer;
+			uint64_t captureIndex = 0;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		/** @brief All slots share one allocation, each slot's range is aligned to the non-coherent atom size */
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize slotSize = 0;
+		uint8_t* mapped = nullptr;
+		/** @brief Host cached memory is usually not coherent, ranges then have to be invalidated before reading */
+		bool hostCoherent = false;
+		std::vector<Slot> slots;
+		/** @brief Submitted slots, oldest first */
+		std::deque<uint32_t> submitted;
+		uint32_t nextSlot = 0;
+		uint64_t captureCount = 0;
+		uint64_t droppedCount = 0;
+
+		void deliver(uint32_t slotIndex);
+	};
+}
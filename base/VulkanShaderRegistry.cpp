@@ -0,0 +1,269 @@
+/*
+* Vulkan shader module registry
+*
+* Loads SPIR-V files without intermediate copies and shares one shader module between all requests for the same file (or the same contents)
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanShaderRegistry.h"
+#include "VulkanTools.h"
+#include "mappedfile.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+namespace vks
+{
+	namespace
+	{
+		/** @brief Read-only view of a SPIR-V file, memory mapped on desktop and backed by the asset's buffer on Android */
+		class SpirvFile
+		{
+		public:
+#if defined(__ANDROID__)
+			~SpirvFile()
+			{
+				if (asset) {
+					AAsset_close(asset);
+				}
+			}
+
+			bool open(AAssetManager* assetManager, const std::string& filename)
+			{
+				asset = AAssetManager_open(assetManager, filename.c_str(), AASSET_MODE_BUFFER);
+				if (!asset) {
+					return false;
+				}
+				size = AAsset_getLength(asset);
+				code = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+				if ((code != nullptr) && ((reinterpret_cast<uintptr_t>(code) % sizeof(uint32_t)) != 0)) {
+					// SPIR-V has to be passed as 32 bit words, assets stored at an unaligned offset in the apk need to be copied
+					alignedCopy.resize((size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+					memcpy(alignedCopy.data(), code, size);
+					code = reinterpret_cast<const uint8_t*>(alignedCopy.data());
+				}
+				return code != nullptr;
+			}
+#else
+			bool open(const std::string& filename)
+			{
+				if (!file.open(filename)) {
+					return false;
+				}
+				// Mappings are page aligned, so the contents can be passed to the driver directly
+				code = file.data();
+				size = file.size();
+				return true;
+			}
+#endif
+
+			const uint8_t* code = nullptr;
+			size_t size = 0;
+
+		private:
+#if defined(__ANDROID__)
+			AAsset* asset = nullptr;
+			std::vector<uint32_t> alignedCopy;
+#else
+			MappedFile file;
+#endif
+		};
+	}
+
+	ShaderModuleRegistry::~ShaderModuleRegistry()
+	{
+		destroy();
+	}
+
+	void ShaderModuleRegistry::create(VkDevice device, bool moduleIdentifiers)
+	{
+		this->device = device;
+		vkGetShaderModuleIdentifierEXT = nullptr;
+		if (moduleIdentifiers) {
+			vkGetShaderModuleIdentifierEXT = reinterpret_cast<PFN_vkGetShaderModuleIdentifierEXT>(vkGetDeviceProcAddr(device, "vkGetShaderModuleIdentifierEXT"));
+		}
+		statistics = Statistics();
+	}
+
+	void ShaderModuleRegistry::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& entry : entries) {
+			vkDestroyShaderModule(device, entry.first, nullptr);
+		}
+		entries.clear();
+		filenameIndex.clear();
+		contentIndex.clear();
+		statistics.liveModules = 0;
+	}
+
+#if defined(__ANDROID__)
+	void ShaderModuleRegistry::setAssetManager(AAssetManager* assetManager)
+	{
+		this->assetManager = assetManager;
+	}
+#endif
+
+	/** FNV-1a hash of the SPIR-V code, combined with its size to make collisions between different modules even less likely */
+	uint64_t ShaderModuleRegistry::contentHash(const uint8_t* data, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= data[i];
+			hash *= 1099511628211ull;
+		}
+		return hash ^ (static_cast<uint64_t>(size) * 0x9e3779b97f4a7c15ull);
+	}
+
+	ShaderModuleRegistry::Entry* ShaderModuleRegistry::createEntry(const uint8_t* code, size_t size, uint64_t contentKey)
+	{
+		VkShaderModuleCreateInfo moduleCreateInfo{};
+		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleCreateInfo.codeSize = size;
+		moduleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code);
+		VkShaderModule module;
+		VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, nullptr, &module));
+		statistics.moduleCreations++;
+
+		std::unique_ptr<Entry> entry(new Entry());
+		entry->module = module;
+		entry->contentKey = contentKey;
+		if (vkGetShaderModuleIdentifierEXT) {
+			VkShaderModuleIdentifierEXT moduleIdentifier{};
+			moduleIdentifier.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT;
+			vkGetShaderModuleIdentifierEXT(device, module, &moduleIdentifier);
+			entry->identifierSize = std::min<uint32_t>(moduleIdentifier.identifierSize, VK_MAX_SHADER_MODULE_IDENTIFIER_SIZE_EXT);
+			memcpy(entry->identifier.data(), moduleIdentifier.identifier, entry->identifierSize);
+		}
+		Entry* result = entry.get();
+		entries[module] = std::move(entry);
+		contentIndex[contentKey] = result;
+		return result;
+	}
+
+	VkShaderModule ShaderModuleRegistry::acquire(const std::string& filename)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			statistics.requests++;
+			auto it = filenameIndex.find(filename);
+			if (it != filenameIndex.end()) {
+				it->second->refCount++;
+				return it->second->module;
+			}
+		}
+
+		// The file is mapped and hashed without holding the lock, so other threads can be served from the registry meanwhile
+		SpirvFile file;
+#if defined(__ANDROID__)
+		const bool opened = (assetManager != nullptr) && file.open(assetManager, filename);
+#else
+		const bool opened = file.open(filename);
+#endif
+		if (!opened || ((file.size % sizeof(uint32_t)) != 0)) {
+			std::cerr << "Error: Could not load shader file \"" << filename << "\"" << "\n";
+			return VK_NULL_HANDLE;
+		}
+		const uint64_t contentKey = contentHash(file.code, file.size);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		statistics.fileReads++;
+		Entry* entry = nullptr;
+		auto filenameIt = filenameIndex.find(filename);
+		if (filenameIt != filenameIndex.end()) {
+			// Loaded by another thread in the meantime
+			entry = filenameIt->second;
+		}
+		else {
+			auto contentIt = contentIndex.find(contentKey);
+			if (contentIt != contentIndex.end()) {
+				entry = contentIt->second;
+				statistics.contentMatches++;
+			}
+			else {
+				entry = createEntry(file.code, file.size, contentKey);
+			}
+			entry->filenames.push_back(filename);
+			filenameIndex[filename] = entry;
+		}
+		entry->refCount++;
+		statistics.liveModules = static_cast<uint32_t>(entries.size());
+		return entry->module;
+	}
+
+	void ShaderModuleRegistry::release(VkShaderModule module)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = entries.find(module);
+		if (it == entries.end()) {
+			return;
+		}
+		Entry* entry = it->second.get();
+		assert(entry->refCount > 0);
+		if (--entry->refCount > 0) {
+			return;
+		}
+		for (auto& filename : entry->filenames) {
+			filenameIndex.erase(filename);
+		}
+		contentIndex.erase(entry->contentKey);
+		vkDestroyShaderModule(device, module, nullptr);
+		entries.erase(it);
+		statistics.liveModules = static_cast<uint32_t>(entries.size());
+	}
+
+	VkResult ShaderModuleRegistry::createGraphicsPipeline(VkPipelineCache pipelineCache, const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline* pipeline)
+	{
+		if (vkGetShaderModuleIdentifierEXT && (pipelineCache != VK_NULL_HANDLE)) {
+			std::vector<VkPipelineShaderStageCreateInfo> stages(createInfo.pStages, createInfo.pStages + createInfo.stageCount);
+			std::vector<VkPipelineShaderStageModuleIdentifierCreateInfoEXT> identifierInfos(createInfo.stageCount);
+			// Copied, as the entries may be released by other threads while the pipeline is created
+			std::vector<std::array<uint8_t, VK_MAX_SHADER_MODULE_IDENTIFIER_SIZE_EXT>> identifiers(createInfo.stageCount);
+			bool allIdentified = true;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				for (uint32_t i = 0; (i < createInfo.stageCount) && allIdentified; i++) {
+					auto it = entries.find(stages[i].module);
+					if ((it == entries.end()) || (it->second->identifierSize == 0)) {
+						allIdentified = false;
+						break;
+					}
+					identifiers[i] = it->second->identifier;
+					identifierInfos[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_MODULE_IDENTIFIER_CREATE_INFO_EXT;
+					identifierInfos[i].pNext = stages[i].pNext;
+					identifierInfos[i].identifierSize = it->second->identifierSize;
+					identifierInfos[i].pIdentifier = identifiers[i].data();
+					stages[i].pNext = &identifierInfos[i];
+					stages[i].module = VK_NULL_HANDLE;
+				}
+			}
+			if (allIdentified) {
+				VkGraphicsPipelineCreateInfo identifierCreateInfo = createInfo;
+				identifierCreateInfo.pStages = stages.data();
+				identifierCreateInfo.flags |= VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT_EXT;
+				VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &identifierCreateInfo, nullptr, pipeline);
+				if (result == VK_SUCCESS) {
+					std::lock_guard<std::mutex> lock(mutex);
+					statistics.identifierPipelines++;
+					return result;
+				}
+				// The driver doesn't know the pipeline yet and would need the SPIR-V to compile it
+				if (result != VK_PIPELINE_COMPILE_REQUIRED_EXT) {
+					return result;
+				}
+			}
+		}
+		return vkCreateGraphicsPipelines(device, pipelineCache, 1, &createInfo, nullptr, pipeline);
+	}
+
+	ShaderModuleRegistry::Statistics ShaderModuleRegistry::getStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return statistics;
+	}
+}
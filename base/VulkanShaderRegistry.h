@@ -0,0 +1,113 @@
+/*
+* Vulkan shader module registry
+*
+* Loads SPIR-V files without intermediate copies and shares one shader module between all requests for the same file (or the same contents)
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#if defined(__ANDROID__)
+#include <android/asset_manager.h>
+#endif
+
+namespace vks
+{
+	/**
+	* @brief Reference counted shader modules keyed by file name and content hash
+	* @note Repeated requests for a file return the existing module without touching the file again, different files with identical contents share a module
+	* @note Thread safe, modules may be acquired and released from worker threads (e.g. while building pipelines in parallel)
+	*/
+	class ShaderModuleRegistry
+	{
+	public:
+		struct Statistics {
+			/** @brief Number of acquire() calls */
+			uint32_t requests = 0;
+			/** @brief SPIR-V files (or Android assets) mapped, repeated requests for a known file don't read it again */
+			uint32_t fileReads = 0;
+			uint32_t moduleCreations = 0;
+			/** @brief Requests served by the module of a different file with identical contents */
+			uint32_t contentMatches = 0;
+			/** @brief Pipelines created by createGraphicsPipeline() from module identifiers alone */
+			uint32_t identifierPipelines = 0;
+			uint32_t liveModules = 0;
+		};
+
+		ShaderModuleRegistry() = default;
+		~ShaderModuleRegistry();
+		ShaderModuleRegistry(const ShaderModuleRegistry&) = delete;
+		ShaderModuleRegistry& operator=(const ShaderModuleRegistry&) = delete;
+
+		/**
+		* Set up the registry for a device
+		*
+		* @param device Logical device the modules are created on
+		* @param moduleIdentifiers Query module identifiers for createGraphicsPipeline(), requires VK_EXT_shader_module_identifier (and its shaderModuleIdentifier feature) as well as pipeline creation cache control to be enabled on the device
+		*/
+		void create(VkDevice device, bool moduleIdentifiers = false);
+		/** @brief Destroy all remaining modules, no module returned by the registry may be used afterwards */
+		void destroy();
+#if defined(__ANDROID__)
+		/** @brief Asset manager shader files are loaded from */
+		void setAssetManager(AAssetManager* assetManager);
+#endif
+
+		/**
+		* Get the module for a SPIR-V file, creating it on the first request
+		*
+		* @param filename Path of the SPIR-V file
+		*
+		* @return Shader module with its reference count increased, VK_NULL_HANDLE if the file can't be read
+		*/
+		VkShaderModule acquire(const std::string& filename);
+		/** @brief Drop a reference to a module returned by acquire(), the module is destroyed once the last reference has been released */
+		void release(VkShaderModule module);
+
+		/**
+		* Create a graphics pipeline, passing the identifiers of registered modules instead of the modules themselves first
+		* @note A driver that has the pipeline in its cache can then create it without the SPIR-V, otherwise (or with identifiers disabled) the pipeline is created from the modules as usual
+		*/
+		VkResult createGraphicsPipeline(VkPipelineCache pipelineCache, const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline* pipeline);
+
+		Statistics getStatistics() const;
+
+	private:
+		struct Entry {
+			VkShaderModule module = VK_NULL_HANDLE;
+			uint32_t refCount = 0;
+			uint64_t contentKey = 0;
+			/** @brief All file names that resolved to this module */
+			std::vector<std::string> filenames;
+			uint32_t identifierSize = 0;
+			std::array<uint8_t, VK_MAX_SHADER_MODULE_IDENTIFIER_SIZE_EXT> identifier{};
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+#if defined(__ANDROID__)
+		AAssetManager* assetManager = nullptr;
+#endif
+		PFN_vkGetShaderModuleIdentifierEXT vkGetShaderModuleIdentifierEXT = nullptr;
+		mutable std::mutex mutex;
+		std::unordered_map<VkShaderModule, std::unique_ptr<Entry>> entries;
+		std::unordered_map<std::string, Entry*> filenameIndex;
+		std::unordered_map<uint64_t, Entry*> contentIndex;
+		Statistics statistics;
+
+		static uint64_t contentHash(const uint8_t* data, size_t size);
+		Entry* createEntry(const uint8_t* code, size_t size, uint64_t contentKey);
+	};
+}
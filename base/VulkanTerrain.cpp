@@ -0,0 +1,608 @@
+/*
+* Vulkan chunked terrain
+*
+* Splits a large heightfield into tiles, each refined by a quadtree of chunks with per node bounds and geometric error
+* Chunk meshes are generated as jobs on a job system and streamed in and out around the camera within a fixed memory budget
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTerrain.h"
+#include "VulkanTools.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include <ktx.h>
+
+namespace vks
+{
+	namespace
+	{
+		/** @brief Grid coordinates of the k-th vertex when walking around the border of a chunk with n quads per side */
+		glm::uvec2 perimeterVertex(uint32_t k, uint32_t n)
+		{
+			const uint32_t t = k % n;
+			switch (k / n) {
+			case 0: return glm::uvec2(t, 0);
+			case 1: return glm::uvec2(n, t);
+			case 2: return glm::uvec2(n - t, n);
+			default: return glm::uvec2(0, n - t);
+			}
+		}
+
+		float hashToFloat(uint32_t x, uint32_t y, uint32_t seed)
+		{
+			uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+			h ^= h >> 13;
+			h *= 0x85ebca6bu;
+			h ^= h >> 16;
+			return static_cast<float>(h) / 4294967295.0f * 2.0f - 1.0f;
+		}
+	}
+
+	TerrainHeightMapSource::TerrainHeightMapSource(const std::string& filename, uint32_t virtualSize, float detailAmplitude)
+	{
+		ktxResult result;
+		ktxTexture* ktxTexture;
+#if defined(__ANDROID__)
+		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+		if (!asset) {
+			vks::tools::exitFatal("Could not load heightmap from " + filename + "\n\nMake sure the assets submodule has been checked out and is up-to-date.", -1);
+		}
+		size_t size = AAsset_getLength(asset);
+		assert(size > 0);
+		ktx_uint8_t* textureData = new ktx_uint8_t[size];
+		AAsset_read(asset, textureData, size);
+		AAsset_close(asset);
+		result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+		delete[] textureData;
+#else
+		if (!vks::tools::fileExists(filename)) {
+			vks::tools::exitFatal("Could not load heightmap from " + filename + "\n\nMake sure the assets submodule has been checked out and is up-to-date.", -1);
+		}
+		result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+#endif
+		assert(result == KTX_SUCCESS);
+		assert(ktxTexture->baseWidth == ktxTexture->baseHeight);
+		dim = ktxTexture->baseWidth;
+		heights.resize(static_cast<size_t>(dim) * dim);
+		assert(ktxTexture_GetImageSize(ktxTexture, 0) >= heights.size() * sizeof(uint16_t));
+		memcpy(heights.data(), ktxTexture_GetData(ktxTexture), heights.size() * sizeof(uint16_t));
+		ktxTexture_Destroy(ktxTexture);
+
+		this->virtualSize = (virtualSize > 0) ? virtualSize : dim;
+		this->detailAmplitude = detailAmplitude;
+	}
+
+	uint32_t TerrainHeightMapSource::getSize() const
+	{
+		return virtualSize;
+	}
+
+	float TerrainHeightMapSource::getHeightmapSample(int32_t x, int32_t y) const
+	{
+		x = std::max(0, std::min(x, static_cast<int32_t>(dim) - 1));
+		y = std::max(0, std::min(y, static_cast<int32_t>(dim) - 1));
+		return heights[static_cast<size_t>(y) * dim + x] / 65535.0f;
+	}
+
+	float TerrainHeightMapSource::getDetail(uint32_t x, uint32_t y) const
+	{
+		// Value noise with a few octaves, the coarsest one spans a couple of heightmap texels
+		uint32_t cellSize = std::max(virtualSize / dim, 1u) * 4;
+		float sum = 0.0f;
+		float amplitude = 1.0f;
+		float totalAmplitude = 0.0f;
+		for (uint32_t octave = 0; (octave < 4) && (cellSize > 0); octave++, cellSize /= 2) {
+			const uint32_t cx = x / cellSize;
+			const uint32_t cy = y / cellSize;
+			float fx = static_cast<float>(x % cellSize) / cellSize;
+			float fy = static_cast<float>(y % cellSize) / cellSize;
+			fx = fx * fx * (3.0f - 2.0f * fx);
+			fy = fy * fy * (3.0f - 2.0f * fy);
+			const float top = glm::mix(hashToFloat(cx, cy, octave), hashToFloat(cx + 1, cy, octave), fx);
+			const float bottom = glm::mix(hashToFloat(cx, cy + 1, octave), hashToFloat(cx + 1, cy + 1, octave), fx);
+			sum += glm::mix(top, bottom, fy) * amplitude;
+			totalAmplitude += amplitude;
+			amplitude *= 0.5f;
+		}
+		return sum / totalAmplitude * detailAmplitude;
+	}
+
+	float TerrainHeightMapSource::getHeight(uint32_t x, uint32_t y) const
+	{
+		if (virtualSize == dim) {
+			return heights[static_cast<size_t>(y) * dim + x] / 65535.0f;
+		}
+		// Map sample centers of the virtual grid onto the heightmap and interpolate bilinearly
+		const float scale = static_cast<float>(dim) / virtualSize;
+		const float fx = (x + 0.5f) * scale - 0.5f;
+		const float fy = (y + 0.5f) * scale - 0.5f;
+		const int32_t ix = static_cast<int32_t>(floorf(fx));
+		const int32_t iy = static_cast<int32_t>(floorf(fy));
+		const float tx = fx - ix;
+		const float ty = fy - iy;
+		const float top = glm::mix(getHeightmapSample(ix, iy), getHeightmapSample(ix + 1, iy), tx);
+		const float bottom = glm::mix(getHeightmapSample(ix, iy + 1), getHeightmapSample(ix + 1, iy + 1), tx);
+		float height = glm::mix(top, bottom, ty);
+		if (detailAmplitude != 0.0f) {
+			height += getDetail(x, y);
+		}
+		return std::max(0.0f, std::min(height, 1.0f));
+	}
+
+	ChunkedTerrain::~ChunkedTerrain()
+	{
+		destroy();
+	}
+
+	void ChunkedTerrain::create(vks::VulkanDevice* device, VkQueue copyQueue, const TerrainHeightSource* source, const Settings& settings)
+	{
+		assert(device && source);
+		assert((settings.chunkResolution >= 2) && (settings.chunkResolution <= 128) && ((settings.chunkResolution & (settings.chunkResolution - 1)) == 0));
+		assert((settings.tileSize >= settings.chunkResolution) && ((settings.tileSize & (settings.tileSize - 1)) == 0));
+		this->device = device;
+		this->source = source;
+		this->settings = settings;
+		this->settings.frameCount = std::max(settings.frameCount, 1u);
+		this->settings.maxUploadsPerFrame = std::max(settings.maxUploadsPerFrame, 1u);
+		fieldSize = source->getSize();
+
+		const uint32_t n = settings.chunkResolution;
+		// Grid vertices followed by one skirt vertex per border vertex
+		chunkVertexCount = (n + 1) * (n + 1) + 4 * n;
+		chunkIndexCount = n * n * 6 + 4 * n * 6;
+		chunkBufferSize = chunkVertexCount * sizeof(Vertex);
+
+		// Root tiles, the last row and column may extend past the heightfield (samples are clamped)
+		const uint32_t tilesPerSide = (fieldSize + settings.tileSize - 1) / settings.tileSize;
+		rootCount = tilesPerSide * tilesPerSide;
+		nodes.clear();
+		nodes.reserve(rootCount * 64);
+		for (uint32_t y = 0; y < tilesPerSide; y++) {
+			for (uint32_t x = 0; x < tilesPerSide; x++) {
+				Node node;
+				node.x = x * settings.tileSize;
+				node.y = y * settings.tileSize;
+				node.size = settings.tileSize;
+				const glm::vec3 origin = getOrigin();
+				node.boundsMin = glm::vec3(origin.x + node.x * settings.scale.x, std::min(0.0f, settings.scale.y), origin.z + node.y * settings.scale.z);
+				node.boundsMax = glm::vec3(origin.x + (node.x + node.size) * settings.scale.x, std::max(0.0f, settings.scale.y), origin.z + (node.y + node.size) * settings.scale.z);
+				node.error = fabsf(settings.scale.y);
+				nodes.push_back(node);
+			}
+		}
+
+		// Root tiles are never evicted, so the budget has to hold at least those plus some room for refinement
+		const uint32_t slotCount = std::max(static_cast<uint32_t>(settings.memoryBudget / chunkBufferSize), rootCount + 16);
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&vertexBuffer,
+			slotCount * chunkBufferSize));
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			this->settings.frameCount * this->settings.maxUploadsPerFrame * chunkBufferSize));
+		VK_CHECK_RESULT(stagingBuffer.map());
+		createIndexBuffer(copyQueue);
+
+		slotOwners.assign(slotCount, invalidIndex);
+		freeSlots.resize(slotCount);
+		for (uint32_t i = 0; i < slotCount; i++) {
+			freeSlots[i] = slotCount - 1 - i;
+		}
+		statistics = Statistics();
+		statistics.chunkCapacity = slotCount;
+		statistics.vertexMemory = slotCount * chunkBufferSize;
+		frameCounter = 0;
+		pendingCount = 0;
+
+		jobSystem = (settings.jobSystem != nullptr) ? settings.jobSystem : &device->getJobSystem();
+	}
+
+	void ChunkedTerrain::createIndexBuffer(VkQueue copyQueue)
+	{
+		const uint32_t n = settings.chunkResolution;
+		const uint32_t rowLength = n + 1;
+		std::vector<uint16_t> indices;
+		indices.reserve(chunkIndexCount);
+		for (uint32_t y = 0; y < n; y++) {
+			for (uint32_t x = 0; x < n; x++) {
+				// Split along the same diagonal the geometric error is measured against
+				const uint16_t i0 = static_cast<uint16_t>(y * rowLength + x);
+				const uint16_t i1 = static_cast<uint16_t>(i0 + 1);
+				const uint16_t i2 = static_cast<uint16_t>(i0 + rowLength);
+				const uint16_t i3 = static_cast<uint16_t>(i2 + 1);
+				indices.insert(indices.end(), { i0, i3, i1, i0, i2, i3 });
+			}
+		}
+		// Skirts hang down from the border, so cracks to neighbouring chunks of a different level are covered
+		const uint32_t skirtStart = rowLength * rowLength;
+		const uint32_t borderCount = 4 * n;
+		for (uint32_t k = 0; k < borderCount; k++) {
+			const uint32_t next = (k + 1) % borderCount;
+			const glm::uvec2 a = perimeterVertex(k, n);
+			const glm::uvec2 b = perimeterVertex(next, n);
+			const uint16_t top0 = static_cast<uint16_t>(a.y * rowLength + a.x);
+			const uint16_t top1 = static_cast<uint16_t>(b.y * rowLength + b.x);
+			const uint16_t bottom0 = static_cast<uint16_t>(skirtStart + k);
+			const uint16_t bottom1 = static_cast<uint16_t>(skirtStart + next);
+			indices.insert(indices.end(), { top0, bottom0, top1, top1, bottom0, bottom1 });
+		}
+		assert(indices.size() == chunkIndexCount);
+
+		const VkDeviceSize indexBufferSize = indices.size() * sizeof(uint16_t);
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&indexBuffer,
+			indexBufferSize));
+		device->uploadManager.uploadBuffer(indexBuffer.buffer, 0, indices.data(), indexBufferSize, copyQueue);
+	}
+
+	void ChunkedTerrain::destroy()
+	{
+		if (device == nullptr) {
+			return;
+		}
+		for (const vks::JobHandle& job : chunkJobs) {
+			jobSystem->wait(job);
+		}
+		chunkJobs.clear();
+		jobSystem = nullptr;
+		finishedMeshes.clear();
+		readyMeshes.clear();
+		nodes.clear();
+		slotOwners.clear();
+		freeSlots.clear();
+		pendingCopies.clear();
+		drawList.clear();
+		vertexBuffer.destroy();
+		indexBuffer.destroy();
+		stagingBuffer.destroy();
+		device = nullptr;
+	}
+
+	glm::vec3 ChunkedTerrain::getOrigin() const
+	{
+		return glm::vec3(-0.5f * fieldSize * settings.scale.x, 0.0f, -0.5f * fieldSize * settings.scale.z);
+	}
+
+	const ChunkedTerrain::Statistics& ChunkedTerrain::getStatistics() const
+	{
+		return statistics;
+	}
+
+	void ChunkedTerrain::ensureChildren(uint32_t nodeIndex)
+	{
+		if (nodes[nodeIndex].firstChild != invalidIndex) {
+			return;
+		}
+		// Copy, adding the children may reallocate the node array
+		const Node parent = nodes[nodeIndex];
+		const uint32_t half = parent.size / 2;
+		const glm::vec3 origin = getOrigin();
+		nodes[nodeIndex].firstChild = static_cast<uint32_t>(nodes.size());
+		for (uint32_t i = 0; i < 4; i++) {
+			Node child;
+			child.x = parent.x + (i & 1) * half;
+			child.y = parent.y + (i >> 1) * half;
+			child.size = half;
+			child.level = parent.level + 1;
+			child.parent = nodeIndex;
+			// The finer mesh deviates from the parent by at most the parent's error
+			child.boundsMin = glm::vec3(origin.x + child.x * settings.scale.x, parent.boundsMin.y - parent.error, origin.z + child.y * settings.scale.z);
+			child.boundsMax = glm::vec3(origin.x + (child.x + half) * settings.scale.x, parent.boundsMax.y + parent.error, origin.z + (child.y + half) * settings.scale.z);
+			child.error = parent.error * 0.5f;
+			nodes.push_back(child);
+		}
+	}
+
+	float ChunkedTerrain::getProjectedError(const Node& node, const glm::vec3& cameraPosition, float projectionScale) const
+	{
+		const glm::vec3 closest = glm::clamp(cameraPosition, node.boundsMin, node.boundsMax);
+		const float distance = glm::length(cameraPosition - closest);
+		return node.error * projectionScale / std::max(distance, 1e-4f);
+	}
+
+	void ChunkedTerrain::select(uint32_t nodeIndex, const glm::vec3& cameraPosition, float projectionScale, std::vector<std::pair<float, uint32_t>>& requests)
+	{
+		Node& node = nodes[nodeIndex];
+		if (!frustum.checkAABB(node.boundsMin, node.boundsMax)) {
+			return;
+		}
+		node.lastUsed = frameCounter;
+		if (node.state != NodeState::Resident) {
+			// Only root tiles get here, children are only visited once all of them are resident
+			if (node.state == NodeState::Unloaded) {
+				requests.push_back({ FLT_MAX, nodeIndex });
+			}
+			return;
+		}
+		if ((node.size <= settings.chunkResolution) || (getProjectedError(node, cameraPosition, projectionScale) <= settings.pixelError)) {
+			drawList.push_back(nodeIndex);
+			return;
+		}
+
+		ensureChildren(nodeIndex);
+		const uint32_t firstChild = nodes[nodeIndex].firstChild;
+		bool childrenResident = true;
+		for (uint32_t i = firstChild; i < firstChild + 4; i++) {
+			Node& child = nodes[i];
+			if ((child.state != NodeState::Resident) && frustum.checkAABB(child.boundsMin, child.boundsMax)) {
+				childrenResident = false;
+				if (child.state == NodeState::Unloaded) {
+					requests.push_back({ getProjectedError(child, cameraPosition, projectionScale), i });
+				}
+			}
+		}
+		if (!childrenResident) {
+			// Keep drawing the coarser chunk until the whole visible refinement has been streamed in
+			drawList.push_back(nodeIndex);
+			for (uint32_t i = firstChild; i < firstChild + 4; i++) {
+				nodes[i].lastUsed = frameCounter;
+			}
+			return;
+		}
+		for (uint32_t i = firstChild; i < firstChild + 4; i++) {
+			select(i, cameraPosition, projectionScale, requests);
+		}
+	}
+
+	uint32_t ChunkedTerrain::acquireSlot()
+	{
+		if (!freeSlots.empty()) {
+			const uint32_t slot = freeSlots.back();
+			freeSlots.pop_back();
+			return slot;
+		}
+		// Evict the least recently used chunk that's not needed this frame and doesn't have resident children (which would leave a hole)
+		uint32_t candidate = invalidIndex;
+		uint64_t oldest = frameCounter;
+		for (uint32_t slot = 0; slot < slotOwners.size(); slot++) {
+			const Node& node = nodes[slotOwners[slot]];
+			if ((node.level > 0) && (node.residentChildren == 0) && (node.lastUsed < oldest)) {
+				oldest = node.lastUsed;
+				candidate = slot;
+			}
+		}
+		if (candidate == invalidIndex) {
+			return invalidIndex;
+		}
+		Node& evicted = nodes[slotOwners[candidate]];
+		evicted.state = NodeState::Unloaded;
+		evicted.slot = invalidIndex;
+		nodes[evicted.parent].residentChildren--;
+		slotOwners[candidate] = invalidIndex;
+		statistics.evictedChunks++;
+		return candidate;
+	}
+
+	void ChunkedTerrain::integrate(ChunkMesh& mesh)
+	{
+		Node& node = nodes[mesh.node];
+		assert(node.state == NodeState::Pending);
+		const uint32_t slot = acquireSlot();
+		if (slot == invalidIndex) {
+			// Budget is exhausted by chunks needed for this frame, the node will be requested again if it's still needed
+			node.state = NodeState::Unloaded;
+			return;
+		}
+
+		const VkDeviceSize stagingOffset = (static_cast<VkDeviceSize>(frameIndex) * settings.maxUploadsPerFrame + pendingCopies.size()) * chunkBufferSize;
+		memcpy(static_cast<uint8_t*>(stagingBuffer.mapped) + stagingOffset, mesh.vertices.data(), chunkBufferSize);
+		pendingCopies.push_back({ stagingOffset, slot * chunkBufferSize, chunkBufferSize });
+
+		slotOwners[slot] = mesh.node;
+		node.slot = slot;
+		node.state = NodeState::Resident;
+		node.boundsMin.y = std::min(mesh.minHeight * settings.scale.y, mesh.maxHeight * settings.scale.y);
+		node.boundsMax.y = std::max(mesh.minHeight * settings.scale.y, mesh.maxHeight * settings.scale.y);
+		node.error = std::max(mesh.error, node.descendantError);
+		if (node.parent != invalidIndex) {
+			nodes[node.parent].residentChildren++;
+		}
+		// The mesh only measures the deviation from the next finer level, the errors of finer levels accumulate towards the root
+		// Ancestors of a resident node are always resident, so their errors have been measured already
+		for (uint32_t ancestor = node.parent; ancestor != invalidIndex; ancestor = nodes[ancestor].parent) {
+			Node& parent = nodes[ancestor];
+			if (parent.descendantError >= node.error) {
+				break;
+			}
+			parent.descendantError = node.error;
+			parent.error = std::max(parent.error, node.error);
+		}
+	}
+
+	void ChunkedTerrain::update(const glm::mat4& projection, const glm::mat4& view, float viewportHeight, uint32_t frameIndex)
+	{
+		assert(device);
+		frameCounter++;
+		this->frameIndex = frameIndex % settings.frameCount;
+		drawList.clear();
+		pendingCopies.clear();
+
+		{
+			std::lock_guard<std::mutex> lock(finishedMutex);
+			for (auto& mesh : finishedMeshes) {
+				readyMeshes.push_back(std::move(mesh));
+			}
+			finishedMeshes.clear();
+		}
+
+		frustum.update(projection * view);
+		const glm::vec3 cameraPosition = glm::vec3(glm::inverse(view)[3]);
+		// Pixels per world unit at a distance of one unit, the error is divided by the distance to project it
+		const float projectionScale = 0.5f * viewportHeight * fabsf(projection[1][1]);
+
+		std::vector<std::pair<float, uint32_t>> requests;
+		for (uint32_t i = 0; i < rootCount; i++) {
+			select(i, cameraPosition, projectionScale, requests);
+		}
+
+		// Schedule the chunks with the largest projected error first, only keep a few in flight so the generated chunks follow the camera
+		chunkJobs.erase(std::remove_if(chunkJobs.begin(), chunkJobs.end(), [this](const vks::JobHandle& job) { return jobSystem->isDone(job); }), chunkJobs.end());
+		const uint32_t maxPending = std::max(jobSystem->getThreadCount() - 1, 1u) * 2;
+		if (!requests.empty() && (pendingCount < maxPending)) {
+			std::sort(requests.begin(), requests.end(), [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) { return a.first > b.first; });
+			for (const auto& request : requests) {
+				if (pendingCount >= maxPending) {
+					break;
+				}
+				Node& node = nodes[request.second];
+				node.state = NodeState::Pending;
+				// Cracks are at most as high as the error of the coarser neighbour, which is usually no more than one level up
+				const float parentError = (node.parent != invalidIndex) ? nodes[node.parent].error : 0.0f;
+				const float skirtDepth = std::max(2.0f * parentError / std::max(fabsf(settings.scale.y), FLT_MIN), 1.0f / 256.0f);
+				const ChunkRequest chunkRequest{ request.second, node.x, node.y, node.size, skirtDepth };
+				chunkJobs.push_back(jobSystem->schedule([this, chunkRequest]() {
+					ChunkMesh mesh;
+					generateChunk(chunkRequest, mesh);
+					std::lock_guard<std::mutex> lock(finishedMutex);
+					finishedMeshes.push_back(std::move(mesh));
+				}));
+				pendingCount++;
+			}
+		}
+
+		uint32_t uploads = 0;
+		while (!readyMeshes.empty() && (uploads < settings.maxUploadsPerFrame)) {
+			integrate(readyMeshes.front());
+			readyMeshes.pop_front();
+			pendingCount--;
+			uploads++;
+		}
+
+		statistics.nodeCount = static_cast<uint32_t>(nodes.size());
+		statistics.residentChunks = static_cast<uint32_t>(slotOwners.size() - freeSlots.size());
+		statistics.drawnChunks = static_cast<uint32_t>(drawList.size());
+		statistics.pendingChunks = pendingCount;
+		statistics.uploadsLastFrame = static_cast<uint32_t>(pendingCopies.size());
+	}
+
+	void ChunkedTerrain::recordUploads(VkCommandBuffer commandBuffer)
+	{
+		if (pendingCopies.empty()) {
+			return;
+		}
+		// Slots may be reused by evicted chunks that earlier frames still read from
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer.buffer, vertexBuffer.buffer, static_cast<uint32_t>(pendingCopies.size()), pendingCopies.data());
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = vertexBuffer.buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		pendingCopies.clear();
+	}
+
+	void ChunkedTerrain::draw(VkCommandBuffer commandBuffer)
+	{
+		if (drawList.empty()) {
+			return;
+		}
+		const VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		for (const uint32_t nodeIndex : drawList) {
+			vkCmdDrawIndexed(commandBuffer, chunkIndexCount, 1, 0, static_cast<int32_t>(nodes[nodeIndex].slot * chunkVertexCount), 0);
+		}
+	}
+
+	void ChunkedTerrain::generateChunk(const ChunkRequest& request, ChunkMesh& mesh) const
+	{
+		const uint32_t n = settings.chunkResolution;
+		const uint32_t stride = request.size / n;
+		const int64_t maxSample = static_cast<int64_t>(fieldSize) - 1;
+		auto sample = [&](int64_t x, int64_t y) {
+			return source->getHeight(static_cast<uint32_t>(std::max<int64_t>(0, std::min(x, maxSample))), static_cast<uint32_t>(std::max<int64_t>(0, std::min(y, maxSample))));
+		};
+
+		// Chunk grid with a border of one sample for the normals
+		const uint32_t gridSize = n + 3;
+		std::vector<float> grid(gridSize * gridSize);
+		for (uint32_t y = 0; y < gridSize; y++) {
+			for (uint32_t x = 0; x < gridSize; x++) {
+				grid[y * gridSize + x] = sample(static_cast<int64_t>(request.x) + (static_cast<int64_t>(x) - 1) * stride, static_cast<int64_t>(request.y) + (static_cast<int64_t>(y) - 1) * stride);
+			}
+		}
+		auto height = [&](int32_t x, int32_t y) { return grid[(y + 1) * gridSize + (x + 1)]; };
+
+		float minHeight = FLT_MAX;
+		float maxHeight = -FLT_MAX;
+		for (int32_t y = 0; y <= static_cast<int32_t>(n); y++) {
+			for (int32_t x = 0; x <= static_cast<int32_t>(n); x++) {
+				minHeight = std::min(minHeight, height(x, y));
+				maxHeight = std::max(maxHeight, height(x, y));
+			}
+		}
+
+		// Geometric error: deviation of the samples the next finer level adds (edge midpoints and quad centers) from this chunk's triangles
+		float error = 0.0f;
+		if (stride > 1) {
+			const uint32_t half = stride / 2;
+			auto measure = [&](int64_t x, int64_t y, float interpolated) {
+				const float h = sample(x, y);
+				error = std::max(error, fabsf(h - interpolated));
+				minHeight = std::min(minHeight, h);
+				maxHeight = std::max(maxHeight, h);
+			};
+			for (uint32_t y = 0; y <= n; y++) {
+				for (uint32_t x = 0; x <= n; x++) {
+					const int64_t sx = static_cast<int64_t>(request.x) + x * stride;
+					const int64_t sy = static_cast<int64_t>(request.y) + y * stride;
+					if (x < n) {
+						measure(sx + half, sy, 0.5f * (height(x, y) + height(x + 1, y)));
+					}
+					if (y < n) {
+						measure(sx, sy + half, 0.5f * (height(x, y) + height(x, y + 1)));
+					}
+					if ((x < n) && (y < n)) {
+						measure(sx + half, sy + half, 0.5f * (height(x, y) + height(x + 1, y + 1)));
+					}
+				}
+			}
+		}
+
+		const glm::vec3 origin = getOrigin();
+		const glm::vec3& scale = settings.scale;
+		// Normals point towards increasing height, which is -y if the height scale is negative
+		const float up = (scale.y < 0.0f) ? -1.0f : 1.0f;
+		mesh.vertices.resize(chunkVertexCount);
+		for (uint32_t y = 0; y <= n; y++) {
+			for (uint32_t x = 0; x <= n; x++) {
+				const uint32_t sx = request.x + x * stride;
+				const uint32_t sy = request.y + y * stride;
+				Vertex& vertex = mesh.vertices[y * (n + 1) + x];
+				vertex.pos = glm::vec3(origin.x + sx * scale.x, height(x, y) * scale.y, origin.z + sy * scale.z);
+				const float dx = (height(x + 1, y) - height(x - 1, y)) * scale.y / (2.0f * stride * scale.x);
+				const float dz = (height(x, y + 1) - height(x, y - 1)) * scale.y / (2.0f * stride * scale.z);
+				vertex.normal = glm::normalize(glm::vec3(-dx, 1.0f, -dz)) * up;
+				vertex.uv = glm::vec2(static_cast<float>(sx), static_cast<float>(sy)) / static_cast<float>(fieldSize) * settings.uvScale;
+			}
+		}
+		const float skirtDepth = std::max(request.skirtDepth, 2.0f * error);
+		for (uint32_t k = 0; k < 4 * n; k++) {
+			const glm::uvec2 border = perimeterVertex(k, n);
+			Vertex vertex = mesh.vertices[border.y * (n + 1) + border.x];
+			vertex.pos.y = (height(border.x, border.y) - skirtDepth) * scale.y;
+			mesh.vertices[(n + 1) * (n + 1) + k] = vertex;
+		}
+
+		mesh.node = request.node;
+		mesh.minHeight = minHeight - skirtDepth;
+		mesh.maxHeight = maxHeight;
+		mesh.error = error * fabsf(scale.y);
+	}
+}
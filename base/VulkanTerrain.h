@@ -0,0 +1,239 @@
+/*
+* Vulkan chunked terrain
+*
+* Splits a large heightfield into tiles, each refined by a quadtree of chunks with per node bounds and geometric error
+* Chunk meshes are generated as jobs on a job system and streamed in and out around the camera within a fixed memory budget
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "frustum.hpp"
+#include "jobsystem.hpp"
+
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	/**
+	* @brief Source of the height samples for a chunked terrain
+	* @note getHeight() is called from the job system's threads and has to be thread safe
+	*/
+	class TerrainHeightSource
+	{
+	public:
+		virtual ~TerrainHeightSource() = default;
+		/** @return Number of samples along each side of the (square) heightfield */
+		virtual uint32_t getSize() const = 0;
+		/** @return Normalized height (0.0 .. 1.0) at the sample, coordinates are always smaller than getSize() */
+		virtual float getHeight(uint32_t x, uint32_t y) const = 0;
+	};
+
+	/**
+	* @brief Height source reading a single channel 16 bit KTX heightmap
+	* @note The heightmap can be sampled at a higher virtual resolution than it's stored at, samples are then interpolated bilinearly with optional procedural detail added on top
+	*/
+	class TerrainHeightMapSource : public TerrainHeightSource
+	{
+	public:
+		/**
+		* Load the heightmap
+		*
+		* @param filename KTX file containing a single channel 16 bit heightmap (e.g. VK_FORMAT_R16_UNORM)
+		* @param virtualSize Number of samples per side the terrain sees, 0 to use the heightmap's own size
+		* @param detailAmplitude Amplitude of the value noise added to interpolated samples (relative to the full height range)
+		*/
+		TerrainHeightMapSource(const std::string& filename, uint32_t virtualSize = 0, float detailAmplitude = 0.0f);
+
+		uint32_t getSize() const override;
+		float getHeight(uint32_t x, uint32_t y) const override;
+
+	private:
+		std::vector<uint16_t> heights;
+		uint32_t dim = 0;
+		uint32_t virtualSize = 0;
+		float detailAmplitude = 0.0f;
+
+		float getHeightmapSample(int32_t x, int32_t y) const;
+		float getDetail(uint32_t x, uint32_t y) const;
+	};
+
+	/**
+	* @brief Streamed terrain made of quadtree chunks with a shared index buffer and skirts to hide cracks between levels of detail
+	* @note Per frame usage: update() with the current camera, recordUploads() outside of a render pass, then draw() inside the render pass
+	* @note Uses the vertex layout given by Vertex, drawn as an indexed triangle list (16 bit indices) from a single vertex buffer
+	*/
+	class ChunkedTerrain
+	{
+	public:
+		struct Vertex {
+			glm::vec3 pos;
+			glm::vec3 normal;
+			glm::vec2 uv;
+		};
+
+		struct Settings {
+			/** @brief Samples along each side of a root tile, the heightfield is split into tiles that each get their own quadtree */
+			uint32_t tileSize = 2048;
+			/** @brief Quads along each side of a chunk mesh (power of two, at most 128), all chunks share the same index buffer */
+			uint32_t chunkResolution = 32;
+			/** @brief World space size of a sample (x, z) and of the full height range (y, may be negative) */
+			glm::vec3 scale = glm::vec3(1.0f);
+			float uvScale = 1.0f;
+			/** @brief Device memory for chunk vertices, limits the number of resident chunks */
+			VkDeviceSize memoryBudget = 64 * 1024 * 1024;
+			/** @brief Chunks are refined until their geometric error projects to less than this many pixels */
+			float pixelError = 2.0f;
+			/** @brief Job system the chunk meshes are generated on, nullptr to use the device's shared job system (must have been created on the thread calling update()) */
+			vks::JobSystem* jobSystem = nullptr;
+			/** @brief Upper limit for chunks uploaded within a single frame */
+			uint32_t maxUploadsPerFrame = 16;
+			/** @brief Number of frames that may be in flight, upload staging memory is allocated per frame */
+			uint32_t frameCount = 1;
+		};
+
+		struct Statistics {
+			uint32_t nodeCount = 0;
+			uint32_t residentChunks = 0;
+			uint32_t chunkCapacity = 0;
+			uint32_t drawnChunks = 0;
+			uint32_t pendingChunks = 0;
+			uint32_t uploadsLastFrame = 0;
+			uint64_t evictedChunks = 0;
+			VkDeviceSize vertexMemory = 0;
+		};
+
+		ChunkedTerrain() = default;
+		~ChunkedTerrain();
+		ChunkedTerrain(const ChunkedTerrain&) = delete;
+		ChunkedTerrain& operator=(const ChunkedTerrain&) = delete;
+
+		/**
+		* Create the buffers
+		*
+		* @param device Vulkan device to create the buffers on
+		* @param copyQueue Queue used to upload the shared index buffer
+		* @param source Height samples, must outlive the terrain
+		* @param settings Tiling, level of detail and streaming settings
+		*/
+		void create(vks::VulkanDevice* device, VkQueue copyQueue, const TerrainHeightSource* source, const Settings& settings);
+		/** @brief Wait for the chunks being generated and release all resources, the device must not use the terrain anymore */
+		void destroy();
+
+		/**
+		* Select the chunks to draw for the camera, schedule missing chunks for generation and stage finished chunks for upload
+		*
+		* @param projection Projection matrix of the camera
+		* @param view View matrix of the camera
+		* @param viewportHeight Height of the viewport in pixels, used to project the geometric error
+		* @param frameIndex Index of the frame the following recordUploads() and draw() calls are recorded for (0 .. frameCount - 1)
+		*/
+		void update(const glm::mat4& projection, const glm::mat4& view, float viewportHeight, uint32_t frameIndex);
+		/** @brief Record the copies of chunks staged by update(), has to be recorded outside of a render pass before draw() */
+		void recordUploads(VkCommandBuffer commandBuffer);
+		/** @brief Draw the chunks selected by update(), the pipeline and descriptor sets have to be bound by the caller */
+		void draw(VkCommandBuffer commandBuffer);
+
+		const Statistics& getStatistics() const;
+		/** @return World space position of the terrain's minimum corner (the terrain is centered around the origin in x and z) */
+		glm::vec3 getOrigin() const;
+
+	private:
+		static const uint32_t invalidIndex = UINT32_MAX;
+
+		enum class NodeState : uint8_t { Unloaded, Pending, Resident };
+
+		struct Node {
+			/** @brief Sample coordinates of the node's minimum corner and number of samples covered along each side */
+			uint32_t x = 0;
+			uint32_t y = 0;
+			uint32_t size = 0;
+			uint32_t level = 0;
+			uint32_t parent = invalidIndex;
+			/** @brief Children are allocated on first refinement as four consecutive nodes */
+			uint32_t firstChild = invalidIndex;
+			/** @brief World space bounds, estimated from the parent until the node's mesh has been generated */
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			/** @brief World space height error of the node's mesh, the larger of its deviation from the next finer level and the error of any generated descendant, so it never decreases towards the root */
+			float error = 0.0f;
+			/** @brief Largest error of the descendants generated so far, kept when they're evicted */
+			float descendantError = 0.0f;
+			NodeState state = NodeState::Unloaded;
+			uint32_t residentChildren = 0;
+			uint32_t slot = invalidIndex;
+			uint64_t lastUsed = 0;
+		};
+
+		/** @brief Everything a job needs to generate a chunk, jobs never access the node array as it may grow */
+		struct ChunkRequest {
+			uint32_t node;
+			uint32_t x;
+			uint32_t y;
+			uint32_t size;
+			float skirtDepth;
+		};
+
+		struct ChunkMesh {
+			uint32_t node;
+			std::vector<Vertex> vertices;
+			float minHeight;
+			float maxHeight;
+			float error;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		const TerrainHeightSource* source = nullptr;
+		Settings settings;
+		uint32_t fieldSize = 0;
+		uint32_t chunkVertexCount = 0;
+		uint32_t chunkIndexCount = 0;
+		VkDeviceSize chunkBufferSize = 0;
+
+		std::vector<Node> nodes;
+		uint32_t rootCount = 0;
+		uint64_t frameCounter = 0;
+		uint32_t frameIndex = 0;
+		vks::Frustum frustum;
+
+		/** @brief Chunk vertices are stored in fixed size slots of a single device local buffer */
+		vks::Buffer vertexBuffer;
+		vks::Buffer indexBuffer;
+		vks::Buffer stagingBuffer;
+		std::vector<uint32_t> slotOwners;
+		std::vector<uint32_t> freeSlots;
+		std::vector<VkBufferCopy> pendingCopies;
+		std::vector<uint32_t> drawList;
+		/** @brief Finished meshes that haven't been uploaded yet due to the per frame upload limit */
+		std::deque<ChunkMesh> readyMeshes;
+		Statistics statistics;
+
+		vks::JobSystem* jobSystem = nullptr;
+		/** @brief Chunk generation jobs that may not have finished yet */
+		std::vector<vks::JobHandle> chunkJobs;
+		/** @brief Protects finishedMeshes, which the jobs append to */
+		std::mutex finishedMutex;
+		std::vector<ChunkMesh> finishedMeshes;
+		uint32_t pendingCount = 0;
+
+		void createIndexBuffer(VkQueue copyQueue);
+		void ensureChildren(uint32_t nodeIndex);
+		float getProjectedError(const Node& node, const glm::vec3& cameraPosition, float projectionScale) const;
+		void select(uint32_t nodeIndex, const glm::vec3& cameraPosition, float projectionScale, std::vector<std::pair<float, uint32_t>>& requests);
+		uint32_t acquireSlot();
+		void integrate(ChunkMesh& mesh);
+		void generateChunk(const ChunkRequest& request, ChunkMesh& mesh) const;
+	};
+}
@@ -41,6 +41,8 @@ class Texture
 	uint32_t              layerCount;
 	VkDescriptorImageInfo descriptor;
 	VkSampler             sampler;
+	/** @brief Range of the device's memory arena backing the image (deviceMemory is set to the arena page) */
+	MemoryAllocation      allocation;
 
 	void      updateDescriptor();
 	void      destroy();
@@ -0,0 +1,671 @@
+/*
+* Vulkan asynchronous texture streaming
+*
+* Decodes textures on background threads and uploads them in batches through a persistent staging ring buffer,
+* using the dedicated transfer queue (if available) with a queue family ownership transfer to the graphics queue
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTextureStreamer.h"
+#include "VulkanTools.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <ktx.h>
+#include "stb_image.h"
+
+namespace vks
+{
+	namespace
+	{
+		bool readFile(const std::string& filename, std::vector<unsigned char>& data)
+		{
+#if defined(__ANDROID__)
+			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+			if (!asset) {
+				return false;
+			}
+			data.resize(AAsset_getLength(asset));
+			AAsset_read(asset, data.data(), data.size());
+			AAsset_close(asset);
+			return !data.empty();
+#else
+			std::ifstream file(filename, std::ios::binary | std::ios::ate);
+			if (!file.is_open()) {
+				return false;
+			}
+			data.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0, std::ios::beg);
+			return file.read(reinterpret_cast<char*>(data.data()), data.size()) && !data.empty();
+#endif
+		}
+
+		VkImageMemoryBarrier imageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, uint32_t baseMipLevel, uint32_t levelCount)
+		{
+			VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+			barrier.image = image;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcAccessMask = srcAccessMask;
+			barrier.dstAccessMask = dstAccessMask;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseMipLevel, levelCount, 0, 1 };
+			return barrier;
+		}
+	}
+
+	/**
+	* Create the streamer's GPU resources and start the decode threads
+	*
+	* @param device Device to create the textures on
+	* @param graphicsQueue Queue the textures are used on, also used for mip map generation
+	*
+	* @note The dedicated transfer queue is only available if the device has been created with VK_QUEUE_TRANSFER_BIT requested, otherwise uploads go through the graphics queue
+	*/
+	void TextureStreamer::create(vks::VulkanDevice* device, VkQueue graphicsQueue)
+	{
+		this->device = device;
+		this->graphicsQueue = graphicsQueue;
+
+		graphicsCommandPool = device->createCommandPool(device->queueFamilyIndices.graphics);
+		ownershipTransfer = device->queueFamilyIndices.transfer != device->queueFamilyIndices.graphics;
+		if (ownershipTransfer) {
+			vkGetDeviceQueue(device->logicalDevice, device->queueFamilyIndices.transfer, 0, &transferQueue);
+			transferCommandPool = device->createCommandPool(device->queueFamilyIndices.transfer);
+		} else {
+			transferQueue = graphicsQueue;
+		}
+
+		stagingAlignment = std::max<VkDeviceSize>(16, device->properties.limits.optimalBufferCopyOffsetAlignment);
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging, stagingSize));
+		VK_CHECK_RESULT(staging.map());
+		stagingHead = 0;
+		stagingUsed = 0;
+
+		createPlaceholder();
+
+		uint32_t threadCount = decodeThreadCount;
+		if (threadCount == 0) {
+			threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		}
+		stopping = false;
+		for (uint32_t i = 0; i < threadCount; i++) {
+			decodeThreads.push_back(std::thread(&TextureStreamer::decodeLoop, this));
+		}
+	}
+
+	/**
+	* Stop the decode threads, wait for all submitted uploads and release the streamer's resources
+	*
+	* @note Requests that haven't been uploaded yet are dropped, their textures keep the placeholder descriptor (which becomes invalid)
+	*/
+	void TextureStreamer::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+			requestQueue.clear();
+		}
+		requestCondition.notify_all();
+		for (auto& thread : decodeThreads) {
+			thread.join();
+		}
+		decodeThreads.clear();
+		decodedQueue.clear();
+		uploadQueue.clear();
+
+		while (!batchesInFlight.empty()) {
+			retireBatches(true);
+		}
+		for (auto& batch : freeBatches) {
+			vkDestroyFence(device->logicalDevice, batch.fence, nullptr);
+			vkDestroySemaphore(device->logicalDevice, batch.transferComplete, nullptr);
+		}
+		freeBatches.clear();
+		pendingCount = 0;
+
+		vkDestroyCommandPool(device->logicalDevice, graphicsCommandPool, nullptr);
+		if (transferCommandPool != VK_NULL_HANDLE) {
+			vkDestroyCommandPool(device->logicalDevice, transferCommandPool, nullptr);
+			transferCommandPool = VK_NULL_HANDLE;
+		}
+		staging.destroy();
+		placeholder.destroy();
+		device = nullptr;
+	}
+
+	/**
+	* Request a texture to be loaded from a file
+	*
+	* @param filename File to load, .ktx files are loaded with all their mip levels, other formats are decoded with stb_image and get a generated mip chain
+	* @param format Vulkan format of the image data stored in a .ktx file (images decoded with stb_image are always VK_FORMAT_R8G8B8A8_UNORM)
+	* @param target Texture that receives the image, it uses the placeholder descriptor until the image is resident
+	* @param addressMode Address mode of the texture's sampler
+	* @param onResident Optional callback invoked from update() once the texture can be used
+	*/
+	void TextureStreamer::requestFile(const std::string& filename, VkFormat format, vks::Texture* target, VkSamplerAddressMode addressMode, ResidentCallback onResident)
+	{
+		Request request;
+		const size_t extension = filename.find_last_of('.');
+		request.sourceType = ((extension != std::string::npos) && (filename.substr(extension + 1) == "ktx")) ? SourceType::KtxFile : SourceType::EncodedFile;
+		request.filename = filename;
+		request.name = filename;
+		request.format = format;
+		request.target = target;
+		request.addressMode = addressMode;
+		request.onResident = onResident;
+		enqueue(std::move(request));
+	}
+
+	/**
+	* Request a texture to be decoded from an image file stored in memory (e.g. a png or jpg embedded in a glTF file)
+	*
+	* @param data Encoded image data, decoded with stb_image on a background thread
+	* @param name Optional name of the image (e.g. its name in a glTF file), used to identify it in error messages
+	*/
+	void TextureStreamer::requestEncoded(std::vector<unsigned char>&& data, vks::Texture* target, VkSamplerAddressMode addressMode, ResidentCallback onResident, const std::string& name)
+	{
+		Request request;
+		request.sourceType = SourceType::EncodedMemory;
+		request.name = name;
+		request.data = std::move(data);
+		request.target = target;
+		request.addressMode = addressMode;
+		request.onResident = onResident;
+		enqueue(std::move(request));
+	}
+
+	/**
+	* Request a texture to be created from already decoded pixels
+	*
+	* @param pixels RGBA8 pixel data
+	* @param name Optional name of the image, used to identify it in error messages
+	*/
+	void TextureStreamer::requestPixels(std::vector<unsigned char>&& pixels, uint32_t width, uint32_t height, vks::Texture* target, VkSamplerAddressMode addressMode, ResidentCallback onResident, const std::string& name)
+	{
+		assert(pixels.size() >= static_cast<size_t>(width) * height * 4);
+		Request request;
+		request.sourceType = SourceType::Pixels;
+		request.name = name;
+		request.data = std::move(pixels);
+		request.width = width;
+		request.height = height;
+		request.target = target;
+		request.addressMode = addressMode;
+		request.onResident = onResident;
+		enqueue(std::move(request));
+	}
+
+	/**
+	* Upload decoded images and finish uploads whose batch has been executed by the GPU
+	*
+	* @note Must be called from the thread that submits to the graphics queue, as it submits the upload batches to the graphics (and transfer) queue
+	*/
+	void TextureStreamer::update()
+	{
+		retireBatches(false);
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			for (auto& image : decodedQueue) {
+				uploadQueue.push_back(std::move(image));
+			}
+			decodedQueue.clear();
+		}
+		if (uploadQueue.empty()) {
+			return;
+		}
+
+		Batch batch;
+		bool batchStarted = false;
+		VkDeviceSize uploaded = 0;
+		while (!uploadQueue.empty()) {
+			DecodedImage& image = uploadQueue.front();
+			if (image.failed) {
+				std::cerr << "Could not load texture \"" << (image.request.name.empty() ? "unnamed" : image.request.name) << "\", keeping the placeholder\n";
+				pendingCount--;
+				uploadQueue.pop_front();
+				continue;
+			}
+
+			const VkDeviceSize size = image.data.size();
+			if ((uploaded > 0) && (uploaded + size > uploadBudget)) {
+				break;
+			}
+			if (!batchStarted) {
+				batch = acquireBatch();
+				batchStarted = true;
+			}
+			VkBuffer buffer;
+			VkDeviceSize offset = 0;
+			if (size > stagingSize) {
+				// Larger than the whole ring, use a staging buffer of its own that lives as long as the batch
+				vks::Buffer temporary;
+				VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &temporary, size, image.data.data()));
+				buffer = temporary.buffer;
+				batch.temporaryStaging.push_back(temporary);
+			} else {
+				// Wait for older batches to free up ring space
+				if (!allocateStaging(size, &offset, batch)) {
+					break;
+				}
+				memcpy(static_cast<uint8_t*>(staging.mapped) + offset, image.data.data(), size);
+				buffer = staging.buffer;
+			}
+			uploaded += size;
+			recordUpload(batch, image, buffer, offset);
+			batch.textures.push_back(std::move(image.request));
+			uploadQueue.pop_front();
+		}
+
+		if (batchStarted) {
+			submit(batch);
+		}
+	}
+
+	/** @brief Block until all requested textures are resident, the calling thread uploads while the decode threads work */
+	void TextureStreamer::flush()
+	{
+		while (pendingCount > 0) {
+			update();
+			if (pendingCount == 0) {
+				break;
+			}
+			if (!batchesInFlight.empty()) {
+				retireBatches(true);
+			} else if (uploadQueue.empty()) {
+				std::unique_lock<std::mutex> lock(queueMutex);
+				decodedCondition.wait(lock, [this] { return !decodedQueue.empty(); });
+			}
+		}
+	}
+
+	/** @return Number of requested textures that are not resident yet */
+	uint32_t TextureStreamer::getPendingCount() const
+	{
+		return pendingCount;
+	}
+
+	/** @return Descriptor of the texture bound to requests until their image is resident */
+	const VkDescriptorImageInfo& TextureStreamer::getPlaceholderDescriptor() const
+	{
+		return placeholder.descriptor;
+	}
+
+	void TextureStreamer::createPlaceholder()
+	{
+		// Neutral grey, uploaded through the regular path
+		Request request;
+		request.sourceType = SourceType::Pixels;
+		request.data = { 128, 128, 128, 255 };
+		request.width = 1;
+		request.height = 1;
+		request.target = &placeholder;
+		placeholder.device = device;
+		pendingCount++;
+		DecodedImage image;
+		decode(std::move(request), image);
+		uploadQueue.push_back(std::move(image));
+		flush();
+	}
+
+	void TextureStreamer::enqueue(Request&& request)
+	{
+		assert(device && request.target);
+		// The texture is bound to the placeholder until the real image is resident
+		request.target->device = device;
+		request.target->descriptor = placeholder.descriptor;
+		pendingCount++;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			requestQueue.push_back(std::move(request));
+		}
+		requestCondition.notify_one();
+	}
+
+	void TextureStreamer::decodeLoop()
+	{
+		while (true) {
+			Request request;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				requestCondition.wait(lock, [this] { return stopping || !requestQueue.empty(); });
+				if (stopping) {
+					return;
+				}
+				request = std::move(requestQueue.front());
+				requestQueue.pop_front();
+			}
+			DecodedImage image;
+			decode(std::move(request), image);
+			{
+				std::lock_guard<std::mutex> lock(queueMutex);
+				decodedQueue.push_back(std::move(image));
+			}
+			decodedCondition.notify_all();
+		}
+	}
+
+	/** @brief Load and decode the image data of a request, runs on the decode threads */
+	void TextureStreamer::decode(Request&& request, DecodedImage& image)
+	{
+		std::vector<unsigned char> encoded;
+		switch (request.sourceType) {
+		case SourceType::KtxFile:
+		{
+			if (!readFile(request.filename, encoded)) {
+				image.failed = true;
+				break;
+			}
+			ktxTexture* ktxTexture = nullptr;
+			if (ktxTexture_CreateFromMemory(encoded.data(), encoded.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture) != KTX_SUCCESS) {
+				image.failed = true;
+				break;
+			}
+			image.format = request.format;
+			image.width = ktxTexture->baseWidth;
+			image.height = ktxTexture->baseHeight;
+			image.mipLevels = ktxTexture->numLevels;
+			const ktx_uint8_t* data = ktxTexture_GetData(ktxTexture);
+			image.data.assign(data, data + ktxTexture_GetSize(ktxTexture));
+			for (uint32_t i = 0; i < image.mipLevels; i++) {
+				ktx_size_t offset;
+				ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
+				VkBufferImageCopy region{};
+				region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+				region.imageExtent = { std::max(1u, image.width >> i), std::max(1u, image.height >> i), 1 };
+				region.bufferOffset = offset;
+				image.regions.push_back(region);
+			}
+			ktxTexture_Destroy(ktxTexture);
+			break;
+		}
+		case SourceType::EncodedFile:
+		case SourceType::EncodedMemory:
+		{
+			if (request.sourceType == SourceType::EncodedFile) {
+				if (!readFile(request.filename, encoded)) {
+					image.failed = true;
+					break;
+				}
+			} else {
+				encoded = std::move(request.data);
+			}
+			int width, height, components;
+			stbi_uc* pixels = stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &width, &height, &components, STBI_rgb_alpha);
+			if (!pixels) {
+				image.failed = true;
+				break;
+			}
+			image.width = static_cast<uint32_t>(width);
+			image.height = static_cast<uint32_t>(height);
+			image.data.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+			stbi_image_free(pixels);
+			break;
+		}
+		case SourceType::Pixels:
+			image.width = request.width;
+			image.height = request.height;
+			image.data = std::move(request.data);
+			break;
+		}
+
+		if (!image.failed && image.regions.empty()) {
+			// Only the base level is stored, the rest of the mip chain is generated on the GPU
+			image.format = VK_FORMAT_R8G8B8A8_UNORM;
+			image.mipLevels = static_cast<uint32_t>(floor(log2(std::max(image.width, image.height))) + 1.0);
+			VkBufferImageCopy region{};
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			region.imageExtent = { image.width, image.height, 1 };
+			image.regions.push_back(region);
+		}
+		image.request = std::move(request);
+		image.request.data.clear();
+		image.request.data.shrink_to_fit();
+	}
+
+	/**
+	* Take a range from the staging ring, wrapping around to the start if the end of the ring is too small
+	*
+	* @return False if the ring doesn't have enough free space until older batches have finished
+	*/
+	bool TextureStreamer::allocateStaging(VkDeviceSize size, VkDeviceSize* offset, Batch& batch)
+	{
+		if (stagingUsed == 0) {
+			stagingHead = 0;
+		}
+		if (stagingUsed == stagingSize) {
+			return false;
+		}
+		const VkDeviceSize tail = (stagingHead + stagingSize - stagingUsed) % stagingSize;
+		const VkDeviceSize alignedHead = (stagingHead + stagingAlignment - 1) / stagingAlignment * stagingAlignment;
+		VkDeviceSize consumed;
+		if (stagingHead >= tail) {
+			// Free space is split into [head, end) and [0, tail)
+			if (alignedHead + size <= stagingSize) {
+				*offset = alignedHead;
+				consumed = alignedHead + size - stagingHead;
+			} else if (size <= tail) {
+				*offset = 0;
+				consumed = stagingSize - stagingHead + size;
+			} else {
+				return false;
+			}
+		} else {
+			if (alignedHead + size > tail) {
+				return false;
+			}
+			*offset = alignedHead;
+			consumed = alignedHead + size - stagingHead;
+		}
+		stagingHead = *offset + size;
+		stagingUsed += consumed;
+		batch.stagingBytes += consumed;
+		return true;
+	}
+
+	TextureStreamer::Batch TextureStreamer::acquireBatch()
+	{
+		Batch batch;
+		if (!freeBatches.empty()) {
+			batch = std::move(freeBatches.back());
+			freeBatches.pop_back();
+			VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &batch.fence));
+			VK_CHECK_RESULT(vkResetCommandBuffer(batch.graphicsCommandBuffer, 0));
+			if (ownershipTransfer) {
+				VK_CHECK_RESULT(vkResetCommandBuffer(batch.transferCommandBuffer, 0));
+			}
+		} else {
+			batch.graphicsCommandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, graphicsCommandPool);
+			if (ownershipTransfer) {
+				batch.transferCommandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, transferCommandPool);
+				VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+				VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCreateInfo, nullptr, &batch.transferComplete));
+			}
+			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCreateInfo, nullptr, &batch.fence));
+		}
+		VkCommandBufferBeginInfo beginInfo = vks::initializers::commandBufferBeginInfo();
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(batch.graphicsCommandBuffer, &beginInfo));
+		if (ownershipTransfer) {
+			VK_CHECK_RESULT(vkBeginCommandBuffer(batch.transferCommandBuffer, &beginInfo));
+		}
+		batch.stagingBytes = 0;
+		return batch;
+	}
+
+	/** @brief Create the image for a decoded texture and record its upload (and mip map generation) into the batch */
+	void TextureStreamer::recordUpload(Batch& batch, DecodedImage& image, VkBuffer buffer, VkDeviceSize bufferOffset)
+	{
+		vks::Texture* texture = image.request.target;
+		const uint32_t storedLevels = static_cast<uint32_t>(image.regions.size());
+
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, image.format, &formatProperties);
+		const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		if ((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures) {
+			image.mipLevels = storedLevels;
+		}
+		const bool generateMips = image.mipLevels > storedLevels;
+
+		texture->device = device;
+		texture->width = image.width;
+		texture->height = image.height;
+		texture->mipLevels = image.mipLevels;
+		texture->layerCount = 1;
+		texture->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = image.format;
+		imageCreateInfo.mipLevels = image.mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { image.width, image.height, 1 };
+		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		if (generateMips) {
+			imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		}
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &texture->image));
+		VK_CHECK_RESULT(device->allocateImageMemory(texture->image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture->allocation));
+		texture->deviceMemory = texture->allocation.memory;
+
+		// Copy the stored levels on the transfer queue
+		VkCommandBuffer copyCmd = ownershipTransfer ? batch.transferCommandBuffer : batch.graphicsCommandBuffer;
+		VkImageMemoryBarrier barrier = imageBarrier(texture->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT, 0, image.mipLevels);
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		for (auto& region : image.regions) {
+			region.bufferOffset += bufferOffset;
+		}
+		vkCmdCopyBufferToImage(copyCmd, buffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, storedLevels, image.regions.data());
+
+		// Images without generated mips go straight to their final layout
+		const VkImageLayout uploadedLayout = generateMips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		const VkAccessFlags uploadedAccess = generateMips ? (VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT) : VK_ACCESS_SHADER_READ_BIT;
+		const VkPipelineStageFlags uploadedStage = generateMips ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		if (ownershipTransfer) {
+			// Release the image from the transfer queue family...
+			barrier = imageBarrier(texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, uploadedLayout, VK_ACCESS_TRANSFER_WRITE_BIT, 0, 0, image.mipLevels);
+			barrier.srcQueueFamilyIndex = device->queueFamilyIndices.transfer;
+			barrier.dstQueueFamilyIndex = device->queueFamilyIndices.graphics;
+			vkCmdPipelineBarrier(batch.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			// ...and acquire it on the graphics queue family with a matching barrier
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = uploadedAccess;
+			vkCmdPipelineBarrier(batch.graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, uploadedStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		} else if (!generateMips) {
+			barrier = imageBarrier(texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, 0, image.mipLevels);
+			vkCmdPipelineBarrier(batch.graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		if (generateMips) {
+			// Blitting requires a graphics capable queue, so the mip chain is generated after the image has been acquired
+			VkCommandBuffer blitCmd = batch.graphicsCommandBuffer;
+			barrier = imageBarrier(texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, 0, storedLevels);
+			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			for (uint32_t i = storedLevels; i < image.mipLevels; i++) {
+				VkImageBlit imageBlit{};
+				imageBlit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, 1 };
+				imageBlit.srcOffsets[1] = { int32_t(std::max(1u, image.width >> (i - 1))), int32_t(std::max(1u, image.height >> (i - 1))), 1 };
+				imageBlit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+				imageBlit.dstOffsets[1] = { int32_t(std::max(1u, image.width >> i)), int32_t(std::max(1u, image.height >> i)), 1 };
+				vkCmdBlitImage(blitCmd, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+				barrier = imageBarrier(texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, i, 1);
+				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			}
+			barrier = imageBarrier(texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, 0, image.mipLevels);
+			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCreateInfo.addressModeU = image.request.addressMode;
+		samplerCreateInfo.addressModeV = image.request.addressMode;
+		samplerCreateInfo.addressModeW = image.request.addressMode;
+		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		samplerCreateInfo.maxLod = static_cast<float>(image.mipLevels);
+		// Only enable anisotropic filtering if enabled on the device
+		samplerCreateInfo.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
+		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &texture->sampler));
+
+		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = image.format;
+		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, image.mipLevels, 0, 1 };
+		viewCreateInfo.image = texture->image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &texture->view));
+	}
+
+	void TextureStreamer::submit(Batch& batch)
+	{
+		VK_CHECK_RESULT(vkEndCommandBuffer(batch.graphicsCommandBuffer));
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		if (ownershipTransfer) {
+			VK_CHECK_RESULT(vkEndCommandBuffer(batch.transferCommandBuffer));
+			VkSubmitInfo transferSubmitInfo = vks::initializers::submitInfo();
+			transferSubmitInfo.commandBufferCount = 1;
+			transferSubmitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+			transferSubmitInfo.signalSemaphoreCount = 1;
+			transferSubmitInfo.pSignalSemaphores = &batch.transferComplete;
+			VK_CHECK_RESULT(vkQueueSubmit(transferQueue, 1, &transferSubmitInfo, VK_NULL_HANDLE));
+			// The graphics part (ownership acquire and mip generation) starts once the copies are done
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &batch.transferComplete;
+			submitInfo.pWaitDstStageMask = &waitStageMask;
+		}
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.graphicsCommandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(graphicsQueue, 1, &submitInfo, batch.fence));
+		batchesInFlight.push_back(std::move(batch));
+	}
+
+	/**
+	* Release the staging space of finished batches and switch their textures from the placeholder to the real image
+	*
+	* @param wait Wait for the oldest batch to finish
+	*/
+	void TextureStreamer::retireBatches(bool wait)
+	{
+		while (!batchesInFlight.empty()) {
+			Batch& batch = batchesInFlight.front();
+			if (wait) {
+				VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &batch.fence, VK_TRUE, UINT64_MAX));
+				wait = false;
+			} else if (vkGetFenceStatus(device->logicalDevice, batch.fence) != VK_SUCCESS) {
+				break;
+			}
+			stagingUsed -= batch.stagingBytes;
+			for (auto& buffer : batch.temporaryStaging) {
+				buffer.destroy();
+			}
+			batch.temporaryStaging.clear();
+			for (auto& request : batch.textures) {
+				request.target->updateDescriptor();
+				pendingCount--;
+				if (request.onResident) {
+					request.onResident(request.target);
+				}
+			}
+			batch.textures.clear();
+			freeBatches.push_back(std::move(batch));
+			batchesInFlight.pop_front();
+		}
+	}
+}
@@ -0,0 +1,144 @@
+/*
+* Vulkan asynchronous texture streaming
+*
+* Decodes textures on background threads and uploads them in batches through a persistent staging ring buffer,
+* using the dedicated transfer queue (if available) with a queue family ownership transfer to the graphics queue
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanTexture.h"
+
+namespace vks
+{
+	/**
+	* @brief Streams textures to the GPU without blocking the calling thread
+	* @note Requested textures use the descriptor of a placeholder texture until their image is resident, update() has to be called regularly (e.g. once per frame) from the thread that owns the graphics queue
+	* @note Textures filled by the streamer are owned by the caller and released with Texture::destroy, the placeholder is owned by the streamer
+	*/
+	class TextureStreamer
+	{
+	public:
+		/** @brief Called from update() once a texture is resident, e.g. to replace the placeholder in descriptor sets */
+		typedef std::function<void(vks::Texture* texture)> ResidentCallback;
+
+		/** @brief Size of the persistent staging ring buffer, images that don't fit get a temporary staging buffer */
+		VkDeviceSize stagingSize = 64 * 1024 * 1024;
+		/** @brief Maximum number of bytes copied into the staging ring per update() call, keeps the per-frame cost bounded */
+		VkDeviceSize uploadBudget = 32 * 1024 * 1024;
+		/** @brief Number of background threads decoding images (0 = one per core, leaving one for the calling thread) */
+		uint32_t decodeThreadCount = 0;
+
+		void     create(vks::VulkanDevice* device, VkQueue graphicsQueue);
+		void     destroy();
+		void     requestFile(const std::string& filename, VkFormat format, vks::Texture* target, VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT, ResidentCallback onResident = nullptr);
+		void     requestEncoded(std::vector<unsigned char>&& data, vks::Texture* target, VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT, ResidentCallback onResident = nullptr, const std::string& name = "");
+		void     requestPixels(std::vector<unsigned char>&& pixels, uint32_t width, uint32_t height, vks::Texture* target, VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT, ResidentCallback onResident = nullptr, const std::string& name = "");
+		void     update();
+		void     flush();
+		uint32_t getPendingCount() const;
+		const VkDescriptorImageInfo& getPlaceholderDescriptor() const;
+
+	private:
+		enum class SourceType { KtxFile, EncodedFile, EncodedMemory, Pixels };
+
+		struct Request
+		{
+			SourceType sourceType;
+			std::string filename;
+			/** @brief Identifies the texture in error messages, the file name for file requests */
+			std::string name;
+			std::vector<unsigned char> data;
+			VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			vks::Texture* target = nullptr;
+			VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+			ResidentCallback onResident;
+		};
+
+		/** @brief Image data ready to be copied to the GPU, produced by the decode threads */
+		struct DecodedImage
+		{
+			Request request;
+			bool failed = false;
+			std::vector<unsigned char> data;
+			VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t mipLevels = 1;
+			/** @brief Mip levels stored in data (offsets relative to the start of data), the remaining levels are generated by blitting */
+			std::vector<VkBufferImageCopy> regions;
+		};
+
+		/** @brief Group of uploads submitted together, the staging ring range is reused once the batch's fence signals */
+		struct Batch
+		{
+			VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+			VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+			VkSemaphore transferComplete = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			/** @brief Bytes of the staging ring used by this batch (including alignment and wrap around padding) */
+			VkDeviceSize stagingBytes = 0;
+			std::vector<Request> textures;
+			std::vector<vks::Buffer> temporaryStaging;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkQueue graphicsQueue = VK_NULL_HANDLE;
+		VkQueue transferQueue = VK_NULL_HANDLE;
+		VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+		VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+		/** @brief True if the transfer queue belongs to a different queue family than the graphics queue */
+		bool ownershipTransfer = false;
+		vks::Texture placeholder{};
+
+		vks::Buffer staging;
+		VkDeviceSize stagingAlignment = 16;
+		/** @brief Next free byte of the staging ring */
+		VkDeviceSize stagingHead = 0;
+		/** @brief Bytes of the staging ring in use by batches in flight, the ring is released in submission order */
+		VkDeviceSize stagingUsed = 0;
+
+		/** @brief Batches submitted to the GPU, oldest first */
+		std::deque<Batch> batchesInFlight;
+		/** @brief Batches ready for reuse */
+		std::vector<Batch> freeBatches;
+		uint32_t pendingCount = 0;
+
+		std::vector<std::thread> decodeThreads;
+		std::deque<Request> requestQueue;
+		std::deque<DecodedImage> decodedQueue;
+		/** @brief Decoded image that didn't fit into the staging ring or upload budget, retried on the next update */
+		std::deque<DecodedImage> uploadQueue;
+		std::mutex queueMutex;
+		std::condition_variable requestCondition;
+		std::condition_variable decodedCondition;
+		bool stopping = false;
+
+		void createPlaceholder();
+		void enqueue(Request&& request);
+		void decodeLoop();
+		void decode(Request&& request, DecodedImage& image);
+		bool allocateStaging(VkDeviceSize size, VkDeviceSize* offset, Batch& batch);
+		Batch acquireBatch();
+		void recordUpload(Batch& batch, DecodedImage& image, VkBuffer buffer, VkDeviceSize bufferOffset);
+		void submit(Batch& batch);
+		void retireBatches(bool wait);
+	};
+}
@@ -7,6 +7,7 @@
  */
 
 #include "VulkanTools.h"
+#include "mappedfile.hpp"
 
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 // iOS & macOS: VulkanExampleBase::getAssetPath() implemented externally to allow access to Objective-C components
@@ -366,55 +367,52 @@ namespace vks
 		// So they need to be loaded via the asset manager
 		VkShaderModule loadShader(AAssetManager* assetManager, const char *fileName, VkDevice device)
 		{
-			// Load shader from compressed asset
-			AAsset* asset = AAssetManager_open(assetManager, fileName, AASSET_MODE_STREAMING);
+			// Use the asset's buffer directly instead of reading it into a copy
+			AAsset* asset = AAssetManager_open(assetManager, fileName, AASSET_MODE_BUFFER);
 			assert(asset);
 			size_t size = AAsset_getLength(asset);
 			assert(size > 0);
 
-			char *shaderCode = new char[size];
-			AAsset_read(asset, shaderCode, size);
-			AAsset_close(asset);
+			const void* shaderCode = AAsset_getBuffer(asset);
+			std::vector<uint32_t> alignedCode;
+			if ((reinterpret_cast<uintptr_t>(shaderCode) % sizeof(uint32_t)) != 0) {
+				// SPIR-V has to be passed as 32 bit words, assets stored at an unaligned offset in the apk need to be copied
+				alignedCode.resize((size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+				memcpy(alignedCode.data(), shaderCode, size);
+				shaderCode = alignedCode.data();
+			}
 
 			VkShaderModule shaderModule;
 			VkShaderModuleCreateInfo moduleCreateInfo;
 			moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 			moduleCreateInfo.pNext = NULL;
 			moduleCreateInfo.codeSize = size;
-			moduleCreateInfo.pCode = (uint32_t*)shaderCode;
+			moduleCreateInfo.pCode = (const uint32_t*)shaderCode;
 			moduleCreateInfo.flags = 0;
 
 			VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
 
-			delete[] shaderCode;
+			AAsset_close(asset);
 
 			return shaderModule;
 		}
 #else
 		VkShaderModule loadShader(const char *fileName, VkDevice device)
 		{
-			std::ifstream is(fileName, std::ios::binary | std::ios::in | std::ios::ate);
-
-			if (is.is_open())
+			// The mapping is page aligned, so the file's contents can be passed to the driver without reading them into a copy
+			vks::MappedFile file;
+			if (file.open(fileName))
 			{
-				size_t size = is.tellg();
-				is.seekg(0, std::ios::beg);
-				char* shaderCode = new char[size];
-				is.read(shaderCode, size);
-				is.close();
-
-				assert(size > 0);
+				assert((file.size() % sizeof(uint32_t)) == 0);
 
 				VkShaderModule shaderModule;
 				VkShaderModuleCreateInfo moduleCreateInfo{};
 				moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-				moduleCreateInfo.codeSize = size;
-				moduleCreateInfo.pCode = (uint32_t*)shaderCode;
+				moduleCreateInfo.codeSize = file.size();
+				moduleCreateInfo.pCode = (const uint32_t*)file.data();
 
 				VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
 
-				delete[] shaderCode;
-
 				return shaderModule;
 			}
 			else
@@ -441,5 +439,10 @@ namespace vks
 			return (value + alignment - 1) & ~(alignment - 1);
 		}
 
+		VkDeviceSize alignedVkSize(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
 	}
 }
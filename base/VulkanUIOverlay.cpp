@@ -48,6 +48,8 @@ namespace vks
 		// Dimensions
 		ImGuiIO& io = ImGui::GetIO();
 		io.FontGlobalScale = scale;
+
+		frames.resize(1);
 	}
 
 	UIOverlay::~UIOverlay()	{
@@ -120,21 +122,9 @@ namespace vks
 		viewInfo.subresourceRange.layerCount = 1;
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewInfo, nullptr, &fontView));
 
-		// Staging buffers for font data upload
-		vks::Buffer stagingBuffer;
-
-		VK_CHECK_RESULT(device->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			uploadSize));
-
-		stagingBuffer.map();
-		memcpy(stagingBuffer.mapped, fontData, uploadSize);
-		stagingBuffer.unmap();
-
-		// Copy buffer data to font image
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		// Font data is staged in the device's upload ring
+		VkCommandBuffer copyCmd = device->uploadManager.begin(queue);
+		vks::UploadManager::Staging staging = device->uploadManager.stage(fontData, uploadSize);
 
 		// Prepare for transfer
 		vks::tools::setImageLayout(
@@ -153,10 +143,11 @@ namespace vks
 		bufferCopyRegion.imageExtent.width = texWidth;
 		bufferCopyRegion.imageExtent.height = texHeight;
 		bufferCopyRegion.imageExtent.depth = 1;
+		bufferCopyRegion.bufferOffset = staging.offset;
 
 		vkCmdCopyBufferToImage(
 			copyCmd,
-			stagingBuffer.buffer,
+			staging.buffer,
 			fontImage,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1,
@@ -173,9 +164,7 @@ namespace vks
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 
-		device->flushCommandBuffer(copyCmd, queue, true);
-
-		stagingBuffer.destroy();
+		device->uploadManager.end();
 
 		// Font texture Sampler
 		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
@@ -310,6 +299,26 @@ namespace vks
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 	}
 
+	/**
+	* Set the number of frames that can be in flight, each frame gets its own set of geometry buffers
+	*
+	* @param count Number of frames in flight (1 if the GPU is idle after each frame)
+	*
+	* @note Buffers of frames that are dropped are destroyed, so the GPU must not be using them
+	*/
+	void UIOverlay::setFrameCount(uint32_t count)
+	{
+		assert(count > 0);
+		for (size_t i = count; i < frames.size(); i++) {
+			frames[i].vertexBuffer.unmap();
+			frames[i].indexBuffer.unmap();
+			frames[i].vertexBuffer.destroy();
+			frames[i].indexBuffer.destroy();
+		}
+		frames.resize(count);
+		currentFrame = 0;
+	}
+
 	/** Update vertex and index buffer containing the imGui elements when required */
 	bool UIOverlay::update()
 	{
@@ -318,39 +327,40 @@ namespace vks
 
 		if (!imDrawData) { return false; };
 
-		// Note: Alignment is done inside buffer creation
-		VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
-		VkDeviceSize indexBufferSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
+		if ((imDrawData->TotalVtxCount == 0) || (imDrawData->TotalIdxCount == 0)) {
+			return false;
+		}
 
-		// Update buffers only if vertex or index count has been changed compared to current buffer size
-		if ((vertexBufferSize == 0) || (indexBufferSize == 0)) {
+		FrameGeometry& frame = frames[currentFrame];
+
+		// The draw data only changes when a new ImGui frame has been rendered, which may happen less often than frames are drawn
+		if (frame.drawDataFrame == ImGui::GetFrameCount()) {
 			return false;
 		}
 
-		// Vertex buffer
-		if ((vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCount != imDrawData->TotalVtxCount)) {
-			vertexBuffer.unmap();
-			vertexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vertexBuffer, vertexBufferSize));
-			vertexCount = imDrawData->TotalVtxCount;
-			vertexBuffer.unmap();
-			vertexBuffer.map();
+		// Buffers grow to at least twice their size, so fluctuating geometry (e.g. changing text) doesn't cause a reallocation every frame
+		// Note: Alignment is done inside buffer creation
+		if ((frame.vertexBuffer.buffer == VK_NULL_HANDLE) || (frame.vertexCapacity < imDrawData->TotalVtxCount)) {
+			frame.vertexCapacity = std::max(imDrawData->TotalVtxCount, frame.vertexCapacity * 2);
+			frame.vertexBuffer.unmap();
+			frame.vertexBuffer.destroy();
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &frame.vertexBuffer, frame.vertexCapacity * sizeof(ImDrawVert)));
+			VK_CHECK_RESULT(frame.vertexBuffer.map());
 			updateCmdBuffers = true;
 		}
 
-		// Index buffer
-		if ((indexBuffer.buffer == VK_NULL_HANDLE) || (indexCount < imDrawData->TotalIdxCount)) {
-			indexBuffer.unmap();
-			indexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &indexBuffer, indexBufferSize));
-			indexCount = imDrawData->TotalIdxCount;
-			indexBuffer.map();
+		if ((frame.indexBuffer.buffer == VK_NULL_HANDLE) || (frame.indexCapacity < imDrawData->TotalIdxCount)) {
+			frame.indexCapacity = std::max(imDrawData->TotalIdxCount, frame.indexCapacity * 2);
+			frame.indexBuffer.unmap();
+			frame.indexBuffer.destroy();
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &frame.indexBuffer, frame.indexCapacity * sizeof(ImDrawIdx)));
+			VK_CHECK_RESULT(frame.indexBuffer.map());
 			updateCmdBuffers = true;
 		}
 
-		// Upload data
-		ImDrawVert* vtxDst = (ImDrawVert*)vertexBuffer.mapped;
-		ImDrawIdx* idxDst = (ImDrawIdx*)indexBuffer.mapped;
+		// Upload data (buffers stay mapped for their whole lifetime)
+		ImDrawVert* vtxDst = (ImDrawVert*)frame.vertexBuffer.mapped;
+		ImDrawIdx* idxDst = (ImDrawIdx*)frame.indexBuffer.mapped;
 
 		for (int n = 0; n < imDrawData->CmdListsCount; n++) {
 			const ImDrawList* cmd_list = imDrawData->CmdLists[n];
@@ -361,8 +371,9 @@ namespace vks
 		}
 
 		// Flush to make writes visible to GPU
-		vertexBuffer.flush();
-		indexBuffer.flush();
+		frame.vertexBuffer.flush();
+		frame.indexBuffer.flush();
+		frame.drawDataFrame = ImGui::GetFrameCount();
 
 		return updateCmdBuffers;
 	}
@@ -387,8 +398,8 @@ namespace vks
 		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 
 		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &frames[currentFrame].vertexBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, frames[currentFrame].indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
 
 		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++)
 		{
@@ -417,8 +428,12 @@ namespace vks
 
 	void UIOverlay::freeResources()
 	{
-		vertexBuffer.destroy();
-		indexBuffer.destroy();
+		for (auto& frame : frames) {
+			frame.vertexBuffer.unmap();
+			frame.indexBuffer.unmap();
+			frame.vertexBuffer.destroy();
+			frame.indexBuffer.destroy();
+		}
 		vkDestroyImageView(device->logicalDevice, fontView, nullptr);
 		vkDestroyImage(device->logicalDevice, fontImage, nullptr);
 		vkFreeMemory(device->logicalDevice, fontMemory, nullptr);
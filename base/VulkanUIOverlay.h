@@ -39,10 +39,20 @@ namespace vks
 		VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 		uint32_t subpass = 0;
 
-		vks::Buffer vertexBuffer;
-		vks::Buffer indexBuffer;
-		int32_t vertexCount = 0;
-		int32_t indexCount = 0;
+		/** @brief Persistently mapped vertex and index buffers holding the ImGui geometry of one frame */
+		struct FrameGeometry {
+			vks::Buffer vertexBuffer;
+			vks::Buffer indexBuffer;
+			/** @brief Number of vertices and indices the buffers can hold, buffers grow geometrically and are never shrunk */
+			int32_t vertexCapacity = 0;
+			int32_t indexCapacity = 0;
+			/** @brief ImGui frame whose draw data has been copied into the buffers (-1 if none) */
+			int32_t drawDataFrame = -1;
+		};
+		/** @brief One set of geometry buffers per frame in flight, so the CPU never overwrites buffers the GPU may still read from */
+		std::vector<FrameGeometry> frames;
+		/** @brief Frame in flight that update() writes to and draw() reads from */
+		uint32_t currentFrame = 0;
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaders;
 
@@ -71,7 +81,9 @@ namespace vks
 
 		void preparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass, const VkFormat colorFormat, const VkFormat depthFormat);
 		void prepareResources();
+		void setFrameCount(uint32_t count);
 
+		/** @brief Copy the current ImGui draw data into the buffers of the current frame if it hasn't been copied yet, returns true if buffers have been (re)created */
 		bool update();
 		void draw(const VkCommandBuffer commandBuffer);
 		void resize(uint32_t width, uint32_t height);
@@ -0,0 +1,331 @@
+/*
+* Vulkan upload manager
+*
+* Stages one-shot uploads (buffer contents, texture images) through a persistently mapped ring buffer and records them into
+* shared command buffers, so loading a scene's assets takes a handful of queue submissions instead of one per resource
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanUploadManager.h"
+#include "VulkanDevice.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace vks
+{
+	UploadManager::~UploadManager()
+	{
+		destroy();
+	}
+
+	void UploadManager::create(vks::VulkanDevice* device, bool timelineSemaphore)
+	{
+		this->device = device;
+		vkGetDeviceQueue(device->logicalDevice, device->queueFamilyIndices.graphics, 0, &defaultQueue);
+		commandPool = device->createCommandPool(device->queueFamilyIndices.graphics);
+
+		// Image copies need offsets aligned to the texel (block) size, 16 bytes covers all uncompressed and block compressed formats
+		ringAlignment = std::max<VkDeviceSize>(16, device->properties.limits.optimalBufferCopyOffsetAlignment);
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &ring, ringSize));
+		VK_CHECK_RESULT(ring.map());
+		ringHead = 0;
+		ringUsed = 0;
+
+		vkGetSemaphoreCounterValue = nullptr;
+		vkWaitSemaphores = nullptr;
+		if (timelineSemaphore) {
+			// Core entry points are only exposed for Vulkan 1.2 devices, the extension's for devices that enabled VK_KHR_timeline_semaphore
+			vkGetSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetSemaphoreCounterValue"));
+			vkWaitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkWaitSemaphores"));
+			if (!vkGetSemaphoreCounterValue || !vkWaitSemaphores) {
+				vkGetSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetSemaphoreCounterValueKHR"));
+				vkWaitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkWaitSemaphoresKHR"));
+			}
+		}
+		if (vkGetSemaphoreCounterValue && vkWaitSemaphores) {
+			VkSemaphoreTypeCreateInfoKHR semaphoreTypeCreateInfo{};
+			semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+			semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+			semaphoreTypeCreateInfo.initialValue = 0;
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+			VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCreateInfo, nullptr, &timeline));
+		}
+
+		nextValue = 1;
+		completedValue = 0;
+		batchDepth = 0;
+		statistics = Statistics();
+	}
+
+	void UploadManager::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		if (batchDepth > 0) {
+			batchDepth = 0;
+			submit();
+		}
+		while (!inFlight.empty()) {
+			retire(true);
+		}
+		for (auto fence : freeFences) {
+			vkDestroyFence(device->logicalDevice, fence, nullptr);
+		}
+		freeFences.clear();
+		if (timeline) {
+			vkDestroySemaphore(device->logicalDevice, timeline, nullptr);
+			timeline = VK_NULL_HANDLE;
+		}
+		// Destroying the pool also frees all command buffers allocated from it
+		vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+		commandPool = VK_NULL_HANDLE;
+		freeCommandBuffers.clear();
+		ring.destroy();
+		ring = vks::Buffer();
+		device = nullptr;
+	}
+
+	VkCommandBuffer UploadManager::begin(VkQueue queue)
+	{
+		assert(device);
+		if (batchDepth == 0) {
+			// Recycle whatever the device has finished in the meantime, so the ring starts out as empty as possible
+			retire(false);
+			if (!freeCommandBuffers.empty()) {
+				recording.commandBuffer = freeCommandBuffers.back();
+				freeCommandBuffers.pop_back();
+			} else {
+				recording.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool);
+			}
+			// The pool allows resetting individual command buffers, so beginning implicitly resets recycled ones
+			VkCommandBufferBeginInfo beginInfo = vks::initializers::commandBufferBeginInfo();
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			VK_CHECK_RESULT(vkBeginCommandBuffer(recording.commandBuffer, &beginInfo));
+			recording.value = nextValue;
+			// Nested batches join the outer batch and are submitted to its queue
+			batchQueue = (queue != VK_NULL_HANDLE) ? queue : defaultQueue;
+		}
+		batchDepth++;
+		return recording.commandBuffer;
+	}
+
+	uint64_t UploadManager::end(bool wait)
+	{
+		assert(batchDepth > 0);
+		const uint64_t value = recording.value;
+		if (--batchDepth > 0) {
+			return value;
+		}
+		submit();
+		if (wait) {
+			this->wait(value);
+		}
+		return value;
+	}
+
+	UploadManager::Staging UploadManager::stage(const void* data, VkDeviceSize size)
+	{
+		assert(batchDepth > 0);
+		statistics.stagedUploads++;
+		statistics.stagedBytes += size;
+
+		Staging staging;
+		VkDeviceSize offset = 0;
+		bool allocated = false;
+		if (size <= ringSize) {
+			allocated = allocateRing(size, &offset);
+			while (!allocated && !inFlight.empty()) {
+				statistics.ringStalls++;
+				retire(true);
+				allocated = allocateRing(size, &offset);
+			}
+		}
+		if (allocated) {
+			staging.buffer = ring.buffer;
+			staging.offset = offset;
+			staging.mapped = static_cast<uint8_t*>(ring.mapped) + offset;
+		} else {
+			// Either larger than the whole ring or the ring is filled by the batch being recorded, the buffer is released with the batch
+			vks::Buffer temporary;
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &temporary, size));
+			VK_CHECK_RESULT(temporary.map());
+			staging.buffer = temporary.buffer;
+			staging.offset = 0;
+			staging.mapped = temporary.mapped;
+			recording.temporaryStaging.push_back(temporary);
+			statistics.temporaryBuffers++;
+		}
+		if (data) {
+			memcpy(staging.mapped, data, size);
+		}
+		return staging;
+	}
+
+	void UploadManager::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, VkQueue queue)
+	{
+		VkCommandBuffer commandBuffer = begin(queue);
+		Staging staging = stage(data, size);
+		VkBufferCopy region{};
+		region.srcOffset = staging.offset;
+		region.dstOffset = offset;
+		region.size = size;
+		vkCmdCopyBuffer(commandBuffer, staging.buffer, buffer, 1, &region);
+		end();
+	}
+
+	void UploadManager::copyBuffer(VkBuffer src, VkBuffer dst, const VkBufferCopy& region, VkQueue queue)
+	{
+		VkCommandBuffer commandBuffer = begin(queue);
+		vkCmdCopyBuffer(commandBuffer, src, dst, 1, &region);
+		end();
+	}
+
+	void UploadManager::wait(uint64_t value)
+	{
+		// The batch that is still being recorded can't be waited for
+		assert((batchDepth == 0) || (value < recording.value));
+		while ((completedValue < value) && !inFlight.empty()) {
+			retire(true);
+		}
+	}
+
+	bool UploadManager::isComplete(uint64_t value)
+	{
+		retire(false);
+		return value <= completedValue;
+	}
+
+	bool UploadManager::isRecording() const
+	{
+		return batchDepth > 0;
+	}
+
+	UploadManager::Statistics UploadManager::getStatistics() const
+	{
+		return statistics;
+	}
+
+	bool UploadManager::allocateRing(VkDeviceSize size, VkDeviceSize* offset)
+	{
+		if (ringUsed == 0) {
+			ringHead = 0;
+		}
+		if (ringUsed == ringSize) {
+			return false;
+		}
+		const VkDeviceSize tail = (ringHead + ringSize - ringUsed) % ringSize;
+		const VkDeviceSize alignedHead = (ringHead + ringAlignment - 1) / ringAlignment * ringAlignment;
+		VkDeviceSize consumed;
+		if (ringHead >= tail) {
+			// Free space is split into [head, end) and [0, tail)
+			if (alignedHead + size <= ringSize) {
+				*offset = alignedHead;
+				consumed = alignedHead + size - ringHead;
+			} else if (size <= tail) {
+				*offset = 0;
+				consumed = ringSize - ringHead + size;
+			} else {
+				return false;
+			}
+		} else {
+			if (alignedHead + size > tail) {
+				return false;
+			}
+			*offset = alignedHead;
+			consumed = alignedHead + size - ringHead;
+		}
+		ringHead = *offset + size;
+		ringUsed += consumed;
+		recording.ringBytes += consumed;
+		return true;
+	}
+
+	void UploadManager::submit()
+	{
+		// Make the uploaded data visible to everything submitted to the queue after the batch
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(recording.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		VK_CHECK_RESULT(vkEndCommandBuffer(recording.commandBuffer));
+
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &recording.commandBuffer;
+		VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+		if (timeline) {
+			timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineSubmitInfo.signalSemaphoreValueCount = 1;
+			timelineSubmitInfo.pSignalSemaphoreValues = &recording.value;
+			submitInfo.pNext = &timelineSubmitInfo;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &timeline;
+		} else {
+			if (!freeFences.empty()) {
+				recording.fence = freeFences.back();
+				freeFences.pop_back();
+				VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &recording.fence));
+			} else {
+				VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
+				VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCreateInfo, nullptr, &recording.fence));
+			}
+		}
+		VK_CHECK_RESULT(vkQueueSubmit(batchQueue, 1, &submitInfo, recording.fence));
+		statistics.submissions++;
+
+		inFlight.push_back(std::move(recording));
+		recording = Submission();
+		nextValue++;
+	}
+
+	void UploadManager::retire(bool wait)
+	{
+		while (!inFlight.empty()) {
+			Submission& submission = inFlight.front();
+			if (!submissionComplete(submission, wait)) {
+				break;
+			}
+			wait = false;
+			ringUsed -= submission.ringBytes;
+			for (auto& buffer : submission.temporaryStaging) {
+				buffer.destroy();
+			}
+			freeCommandBuffers.push_back(submission.commandBuffer);
+			if (submission.fence) {
+				freeFences.push_back(submission.fence);
+			}
+			completedValue = submission.value;
+			inFlight.pop_front();
+		}
+	}
+
+	bool UploadManager::submissionComplete(const Submission& submission, bool wait)
+	{
+		if (timeline) {
+			if (wait) {
+				VkSemaphoreWaitInfoKHR waitInfo{};
+				waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+				waitInfo.semaphoreCount = 1;
+				waitInfo.pSemaphores = &timeline;
+				waitInfo.pValues = &submission.value;
+				VK_CHECK_RESULT(vkWaitSemaphores(device->logicalDevice, &waitInfo, UINT64_MAX));
+				return true;
+			}
+			uint64_t value = 0;
+			VK_CHECK_RESULT(vkGetSemaphoreCounterValue(device->logicalDevice, timeline, &value));
+			return value >= submission.value;
+		}
+		if (wait) {
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &submission.fence, VK_TRUE, UINT64_MAX));
+			return true;
+		}
+		return vkGetFenceStatus(device->logicalDevice, submission.fence) == VK_SUCCESS;
+	}
+}
@@ -0,0 +1,153 @@
+/*
+* Vulkan upload manager
+*
+* Stages one-shot uploads (buffer contents, texture images) through a persistently mapped ring buffer and records them into
+* shared command buffers, so loading a scene's assets takes a handful of queue submissions instead of one per resource
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* @brief Batches staged uploads into few queue submissions and recycles the staging memory once the device has consumed it
+	* @note Uploads recorded between begin() and end() go into a single command buffer that is submitted by the outermost end(), batches can be nested
+	* @note Every submission gets a monotonically increasing value, tracked with a timeline semaphore if the device has them enabled and with one fence per submission otherwise
+	* @note Not thread safe, uploads have to be recorded from the thread that loads the assets
+	*/
+	class UploadManager
+	{
+	public:
+		/** @brief Staging memory returned by stage(), valid for copies recorded into the current batch */
+		struct Staging {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			void* mapped = nullptr;
+		};
+
+		struct Statistics {
+			uint32_t submissions = 0;
+			/** @brief Number of stage() calls, usually one per uploaded resource */
+			uint32_t stagedUploads = 0;
+			VkDeviceSize stagedBytes = 0;
+			/** @brief Uploads too large for the ring that got a temporary staging buffer */
+			uint32_t temporaryBuffers = 0;
+			/** @brief Times the host had to wait for the device to free ring space */
+			uint32_t ringStalls = 0;
+		};
+
+		/** @brief Size of the staging ring */
+		VkDeviceSize ringSize = 32 * 1024 * 1024;
+
+		UploadManager() = default;
+		~UploadManager();
+		UploadManager(const UploadManager&) = delete;
+		UploadManager& operator=(const UploadManager&) = delete;
+
+		/**
+		* Create the staging ring and the submission tracking objects
+		*
+		* @param device Device the uploads are recorded for
+		* @param timelineSemaphore Track submissions with a timeline semaphore, requires the timelineSemaphore feature (Vulkan 1.2 or VK_KHR_timeline_semaphore) to be enabled on the device
+		*/
+		void create(vks::VulkanDevice* device, bool timelineSemaphore = false);
+		/** @brief Wait for all submitted uploads and release the manager's resources */
+		void destroy();
+
+		/**
+		* Start (or join) a batch of uploads
+		*
+		* @note Wrapping several asset loads in begin()/end() merges their buffer and ktx texture uploads into one submission, glTF images are uploaded by the device's TextureStreamer with its own submissions
+		*
+		* @param queue Queue the batch is submitted to, VK_NULL_HANDLE for the first queue of the graphics family, must be from the family of the device's default command pool
+		*
+		* @return Command buffer the caller records its copies and layout transitions into, valid until the matching end()
+		*/
+		VkCommandBuffer begin(VkQueue queue = VK_NULL_HANDLE);
+		/**
+		* Finish a batch, the outermost end() submits it
+		*
+		* @param wait Block until the device has executed the batch, without waiting only work submitted to the same queue afterwards is guaranteed to see the uploaded data
+		*
+		* @return Value of the submission the batch is part of, to be passed to wait() or isComplete()
+		*/
+		uint64_t end(bool wait = true);
+
+		/**
+		* Reserve staging memory for the current batch and optionally fill it
+		*
+		* @param data Data copied into the staging memory (may be nullptr to fill it through the returned pointer)
+		* @param size Size of the upload in bytes
+		*
+		* @note Has to be called between begin() and end(), the memory is recycled once the batch's submission has completed
+		*/
+		Staging stage(const void* data, VkDeviceSize size);
+
+		/** @brief Upload data to a buffer (e.g. in device local memory) through the staging ring */
+		void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, VkQueue queue = VK_NULL_HANDLE);
+		/** @brief Copy between two buffers, outside of a batch this blocks until the copy has been executed, inside of a batch the source has to stay valid until then */
+		void copyBuffer(VkBuffer src, VkBuffer dst, const VkBufferCopy& region, VkQueue queue = VK_NULL_HANDLE);
+
+		/** @brief Block until the submission with the given value has been executed and recycle its resources */
+		void wait(uint64_t value);
+		/** @return True if the submission with the given value has been executed, never blocks */
+		bool isComplete(uint64_t value);
+		/** @return True if a batch is being recorded */
+		bool isRecording() const;
+
+		Statistics getStatistics() const;
+
+	private:
+		struct Submission {
+			uint64_t value = 0;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			/** @brief Only used if timeline semaphores aren't available */
+			VkFence fence = VK_NULL_HANDLE;
+			VkDeviceSize ringBytes = 0;
+			std::vector<vks::Buffer> temporaryStaging;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkQueue defaultQueue = VK_NULL_HANDLE;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+
+		vks::Buffer ring;
+		VkDeviceSize ringAlignment = 16;
+		VkDeviceSize ringHead = 0;
+		VkDeviceSize ringUsed = 0;
+
+		VkSemaphore timeline = VK_NULL_HANDLE;
+		PFN_vkGetSemaphoreCounterValueKHR vkGetSemaphoreCounterValue = nullptr;
+		PFN_vkWaitSemaphoresKHR vkWaitSemaphores = nullptr;
+
+		/** @brief Value of the next submission, the batch being recorded will get this value */
+		uint64_t nextValue = 1;
+		uint64_t completedValue = 0;
+		uint32_t batchDepth = 0;
+		VkQueue batchQueue = VK_NULL_HANDLE;
+		Submission recording;
+		std::deque<Submission> inFlight;
+		std::vector<VkCommandBuffer> freeCommandBuffers;
+		std::vector<VkFence> freeFences;
+		Statistics statistics;
+
+		bool allocateRing(VkDeviceSize size, VkDeviceSize* offset);
+		void submit();
+		/** @brief Recycle finished submissions, optionally waiting for the oldest one to finish first */
+		void retire(bool wait);
+		bool submissionComplete(const Submission& submission, bool wait);
+	};
+}
@@ -12,11 +12,31 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
+#include "jobsystem.hpp"
+#include "mappedfile.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <unordered_map>
+#include <sys/stat.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
 uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
+#if defined(__ANDROID__)
+bool vkglTF::meshCacheEnabled = false;
+#else
+bool vkglTF::meshCacheEnabled = true;
+#endif
 
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
@@ -30,7 +50,10 @@ bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string
 		}
 	}
 
-	return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
+	// Keep the encoded data, images are decoded on the texture streamer's background threads
+	image->image.assign(bytes, bytes + size);
+	image->as_is = true;
+	return true;
 }
 
 bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData) 
@@ -57,7 +80,11 @@ void vkglTF::Texture::destroy()
 	{
 		vkDestroyImageView(device->logicalDevice, view, nullptr);
 		vkDestroyImage(device->logicalDevice, image, nullptr);
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		if (allocation.arena) {
+			allocation.arena->free(allocation);
+		} else {
+			vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		}
 		vkDestroySampler(device->logicalDevice, sampler, nullptr);
 	}
 }
@@ -77,6 +104,19 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 	VkFormat format;
 
 	if (!isKtx) {
+		if (gltfimage.as_is) {
+			// Encoded image data as stored by loadImageDataFunc
+			int decodedWidth, decodedHeight, components;
+			stbi_uc* pixels = stbi_load_from_memory(gltfimage.image.data(), static_cast<int>(gltfimage.image.size()), &decodedWidth, &decodedHeight, &components, STBI_rgb_alpha);
+			assert(pixels);
+			gltfimage.image.assign(pixels, pixels + static_cast<size_t>(decodedWidth) * decodedHeight * 4);
+			stbi_image_free(pixels);
+			gltfimage.width = decodedWidth;
+			gltfimage.height = decodedHeight;
+			gltfimage.component = 4;
+			gltfimage.as_is = false;
+		}
+
 		// Texture was loaded using STB_Image
 
 		unsigned char* buffer = nullptr;
@@ -115,29 +155,9 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
 
-		VkMemoryAllocateInfo memAllocInfo{};
-		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		VkMemoryRequirements memReqs{};
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo{};
-		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCreateInfo.size = bufferSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, buffer, bufferSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		// Upload and mip generation are recorded into the upload manager's current batch (e.g. the one of the model being loaded)
+		VkCommandBuffer copyCmd = device->uploadManager.begin(copyQueue);
+		vks::UploadManager::Staging staging = device->uploadManager.stage(buffer, bufferSize);
 
 		VkImageCreateInfo imageCreateInfo{};
 		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -153,13 +173,8 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		imageCreateInfo.extent = { width, height, 1 };
 		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation));
+		deviceMemory = allocation.memory;
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -186,8 +201,9 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		bufferCopyRegion.imageExtent.width = width;
 		bufferCopyRegion.imageExtent.height = height;
 		bufferCopyRegion.imageExtent.depth = 1;
+		bufferCopyRegion.bufferOffset = staging.offset;
 
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+		vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
 		{
 			VkImageMemoryBarrier imageMemoryBarrier{};
@@ -201,13 +217,8 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 		}
 
-		device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
 		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer blitCmd = copyCmd;
 		for (uint32_t i = 1; i < mipLevels; i++) {
 			VkImageBlit imageBlit{};
 
@@ -277,7 +288,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
             delete[] buffer;
         }
 
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
+		device->uploadManager.end();
 	}
 	else {
 		// Texture is stored in an external ktx file
@@ -320,29 +331,8 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		VkCommandBuffer copyCmd = device->uploadManager.begin(copyQueue);
+		vks::UploadManager::Staging staging = device->uploadManager.stage(ktxTextureData, ktxTextureSize);
 
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
 		for (uint32_t i = 0; i < mipLevels; i++)
@@ -358,7 +348,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 			bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
 			bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
 			bufferCopyRegion.imageExtent.depth = 1;
-			bufferCopyRegion.bufferOffset = offset;
+			bufferCopyRegion.bufferOffset = staging.offset + offset;
 			bufferCopyRegions.push_back(bufferCopyRegion);
 		}
 
@@ -376,11 +366,8 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation));
+		deviceMemory = allocation.memory;
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -389,14 +376,11 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		subresourceRange.layerCount = 1;
 
 		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
 		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-		device->flushCommandBuffer(copyCmd, copyQueue);
+		device->uploadManager.end();
 		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
 		ktxTexture_Destroy(ktxTexture);
 	}
 
@@ -488,26 +472,260 @@ void vkglTF::Primitive::setDimensions(glm::vec3 min, glm::vec3 max) {
 vkglTF::Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix) {
 	this->device = device;
 	this->uniformBlock.matrix = matrix;
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		sizeof(uniformBlock),
-		&uniformBuffer.buffer,
-		&uniformBuffer.memory,
-		&uniformBlock));
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
+	// Per-mesh uniform buffers are small, so they are sub-allocated from the device's (persistently mapped) memory arena
+	VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(uniformBlock));
+	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &uniformBuffer.buffer));
+	VkMemoryRequirements memReqs;
+	vkGetBufferMemoryRequirements(device->logicalDevice, uniformBuffer.buffer, &memReqs);
+	uint32_t memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	VK_CHECK_RESULT(device->memoryArena.allocate(memReqs, memoryTypeIndex, true, &uniformBuffer.allocation));
+	VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, uniformBuffer.buffer, uniformBuffer.allocation.memory, uniformBuffer.allocation.offset));
+	uniformBuffer.memory = uniformBuffer.allocation.memory;
+	uniformBuffer.mapped = uniformBuffer.allocation.mapped;
+	memcpy(uniformBuffer.mapped, &uniformBlock, sizeof(uniformBlock));
 	uniformBuffer.descriptor = { uniformBuffer.buffer, 0, sizeof(uniformBlock) };
 };
 
 vkglTF::Mesh::~Mesh() {
 	vkDestroyBuffer(device->logicalDevice, uniformBuffer.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, uniformBuffer.memory, nullptr);
+	device->memoryArena.free(uniformBuffer.allocation);
     for(auto primitive : primitives)
     {
         delete primitive;
     }
 }
 
+/*
+	glTF transform hierarchy
+*/
+
+namespace
+{
+	// Four lane float vectors for the batched TRS to matrix conversion
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	typedef __m128 float4;
+	inline float4 load4(const float* v) { return _mm_loadu_ps(v); }
+	inline void store4(float* v, float4 a) { _mm_storeu_ps(v, a); }
+	inline float4 splat4(float s) { return _mm_set1_ps(s); }
+	inline float4 add4(float4 a, float4 b) { return _mm_add_ps(a, b); }
+	inline float4 sub4(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+	inline float4 mul4(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+	typedef float32x4_t float4;
+	inline float4 load4(const float* v) { return vld1q_f32(v); }
+	inline void store4(float* v, float4 a) { vst1q_f32(v, a); }
+	inline float4 splat4(float s) { return vdupq_n_f32(s); }
+	inline float4 add4(float4 a, float4 b) { return vaddq_f32(a, b); }
+	inline float4 sub4(float4 a, float4 b) { return vsubq_f32(a, b); }
+	inline float4 mul4(float4 a, float4 b) { return vmulq_f32(a, b); }
+#else
+	struct float4 { float v[4]; };
+	inline float4 load4(const float* v) { return { { v[0], v[1], v[2], v[3] } }; }
+	inline void store4(float* v, float4 a) { for (int i = 0; i < 4; i++) v[i] = a.v[i]; }
+	inline float4 splat4(float s) { return { { s, s, s, s } }; }
+	inline float4 add4(float4 a, float4 b) { return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+	inline float4 sub4(float4 a, float4 b) { return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }; }
+	inline float4 mul4(float4 a, float4 b) { return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+#endif
+
+	/* Compute translation * rotation * scale (* node matrix) for the given transforms, four at a time */
+	void composeLocalMatrices(vkglTF::TransformHierarchy& transforms, const uint32_t* indices, size_t count)
+	{
+		for (size_t first = 0; first < count; first += 4) {
+			const size_t lanes = std::min<size_t>(count - first, 4);
+			// Gather the components of up to four transforms into lanes, unused lanes compute an identity rotation
+			float rotation[4][4] = {};
+			float scale[3][4] = {};
+			for (size_t lane = 0; lane < lanes; lane++) {
+				const uint32_t index = indices[first + lane];
+				rotation[0][lane] = transforms.rotations.x[index];
+				rotation[1][lane] = transforms.rotations.y[index];
+				rotation[2][lane] = transforms.rotations.z[index];
+				rotation[3][lane] = transforms.rotations.w[index];
+				scale[0][lane] = transforms.scales.x[index];
+				scale[1][lane] = transforms.scales.y[index];
+				scale[2][lane] = transforms.scales.z[index];
+			}
+			const float4 qx = load4(rotation[0]);
+			const float4 qy = load4(rotation[1]);
+			const float4 qz = load4(rotation[2]);
+			const float4 qw = load4(rotation[3]);
+			const float4 sx = load4(scale[0]);
+			const float4 sy = load4(scale[1]);
+			const float4 sz = load4(scale[2]);
+			const float4 one = splat4(1.0f);
+
+			// Rotation matrix of a unit quaternion (same as glm::mat3_cast), columns scaled by the node's scale
+			const float4 x2 = add4(qx, qx);
+			const float4 y2 = add4(qy, qy);
+			const float4 z2 = add4(qz, qz);
+			const float4 xx = mul4(qx, x2);
+			const float4 yy = mul4(qy, y2);
+			const float4 zz = mul4(qz, z2);
+			const float4 xy = mul4(qx, y2);
+			const float4 xz = mul4(qx, z2);
+			const float4 yz = mul4(qy, z2);
+			const float4 wx = mul4(qw, x2);
+			const float4 wy = mul4(qw, y2);
+			const float4 wz = mul4(qw, z2);
+
+			float columns[9][4];
+			store4(columns[0], mul4(sub4(one, add4(yy, zz)), sx));
+			store4(columns[1], mul4(add4(xy, wz), sx));
+			store4(columns[2], mul4(sub4(xz, wy), sx));
+			store4(columns[3], mul4(sub4(xy, wz), sy));
+			store4(columns[4], mul4(sub4(one, add4(xx, zz)), sy));
+			store4(columns[5], mul4(add4(yz, wx), sy));
+			store4(columns[6], mul4(add4(xz, wy), sz));
+			store4(columns[7], mul4(sub4(yz, wx), sz));
+			store4(columns[8], mul4(sub4(one, add4(xx, yy)), sz));
+
+			for (size_t lane = 0; lane < lanes; lane++) {
+				const uint32_t index = indices[first + lane];
+				glm::mat4& m = transforms.localMatrices[index];
+				m[0] = glm::vec4(columns[0][lane], columns[1][lane], columns[2][lane], 0.0f);
+				m[1] = glm::vec4(columns[3][lane], columns[4][lane], columns[5][lane], 0.0f);
+				m[2] = glm::vec4(columns[6][lane], columns[7][lane], columns[8][lane], 0.0f);
+				m[3] = glm::vec4(transforms.translations.x[index], transforms.translations.y[index], transforms.translations.z[index], 1.0f);
+				if (transforms.hasMatrix[index]) {
+					m = m * transforms.matrices[index];
+				}
+			}
+		}
+	}
+}
+
+/* Flatten the node hierarchy below the given root nodes, parents are stored before their children */
+void vkglTF::TransformHierarchy::build(const std::vector<Node*>& rootNodes)
+{
+	*this = TransformHierarchy();
+	for (auto node : rootNodes) {
+		add(node, -1);
+	}
+}
+
+void vkglTF::TransformHierarchy::add(Node* node, int32_t parent)
+{
+	const uint32_t index = static_cast<uint32_t>(nodes.size());
+	node->transforms = this;
+	node->transformIndex = index;
+	nodes.push_back(node);
+	parents.push_back(parent);
+	translations.x.push_back(0.0f);
+	translations.y.push_back(0.0f);
+	translations.z.push_back(0.0f);
+	rotations.x.push_back(0.0f);
+	rotations.y.push_back(0.0f);
+	rotations.z.push_back(0.0f);
+	rotations.w.push_back(1.0f);
+	scales.x.push_back(1.0f);
+	scales.y.push_back(1.0f);
+	scales.z.push_back(1.0f);
+	matrices.push_back(glm::mat4(1.0f));
+	hasMatrix.push_back(0);
+	localMatrices.push_back(glm::mat4(1.0f));
+	worldMatrices.push_back(glm::mat4(1.0f));
+	dirty.push_back(0);
+	changed.push_back(0);
+	setFromNode(index);
+	for (auto child : node->children) {
+		add(child, static_cast<int32_t>(index));
+	}
+}
+
+void vkglTF::TransformHierarchy::setTranslation(uint32_t index, const glm::vec3& translation)
+{
+	nodes[index]->translation = translation;
+	translations.x[index] = translation.x;
+	translations.y[index] = translation.y;
+	translations.z[index] = translation.z;
+	dirty[index] |= LocalDirty;
+	anyDirty = true;
+}
+
+void vkglTF::TransformHierarchy::setRotation(uint32_t index, const glm::quat& rotation)
+{
+	nodes[index]->rotation = rotation;
+	rotations.x[index] = rotation.x;
+	rotations.y[index] = rotation.y;
+	rotations.z[index] = rotation.z;
+	rotations.w[index] = rotation.w;
+	dirty[index] |= LocalDirty;
+	anyDirty = true;
+}
+
+void vkglTF::TransformHierarchy::setScale(uint32_t index, const glm::vec3& scale)
+{
+	nodes[index]->scale = scale;
+	scales.x[index] = scale.x;
+	scales.y[index] = scale.y;
+	scales.z[index] = scale.z;
+	dirty[index] |= LocalDirty;
+	anyDirty = true;
+}
+
+/* Take over the translation, rotation, scale and matrix of the transform's node (e.g. after they have been changed directly) */
+void vkglTF::TransformHierarchy::setFromNode(uint32_t index)
+{
+	const Node* node = nodes[index];
+	setTranslation(index, node->translation);
+	setRotation(index, node->rotation);
+	setScale(index, node->scale);
+	matrices[index] = node->matrix;
+	hasMatrix[index] = (node->matrix != glm::mat4(1.0f)) ? 1 : 0;
+}
+
+/* Recompute the world matrices of all transforms whose local transform or one of whose ancestors has changed */
+void vkglTF::TransformHierarchy::update()
+{
+	if (!anyDirty) {
+		return;
+	}
+	anyDirty = false;
+	dirtyLocal.clear();
+	dirtyWorld.clear();
+	const uint32_t count = static_cast<uint32_t>(nodes.size());
+	for (uint32_t i = 0; i < count; i++) {
+		// Parents precede their children, so the parent's flags are final by the time a child is visited
+		if ((parents[i] >= 0) && (dirty[parents[i]] & WorldDirty)) {
+			dirty[i] |= WorldDirty;
+		}
+		if (dirty[i] & LocalDirty) {
+			dirty[i] |= WorldDirty;
+			dirtyLocal.push_back(i);
+		}
+		if (dirty[i] & WorldDirty) {
+			dirtyWorld.push_back(i);
+		}
+	}
+	composeLocalMatrices(*this, dirtyLocal.data(), dirtyLocal.size());
+	for (uint32_t i : dirtyWorld) {
+		worldMatrices[i] = (parents[i] >= 0) ? worldMatrices[parents[i]] * localMatrices[i] : localMatrices[i];
+		dirty[i] = 0;
+		changed[i] = 1;
+	}
+	anyChanged = anyChanged || !dirtyWorld.empty();
+}
+
+/** @return True if any world matrix has been recomputed since the last call to clearChanges */
+bool vkglTF::TransformHierarchy::hasChanges() const
+{
+	return anyChanged;
+}
+
+bool vkglTF::TransformHierarchy::worldChanged(uint32_t index) const
+{
+	return changed[index] != 0;
+}
+
+void vkglTF::TransformHierarchy::clearChanges()
+{
+	if (anyChanged) {
+		std::fill(changed.begin(), changed.end(), 0);
+		anyChanged = false;
+	}
+}
+
 /*
 	glTF node
 */
@@ -516,6 +734,11 @@ glm::mat4 vkglTF::Node::localMatrix() {
 }
 
 glm::mat4 vkglTF::Node::getMatrix() {
+	// Nodes of a loaded model read their world matrix from the model's flattened transform hierarchy
+	if (transforms) {
+		transforms->update();
+		return transforms->worldMatrices[transformIndex];
+	}
 	glm::mat4 m = localMatrix();
 	vkglTF::Node *p = parent;
 	while (p) {
@@ -559,6 +782,87 @@ vkglTF::Node::~Node() {
 	}
 }
 
+/*
+	glTF animation sampler
+*/
+
+// Cubic spline samplers store three outputs (in-tangent, value, out-tangent) per keyframe
+bool vkglTF::AnimationSampler::isValid() const
+{
+	const size_t stride = (interpolation == CUBICSPLINE) ? 3 : 1;
+	return !inputs.empty() && (outputsVec4.size() >= inputs.size() * stride);
+}
+
+/*
+	Find the keyframe interval [inputs[i], inputs[i + 1]] containing the given time, times outside the sampler's range are clamped to the first or last interval
+	Starts at the interval found by the previous search, so playing an animation forward only costs a few comparisons per frame, seeking falls back to a binary search
+	@param cursor Interval found by the previous search, updated with the result
+*/
+uint32_t vkglTF::AnimationSampler::findKeyframe(float time, uint32_t& cursor) const
+{
+	if (inputs.size() < 2) {
+		cursor = 0;
+		return 0;
+	}
+	const uint32_t last = static_cast<uint32_t>(inputs.size()) - 2;
+	const uint32_t i = std::min(cursor, last);
+	if (time >= inputs[i]) {
+		if (time <= inputs[i + 1]) {
+			cursor = i;
+			return cursor;
+		}
+		if ((i < last) && (time <= inputs[i + 2])) {
+			cursor = i + 1;
+			return cursor;
+		}
+	}
+	const ptrdiff_t upper = std::upper_bound(inputs.begin(), inputs.end(), time) - inputs.begin();
+	cursor = static_cast<uint32_t>(std::min<ptrdiff_t>(std::max<ptrdiff_t>(upper - 1, 0), last));
+	return cursor;
+}
+
+/*
+	Sample the output value at the given time
+	@param rotation Interpolate the outputs as quaternions (stored as x, y, z, w)
+*/
+glm::vec4 vkglTF::AnimationSampler::evaluate(float time, uint32_t& cursor, bool rotation) const
+{
+	const bool cubic = (interpolation == CUBICSPLINE);
+	const size_t stride = cubic ? 3 : 1;
+	const size_t valueOffset = cubic ? 1 : 0;
+	if (inputs.size() < 2) {
+		return outputsVec4[valueOffset];
+	}
+
+	const uint32_t i = findKeyframe(time, cursor);
+	const float t0 = inputs[i];
+	const float dt = inputs[i + 1] - t0;
+	const float u = (dt > 0.0f) ? glm::clamp((time - t0) / dt, 0.0f, 1.0f) : 0.0f;
+	const glm::vec4& v0 = outputsVec4[i * stride + valueOffset];
+	const glm::vec4& v1 = outputsVec4[(i + 1) * stride + valueOffset];
+
+	switch (interpolation) {
+	case STEP:
+		return (u < 1.0f) ? v0 : v1;
+	case CUBICSPLINE: {
+		// Hermite spline with the tangents scaled by the keyframe interval, see Appendix C of the glTF 2.0 specification
+		const glm::vec4& b0 = outputsVec4[i * stride + 2];
+		const glm::vec4& a1 = outputsVec4[(i + 1) * stride];
+		const float u2 = u * u;
+		const float u3 = u2 * u;
+		glm::vec4 value = (2.0f * u3 - 3.0f * u2 + 1.0f) * v0 + (u3 - 2.0f * u2 + u) * dt * b0 + (-2.0f * u3 + 3.0f * u2) * v1 + (u3 - u2) * dt * a1;
+		return rotation ? glm::normalize(value) : value;
+	}
+	default: {
+		if (!rotation) {
+			return glm::mix(v0, v1, u);
+		}
+		const glm::quat q = glm::normalize(glm::slerp(glm::quat(v0.w, v0.x, v0.y, v0.z), glm::quat(v1.w, v1.x, v1.y, v1.z), u));
+		return glm::vec4(q.x, q.y, q.z, q.w);
+	}
+	}
+}
+
 /*
 	glTF default vertex layout with easy Vulkan mapping functions
 */
@@ -635,30 +939,11 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	unsigned char* buffer = new unsigned char[bufferSize];
 	memset(buffer, 0, bufferSize);
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingMemory;
-	VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-	bufferCreateInfo.size = bufferSize;
-	// This buffer is used as a transfer source for the buffer copy
-	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-	VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-	VkMemoryRequirements memReqs;
-	vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-	VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-	// Copy texture data into staging buffer
-	uint8_t* data;
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-	memcpy(data, buffer, bufferSize);
-	vkUnmapMemory(device->logicalDevice, stagingMemory);
+	VkCommandBuffer copyCmd = device->uploadManager.begin(transferQueue);
+	vks::UploadManager::Staging staging = device->uploadManager.stage(buffer, bufferSize);
 
 	VkBufferImageCopy bufferCopyRegion = {};
+	bufferCopyRegion.bufferOffset = staging.offset;
 	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	bufferCopyRegion.imageSubresource.layerCount = 1;
 	bufferCopyRegion.imageExtent.width = emptyTexture.width;
@@ -679,11 +964,8 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &emptyTexture.image));
 
-	vkGetImageMemoryRequirements(device->logicalDevice, emptyTexture.image, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &emptyTexture.deviceMemory));
-	VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, emptyTexture.image, emptyTexture.deviceMemory, 0));
+	VK_CHECK_RESULT(device->allocateImageMemory(emptyTexture.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &emptyTexture.allocation));
+	emptyTexture.deviceMemory = emptyTexture.allocation.memory;
 
 	VkImageSubresourceRange subresourceRange{};
 	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -691,17 +973,12 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	subresourceRange.levelCount = 1;
 	subresourceRange.layerCount = 1;
 
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-	vkCmdCopyBufferToImage(copyCmd, stagingBuffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+	vkCmdCopyBufferToImage(copyCmd, staging.buffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-	device->flushCommandBuffer(copyCmd, transferQueue);
+	device->uploadManager.end();
 	emptyTexture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	// Clean up staging resources
-	vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
 	VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
 	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
 	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
@@ -735,6 +1012,10 @@ vkglTF::Model::~Model()
 	vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
 	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
 	vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+	if (vertices.positionBuffer != VK_NULL_HANDLE) {
+		vkDestroyBuffer(device->logicalDevice, vertices.positionBuffer, nullptr);
+		vkFreeMemory(device->logicalDevice, vertices.positionMemory, nullptr);
+	}
 	for (auto texture : textures) {
 		texture.destroy();
 	}
@@ -753,10 +1034,11 @@ vkglTF::Model::~Model()
 		descriptorSetLayoutImage = VK_NULL_HANDLE;
 	}
 	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+	destroyIndirectDraw();
 	emptyTexture.destroy();
 }
 
-void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale)
+void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, std::vector<PrimitiveLoadInfo>& primitives, uint32_t& indexCount, uint32_t& vertexCount, float globalscale)
 {
 	vkglTF::Node *newNode = new Node{};
 	newNode->index = nodeIndex;
@@ -791,13 +1073,14 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 	// Node with children
 	if (node.children.size() > 0) {
 		for (auto i = 0; i < node.children.size(); i++) {
-			loadNode(newNode, model.nodes[node.children[i]], node.children[i], model, indexBuffer, vertexBuffer, globalscale);
+			loadNode(newNode, model.nodes[node.children[i]], node.children[i], model, primitives, indexCount, vertexCount, globalscale);
 		}
 	}
 
 	// Node contains mesh data
+	// Only the ranges of the primitives are allocated here, their data is converted in parallel once all nodes have been loaded
 	if (node.mesh > -1) {
-		const tinygltf::Mesh mesh = model.meshes[node.mesh];
+		const tinygltf::Mesh &mesh = model.meshes[node.mesh];
 		Mesh *newMesh = new Mesh(device, newNode->matrix);
 		newMesh->name = mesh.name;
 		for (size_t j = 0; j < mesh.primitives.size(); j++) {
@@ -805,156 +1088,349 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 			if (primitive.indices < 0) {
 				continue;
 			}
-			uint32_t indexStart = static_cast<uint32_t>(indexBuffer.size());
-			uint32_t vertexStart = static_cast<uint32_t>(vertexBuffer.size());
-			uint32_t indexCount = 0;
-			uint32_t vertexCount = 0;
-			glm::vec3 posMin{};
-			glm::vec3 posMax{};
-			bool hasSkin = false;
-			// Vertices
-			{
-				const float *bufferPos = nullptr;
-				const float *bufferNormals = nullptr;
-				const float *bufferTexCoords = nullptr;
-				const float* bufferColors = nullptr;
-				const float *bufferTangents = nullptr;
-				uint32_t numColorComponents;
-				const uint16_t *bufferJoints = nullptr;
-				const float *bufferWeights = nullptr;
-
-				// Position attribute is required
-				assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
-
-				const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-				const tinygltf::BufferView &posView = model.bufferViews[posAccessor.bufferView];
-				bufferPos = reinterpret_cast<const float *>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
-				posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
-				posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
-
-				if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-					const tinygltf::Accessor &normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-					const tinygltf::BufferView &normView = model.bufferViews[normAccessor.bufferView];
-					bufferNormals = reinterpret_cast<const float *>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
-				}
+			const tinygltf::Accessor &indexAccessor = model.accessors[primitive.indices];
+			if ((indexAccessor.componentType != TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT) && (indexAccessor.componentType != TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT) && (indexAccessor.componentType != TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE)) {
+				std::cerr << "Index component type " << indexAccessor.componentType << " not supported!" << std::endl;
+				continue;
+			}
 
-				if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferTexCoords = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-				}
+			// Position attribute is required
+			assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
+			const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
 
-				if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
-					const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
-					// Color buffer are either of type vec3 or vec4
-					numColorComponents = colorAccessor.type == TINYGLTF_PARAMETER_TYPE_FLOAT_VEC3 ? 3 : 4;
-					bufferColors = reinterpret_cast<const float*>(&(model.buffers[colorView.buffer].data[colorAccessor.byteOffset + colorView.byteOffset]));
-				}
+			Primitive *newPrimitive = new Primitive(indexCount, static_cast<uint32_t>(indexAccessor.count), primitive.material > -1 ? materials[primitive.material] : materials.back());
+			newPrimitive->firstVertex = vertexCount;
+			newPrimitive->vertexCount = static_cast<uint32_t>(posAccessor.count);
+			newPrimitive->setDimensions(glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]), glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]));
+			newMesh->primitives.push_back(newPrimitive);
+			indexCount += newPrimitive->indexCount;
+			vertexCount += newPrimitive->vertexCount;
+
+			PrimitiveLoadInfo info{};
+			info.source = &primitive;
+			info.primitive = newPrimitive;
+			info.node = newNode;
+			primitives.push_back(info);
+		}
+		newNode->mesh = newMesh;
+	}
+	if (parent) {
+		parent->children.push_back(newNode);
+	} else {
+		nodes.push_back(newNode);
+	}
+	linearNodes.push_back(newNode);
+}
 
-				if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor &tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
-					const tinygltf::BufferView &tangentView = model.bufferViews[tangentAccessor.bufferView];
-					bufferTangents = reinterpret_cast<const float *>(&(model.buffers[tangentView.buffer].data[tangentAccessor.byteOffset + tangentView.byteOffset]));
-				}
+/*
+	Converts a range of a primitive's vertices and indices into the model's vertex and index data
+	Called from multiple threads at once, the ranges don't overlap
+*/
+void vkglTF::Model::loadPrimitive(const tinygltf::Model &model, const PrimitiveLoadInfo &info, uint32_t vertexBegin, uint32_t vertexEnd, uint32_t indexBegin, uint32_t indexEnd, Vertex *vertexBuffer, uint32_t *indexBuffer, uint32_t fileLoadingFlags) const
+{
+	const tinygltf::Primitive &primitive = *info.source;
+	const Primitive &target = *info.primitive;
+
+	// Vertices
+	if (vertexBegin < vertexEnd) {
+		const float *bufferPos = nullptr;
+		const float *bufferNormals = nullptr;
+		const float *bufferTexCoords = nullptr;
+		const float* bufferColors = nullptr;
+		const float *bufferTangents = nullptr;
+		uint32_t numColorComponents;
+		const uint16_t *bufferJoints = nullptr;
+		const float *bufferWeights = nullptr;
+
+		const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
+		const tinygltf::BufferView &posView = model.bufferViews[posAccessor.bufferView];
+		bufferPos = reinterpret_cast<const float *>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
+
+		if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
+			const tinygltf::Accessor &normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
+			const tinygltf::BufferView &normView = model.bufferViews[normAccessor.bufferView];
+			bufferNormals = reinterpret_cast<const float *>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
+		}
 
-				// Skinning
-				// Joints
-				if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
-					const tinygltf::BufferView &jointView = model.bufferViews[jointAccessor.bufferView];
-					bufferJoints = reinterpret_cast<const uint16_t *>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
-				}
+		if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
+			const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
+			const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
+			bufferTexCoords = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+		}
 
-				if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferWeights = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-				}
+		if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
+		{
+			const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
+			const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
+			// Color buffer are either of type vec3 or vec4
+			numColorComponents = colorAccessor.type == TINYGLTF_PARAMETER_TYPE_FLOAT_VEC3 ? 3 : 4;
+			bufferColors = reinterpret_cast<const float*>(&(model.buffers[colorView.buffer].data[colorAccessor.byteOffset + colorView.byteOffset]));
+		}
 
-				hasSkin = (bufferJoints && bufferWeights);
-
-				vertexCount = static_cast<uint32_t>(posAccessor.count);
-
-				for (size_t v = 0; v < posAccessor.count; v++) {
-					Vertex vert{};
-					vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
-					vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
-					vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * 2]) : glm::vec3(0.0f);
-					if (bufferColors) {
-						switch (numColorComponents) {
-							case 3: 
-								vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * 3]), 1.0f);
-							case 4:
-								vert.color = glm::make_vec4(&bufferColors[v * 4]);
-						}
-					}
-					else {
-						vert.color = glm::vec4(1.0f);
-					}
-					vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * 4])) : glm::vec4(0.0f);
-					vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
-					vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
-					vertexBuffer.push_back(vert);
+		if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
+		{
+			const tinygltf::Accessor &tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
+			const tinygltf::BufferView &tangentView = model.bufferViews[tangentAccessor.bufferView];
+			bufferTangents = reinterpret_cast<const float *>(&(model.buffers[tangentView.buffer].data[tangentAccessor.byteOffset + tangentView.byteOffset]));
+		}
+
+		// Skinning
+		// Joints
+		if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
+			const tinygltf::Accessor &jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
+			const tinygltf::BufferView &jointView = model.bufferViews[jointAccessor.bufferView];
+			bufferJoints = reinterpret_cast<const uint16_t *>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
+		}
+
+		if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
+			const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
+			const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
+			bufferWeights = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+		}
+
+		const bool hasSkin = (bufferJoints && bufferWeights);
+
+		// Pre-calculations for requested features are applied while converting
+		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
+		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
+		const glm::mat3 normalMatrix = glm::mat3(info.matrix);
+
+		for (size_t v = vertexBegin; v < vertexEnd; v++) {
+			Vertex& vert = vertexBuffer[target.firstVertex + v];
+			vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
+			vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
+			vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * 2]) : glm::vec3(0.0f);
+			if (bufferColors) {
+				switch (numColorComponents) {
+					case 3: 
+						vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * 3]), 1.0f);
+					case 4:
+						vert.color = glm::make_vec4(&bufferColors[v * 4]);
 				}
 			}
-			// Indices
-			{
-				const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
-				const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
+			else {
+				vert.color = glm::vec4(1.0f);
+			}
+			vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * 4])) : glm::vec4(0.0f);
+			vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
+			vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
+			// Pre-transform vertex positions by node-hierarchy
+			if (preTransform) {
+				vert.pos = glm::vec3(info.matrix * glm::vec4(vert.pos, 1.0f));
+				vert.normal = glm::normalize(normalMatrix * vert.normal);
+			}
+			// Flip Y-Axis of vertex positions
+			if (flipY) {
+				vert.pos.y *= -1.0f;
+				vert.normal.y *= -1.0f;
+			}
+			// Pre-Multiply vertex colors with material base color
+			if (preMultiplyColor) {
+				vert.color = target.material.baseColorFactor * vert.color;
+			}
+		}
+	}
+
+	// Indices
+	if (indexBegin < indexEnd) {
+		const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
+		const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
+		const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
+		const unsigned char *data = &buffer.data[accessor.byteOffset + bufferView.byteOffset];
+		uint32_t *dst = &indexBuffer[target.firstIndex];
+
+		switch (accessor.componentType) {
+		case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
+			const uint32_t *buf = reinterpret_cast<const uint32_t*>(data);
+			for (size_t index = indexBegin; index < indexEnd; index++) {
+				dst[index] = buf[index] + target.firstVertex;
+			}
+			break;
+		}
+		case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
+			const uint16_t *buf = reinterpret_cast<const uint16_t*>(data);
+			for (size_t index = indexBegin; index < indexEnd; index++) {
+				dst[index] = buf[index] + target.firstVertex;
+			}
+			break;
+		}
+		case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
+			for (size_t index = indexBegin; index < indexEnd; index++) {
+				dst[index] = data[index] + target.firstVertex;
+			}
+			break;
+		}
+		}
+	}
+}
 
-				indexCount = static_cast<uint32_t>(accessor.count);
+/*
+	Optimizes the vertex and index data of a single primitive in place, the primitive's vertex count may shrink due to vertex deduplication
+	Called from multiple threads at once for different primitives
+*/
+void vkglTF::Model::optimizePrimitive(Primitive &primitive, Vertex *vertexBuffer, uint32_t *indexBuffer, vks::meshoptimizer::VertexCacheStatistics &before, vks::meshoptimizer::VertexCacheStatistics &after) const
+{
+	namespace meshopt = vks::meshoptimizer;
+	const size_t vertexCount = primitive.vertexCount;
+	const size_t indexCount = primitive.indexCount;
+	if ((vertexCount == 0) || (indexCount < 3)) {
+		return;
+	}
+	Vertex* primitiveVertices = &vertexBuffer[primitive.firstVertex];
+	uint32_t* primitiveIndices = &indexBuffer[primitive.firstIndex];
 
-				switch (accessor.componentType) {
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-					uint32_t *buf = new uint32_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint32_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-                    delete[] buf;
+	// The optimizer works on indices relative to the primitive's first vertex
+	std::vector<uint32_t> indices(primitiveIndices, primitiveIndices + indexCount);
+	for (uint32_t& index : indices) {
+		index -= primitive.firstVertex;
+	}
+	before = meshopt::analyzeVertexCache(indices.data(), indexCount, vertexCount);
+
+	// Remove duplicate vertices
+	std::vector<uint32_t> remap(vertexCount);
+	size_t uniqueCount = meshopt::generateVertexRemap(remap.data(), indices.data(), indexCount, primitiveVertices, vertexCount, sizeof(Vertex));
+	std::vector<Vertex> vertices(uniqueCount);
+	meshopt::remapVertexBuffer(vertices.data(), primitiveVertices, vertexCount, sizeof(Vertex), remap.data());
+	meshopt::remapIndexBuffer(indices.data(), indices.data(), indexCount, remap.data());
+
+	// Triangle order for the post-transform vertex cache and overdraw
+	std::vector<uint32_t> reordered(indexCount);
+	meshopt::optimizeVertexCache(reordered.data(), indices.data(), indexCount, uniqueCount);
+	meshopt::optimizeOverdraw(indices.data(), reordered.data(), indexCount, glm::value_ptr(vertices[0].pos), sizeof(Vertex), uniqueCount);
+
+	// Vertex order for fetch locality, writes the vertices back to the primitive's range
+	remap.resize(uniqueCount);
+	uniqueCount = meshopt::optimizeVertexFetchRemap(remap.data(), indices.data(), indexCount, uniqueCount);
+	meshopt::remapVertexBuffer(primitiveVertices, vertices.data(), vertices.size(), sizeof(Vertex), remap.data());
+	meshopt::remapIndexBuffer(indices.data(), indices.data(), indexCount, remap.data());
+
+	after = meshopt::analyzeVertexCache(indices.data(), indexCount, uniqueCount);
+	for (size_t i = 0; i < indexCount; i++) {
+		primitiveIndices[i] = indices[i] + primitive.firstVertex;
+	}
+	primitive.vertexCount = static_cast<uint32_t>(uniqueCount);
+}
+
+/* Optimizes all primitives in parallel and removes the vertices dropped by the deduplication from the vertex data */
+void vkglTF::Model::optimizeMeshes(const std::vector<PrimitiveLoadInfo>& primitives, std::vector<Vertex>& vertexBuffer, std::vector<uint32_t>& indexBuffer, vks::JobSystem& jobSystem)
+{
+	std::vector<vks::meshoptimizer::VertexCacheStatistics> before(primitives.size());
+	std::vector<vks::meshoptimizer::VertexCacheStatistics> after(primitives.size());
+	jobSystem.parallelFor(static_cast<uint32_t>(primitives.size()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			optimizePrimitive(*primitives[i].primitive, vertexBuffer.data(), indexBuffer.data(), before[i], after[i]);
+		}
+	});
+
+	// Primitives are stored in the order of their vertex ranges, so the ranges can be moved down in place
+	const size_t originalVertexCount = vertexBuffer.size();
+	uint32_t vertexCount = 0;
+	uint32_t triangleCount = 0;
+	meshOptimizationStatistics = {};
+	for (size_t i = 0; i < primitives.size(); i++) {
+		Primitive* primitive = primitives[i].primitive;
+		if (primitive->firstVertex != vertexCount) {
+			std::copy(vertexBuffer.begin() + primitive->firstVertex, vertexBuffer.begin() + primitive->firstVertex + primitive->vertexCount, vertexBuffer.begin() + vertexCount);
+			const uint32_t offset = primitive->firstVertex - vertexCount;
+			for (uint32_t j = 0; j < primitive->indexCount; j++) {
+				indexBuffer[primitive->firstIndex + j] -= offset;
+			}
+			primitive->firstVertex = vertexCount;
+		}
+		vertexCount += primitive->vertexCount;
+		triangleCount += primitive->indexCount / 3;
+		meshOptimizationStatistics.before.verticesTransformed += before[i].verticesTransformed;
+		meshOptimizationStatistics.after.verticesTransformed += after[i].verticesTransformed;
+	}
+	vertexBuffer.resize(vertexCount);
+
+	MeshOptimizationStatistics& stats = meshOptimizationStatistics;
+	stats.verticesRemoved = static_cast<uint32_t>(originalVertexCount - vertexCount);
+	if ((triangleCount > 0) && (vertexCount > 0)) {
+		stats.before.acmr = static_cast<float>(stats.before.verticesTransformed) / static_cast<float>(triangleCount);
+		stats.before.atvr = static_cast<float>(stats.before.verticesTransformed) / static_cast<float>(originalVertexCount);
+		stats.after.acmr = static_cast<float>(stats.after.verticesTransformed) / static_cast<float>(triangleCount);
+		stats.after.atvr = static_cast<float>(stats.after.verticesTransformed) / static_cast<float>(vertexCount);
+	}
+	std::cout << "Mesh optimization: ACMR " << stats.before.acmr << " -> " << stats.after.acmr << ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << ", " << stats.verticesRemoved << " duplicate vertices removed" << std::endl;
+}
+
+/*
+	Generates the LOD chain of each primitive in parallel
+	The index buffer is rebuilt so the levels of a primitive follow its full detail indices, all levels use the primitive's vertices
+*/
+void vkglTF::Model::generateLODs(const std::vector<PrimitiveLoadInfo>& primitives, const std::vector<Vertex>& vertexBuffer, std::vector<uint32_t>& indexBuffer, bool optimize, vks::JobSystem& jobSystem)
+{
+	// Simplified indices (relative to the primitive's first vertex) and errors of the levels after LOD 0
+	struct LODChain {
+		std::vector<std::vector<uint32_t>> indices;
+		std::vector<float> errors;
+	};
+	std::vector<LODChain> chains(primitives.size());
+	jobSystem.parallelFor(static_cast<uint32_t>(primitives.size()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			const Primitive& primitive = *primitives[i].primitive;
+			if ((primitive.vertexCount == 0) || (primitive.indexCount < 3)) {
+				continue;
+			}
+			const Vertex* vertices = &vertexBuffer[primitive.firstVertex];
+			std::vector<uint32_t> indices(&indexBuffer[primitive.firstIndex], &indexBuffer[primitive.firstIndex] + primitive.indexCount);
+			for (uint32_t& index : indices) {
+				index -= primitive.firstVertex;
+			}
+			const float attributeWeights[5] = { lodSettings.normalWeight, lodSettings.normalWeight, lodSettings.normalWeight, lodSettings.uvWeight, lodSettings.uvWeight };
+			const float maxError = lodSettings.maxError * glm::length(primitive.dimensions.size);
+			size_t previousCount = indices.size();
+			float targetCount = static_cast<float>(indices.size());
+			for (uint32_t level = 1; level < lodSettings.levelCount; level++) {
+				targetCount *= lodSettings.reduction;
+				// Each level is simplified from the full detail indices, so its error is relative to the original surface
+				std::vector<uint32_t> lodIndices(indices.size());
+				float error = 0.0f;
+				size_t count = vks::meshoptimizer::simplify(lodIndices.data(), indices.data(), indices.size(), glm::value_ptr(vertices[0].pos), sizeof(Vertex), primitive.vertexCount,
+					static_cast<size_t>(targetCount) / 3 * 3, maxError, &error, glm::value_ptr(vertices[0].normal), sizeof(Vertex), attributeWeights, 5);
+				// Stop once simplification doesn't make progress (error limit reached or everything locked)
+				if ((count == 0) || (count > previousCount * 9 / 10)) {
 					break;
 				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-					uint16_t *buf = new uint16_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint16_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-                    delete[] buf;
-                    break;
-				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-					uint8_t *buf = new uint8_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint8_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-                    delete[] buf;
-                    break;
-				}
-				default:
-					std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
-					return;
+				lodIndices.resize(count);
+				if (optimize) {
+					std::vector<uint32_t> optimized(count);
+					vks::meshoptimizer::optimizeVertexCache(optimized.data(), lodIndices.data(), count, primitive.vertexCount);
+					lodIndices.swap(optimized);
 				}
+				chains[i].indices.push_back(std::move(lodIndices));
+				chains[i].errors.push_back(error);
+				previousCount = count;
 			}
-			Primitive *newPrimitive = new Primitive(indexStart, indexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
-			newPrimitive->firstVertex = vertexStart;
-			newPrimitive->vertexCount = vertexCount;
-			newPrimitive->setDimensions(posMin, posMax);
-			newMesh->primitives.push_back(newPrimitive);
 		}
-		newNode->mesh = newMesh;
+	});
+
+	size_t indexCount = indexBuffer.size();
+	for (const LODChain& chain : chains) {
+		for (const auto& lodIndices : chain.indices) {
+			indexCount += lodIndices.size();
+		}
 	}
-	if (parent) {
-		parent->children.push_back(newNode);
-	} else {
-		nodes.push_back(newNode);
+	std::vector<uint32_t> lodIndexBuffer;
+	lodIndexBuffer.reserve(indexCount);
+	for (size_t i = 0; i < primitives.size(); i++) {
+		Primitive* primitive = primitives[i].primitive;
+		const uint32_t firstIndex = static_cast<uint32_t>(lodIndexBuffer.size());
+		lodIndexBuffer.insert(lodIndexBuffer.end(), indexBuffer.begin() + primitive->firstIndex, indexBuffer.begin() + primitive->firstIndex + primitive->indexCount);
+		primitive->firstIndex = firstIndex;
+		primitive->lods.clear();
+		primitive->lods.push_back({ firstIndex, primitive->indexCount, 0.0f });
+		for (size_t level = 0; level < chains[i].indices.size(); level++) {
+			const std::vector<uint32_t>& lodIndices = chains[i].indices[level];
+			primitive->lods.push_back({ static_cast<uint32_t>(lodIndexBuffer.size()), static_cast<uint32_t>(lodIndices.size()), chains[i].errors[level] });
+			for (uint32_t index : lodIndices) {
+				lodIndexBuffer.push_back(index + primitive->firstVertex);
+			}
+		}
 	}
-	linearNodes.push_back(newNode);
+	indexBuffer.swap(lodIndexBuffer);
 }
 
 void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
@@ -991,13 +1467,77 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 
 void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
 {
-	for (tinygltf::Image &image : gltfModel.images) {
-		vkglTF::Texture texture;
-		texture.fromglTfImage(image, path, device, transferQueue);
-		textures.push_back(texture);
+	vks::TextureStreamer& streamer = device->getTextureStreamer(transferQueue);
+	std::vector<vks::Texture> streamed;
+	requestImages(gltfModel, streamer, streamed);
+	finishImages(streamer, streamed, transferQueue);
+}
+
+/*
+	Queue all images for decoding on the streamer's threads and upload in batches
+	The textures are allocated up front, so materials can reference them before the images have been loaded
+*/
+void vkglTF::Model::requestImages(tinygltf::Model &gltfModel, vks::TextureStreamer &streamer, std::vector<vks::Texture> &streamed)
+{
+	streamed.resize(gltfModel.images.size());
+	textures.resize(gltfModel.images.size());
+	for (size_t i = 0; i < gltfModel.images.size(); i++) {
+		tinygltf::Image& image = gltfModel.images[i];
+		// Identifies the image in the streamer's error messages
+		const std::string name = !image.uri.empty() ? path + "/" + image.uri : (!image.name.empty() ? image.name : "image " + std::to_string(i) + " of " + path);
+		const size_t extension = image.uri.find_last_of(".");
+		if ((extension != std::string::npos) && (image.uri.substr(extension + 1) == "ktx")) {
+			// @todo: Use ktxTexture_GetVkFormat(ktxTexture)
+			streamer.requestFile(path + "/" + image.uri, VK_FORMAT_R8G8B8A8_UNORM, &streamed[i], VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT);
+		} else if (image.as_is) {
+			streamer.requestEncoded(std::move(image.image), &streamed[i], VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT, nullptr, name);
+		} else {
+			std::vector<unsigned char> pixels;
+			if (image.component == 3) {
+				// Most devices don't support RGB only on Vulkan so convert if necessary
+				pixels.resize(static_cast<size_t>(image.width) * image.height * 4, 255);
+				for (size_t j = 0; j < static_cast<size_t>(image.width) * image.height; j++) {
+					memcpy(&pixels[j * 4], &image.image[j * 3], 3);
+				}
+			} else {
+				pixels = std::move(image.image);
+			}
+			streamer.requestPixels(std::move(pixels), image.width, image.height, &streamed[i], VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT, nullptr, name);
+		}
 	}
+}
+
+/*
+	Wait for all requested images to be resident and take over their resources
+	Images that failed to load (already reported by the streamer) use the empty texture, so no descriptor references their missing image
+*/
+void vkglTF::Model::finishImages(vks::TextureStreamer &streamer, std::vector<vks::Texture> &streamed, VkQueue transferQueue)
+{
+	streamer.flush();
 	// Create an empty texture to be used for empty material images
 	createEmptyTexture(transferQueue);
+	for (size_t i = 0; i < streamed.size(); i++) {
+		const vks::Texture& source = streamed[i];
+		vkglTF::Texture& texture = textures[i];
+		if (source.image == VK_NULL_HANDLE) {
+			// The texture owns no resources, it only points at the empty texture's image
+			texture.device = device;
+			texture.descriptor = emptyTexture.descriptor;
+			continue;
+		}
+		texture.device = source.device;
+		texture.image = source.image;
+		texture.imageLayout = source.imageLayout;
+		texture.deviceMemory = source.deviceMemory;
+		texture.view = source.view;
+		texture.width = source.width;
+		texture.height = source.height;
+		texture.mipLevels = source.mipLevels;
+		texture.layerCount = source.layerCount;
+		texture.sampler = source.sampler;
+		texture.allocation = source.allocation;
+		texture.updateDescriptor();
+	}
 }
 
 void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
@@ -1043,6 +1583,7 @@ void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
 		if (mat.additionalValues.find("alphaCutoff") != mat.additionalValues.end()) {
 			material.alphaCutoff = static_cast<float>(mat.additionalValues["alphaCutoff"].Factor());
 		}
+		material.doubleSided = mat.doubleSided;
 
 		materials.push_back(material);
 	}
@@ -1164,8 +1705,34 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 	}
 }
 
-void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
+void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale, vks::JobSystem* jobSystem)
 {
+	loadTimings = {};
+	loadingFlags = fileLoadingFlags;
+	loadStart = std::chrono::high_resolution_clock::now();
+	loadStageStart = loadStart;
+	beginLoadStage(LoadStage::Parsing, nullptr);
+
+	size_t pos = filename.find_last_of('/');
+	path = filename.substr(0, pos);
+
+	this->device = device;
+
+	// The model's buffer uploads (vertices, indices and the empty texture) are recorded into one batch, so they end up in a single submission
+	// Images are uploaded by the texture streamer with its own submissions, outside of this batch
+	device->uploadManager.begin(transferQueue);
+
+	// A binary cache written by an earlier load of the same file (with the same flags) skips parsing and converting the glTF data
+	const std::string cacheFilename = filename + ".cache";
+	uint64_t cacheKey = 0;
+	if (meshCacheEnabled) {
+		cacheKey = getCacheKey(filename, fileLoadingFlags, scale);
+		if ((cacheKey != 0) && loadFromCache(cacheFilename, cacheKey, transferQueue)) {
+			device->uploadManager.end();
+			return;
+		}
+	}
+
 	tinygltf::Model gltfModel;
 	tinygltf::TinyGLTF gltfContext;
 	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
@@ -1178,86 +1745,114 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	// We let tinygltf handle this, by passing the asset manager of our app
 	tinygltf::asset_manager = androidApp->activity->assetManager;
 #endif
-	size_t pos = filename.find_last_of('/');
-	path = filename.substr(0, pos);
-
 	std::string error, warning;
 
-	this->device = device;
-
-#if defined(__ANDROID__)
-	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
-	// We let tinygltf handle this, by passing the asset manager of our app
-	tinygltf::asset_manager = androidApp->activity->assetManager;
-#endif
 	bool fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
 
 	std::vector<uint32_t> indexBuffer;
 	std::vector<Vertex> vertexBuffer;
+	std::vector<CachedImage> cachedImages;
 
 	if (fileLoaded) {
-		if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
-			loadImages(gltfModel, device, transferQueue);
+		const bool loadImages = !(fileLoadingFlags & FileLoadingFlags::DontLoadImages);
+		// The device's streamer is shared by all loads, so its threads and staging ring are only created once
+		vks::TextureStreamer* streamer = loadImages ? &device->getTextureStreamer(transferQueue) : nullptr;
+		std::vector<vks::Texture> streamed;
+		if (loadImages) {
+			beginLoadStage(LoadStage::Images, &loadTimings.parsing);
+			if (meshCacheEnabled) {
+				// Image data is moved to the streamer, so the cache gets a copy first
+				cachedImages = getCachedImages(gltfModel);
+			}
+			requestImages(gltfModel, *streamer, streamed);
 		}
 		loadMaterials(gltfModel);
+
+		beginLoadStage(LoadStage::Meshes, loadImages ? nullptr : &loadTimings.parsing);
+		// Create the node hierarchy and assign each primitive its range of the vertex and index data
+		std::vector<PrimitiveLoadInfo> primitives;
+		uint32_t indexCount = 0;
+		uint32_t vertexCount = 0;
 		const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
 		for (size_t i = 0; i < scene.nodes.size(); i++) {
-			const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-			loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
+			const tinygltf::Node &node = gltfModel.nodes[scene.nodes[i]];
+			loadNode(nullptr, node, scene.nodes[i], gltfModel, primitives, indexCount, vertexCount, scale);
 		}
-		if (gltfModel.animations.size() > 0) {
-			loadAnimations(gltfModel);
+		for (auto& info : primitives) {
+			info.matrix = info.node->getMatrix();
 		}
-		loadSkins(gltfModel);
 
-		for (auto node : linearNodes) {
-			// Assign skins
-			if (node->skinIndex > -1) {
-				node->skin = skins[node->skinIndex];
-			}
-			// Initial pose
-			if (node->mesh) {
-				node->update();
+		// Convert the primitives in parallel, large primitives are split into chunks so single big meshes are spread across threads too
+		struct ConversionRange {
+			uint32_t primitive;
+			uint32_t vertexBegin, vertexEnd;
+			uint32_t indexBegin, indexEnd;
+		};
+		const uint32_t verticesPerRange = 32768;
+		const uint32_t indicesPerRange = verticesPerRange * 3;
+		std::vector<ConversionRange> ranges;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(primitives.size()); i++) {
+			const Primitive* primitive = primitives[i].primitive;
+			const uint32_t rangeCount = std::max((primitive->vertexCount + verticesPerRange - 1) / verticesPerRange, (primitive->indexCount + indicesPerRange - 1) / indicesPerRange);
+			for (uint32_t r = 0; r < rangeCount; r++) {
+				ConversionRange range;
+				range.primitive = i;
+				range.vertexBegin = std::min(r * verticesPerRange, primitive->vertexCount);
+				range.vertexEnd = std::min((r + 1) * verticesPerRange, primitive->vertexCount);
+				range.indexBegin = std::min(r * indicesPerRange, primitive->indexCount);
+				range.indexEnd = std::min((r + 1) * indicesPerRange, primitive->indexCount);
+				ranges.push_back(range);
 			}
 		}
+		vertexBuffer.resize(vertexCount);
+		indexBuffer.resize(indexCount);
+		// Without a job system from the caller the device's shared one is used, so its threads are only started once
+		if (!jobSystem) {
+			jobSystem = &device->getJobSystem();
+		}
+		jobSystem->parallelFor(static_cast<uint32_t>(ranges.size()), 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				const ConversionRange& range = ranges[i];
+				loadPrimitive(gltfModel, primitives[range.primitive], range.vertexBegin, range.vertexEnd, range.indexBegin, range.indexEnd, vertexBuffer.data(), indexBuffer.data(), fileLoadingFlags);
+			}
+		});
+		if (fileLoadingFlags & FileLoadingFlags::OptimizeMeshes) {
+			optimizeMeshes(primitives, vertexBuffer, indexBuffer, *jobSystem);
+		}
+		if (fileLoadingFlags & FileLoadingFlags::GenerateLODs) {
+			generateLODs(primitives, vertexBuffer, indexBuffer, (fileLoadingFlags & FileLoadingFlags::OptimizeMeshes) != 0, *jobSystem);
+		}
+
+		if (gltfModel.animations.size() > 0) {
+			loadAnimations(gltfModel);
+		}
+		loadSkins(gltfModel);
+
+		for (auto node : linearNodes) {
+			// Assign skins
+			if (node->skinIndex > -1) {
+				node->skin = skins[node->skinIndex];
+			}
+		}
+		// Initial pose
+		buildTransforms();
+
+		if (loadImages) {
+			// Decoding has been running in the background since the images were requested
+			beginLoadStage(LoadStage::Images, &loadTimings.meshes);
+			finishImages(*streamer, streamed, transferQueue);
+			beginLoadStage(LoadStage::Upload, &loadTimings.images);
+		} else {
+			beginLoadStage(LoadStage::Upload, &loadTimings.meshes);
+		}
 	}
 	else {
+		device->uploadManager.end();
 		// TODO: throw
 		vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + error, -1);
 		return;
 	}
 
-	// Pre-Calculations for requested features
-	if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
-		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
-		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
-		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
-		for (Node* node : linearNodes) {
-			if (node->mesh) {
-				const glm::mat4 localMatrix = node->getMatrix();
-				for (Primitive* primitive : node->mesh->primitives) {
-					for (uint32_t i = 0; i < primitive->vertexCount; i++) {
-						Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
-						// Pre-transform vertex positions by node-hierarchy
-						if (preTransform) {
-							vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
-							vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
-						}
-						// Flip Y-Axis of vertex positions
-						if (flipY) {
-							vertex.pos.y *= -1.0f;
-							vertex.normal.y *= -1.0f;
-						}
-						// Pre-Multiply vertex colors with material base color
-						if (preMultiplyColor) {
-							vertex.color = primitive->material.baseColorFactor * vertex.color;
-						}
-					}
-				}
-			}
-		}
-	}
-
 	for (auto extension : gltfModel.extensionsUsed) {
 		if (extension == "KHR_materials_pbrSpecularGlossiness") {
 			std::cout << "Required extension: " << extension;
@@ -1265,35 +1860,233 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		}
 	}
 
-	size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-	indices.count = static_cast<uint32_t>(indexBuffer.size());
-	vertices.count = static_cast<uint32_t>(vertexBuffer.size());
+	createBuffers(vertexBuffer.data(), vertexBuffer.size(), indexBuffer.data(), indexBuffer.size(), transferQueue);
+	device->uploadManager.end();
+	getSceneDimensions();
 
-	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
+	beginLoadStage(LoadStage::Descriptors, &loadTimings.upload);
+	setupDescriptors();
 
-	struct StagingBuffer {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} vertexStaging, indexStaging;
+	beginLoadStage(LoadStage::Done, &loadTimings.descriptors);
+	loadTimings.total = std::chrono::duration<double, std::milli>(loadStageStart - loadStart).count();
 
-	// Create staging buffers
-	// Vertex data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		vertexBufferSize,
-		&vertexStaging.buffer,
-		&vertexStaging.memory,
-		vertexBuffer.data()));
-	// Index data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		indexBufferSize,
-		&indexStaging.buffer,
-		&indexStaging.memory,
-		indexBuffer.data()));
+	if (cacheKey != 0) {
+		std::vector<std::string> dependencies;
+		for (auto& buffer : gltfModel.buffers) {
+			dependencies.push_back(buffer.uri);
+		}
+		for (auto& image : gltfModel.images) {
+			dependencies.push_back(image.uri);
+		}
+		writeCache(cacheFilename, cacheKey, dependencies, cachedImages, vertexBuffer, indexBuffer);
+	}
+}
+
+void vkglTF::Model::beginLoadStage(LoadStage stage, double* previousStageTime)
+{
+	const auto tNow = std::chrono::high_resolution_clock::now();
+	if (previousStageTime) {
+		*previousStageTime = std::chrono::duration<double, std::milli>(tNow - loadStageStart).count();
+	}
+	loadStageStart = tNow;
+	if (progressCallback) {
+		progressCallback(stage, static_cast<float>(static_cast<uint32_t>(stage)) / static_cast<float>(static_cast<uint32_t>(LoadStage::Done)));
+	}
+}
+
+namespace
+{
+	uint32_t vertexFormatSize(VkFormat format)
+	{
+		switch (format) {
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return 16;
+		case VK_FORMAT_R32G32B32_SFLOAT:
+			return 12;
+		case VK_FORMAT_R32G32_SFLOAT:
+		case VK_FORMAT_R16G16B16A16_USCALED:
+		case VK_FORMAT_R16G16B16A16_UINT:
+			return 8;
+		default:
+			// All packed formats use four bytes
+			return 4;
+		}
+	}
+
+	// Octahedral mapping of a unit vector to [-1..1]^2
+	glm::vec2 octEncode(glm::vec3 n)
+	{
+		n /= (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+		glm::vec2 result(n.x, n.y);
+		if (n.z < 0.0f) {
+			result.x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+			result.y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		return result;
+	}
+
+	bool vertexFormatSupported(vks::VulkanDevice* device, VkFormat format)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		return (formatProperties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) != 0;
+	}
+}
+
+/* Select the formats and offsets of the vertex components based on the model's vertex layout */
+void vkglTF::Model::setupVertexAttributes(const Vertex* vertexData, size_t vertexCount)
+{
+	vertexAttributes.clear();
+	const uint32_t packingFlags = vertexLayout.packingFlags;
+	if (vertexLayout.components.empty() && (packingFlags == 0)) {
+		// Default layout, vertices are uploaded as they are
+		vertexAttributes = {
+			{ VertexComponent::Position, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, pos)) },
+			{ VertexComponent::Normal, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, normal)) },
+			{ VertexComponent::UV, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, uv)) },
+			{ VertexComponent::Color, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, color)) },
+			{ VertexComponent::Joint0, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, joint0)) },
+			{ VertexComponent::Weight0, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, weight0)) },
+			{ VertexComponent::Tangent, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, tangent)) },
+		};
+		vertexStride = sizeof(Vertex);
+		return;
+	}
+
+	std::vector<VertexComponent> components = vertexLayout.components;
+	if (components.empty()) {
+		components = { VertexComponent::Position, VertexComponent::Normal, VertexComponent::UV, VertexComponent::Color, VertexComponent::Joint0, VertexComponent::Weight0, VertexComponent::Tangent };
+	}
+
+	// Scan the data for the value ranges that decide between the packed formats
+	bool uvsNormalized = true;
+	float maxJoint = 0.0f;
+	for (size_t i = 0; i < vertexCount; i++) {
+		const Vertex& vertex = vertexData[i];
+		uvsNormalized &= (vertex.uv.x >= 0.0f) && (vertex.uv.x <= 1.0f) && (vertex.uv.y >= 0.0f) && (vertex.uv.y <= 1.0f);
+		maxJoint = std::max(maxJoint, std::max(std::max(vertex.joint0.x, vertex.joint0.y), std::max(vertex.joint0.z, vertex.joint0.w)));
+	}
+
+	uint32_t offset = 0;
+	for (VertexComponent component : components) {
+		VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		switch (component) {
+		case VertexComponent::Position:
+			format = VK_FORMAT_R32G32B32_SFLOAT;
+			break;
+		case VertexComponent::Normal:
+			format = (packingFlags & VertexPackingFlags::PackNormals) ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+			break;
+		case VertexComponent::Tangent:
+			format = (packingFlags & VertexPackingFlags::PackNormals) ? VK_FORMAT_R8G8B8A8_SNORM : VK_FORMAT_R32G32B32A32_SFLOAT;
+			break;
+		case VertexComponent::UV:
+			if (packingFlags & VertexPackingFlags::PackUVs) {
+				format = uvsNormalized ? VK_FORMAT_R16G16_UNORM : VK_FORMAT_R16G16_SFLOAT;
+			} else {
+				format = VK_FORMAT_R32G32_SFLOAT;
+			}
+			break;
+		case VertexComponent::Color:
+			format = (packingFlags & VertexPackingFlags::PackColors) ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32A32_SFLOAT;
+			break;
+		case VertexComponent::Joint0:
+			// Scaled formats keep the float inputs of existing shaders working, but they are optional for vertex buffers
+			if (packingFlags & VertexPackingFlags::PackSkinning) {
+				VkFormat packedFormat = (maxJoint < 256.0f) ? VK_FORMAT_R8G8B8A8_USCALED : VK_FORMAT_R16G16B16A16_USCALED;
+				if (vertexFormatSupported(device, packedFormat)) {
+					format = packedFormat;
+				}
+			}
+			break;
+		case VertexComponent::Weight0:
+			format = (packingFlags & VertexPackingFlags::PackSkinning) ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32A32_SFLOAT;
+			break;
+		}
+		vertexAttributes.push_back({ component, format, offset });
+		offset += vertexFormatSize(format);
+	}
+	vertexStride = offset;
+}
+
+/* Convert the vertices into the formats selected by setupVertexAttributes */
+void vkglTF::Model::packVertices(const Vertex* vertexData, size_t vertexCount, uint8_t* packedData) const
+{
+	for (size_t i = 0; i < vertexCount; i++) {
+		const Vertex& vertex = vertexData[i];
+		uint8_t* dst = packedData + i * vertexStride;
+		for (const VertexAttribute& attribute : vertexAttributes) {
+			uint8_t* attributeData = dst + attribute.offset;
+			uint32_t packed[2] = { 0, 0 };
+			switch (attribute.format) {
+			case VK_FORMAT_R16G16_SNORM:
+				packed[0] = glm::packSnorm2x16(octEncode(vertex.normal));
+				break;
+			case VK_FORMAT_R8G8B8A8_SNORM:
+				packed[0] = glm::packSnorm4x8(glm::vec4(octEncode(glm::vec3(vertex.tangent)), 0.0f, vertex.tangent.w < 0.0f ? -1.0f : 1.0f));
+				break;
+			case VK_FORMAT_R16G16_UNORM:
+				packed[0] = glm::packUnorm2x16(vertex.uv);
+				break;
+			case VK_FORMAT_R16G16_SFLOAT:
+				packed[0] = glm::packHalf2x16(vertex.uv);
+				break;
+			case VK_FORMAT_R8G8B8A8_UNORM:
+				packed[0] = glm::packUnorm4x8((attribute.component == VertexComponent::Color) ? vertex.color : vertex.weight0);
+				break;
+			case VK_FORMAT_R8G8B8A8_USCALED:
+				packed[0] = static_cast<uint32_t>(vertex.joint0.x) | (static_cast<uint32_t>(vertex.joint0.y) << 8) | (static_cast<uint32_t>(vertex.joint0.z) << 16) | (static_cast<uint32_t>(vertex.joint0.w) << 24);
+				break;
+			case VK_FORMAT_R16G16B16A16_USCALED:
+				packed[0] = static_cast<uint32_t>(vertex.joint0.x) | (static_cast<uint32_t>(vertex.joint0.y) << 16);
+				packed[1] = static_cast<uint32_t>(vertex.joint0.z) | (static_cast<uint32_t>(vertex.joint0.w) << 16);
+				break;
+			default:
+				break;
+			}
+			switch (attribute.format) {
+			case VK_FORMAT_R32G32B32_SFLOAT:
+				memcpy(attributeData, (attribute.component == VertexComponent::Position) ? glm::value_ptr(vertex.pos) : glm::value_ptr(vertex.normal), sizeof(glm::vec3));
+				break;
+			case VK_FORMAT_R32G32_SFLOAT:
+				memcpy(attributeData, glm::value_ptr(vertex.uv), sizeof(glm::vec2));
+				break;
+			case VK_FORMAT_R32G32B32A32_SFLOAT: {
+				const glm::vec4* source = &vertex.color;
+				if (attribute.component == VertexComponent::Joint0) {
+					source = &vertex.joint0;
+				} else if (attribute.component == VertexComponent::Weight0) {
+					source = &vertex.weight0;
+				} else if (attribute.component == VertexComponent::Tangent) {
+					source = &vertex.tangent;
+				}
+				memcpy(attributeData, glm::value_ptr(*source), sizeof(glm::vec4));
+				break;
+			}
+			default:
+				memcpy(attributeData, packed, vertexFormatSize(attribute.format));
+				break;
+			}
+		}
+	}
+}
+
+/* Upload the vertex and index data to device local buffers */
+void vkglTF::Model::createBuffers(const Vertex* vertexData, size_t vertexCount, const uint32_t* indexData, size_t indexCount, VkQueue transferQueue)
+{
+	setupVertexAttributes(vertexData, vertexCount);
+
+	const bool packed = !vertexLayout.components.empty() || (vertexLayout.packingFlags != 0);
+	const bool separatePositions = (vertexLayout.packingFlags & VertexPackingFlags::SeparatePositions) != 0;
+	size_t vertexBufferSize = vertexCount * vertexStride;
+	size_t positionBufferSize = separatePositions ? vertexCount * sizeof(glm::vec3) : 0;
+	size_t indexBufferSize = indexCount * sizeof(uint32_t);
+	indices.count = static_cast<uint32_t>(indexCount);
+	vertices.count = static_cast<uint32_t>(vertexCount);
+	const size_t defaultBufferSize = vertexCount * sizeof(Vertex);
+	vertexBytesSaved = (defaultBufferSize > vertexBufferSize + positionBufferSize) ? defaultBufferSize - (vertexBufferSize + positionBufferSize) : 0;
+
+	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
 
 	// Create device local buffers
 	// Vertex buffer
@@ -1303,6 +2096,15 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		vertexBufferSize,
 		&vertices.buffer,
 		&vertices.memory));
+	// Position buffer
+	if (separatePositions) {
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			positionBufferSize,
+			&vertices.positionBuffer,
+			&vertices.positionMemory));
+	}
 	// Index buffer
 	VK_CHECK_RESULT(device->createBuffer(
 	    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
@@ -1311,27 +2113,49 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		&indices.buffer,
 		&indices.memory));
 
-	// Copy from staging buffers
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	// Stage the data in the upload manager's ring and copy it with the rest of the model's uploads
+	VkCommandBuffer copyCmd = device->uploadManager.begin(transferQueue);
 
 	VkBufferCopy copyRegion = {};
 
+	// Vertex data
+	vks::UploadManager::Staging staging = device->uploadManager.stage(packed ? nullptr : vertexData, vertexBufferSize);
+	if (packed) {
+		// Packed vertices are written straight into the staging memory
+		packVertices(vertexData, vertexCount, static_cast<uint8_t*>(staging.mapped));
+	}
+	copyRegion.srcOffset = staging.offset;
 	copyRegion.size = vertexBufferSize;
-	vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
+	vkCmdCopyBuffer(copyCmd, staging.buffer, vertices.buffer, 1, &copyRegion);
+
+	// Position data
+	if (separatePositions) {
+		staging = device->uploadManager.stage(nullptr, positionBufferSize);
+		glm::vec3* positions = static_cast<glm::vec3*>(staging.mapped);
+		for (size_t i = 0; i < vertexCount; i++) {
+			positions[i] = vertexData[i].pos;
+		}
+		copyRegion.srcOffset = staging.offset;
+		copyRegion.size = positionBufferSize;
+		vkCmdCopyBuffer(copyCmd, staging.buffer, vertices.positionBuffer, 1, &copyRegion);
+	}
 
+	// Index data
+	staging = device->uploadManager.stage(indexData, indexBufferSize);
+	copyRegion.srcOffset = staging.offset;
 	copyRegion.size = indexBufferSize;
-	vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
+	vkCmdCopyBuffer(copyCmd, staging.buffer, indices.buffer, 1, &copyRegion);
 
-	device->flushCommandBuffer(copyCmd, transferQueue, true);
+	device->uploadManager.end();
 
-	vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
-
-	getSceneDimensions();
+	if (packed) {
+		std::cout << "Packed vertices: " << vertexStride << " bytes per vertex (default " << sizeof(Vertex) << "), " << (vertexBytesSaved / 1024) << " KB saved" << std::endl;
+	}
+}
 
-	// Setup descriptors
+/* Create the descriptor pool and the descriptor sets for the node uniform buffers and material images */
+void vkglTF::Model::setupDescriptors()
+{
 	uint32_t uboCount{ 0 };
 	uint32_t imageCount{ 0 };
 	for (auto node : linearNodes) {
@@ -1405,14 +2229,598 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	}
 }
 
-void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
+/*
+	Binary mesh cache
+
+	Stores the converted vertex and index data together with everything else loadFromFile derives from the glTF file (node hierarchy, materials, skins, animations and image sources)
+	The key is a hash of the glTF file's contents, the loading flags, the scale and the vertex layout, files referenced by the glTF file are checked by size and modification time
+	Vertex and index data is stored at the end of the file, so it can be copied from the memory mapped file straight into the staging buffers
+*/
+
+namespace
+{
+	const char cacheMagic[4] = { 'V', 'K', 'G', 'C' };
+	// Increment whenever the layout of the cache or the data derived from the glTF file changes
+	const uint32_t cacheVersion = 4;
+
+	struct CacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint64_t fileSize;
+		uint64_t metaOffset;
+		uint64_t metaSize;
+		uint64_t metaHash;
+		uint64_t vertexOffset;
+		uint64_t vertexCount;
+		uint64_t indexOffset;
+		uint64_t indexCount;
+	};
+
+	/* 64 bit FNV-1a */
+	uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	struct FileStamp {
+		uint64_t size = 0;
+		int64_t modified = 0;
+	};
+
+	bool getFileStamp(const std::string& filename, FileStamp& stamp)
+	{
+		struct stat fileStat;
+		if (stat(filename.c_str(), &fileStat) != 0) {
+			return false;
+		}
+		stamp.size = static_cast<uint64_t>(fileStat.st_size);
+		stamp.modified = static_cast<int64_t>(fileStat.st_mtime);
+		return true;
+	}
+
+	/* Files referenced by the glTF file, embedded (data uri) buffers and images are covered by the hash of the glTF file */
+	bool isExternalUri(const std::string& uri)
+	{
+		return !uri.empty() && (uri.compare(0, 5, "data:") != 0);
+	}
+
+	class CacheWriter {
+	public:
+		std::vector<uint8_t> bytes;
+		template<typename T> void write(const T& value)
+		{
+			const uint8_t* data = reinterpret_cast<const uint8_t*>(&value);
+			bytes.insert(bytes.end(), data, data + sizeof(T));
+		}
+		template<typename T> void writeVector(const std::vector<T>& values)
+		{
+			write(static_cast<uint64_t>(values.size()));
+			const uint8_t* data = reinterpret_cast<const uint8_t*>(values.data());
+			bytes.insert(bytes.end(), data, data + values.size() * sizeof(T));
+		}
+		void writeString(const std::string& value)
+		{
+			write(static_cast<uint64_t>(value.size()));
+			bytes.insert(bytes.end(), value.begin(), value.end());
+		}
+	};
+
+	/* Reads from a cache whose contents have been validated by the meta data hash */
+	class CacheReader {
+	public:
+		CacheReader(const uint8_t* data) : current(data) {}
+		template<typename T> T read()
+		{
+			T value;
+			memcpy(&value, current, sizeof(T));
+			current += sizeof(T);
+			return value;
+		}
+		template<typename T> std::vector<T> readVector()
+		{
+			std::vector<T> values(static_cast<size_t>(read<uint64_t>()));
+			memcpy(values.data(), current, values.size() * sizeof(T));
+			current += values.size() * sizeof(T);
+			return values;
+		}
+		std::string readString()
+		{
+			const size_t size = static_cast<size_t>(read<uint64_t>());
+			std::string value(reinterpret_cast<const char*>(current), size);
+			current += size;
+			return value;
+		}
+	private:
+		const uint8_t* current;
+	};
+}
+
+/* @return Key identifying the converted data of a glTF file, 0 if the file can't be read */
+uint64_t vkglTF::Model::getCacheKey(const std::string& filename, uint32_t fileLoadingFlags, float scale) const
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		return 0;
+	}
+	std::vector<char> contents(static_cast<size_t>(file.tellg()));
+	file.seekg(0, std::ios::beg);
+	file.read(contents.data(), contents.size());
+	uint64_t key = hashBytes(contents.data(), contents.size());
+	// The vertex data depends on the loading flags and the vertex layout
+	const uint32_t layout[] = {
+		cacheVersion, fileLoadingFlags, static_cast<uint32_t>(sizeof(Vertex)),
+		static_cast<uint32_t>(offsetof(Vertex, pos)), static_cast<uint32_t>(offsetof(Vertex, normal)), static_cast<uint32_t>(offsetof(Vertex, uv)), static_cast<uint32_t>(offsetof(Vertex, color)),
+		static_cast<uint32_t>(offsetof(Vertex, joint0)), static_cast<uint32_t>(offsetof(Vertex, weight0)), static_cast<uint32_t>(offsetof(Vertex, tangent))
+	};
+	key = hashBytes(layout, sizeof(layout), key);
+	key = hashBytes(&scale, sizeof(scale), key);
+	if (fileLoadingFlags & FileLoadingFlags::GenerateLODs) {
+		const float lodParameters[] = { static_cast<float>(lodSettings.levelCount), lodSettings.reduction, lodSettings.maxError, lodSettings.normalWeight, lodSettings.uvWeight };
+		key = hashBytes(lodParameters, sizeof(lodParameters), key);
+	}
+	return (key != 0) ? key : 1;
+}
+
+/* Copy the image sources before they are handed to the texture streamer */
+std::vector<vkglTF::Model::CachedImage> vkglTF::Model::getCachedImages(const tinygltf::Model& gltfModel) const
+{
+	std::vector<CachedImage> images(gltfModel.images.size());
+	for (size_t i = 0; i < gltfModel.images.size(); i++) {
+		const tinygltf::Image& image = gltfModel.images[i];
+		CachedImage& cachedImage = images[i];
+		const size_t extension = image.uri.find_last_of(".");
+		if ((extension != std::string::npos) && (image.uri.substr(extension + 1) == "ktx")) {
+			cachedImage.type = CachedImage::KtxFile;
+			cachedImage.uri = image.uri;
+		} else if (image.as_is && isExternalUri(image.uri)) {
+			// Image files are read again on load, the cache only references them (and tracks their stamps)
+			cachedImage.type = CachedImage::EncodedFile;
+			cachedImage.uri = image.uri;
+		} else if (image.as_is) {
+			// Data URIs and images stored in a buffer view are embedded
+			cachedImage.type = CachedImage::Encoded;
+			cachedImage.data = image.image;
+		} else {
+			cachedImage.type = CachedImage::Pixels;
+			cachedImage.width = image.width;
+			cachedImage.height = image.height;
+			cachedImage.data.resize(static_cast<size_t>(image.width) * image.height * 4, 255);
+			for (size_t j = 0; j < static_cast<size_t>(image.width) * image.height; j++) {
+				memcpy(&cachedImage.data[j * 4], &image.image[j * image.component], std::min(image.component, 4));
+			}
+		}
+	}
+	return images;
+}
+
+void vkglTF::Model::writeCache(const std::string& cacheFilename, uint64_t key, const std::vector<std::string>& dependencies, const std::vector<CachedImage>& images, const std::vector<Vertex>& vertexBuffer, const std::vector<uint32_t>& indexBuffer) const
 {
+	CacheWriter writer;
+
+	// Files referenced by the glTF file
+	std::vector<std::string> externalFiles;
+	for (auto& uri : dependencies) {
+		if (isExternalUri(uri)) {
+			externalFiles.push_back(uri);
+		}
+	}
+	writer.write(static_cast<uint32_t>(externalFiles.size()));
+	for (auto& uri : externalFiles) {
+		FileStamp stamp;
+		if (!getFileStamp(path + "/" + uri, stamp)) {
+			// Without a stamp the cache couldn't detect changes to this file
+			return;
+		}
+		writer.writeString(uri);
+		writer.write(stamp);
+	}
+
+	writer.write(static_cast<uint32_t>(metallicRoughnessWorkflow));
+
+	writer.write(static_cast<uint32_t>(images.size()));
+	for (auto& image : images) {
+		writer.write(static_cast<uint32_t>(image.type));
+		writer.writeString(image.uri);
+		writer.write(image.width);
+		writer.write(image.height);
+		writer.writeVector(image.data);
+	}
+
+	auto textureIndex = [this](const vkglTF::Texture* texture) -> int32_t {
+		if (texture == nullptr) {
+			return -1;
+		}
+		if (texture == &emptyTexture) {
+			return -2;
+		}
+		return static_cast<int32_t>(texture - textures.data());
+	};
+	writer.write(static_cast<uint32_t>(materials.size()));
+	for (auto& material : materials) {
+		writer.write(static_cast<uint32_t>(material.alphaMode));
+		writer.write(material.alphaCutoff);
+		writer.write(static_cast<uint32_t>(material.doubleSided));
+		writer.write(material.metallicFactor);
+		writer.write(material.roughnessFactor);
+		writer.write(material.baseColorFactor);
+		writer.write(textureIndex(material.baseColorTexture));
+		writer.write(textureIndex(material.metallicRoughnessTexture));
+		writer.write(textureIndex(material.normalTexture));
+		writer.write(textureIndex(material.occlusionTexture));
+		writer.write(textureIndex(material.emissiveTexture));
+	}
+
+	// Nodes are referenced by their index in linearNodes
+	std::unordered_map<const Node*, int32_t> nodeIndices;
+	for (size_t i = 0; i < linearNodes.size(); i++) {
+		nodeIndices[linearNodes[i]] = static_cast<int32_t>(i);
+	}
+	auto nodeIndex = [&nodeIndices](const Node* node) -> int32_t {
+		return node ? nodeIndices[node] : -1;
+	};
+	writer.write(static_cast<uint32_t>(linearNodes.size()));
+	for (auto node : linearNodes) {
+		writer.write(nodeIndex(node->parent));
+		writer.write(node->index);
+		writer.writeString(node->name);
+		writer.write(node->matrix);
+		writer.write(node->translation);
+		writer.write(node->rotation);
+		writer.write(node->scale);
+		writer.write(node->skinIndex);
+		writer.write(static_cast<uint32_t>(node->mesh != nullptr));
+		if (node->mesh) {
+			writer.writeString(node->mesh->name);
+			writer.write(static_cast<uint32_t>(node->mesh->primitives.size()));
+			for (auto primitive : node->mesh->primitives) {
+				writer.write(primitive->firstIndex);
+				writer.write(primitive->indexCount);
+				writer.write(primitive->firstVertex);
+				writer.write(primitive->vertexCount);
+				writer.write(static_cast<uint32_t>(&primitive->material - materials.data()));
+				writer.write(primitive->dimensions.min);
+				writer.write(primitive->dimensions.max);
+				writer.writeVector(primitive->lods);
+			}
+		}
+	}
+
+	writer.write(static_cast<uint32_t>(skins.size()));
+	for (auto skin : skins) {
+		writer.writeString(skin->name);
+		writer.write(nodeIndex(skin->skeletonRoot));
+		std::vector<int32_t> joints;
+		for (auto joint : skin->joints) {
+			joints.push_back(nodeIndex(joint));
+		}
+		writer.writeVector(joints);
+		writer.writeVector(skin->inverseBindMatrices);
+	}
+
+	writer.write(static_cast<uint32_t>(animations.size()));
+	for (auto& animation : animations) {
+		writer.writeString(animation.name);
+		writer.write(animation.start);
+		writer.write(animation.end);
+		writer.write(static_cast<uint32_t>(animation.samplers.size()));
+		for (auto& sampler : animation.samplers) {
+			writer.write(static_cast<uint32_t>(sampler.interpolation));
+			writer.writeVector(sampler.inputs);
+			writer.writeVector(sampler.outputsVec4);
+		}
+		writer.write(static_cast<uint32_t>(animation.channels.size()));
+		for (auto& channel : animation.channels) {
+			writer.write(static_cast<uint32_t>(channel.path));
+			writer.write(nodeIndex(channel.node));
+			writer.write(channel.samplerIndex);
+		}
+	}
+
+	// Vertex and index data follow the meta data, aligned for copying
+	auto align = [](uint64_t offset) { return (offset + 15) & ~static_cast<uint64_t>(15); };
+	CacheHeader header{};
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.key = key;
+	header.metaOffset = sizeof(CacheHeader);
+	header.metaSize = writer.bytes.size();
+	header.metaHash = hashBytes(writer.bytes.data(), writer.bytes.size());
+	header.vertexOffset = align(header.metaOffset + header.metaSize);
+	header.vertexCount = vertexBuffer.size();
+	header.indexOffset = align(header.vertexOffset + vertexBuffer.size() * sizeof(Vertex));
+	header.indexCount = indexBuffer.size();
+	header.fileSize = header.indexOffset + indexBuffer.size() * sizeof(uint32_t);
+
+	// Written to a temporary file first, so other instances never map a partially written cache
+	const std::string temporaryFilename = cacheFilename + ".tmp";
+	{
+		std::ofstream file(temporaryFilename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return;
+		}
+		const char padding[16] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(writer.bytes.data()), writer.bytes.size());
+		file.write(padding, header.vertexOffset - (header.metaOffset + header.metaSize));
+		file.write(reinterpret_cast<const char*>(vertexBuffer.data()), vertexBuffer.size() * sizeof(Vertex));
+		file.write(padding, header.indexOffset - (header.vertexOffset + vertexBuffer.size() * sizeof(Vertex)));
+		file.write(reinterpret_cast<const char*>(indexBuffer.data()), indexBuffer.size() * sizeof(uint32_t));
+		if (!file.good()) {
+			file.close();
+			std::remove(temporaryFilename.c_str());
+			return;
+		}
+	}
+	std::remove(cacheFilename.c_str());
+	if (std::rename(temporaryFilename.c_str(), cacheFilename.c_str()) != 0) {
+		std::remove(temporaryFilename.c_str());
+	}
+}
+
+/*
+	Load the model from its binary cache
+	@return False if there is no valid cache for the current glTF file and loading flags
+*/
+bool vkglTF::Model::loadFromCache(const std::string& cacheFilename, uint64_t key, VkQueue transferQueue)
+{
+	vks::MappedFile cache;
+	if (!cache.open(cacheFilename) || (cache.size() < sizeof(CacheHeader))) {
+		return false;
+	}
+	CacheHeader header;
+	memcpy(&header, cache.data(), sizeof(header));
+	if ((memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0) || (header.version != cacheVersion) || (header.key != key) || (header.fileSize != cache.size())) {
+		return false;
+	}
+	if ((header.metaOffset + header.metaSize > header.fileSize) || (header.vertexOffset + header.vertexCount * sizeof(Vertex) > header.fileSize) || (header.indexOffset + header.indexCount * sizeof(uint32_t) > header.fileSize)) {
+		return false;
+	}
+	if (hashBytes(cache.data() + header.metaOffset, static_cast<size_t>(header.metaSize)) != header.metaHash) {
+		return false;
+	}
+
+	CacheReader reader(cache.data() + header.metaOffset);
+	const uint32_t fileCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < fileCount; i++) {
+		const std::string uri = reader.readString();
+		const FileStamp cachedStamp = reader.read<FileStamp>();
+		FileStamp stamp;
+		if (!getFileStamp(path + "/" + uri, stamp) || (stamp.size != cachedStamp.size) || (stamp.modified != cachedStamp.modified)) {
+			return false;
+		}
+	}
+
+	// The cache is valid, everything from here on mirrors loadFromFile
+	metallicRoughnessWorkflow = reader.read<uint32_t>() != 0;
+
+	vks::TextureStreamer* streamer = nullptr;
+	std::vector<vks::Texture> streamed;
+	const uint32_t imageCount = reader.read<uint32_t>();
+	if (imageCount > 0) {
+		beginLoadStage(LoadStage::Images, &loadTimings.parsing);
+		streamer = &device->getTextureStreamer(transferQueue);
+		streamed.resize(imageCount);
+		textures.resize(imageCount);
+		for (uint32_t i = 0; i < imageCount; i++) {
+			const CachedImage::Type type = static_cast<CachedImage::Type>(reader.read<uint32_t>());
+			const std::string uri = reader.readString();
+			const uint32_t width = reader.read<uint32_t>();
+			const uint32_t height = reader.read<uint32_t>();
+			std::vector<unsigned char> data = reader.readVector<unsigned char>();
+			// Identifies the image in the streamer's error messages
+			const std::string name = !uri.empty() ? path + "/" + uri : "image " + std::to_string(i) + " of " + path;
+			switch (type) {
+			case CachedImage::KtxFile:
+				// @todo: Use ktxTexture_GetVkFormat(ktxTexture)
+				streamer->requestFile(path + "/" + uri, VK_FORMAT_R8G8B8A8_UNORM, &streamed[i], VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT);
+				break;
+			case CachedImage::EncodedFile: {
+				vks::MappedFile file;
+				// The file's stamp has been validated above, so it's only missing if it has been removed since
+				if (!file.open(path + "/" + uri)) {
+					vks::tools::exitFatal("Could not open image file \"" + path + "/" + uri + "\" referenced by the mesh cache", -1);
+				}
+				data.assign(file.data(), file.data() + file.size());
+				streamer->requestEncoded(std::move(data), &streamed[i], VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT, nullptr, name);
+				break;
+			}
+			case CachedImage::Encoded:
+				streamer->requestEncoded(std::move(data), &streamed[i], VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT, nullptr, name);
+				break;
+			case CachedImage::Pixels:
+				streamer->requestPixels(std::move(data), width, height, &streamed[i], VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT, nullptr, name);
+				break;
+			}
+		}
+	}
+
+	beginLoadStage(LoadStage::Meshes, (imageCount > 0) ? nullptr : &loadTimings.parsing);
+	auto getCachedTexture = [this](int32_t index) -> vkglTF::Texture* {
+		return (index == -2) ? &emptyTexture : ((index >= 0) ? getTexture(static_cast<uint32_t>(index)) : nullptr);
+	};
+	const uint32_t materialCount = reader.read<uint32_t>();
+	materials.reserve(materialCount);
+	for (uint32_t i = 0; i < materialCount; i++) {
+		vkglTF::Material material(device);
+		material.alphaMode = static_cast<Material::AlphaMode>(reader.read<uint32_t>());
+		material.alphaCutoff = reader.read<float>();
+		material.doubleSided = reader.read<uint32_t>() != 0;
+		material.metallicFactor = reader.read<float>();
+		material.roughnessFactor = reader.read<float>();
+		material.baseColorFactor = reader.read<glm::vec4>();
+		material.baseColorTexture = getCachedTexture(reader.read<int32_t>());
+		material.metallicRoughnessTexture = getCachedTexture(reader.read<int32_t>());
+		material.normalTexture = getCachedTexture(reader.read<int32_t>());
+		material.occlusionTexture = getCachedTexture(reader.read<int32_t>());
+		material.emissiveTexture = getCachedTexture(reader.read<int32_t>());
+		materials.push_back(material);
+	}
+
+	const uint32_t nodeCount = reader.read<uint32_t>();
+	std::vector<int32_t> parents(nodeCount);
+	linearNodes.resize(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		Node* node = new Node{};
+		parents[i] = reader.read<int32_t>();
+		node->index = reader.read<uint32_t>();
+		node->name = reader.readString();
+		node->matrix = reader.read<glm::mat4>();
+		node->translation = reader.read<glm::vec3>();
+		node->rotation = reader.read<glm::quat>();
+		node->scale = reader.read<glm::vec3>();
+		node->skinIndex = reader.read<int32_t>();
+		if (reader.read<uint32_t>() != 0) {
+			Mesh* mesh = new Mesh(device, node->matrix);
+			mesh->name = reader.readString();
+			const uint32_t primitiveCount = reader.read<uint32_t>();
+			for (uint32_t j = 0; j < primitiveCount; j++) {
+				const uint32_t firstIndex = reader.read<uint32_t>();
+				const uint32_t indexCount = reader.read<uint32_t>();
+				const uint32_t firstVertex = reader.read<uint32_t>();
+				const uint32_t vertexCount = reader.read<uint32_t>();
+				Primitive* primitive = new Primitive(firstIndex, indexCount, materials[reader.read<uint32_t>()]);
+				primitive->firstVertex = firstVertex;
+				primitive->vertexCount = vertexCount;
+				const glm::vec3 min = reader.read<glm::vec3>();
+				const glm::vec3 max = reader.read<glm::vec3>();
+				primitive->setDimensions(min, max);
+				primitive->lods = reader.readVector<Primitive::LOD>();
+				mesh->primitives.push_back(primitive);
+			}
+			node->mesh = mesh;
+		}
+		linearNodes[i] = node;
+	}
+	// Children are stored before their parents, in the order they were added to them
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		Node* node = linearNodes[i];
+		if (parents[i] >= 0) {
+			node->parent = linearNodes[parents[i]];
+			node->parent->children.push_back(node);
+		} else {
+			nodes.push_back(node);
+		}
+	}
+
+	const uint32_t skinCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < skinCount; i++) {
+		Skin* skin = new Skin{};
+		skin->name = reader.readString();
+		const int32_t skeletonRoot = reader.read<int32_t>();
+		skin->skeletonRoot = (skeletonRoot >= 0) ? linearNodes[skeletonRoot] : nullptr;
+		for (int32_t joint : reader.readVector<int32_t>()) {
+			skin->joints.push_back(linearNodes[joint]);
+		}
+		skin->inverseBindMatrices = reader.readVector<glm::mat4>();
+		skins.push_back(skin);
+	}
+
+	const uint32_t animationCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < animationCount; i++) {
+		Animation animation{};
+		animation.name = reader.readString();
+		animation.start = reader.read<float>();
+		animation.end = reader.read<float>();
+		animation.samplers.resize(reader.read<uint32_t>());
+		for (auto& sampler : animation.samplers) {
+			sampler.interpolation = static_cast<AnimationSampler::InterpolationType>(reader.read<uint32_t>());
+			sampler.inputs = reader.readVector<float>();
+			sampler.outputsVec4 = reader.readVector<glm::vec4>();
+		}
+		animation.channels.resize(reader.read<uint32_t>());
+		for (auto& channel : animation.channels) {
+			channel.path = static_cast<AnimationChannel::PathType>(reader.read<uint32_t>());
+			channel.node = linearNodes[reader.read<int32_t>()];
+			channel.samplerIndex = reader.read<uint32_t>();
+		}
+		animations.push_back(animation);
+	}
+
+	for (auto node : linearNodes) {
+		// Assign skins
+		if (node->skinIndex > -1) {
+			node->skin = skins[node->skinIndex];
+		}
+	}
+	// Initial pose
+	buildTransforms();
+
+	if (imageCount > 0) {
+		beginLoadStage(LoadStage::Images, &loadTimings.meshes);
+		finishImages(*streamer, streamed, transferQueue);
+		beginLoadStage(LoadStage::Upload, &loadTimings.images);
+	} else {
+		// Materials without textures still reference the empty texture
+		createEmptyTexture(transferQueue);
+		beginLoadStage(LoadStage::Upload, &loadTimings.meshes);
+	}
+
+	// Vertex and index data is copied from the mapped file into the staging ring
+	createBuffers(reinterpret_cast<const Vertex*>(cache.data() + header.vertexOffset), static_cast<size_t>(header.vertexCount), reinterpret_cast<const uint32_t*>(cache.data() + header.indexOffset), static_cast<size_t>(header.indexCount), transferQueue);
+	cache.close();
+	getSceneDimensions();
+
+	beginLoadStage(LoadStage::Descriptors, &loadTimings.upload);
+	setupDescriptors();
+
+	beginLoadStage(LoadStage::Done, &loadTimings.descriptors);
+	loadTimings.total = std::chrono::duration<double, std::milli>(loadStageStart - loadStart).count();
+	return true;
+}
+
+/*
+	Binds the vertex and index buffer of the model
+	positionsOnly binds the separate position buffer instead (e.g. for depth only passes), requires VertexPackingFlags::SeparatePositions
+*/
+void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer, bool positionsOnly)
+{
+	assert(!positionsOnly || (vertices.positionBuffer != VK_NULL_HANDLE));
 	const VkDeviceSize offsets[1] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, positionsOnly ? &vertices.positionBuffer : &vertices.buffer, offsets);
 	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 	buffersBound = true;
 }
 
+/** @brief Returns the pipeline vertex input state for the requested vertex components matching the model's vertex layout, components are assigned to consecutive locations */
+VkPipelineVertexInputStateCreateInfo* vkglTF::Model::getPipelineVertexInputState(const std::vector<VertexComponent> components)
+{
+	inputBindingDescription = { 0, vertexStride, VK_VERTEX_INPUT_RATE_VERTEX };
+	inputAttributeDescriptions.clear();
+	uint32_t location = 0;
+	for (VertexComponent component : components) {
+		auto attribute = std::find_if(vertexAttributes.begin(), vertexAttributes.end(), [component](const VertexAttribute& a) { return a.component == component; });
+		// The component has to be part of the vertex layout the model has been loaded with
+		assert(attribute != vertexAttributes.end());
+		inputAttributeDescriptions.push_back({ location, 0, attribute->format, attribute->offset });
+		location++;
+	}
+	pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+	pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &inputBindingDescription;
+	pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(inputAttributeDescriptions.size());
+	pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = inputAttributeDescriptions.data();
+	return &pipelineVertexInputStateCreateInfo;
+}
+
+/** @brief Returns the pipeline vertex input state for the separate position buffer (position at location 0) */
+VkPipelineVertexInputStateCreateInfo* vkglTF::Model::getPositionVertexInputState()
+{
+	inputBindingDescription = { 0, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX };
+	inputAttributeDescriptions = { { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 } };
+	pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+	pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &inputBindingDescription;
+	pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = 1;
+	pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = inputAttributeDescriptions.data();
+	return &pipelineVertexInputStateCreateInfo;
+}
+
 void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
 {
 	if (node->mesh) {
@@ -1494,49 +2902,514 @@ void vkglTF::Model::updateAnimation(uint32_t index, float time)
 
 	bool updated = false;
 	for (auto& channel : animation.channels) {
-		vkglTF::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-		if (sampler.inputs.size() > sampler.outputsVec4.size()) {
+		const vkglTF::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
+		if (!sampler.isValid()) {
 			continue;
 		}
+		const glm::vec4 value = sampler.evaluate(time, channel.cursor, channel.path == vkglTF::AnimationChannel::PathType::ROTATION);
+		switch (channel.path) {
+		case vkglTF::AnimationChannel::PathType::TRANSLATION:
+			transforms.setTranslation(channel.node->transformIndex, glm::vec3(value));
+			break;
+		case vkglTF::AnimationChannel::PathType::SCALE:
+			transforms.setScale(channel.node->transformIndex, glm::vec3(value));
+			break;
+		case vkglTF::AnimationChannel::PathType::ROTATION:
+			transforms.setRotation(channel.node->transformIndex, glm::quat(value.w, value.x, value.y, value.z));
+			break;
+		}
+		updated = true;
+	}
+	if (updated) {
+		updateTransforms();
+	}
+}
 
-		for (auto i = 0; i < sampler.inputs.size() - 1; i++) {
-			if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-				float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-				if (u <= 1.0f) {
-					switch (channel.path) {
-					case vkglTF::AnimationChannel::PathType::TRANSLATION: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->translation = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::SCALE: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->scale = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::ROTATION: {
-						glm::quat q1;
-						q1.x = sampler.outputsVec4[i].x;
-						q1.y = sampler.outputsVec4[i].y;
-						q1.z = sampler.outputsVec4[i].z;
-						q1.w = sampler.outputsVec4[i].w;
-						glm::quat q2;
-						q2.x = sampler.outputsVec4[i + 1].x;
-						q2.y = sampler.outputsVec4[i + 1].y;
-						q2.z = sampler.outputsVec4[i + 1].z;
-						q2.w = sampler.outputsVec4[i + 1].w;
-						channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-						break;
-					}
-					}
-					updated = true;
-				}
+/*
+	Evaluate the animations of multiple instances of this model, e.g. for a crowd of characters playing the same animations at different times
+	The model's own node transforms are left untouched, results are stored in the instances
+	@param jobSystem If set, instances are evaluated in parallel on the job system's threads (must be called from the thread that created it)
+*/
+void vkglTF::Model::evaluateAnimations(AnimationInstance* instances, uint32_t count, vks::JobSystem* jobSystem) const
+{
+	if (jobSystem && (count > 1)) {
+		jobSystem->parallelFor(count, 4, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				evaluateAnimation(instances[i]);
+			}
+		});
+		return;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		evaluateAnimation(instances[i]);
+	}
+}
+
+// Samples the instance's animation on top of the rest pose and calculates the world matrices of all nodes in one pass (parents are stored before their children)
+void vkglTF::Model::evaluateAnimation(AnimationInstance& instance) const
+{
+	// Assignments reuse the instance's storage once it has been sized
+	instance.translations = restTranslations;
+	instance.rotations = restRotations;
+	instance.scales = restScales;
+	instance.worldMatrices.resize(transforms.nodes.size());
+
+	if (instance.animation < static_cast<uint32_t>(animations.size())) {
+		const Animation& animation = animations[instance.animation];
+		instance.cursors.resize(animation.channels.size());
+		for (size_t i = 0; i < animation.channels.size(); i++) {
+			const AnimationChannel& channel = animation.channels[i];
+			const AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
+			if (!sampler.isValid()) {
+				continue;
+			}
+			const glm::vec4 value = sampler.evaluate(instance.time, instance.cursors[i], channel.path == AnimationChannel::PathType::ROTATION);
+			const uint32_t target = channel.node->transformIndex;
+			switch (channel.path) {
+			case AnimationChannel::PathType::TRANSLATION:
+				instance.translations[target] = glm::vec3(value);
+				break;
+			case AnimationChannel::PathType::SCALE:
+				instance.scales[target] = glm::vec3(value);
+				break;
+			case AnimationChannel::PathType::ROTATION:
+				instance.rotations[target] = glm::quat(value.w, value.x, value.y, value.z);
+				break;
 			}
 		}
 	}
-	if (updated) {
-		for (auto &node : nodes) {
-			node->update();
+
+	for (size_t i = 0; i < transforms.nodes.size(); i++) {
+		glm::mat4 local = glm::translate(glm::mat4(1.0f), instance.translations[i]) * glm::mat4(instance.rotations[i]) * glm::scale(glm::mat4(1.0f), instance.scales[i]);
+		if (transforms.hasMatrix[i]) {
+			local = local * transforms.matrices[i];
+		}
+		const int32_t parent = transforms.parents[i];
+		instance.worldMatrices[i] = (parent < 0) ? local : instance.worldMatrices[parent] * local;
+	}
+}
+
+/*
+	Calculate the joint matrices of a skinned node for an evaluated animation instance
+	@param jointMatrices Receives one matrix per joint of the node's skin
+	@return Number of joint matrices written, zero if the node isn't skinned
+*/
+uint32_t vkglTF::Model::getJointMatrices(const AnimationInstance& instance, const Node* node, glm::mat4* jointMatrices) const
+{
+	if (!node->skin || (instance.worldMatrices.size() != transforms.nodes.size())) {
+		return 0;
+	}
+	const Skin* skin = node->skin;
+	const glm::mat4 inverseTransform = glm::inverse(instance.worldMatrices[node->transformIndex]);
+	for (size_t i = 0; i < skin->joints.size(); i++) {
+		jointMatrices[i] = inverseTransform * instance.worldMatrices[skin->joints[i]->transformIndex] * skin->inverseBindMatrices[i];
+	}
+	return static_cast<uint32_t>(skin->joints.size());
+}
+
+// Flatten the node hierarchy, store the rest pose for animation instances and upload the initial pose
+void vkglTF::Model::buildTransforms()
+{
+	transforms.build(nodes);
+	const size_t count = transforms.nodes.size();
+	restTranslations.resize(count);
+	restRotations.resize(count);
+	restScales.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		restTranslations[i] = glm::vec3(transforms.translations.x[i], transforms.translations.y[i], transforms.translations.z[i]);
+		restRotations[i] = glm::quat(transforms.rotations.w[i], transforms.rotations.x[i], transforms.rotations.y[i], transforms.rotations.z[i]);
+		restScales[i] = glm::vec3(transforms.scales.x[i], transforms.scales.y[i], transforms.scales.z[i]);
+	}
+	updateTransforms(true);
+}
+
+/*
+	Update the world matrices of all changed nodes in a single pass over the transform hierarchy and upload them to the mesh uniform buffers
+	@param force Upload the matrices of all meshes, even if their nodes haven't changed
+*/
+void vkglTF::Model::updateTransforms(bool force)
+{
+	transforms.update();
+	if (!force && !transforms.hasChanges()) {
+		return;
+	}
+	for (uint32_t i = 0; i < static_cast<uint32_t>(transforms.nodes.size()); i++) {
+		Node* node = transforms.nodes[i];
+		Mesh* mesh = node->mesh;
+		if (!mesh) {
+			continue;
+		}
+		const glm::mat4& m = transforms.worldMatrices[i];
+		if (node->skin) {
+			// Joints can be anywhere in the hierarchy, so skinned meshes are updated whenever any transform has changed
+			mesh->uniformBlock.matrix = m;
+			const glm::mat4 inverseTransform = glm::inverse(m);
+			Skin* skin = node->skin;
+			for (size_t j = 0; j < skin->joints.size(); j++) {
+				mesh->uniformBlock.jointMatrix[j] = inverseTransform * transforms.worldMatrices[skin->joints[j]->transformIndex] * skin->inverseBindMatrices[j];
+			}
+			mesh->uniformBlock.jointcount = (float)skin->joints.size();
+			memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
+		} else if (force || transforms.worldChanged(i)) {
+			mesh->uniformBlock.matrix = m;
+			memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
+		}
+	}
+	if (indirect.prepared) {
+		// Only the current frame's copy is written, the copies of other frames are brought up to date once they're selected
+		indirect.matricesVersion++;
+		indirect.matricesVersions[indirect.frameIndex] = indirect.matricesVersion;
+		memcpy(static_cast<uint8_t*>(indirect.matrices.mapped) + indirect.frameIndex * indirect.matricesFrameSize, transforms.worldMatrices.data(), transforms.worldMatrices.size() * sizeof(glm::mat4));
+	}
+	transforms.clearChanges();
+}
+
+/*
+	GPU driven rendering
+
+	All primitives of the model are packed into indirect draw commands, one contiguous range per IndirectDrawGroup
+	A compute pass culls the primitives against the view frustum and writes the commands of the visible ones, so the whole model is drawn with one indirect draw per group
+	Per draw data (matrix and material) is read from storage buffers using the draw index, which is passed via the first instance of the draw command
+*/
+
+namespace
+{
+	// Transforms an axis aligned bounding box, the result encloses the transformed box
+	void transformBounds(const glm::mat4& m, glm::vec3& min, glm::vec3& max)
+	{
+		const glm::vec3 center = (min + max) * 0.5f;
+		const glm::vec3 extent = (max - min) * 0.5f;
+		const glm::vec3 worldCenter = glm::vec3(m * glm::vec4(center, 1.0f));
+		const glm::vec3 worldExtent = glm::abs(glm::vec3(m[0])) * extent.x + glm::abs(glm::vec3(m[1])) * extent.y + glm::abs(glm::vec3(m[2])) * extent.z;
+		min = worldCenter - worldExtent;
+		max = worldCenter + worldExtent;
+	}
+}
+
+/*
+	Set up the buffers, descriptors and the culling pipeline for the GPU driven render path
+	Requires the multiDrawIndirect and drawIndirectFirstInstance features, and descriptor indexing (runtimeDescriptorArray, shaderSampledImageArrayNonUniformIndexing) for the bindless texture array
+	Skinned meshes are drawn without their joint matrices applied
+	@param cullShader Compute shader culling the primitives (base/gltfindirectcull.comp)
+	@param frameCount Number of frames that may be in flight at once, each gets its own copy of the matrices and culling parameters
+*/
+void vkglTF::Model::prepareIndirectDraw(VkQueue transferQueue, VkPipelineShaderStageCreateInfo cullShader, VkPipelineCache pipelineCache, uint32_t frameCount)
+{
+	destroyIndirectDraw();
+	indirect.frameCount = std::max(frameCount, 1u);
+
+	const bool preTransform = loadingFlags & FileLoadingFlags::PreTransformVertices;
+	const bool flipY = loadingFlags & FileLoadingFlags::FlipY;
+	// The matrix buffer stores the world matrices of all nodes followed by an identity matrix used for pre-transformed vertices
+	const uint32_t identityMatrix = static_cast<uint32_t>(transforms.nodes.size());
+
+	std::vector<IndirectDrawData> groupDraws[IndirectDrawGroupCount];
+	for (uint32_t i = 0; i < static_cast<uint32_t>(transforms.nodes.size()); i++) {
+		const Node* node = transforms.nodes[i];
+		if (!node->mesh) {
+			continue;
+		}
+		for (const Primitive* primitive : node->mesh->primitives) {
+			if (primitive->indexCount == 0) {
+				continue;
+			}
+			const Material& material = primitive->material;
+			glm::vec3 boundsMin = primitive->dimensions.min;
+			glm::vec3 boundsMax = primitive->dimensions.max;
+			IndirectDrawData draw{};
+			if (preTransform) {
+				// Vertices have been transformed into model space while loading
+				transformBounds(transforms.worldMatrices[i], boundsMin, boundsMax);
+				draw.matrixIndex = identityMatrix;
+			} else {
+				draw.matrixIndex = i;
+			}
+			if (flipY) {
+				const float minY = boundsMin.y;
+				boundsMin.y = -boundsMax.y;
+				boundsMax.y = -minY;
+			}
+			draw.boundsMin = glm::vec4(boundsMin, 0.0f);
+			draw.boundsMax = glm::vec4(boundsMax, 0.0f);
+			draw.firstIndex = primitive->firstIndex;
+			draw.indexCount = primitive->indexCount;
+			draw.materialIndex = static_cast<uint32_t>(&material - materials.data());
+			if (material.alphaMode == Material::ALPHAMODE_BLEND) {
+				draw.group = IndirectDrawAlphaBlend;
+			} else {
+				draw.group = material.doubleSided ? IndirectDrawDoubleSided : IndirectDrawOpaque;
+			}
+			groupDraws[draw.group].push_back(draw);
+		}
+	}
+
+	// Draws are sorted by group, each group writes its commands to its own range of the command buffer
+	std::vector<IndirectDrawData> draws;
+	for (uint32_t group = 0; group < IndirectDrawGroupCount; group++) {
+		indirect.groupOffsets[group] = static_cast<uint32_t>(draws.size());
+		indirect.groupSizes[group] = static_cast<uint32_t>(groupDraws[group].size());
+		for (IndirectDrawData& draw : groupDraws[group]) {
+			draw.commandOffset = indirect.groupOffsets[group];
+			draws.push_back(draw);
+		}
+	}
+	indirect.drawCount = static_cast<uint32_t>(draws.size());
+	if (draws.empty()) {
+		return;
+	}
+
+	// Textures are referenced by their index into the bindless texture array
+	auto textureIndex = [this](const vkglTF::Texture* texture) -> int32_t {
+		if ((texture == nullptr) || (texture == &emptyTexture)) {
+			return -1;
+		}
+		return static_cast<int32_t>(texture - textures.data());
+	};
+	std::vector<IndirectMaterialData> materialData(materials.size());
+	for (size_t i = 0; i < materials.size(); i++) {
+		const Material& material = materials[i];
+		IndirectMaterialData& data = materialData[i];
+		data.baseColorFactor = material.baseColorFactor;
+		data.alphaCutoff = material.alphaCutoff;
+		data.alphaMode = static_cast<uint32_t>(material.alphaMode);
+		data.metallicFactor = material.metallicFactor;
+		data.roughnessFactor = material.roughnessFactor;
+		data.baseColorTexture = textureIndex(material.baseColorTexture);
+		data.metallicRoughnessTexture = textureIndex(material.metallicRoughnessTexture);
+		data.normalTexture = textureIndex(material.normalTexture);
+		data.occlusionTexture = textureIndex(material.occlusionTexture);
+		data.emissiveTexture = textureIndex(material.emissiveTexture);
+	}
+
+	// Static data is uploaded to device local buffers
+	auto createDeviceLocalBuffer = [this, transferQueue](vks::Buffer* buffer, VkBufferUsageFlags usage, VkDeviceSize size, void* data) {
+		VK_CHECK_RESULT(device->createBuffer(usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, size));
+		device->uploadManager.uploadBuffer(buffer->buffer, 0, data, size, transferQueue);
+	};
+	device->uploadManager.begin(transferQueue);
+	createDeviceLocalBuffer(&indirect.drawData, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, draws.size() * sizeof(IndirectDrawData), draws.data());
+	createDeviceLocalBuffer(&indirect.materialData, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, materialData.size() * sizeof(IndirectMaterialData), materialData.data());
+	device->uploadManager.end();
+
+	// Matrices change with animations, so they're kept in host visible memory and updated by updateTransforms
+	// Each frame in flight has its own copy, selected with a dynamic offset
+	const VkDeviceSize matricesSize = (transforms.nodes.size() + 1) * sizeof(glm::mat4);
+	indirect.matricesFrameSize = vks::tools::alignedVkSize(matricesSize, device->properties.limits.minStorageBufferOffsetAlignment);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &indirect.matrices, indirect.matricesFrameSize * indirect.frameCount));
+	VK_CHECK_RESULT(indirect.matrices.map());
+	indirect.matrices.setupDescriptor(matricesSize);
+	const glm::mat4 identity(1.0f);
+	for (uint32_t i = 0; i < indirect.frameCount; i++) {
+		glm::mat4* frameMatrices = reinterpret_cast<glm::mat4*>(static_cast<uint8_t*>(indirect.matrices.mapped) + i * indirect.matricesFrameSize);
+		memcpy(frameMatrices, transforms.worldMatrices.data(), transforms.worldMatrices.size() * sizeof(glm::mat4));
+		memcpy(frameMatrices + identityMatrix, &identity, sizeof(glm::mat4));
+	}
+	indirect.matricesVersions.assign(indirect.frameCount, 0);
+
+	// Written by the culling pass
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirect.commands, draws.size() * sizeof(VkDrawIndexedIndirectCommand)));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirect.drawCounts, IndirectDrawGroupCount * sizeof(uint32_t)));
+
+	indirect.cullParamsFrameSize = vks::tools::alignedVkSize(sizeof(IndirectCullParams), device->properties.limits.minUniformBufferOffsetAlignment);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &indirect.cullParams, indirect.cullParamsFrameSize * indirect.frameCount));
+	VK_CHECK_RESULT(indirect.cullParams.map());
+	indirect.cullParams.setupDescriptor(sizeof(IndirectCullParams));
+	for (uint32_t i = 0; i < indirect.frameCount; i++) {
+		indirect.frameIndex = i;
+		updateIndirectCulling(glm::mat4(1.0f), false);
+	}
+	indirect.frameIndex = 0;
+
+	// Descriptors
+	const uint32_t textureCount = std::max(static_cast<uint32_t>(textures.size()), 1u);
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &indirect.descriptorPool));
+
+	// Set used by the graphics pipelines
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3, textureCount),
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &indirect.descriptorSetLayout));
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(indirect.descriptorPool, &indirect.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &indirect.descriptorSet));
+
+	std::vector<VkDescriptorImageInfo> textureDescriptors;
+	for (auto& texture : textures) {
+		textureDescriptors.push_back(texture.descriptor);
+	}
+	if (textureDescriptors.empty()) {
+		textureDescriptors.push_back(emptyTexture.descriptor);
+	}
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 0, &indirect.matrices.descriptor),
+		vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &indirect.drawData.descriptor),
+		vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &indirect.materialData.descriptor),
+		vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, textureDescriptors.data(), textureCount),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	// Set used by the culling pass
+	setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+	};
+	descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &indirect.cullDescriptorSetLayout));
+	allocInfo = vks::initializers::descriptorSetAllocateInfo(indirect.descriptorPool, &indirect.cullDescriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &indirect.cullDescriptorSet));
+	writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(indirect.cullDescriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &indirect.cullParams.descriptor),
+		vks::initializers::writeDescriptorSet(indirect.cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &indirect.drawData.descriptor),
+		vks::initializers::writeDescriptorSet(indirect.cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2, &indirect.matrices.descriptor),
+		vks::initializers::writeDescriptorSet(indirect.cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &indirect.commands.descriptor),
+		vks::initializers::writeDescriptorSet(indirect.cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &indirect.drawCounts.descriptor),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&indirect.cullDescriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &indirect.cullPipelineLayout));
+	VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(indirect.cullPipelineLayout, 0);
+	computePipelineCI.stage = cullShader;
+	VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCI, nullptr, &indirect.cullPipeline));
+
+	// Without VK_KHR_draw_indirect_count all commands of a group are drawn, culled commands are cleared to zero indices each frame
+	if (device->extensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+		indirect.vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+	}
+
+	indirect.prepared = true;
+}
+
+void vkglTF::Model::destroyIndirectDraw()
+{
+	if (!indirect.prepared) {
+		return;
+	}
+	indirect.drawData.destroy();
+	indirect.materialData.destroy();
+	indirect.matrices.destroy();
+	indirect.commands.destroy();
+	indirect.drawCounts.destroy();
+	indirect.cullParams.destroy();
+	vkDestroyPipeline(device->logicalDevice, indirect.cullPipeline, nullptr);
+	vkDestroyPipelineLayout(device->logicalDevice, indirect.cullPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device->logicalDevice, indirect.cullDescriptorSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device->logicalDevice, indirect.descriptorSetLayout, nullptr);
+	vkDestroyDescriptorPool(device->logicalDevice, indirect.descriptorPool, nullptr);
+	indirect = IndirectDraw();
+}
+
+/*
+	Select the copy of the per frame data written by updateTransforms and updateIndirectCulling
+	Has to be called once the previous submission using this frame index has finished executing (e.g. after waiting for the frame's fence)
+*/
+void vkglTF::Model::setIndirectFrame(uint32_t frameIndex)
+{
+	if (!indirect.prepared) {
+		return;
+	}
+	assert(frameIndex < indirect.frameCount);
+	indirect.frameIndex = frameIndex;
+	if (indirect.matricesVersions[frameIndex] != indirect.matricesVersion) {
+		indirect.matricesVersions[frameIndex] = indirect.matricesVersion;
+		memcpy(static_cast<uint8_t*>(indirect.matrices.mapped) + frameIndex * indirect.matricesFrameSize, transforms.worldMatrices.data(), transforms.worldMatrices.size() * sizeof(glm::mat4));
+	}
+	memcpy(static_cast<uint8_t*>(indirect.cullParams.mapped) + frameIndex * indirect.cullParamsFrameSize, &indirect.cullParamsData, sizeof(IndirectCullParams));
+}
+
+/*
+	Update the view frustum the primitives are culled against by cullIndirect
+	@param viewProjection Combined projection and view matrix of the camera
+*/
+void vkglTF::Model::updateIndirectCulling(const glm::mat4& viewProjection, bool cullingEnabled)
+{
+	if (!indirect.cullParams.mapped) {
+		return;
+	}
+	vks::Frustum frustum;
+	frustum.update(viewProjection);
+	IndirectCullParams& params = indirect.cullParamsData;
+	params = {};
+	for (size_t i = 0; i < frustum.planes.size(); i++) {
+		params.frustumPlanes[i] = frustum.planes[i];
+	}
+	params.drawCount = indirect.drawCount;
+	params.cullingEnabled = cullingEnabled ? 1 : 0;
+	memcpy(static_cast<uint8_t*>(indirect.cullParams.mapped) + indirect.frameIndex * indirect.cullParamsFrameSize, &params, sizeof(params));
+}
+
+/*
+	Record the culling pass that writes the draw commands for drawIndirect, has to be recorded outside of a render pass
+	@param frameIndex Copy of the matrices and culling parameters read by the pass (see setIndirectFrame)
+*/
+void vkglTF::Model::cullIndirect(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	if (!indirect.prepared) {
+		return;
+	}
+
+	// Draws of previously submitted frames have to finish reading the commands before they're overwritten
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	vkCmdFillBuffer(commandBuffer, indirect.commands.buffer, 0, VK_WHOLE_SIZE, 0);
+	vkCmdFillBuffer(commandBuffer, indirect.drawCounts.buffer, 0, VK_WHOLE_SIZE, 0);
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, indirect.cullPipeline);
+	const uint32_t dynamicOffsets[2] = { static_cast<uint32_t>(frameIndex * indirect.cullParamsFrameSize), static_cast<uint32_t>(frameIndex * indirect.matricesFrameSize) };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, indirect.cullPipelineLayout, 0, 1, &indirect.cullDescriptorSet, 2, dynamicOffsets);
+	// Matches the local size of the culling shader
+	const uint32_t workGroupSize = 64;
+	vkCmdDispatch(commandBuffer, (indirect.drawCount + workGroupSize - 1) / workGroupSize, 1, 1);
+
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+/*
+	Draw the visible primitives of a group with a single indirect draw, the pipeline for the group has to be bound
+	@param pipelineLayout If set, the model's indirect descriptor set is bound to the given set number (with the matrices of frameIndex)
+*/
+void vkglTF::Model::drawIndirect(VkCommandBuffer commandBuffer, IndirectDrawGroup group, VkPipelineLayout pipelineLayout, uint32_t bindSet, uint32_t frameIndex)
+{
+	if (!indirect.prepared || (indirect.groupSizes[group] == 0)) {
+		return;
+	}
+	if (!buffersBound) {
+		const VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+	if (pipelineLayout != VK_NULL_HANDLE) {
+		const uint32_t dynamicOffset = static_cast<uint32_t>(frameIndex * indirect.matricesFrameSize);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindSet, 1, &indirect.descriptorSet, 1, &dynamicOffset);
+	}
+	const VkDeviceSize offset = indirect.groupOffsets[group] * sizeof(VkDrawIndexedIndirectCommand);
+	const uint32_t maxDrawCount = indirect.groupSizes[group];
+	if (indirect.vkCmdDrawIndexedIndirectCountKHR) {
+		indirect.vkCmdDrawIndexedIndirectCountKHR(commandBuffer, indirect.commands.buffer, offset, indirect.drawCounts.buffer, group * sizeof(uint32_t), maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+	} else if (device->enabledFeatures.multiDrawIndirect) {
+		vkCmdDrawIndexedIndirect(commandBuffer, indirect.commands.buffer, offset, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+	} else {
+		for (uint32_t i = 0; i < maxDrawCount; i++) {
+			vkCmdDrawIndexedIndirect(commandBuffer, indirect.commands.buffer, offset + i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
 		}
 	}
 }
@@ -10,11 +10,16 @@
 
 #include <stdlib.h>
 #include <string>
+#include <chrono>
 #include <fstream>
+#include <functional>
 #include <vector>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "VulkanTextureStreamer.h"
+#include "meshoptimizer.hpp"
+#include "meshsimplifier.hpp"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -35,6 +40,11 @@
 #include <android/asset_manager.h>
 #endif
 
+namespace vks
+{
+	class JobSystem;
+}
+
 namespace vkglTF
 {
 	enum DescriptorBindingFlags {
@@ -46,6 +56,8 @@ namespace vkglTF
 	extern VkDescriptorSetLayout descriptorSetLayoutUbo;
 	extern VkMemoryPropertyFlags memoryPropertyFlags;
 	extern uint32_t descriptorBindingFlags;
+	/** @brief Load models from (and write) a binary cache stored next to the glTF file, a read-only asset folder only costs the cache miss (disabled on Android where assets are packed with the apk) */
+	extern bool meshCacheEnabled;
 
 	struct Node;
 
@@ -63,6 +75,7 @@ namespace vkglTF
 		uint32_t layerCount;
 		VkDescriptorImageInfo descriptor;
 		VkSampler sampler;
+		vks::MemoryAllocation allocation;
 		void updateDescriptor();
 		void destroy();
 		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
@@ -76,6 +89,7 @@ namespace vkglTF
 		enum AlphaMode { ALPHAMODE_OPAQUE, ALPHAMODE_MASK, ALPHAMODE_BLEND };
 		AlphaMode alphaMode = ALPHAMODE_OPAQUE;
 		float alphaCutoff = 1.0f;
+		bool doubleSided = false;
 		float metallicFactor = 1.0f;
 		float roughnessFactor = 1.0f;
 		glm::vec4 baseColorFactor = glm::vec4(1.0f);
@@ -104,6 +118,15 @@ namespace vkglTF
 		uint32_t vertexCount;
 		Material& material;
 
+		/** @brief Index range of a level of detail, error is the geometric deviation from the full detail primitive in model space */
+		struct LOD {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error;
+		};
+		/** @brief Levels of detail generated with FileLoadingFlags::GenerateLODs in order of decreasing detail, LOD 0 is the full detail range (firstIndex, indexCount) */
+		std::vector<LOD> lods;
+
 		struct Dimensions {
 			glm::vec3 min = glm::vec3(FLT_MAX);
 			glm::vec3 max = glm::vec3(-FLT_MAX);
@@ -131,6 +154,7 @@ namespace vkglTF
 			VkDescriptorBufferInfo descriptor;
 			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 			void* mapped;
+			vks::MemoryAllocation allocation;
 		} uniformBuffer;
 
 		struct UniformBlock {
@@ -153,6 +177,50 @@ namespace vkglTF
 		std::vector<Node*> joints;
 	};
 
+	/*
+		Flattened transform hierarchy of a model's nodes, stored as a structure of arrays
+		Nodes are sorted so parents precede their children, which lets a single linear pass recompute the world matrices of all changed subtrees
+	*/
+	struct TransformHierarchy {
+		struct Components {
+			std::vector<float> x, y, z, w;
+		};
+		enum DirtyFlags : uint8_t { LocalDirty = 0x01, WorldDirty = 0x02 };
+
+		/** @brief Index of the parent transform, -1 for root nodes */
+		std::vector<int32_t> parents;
+		Components translations;
+		/** @brief Rotation quaternions */
+		Components rotations;
+		Components scales;
+		/** @brief Node matrix applied after the TRS transform (glTF "matrix" property), only used if hasMatrix is set */
+		std::vector<glm::mat4> matrices;
+		std::vector<uint8_t> hasMatrix;
+		std::vector<glm::mat4> localMatrices;
+		std::vector<glm::mat4> worldMatrices;
+		std::vector<uint8_t> dirty;
+		/** @brief Node of each transform */
+		std::vector<Node*> nodes;
+
+		void build(const std::vector<Node*>& rootNodes);
+		void setTranslation(uint32_t index, const glm::vec3& translation);
+		void setRotation(uint32_t index, const glm::quat& rotation);
+		void setScale(uint32_t index, const glm::vec3& scale);
+		void setFromNode(uint32_t index);
+		void update();
+		bool hasChanges() const;
+		bool worldChanged(uint32_t index) const;
+		void clearChanges();
+	private:
+		bool anyDirty = false;
+		bool anyChanged = false;
+		/** @brief Set for transforms whose world matrix has been recomputed since the last call to clearChanges */
+		std::vector<uint8_t> changed;
+		std::vector<uint32_t> dirtyLocal;
+		std::vector<uint32_t> dirtyWorld;
+		void add(Node* node, int32_t parent);
+	};
+
 	/*
 		glTF node
 	*/
@@ -168,6 +236,9 @@ namespace vkglTF
 		glm::vec3 translation{};
 		glm::vec3 scale{ 1.0f };
 		glm::quat rotation{};
+		/** @brief Transform hierarchy of the model the node belongs to, changes to translation, rotation or scale have to be passed on with TransformHierarchy::setFromNode */
+		TransformHierarchy* transforms = nullptr;
+		uint32_t transformIndex = 0;
 		glm::mat4 localMatrix();
 		glm::mat4 getMatrix();
 		void update();
@@ -182,6 +253,8 @@ namespace vkglTF
 		PathType path;
 		Node* node;
 		uint32_t samplerIndex;
+		/** @brief Keyframe interval found by the last call to Model::updateAnimation, the next search starts there */
+		uint32_t cursor = 0;
 	};
 
 	/*
@@ -191,7 +264,11 @@ namespace vkglTF
 		enum InterpolationType { LINEAR, STEP, CUBICSPLINE };
 		InterpolationType interpolation;
 		std::vector<float> inputs;
+		/** @brief Output values, cubic spline samplers store an in-tangent, the value and an out-tangent for each keyframe */
 		std::vector<glm::vec4> outputsVec4;
+		bool isValid() const;
+		uint32_t findKeyframe(float time, uint32_t& cursor) const;
+		glm::vec4 evaluate(float time, uint32_t& cursor, bool rotation) const;
 	};
 
 	/*
@@ -205,6 +282,23 @@ namespace vkglTF
 		float end = std::numeric_limits<float>::min();
 	};
 
+	/*
+		Playback state of a single instance of an animated model, lets many instances (e.g. a crowd of characters) share one model
+		Evaluated with Model::evaluateAnimations, which doesn't touch the model's own node transforms
+	*/
+	struct AnimationInstance {
+		uint32_t animation = 0;
+		float time = 0.0f;
+		/** @brief Keyframe cursor for each channel of the animation */
+		std::vector<uint32_t> cursors;
+		/** @brief Local transforms of all nodes, indexed by Node::transformIndex */
+		std::vector<glm::vec3> translations;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+		/** @brief World matrices of all nodes, indexed by Node::transformIndex */
+		std::vector<glm::mat4> worldMatrices;
+	};
+
 	/*
 		glTF default vertex layout with easy Vulkan mapping functions
 	*/
@@ -228,14 +322,42 @@ namespace vkglTF
 		static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
 	};
 
+	/** @brief Vertex compression applied when uploading a model's vertices, see Model::vertexLayout */
+	enum VertexPackingFlags {
+		/** @brief Normals as octahedral encoded snorm16x2 and tangents as octahedral encoded snorm8x4 (handedness in w), shaders have to decode them (see sceneindirect.vert) */
+		PackNormals = 0x00000001,
+		/** @brief UVs as unorm16 if all UVs of the model are within [0..1], half floats otherwise */
+		PackUVs = 0x00000002,
+		PackColors = 0x00000004,
+		/** @brief Joint indices as uint8 or uint16 (read as floats using a scaled format, if the device supports it) and weights as unorm8 */
+		PackSkinning = 0x00000008,
+		/** @brief Additionally store the positions in a separate tightly packed buffer for depth only passes, see Model::bindBuffers */
+		SeparatePositions = 0x00000010
+	};
+
+	/** @brief Vertex data stored for a model, the default stores all components with the float layout of Vertex */
+	struct VertexLayout {
+		/** @brief Components stored per vertex in this order (empty = all components) */
+		std::vector<VertexComponent> components;
+		/** @brief Combination of VertexPackingFlags */
+		uint32_t packingFlags = 0;
+	};
+
 	enum FileLoadingFlags {
 		None = 0x00000000,
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		/** @brief Deduplicate vertices and reorder the triangles and vertices of each primitive for vertex cache, overdraw and vertex fetch efficiency */
+		OptimizeMeshes = 0x00000010,
+		/** @brief Generate a chain of simplified index ranges for each primitive, see Model::lodSettings */
+		GenerateLODs = 0x00000020
 	};
 
+	/** @brief Stages of Model::loadFromFile, reported to the model's progress callback */
+	enum class LoadStage { Parsing, Images, Meshes, Upload, Descriptors, Done };
+
 	enum RenderFlags {
 		BindImages = 0x00000001,
 		RenderOpaqueNodes = 0x00000002,
@@ -243,14 +365,120 @@ namespace vkglTF
 		RenderAlphaBlendedNodes = 0x00000008
 	};
 
+	/** @brief Groups of primitives drawn by Model::drawIndirect, each group needs its own pipeline (back face culling, blending) */
+	enum IndirectDrawGroup {
+		IndirectDrawOpaque = 0,
+		IndirectDrawDoubleSided = 1,
+		IndirectDrawAlphaBlend = 2,
+		IndirectDrawGroupCount = 3
+	};
+
 	/*
 		glTF model loading and rendering class
 	*/
 	class Model {
 	private:
+		/** @brief Primitive whose vertices and indices are converted into its range of the model's vertex and index data, which is known up front */
+		struct PrimitiveLoadInfo {
+			const tinygltf::Primitive* source;
+			Primitive* primitive;
+			Node* node;
+			/** @brief Node matrix applied to the vertices if vertices are pre-transformed */
+			glm::mat4 matrix;
+		};
+
+		/** @brief Image source stored in the mesh cache, images are still decoded and uploaded on each load */
+		struct CachedImage {
+			/** @brief Files (KtxFile, EncodedFile) are referenced by their uri, only images embedded in the glTF data store their contents */
+			enum Type : uint32_t { KtxFile, EncodedFile, Encoded, Pixels };
+			Type type;
+			std::string uri;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			std::vector<unsigned char> data;
+		};
+
+		/** @brief Per primitive data read by the culling compute shader and the vertex shader (std430 layout) */
+		struct IndirectDrawData {
+			/** @brief Bounding box of the primitive in the space of its matrix */
+			glm::vec4 boundsMin;
+			glm::vec4 boundsMax;
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			uint32_t matrixIndex;
+			uint32_t materialIndex;
+			uint32_t group;
+			/** @brief First draw command of the primitive's group */
+			uint32_t commandOffset;
+			uint32_t padding[2];
+		};
+
+		/** @brief Material parameters read by the fragment shader, texture indices refer to the bindless texture array (-1 = no texture) (std430 layout) */
+		struct IndirectMaterialData {
+			glm::vec4 baseColorFactor;
+			float alphaCutoff;
+			uint32_t alphaMode;
+			float metallicFactor;
+			float roughnessFactor;
+			int32_t baseColorTexture;
+			int32_t metallicRoughnessTexture;
+			int32_t normalTexture;
+			int32_t occlusionTexture;
+			int32_t emissiveTexture;
+			uint32_t padding[3];
+		};
+
+		struct IndirectCullParams {
+			glm::vec4 frustumPlanes[6];
+			uint32_t drawCount;
+			uint32_t cullingEnabled;
+			uint32_t padding[2];
+		};
+
+		/** @brief FileLoadingFlags the model has been loaded with */
+		uint32_t loadingFlags = 0;
+
+		/** @brief Format and offset of a component in the model's vertex buffer */
+		struct VertexAttribute {
+			VertexComponent component;
+			VkFormat format;
+			uint32_t offset;
+		};
+		std::vector<VertexAttribute> vertexAttributes;
+		/** @brief Storage for the structures returned by getPipelineVertexInputState */
+		VkVertexInputBindingDescription inputBindingDescription{};
+		std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions;
+		VkPipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo{};
+
+		/** @brief Local transforms of all nodes as loaded, the starting point for evaluating animation instances */
+		std::vector<glm::vec3> restTranslations;
+		std::vector<glm::quat> restRotations;
+		std::vector<glm::vec3> restScales;
+
+		std::chrono::high_resolution_clock::time_point loadStart;
+		std::chrono::high_resolution_clock::time_point loadStageStart;
+
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
 		void createEmptyTexture(VkQueue transferQueue);
+		void beginLoadStage(LoadStage stage, double* previousStageTime);
+		void createBuffers(const Vertex* vertexData, size_t vertexCount, const uint32_t* indexData, size_t indexCount, VkQueue transferQueue);
+		void setupVertexAttributes(const Vertex* vertexData, size_t vertexCount);
+		void packVertices(const Vertex* vertexData, size_t vertexCount, uint8_t* packedData) const;
+		void setupDescriptors();
+		void buildTransforms();
+		void evaluateAnimation(AnimationInstance& instance) const;
+		void destroyIndirectDraw();
+		uint64_t getCacheKey(const std::string& filename, uint32_t fileLoadingFlags, float scale) const;
+		std::vector<CachedImage> getCachedImages(const tinygltf::Model& gltfModel) const;
+		bool loadFromCache(const std::string& cacheFilename, uint64_t key, VkQueue transferQueue);
+		void writeCache(const std::string& cacheFilename, uint64_t key, const std::vector<std::string>& dependencies, const std::vector<CachedImage>& images, const std::vector<Vertex>& vertexBuffer, const std::vector<uint32_t>& indexBuffer) const;
+		void requestImages(tinygltf::Model& gltfModel, vks::TextureStreamer& streamer, std::vector<vks::Texture>& streamed);
+		void finishImages(vks::TextureStreamer& streamer, std::vector<vks::Texture>& streamed, VkQueue transferQueue);
+		void loadPrimitive(const tinygltf::Model& model, const PrimitiveLoadInfo& info, uint32_t vertexBegin, uint32_t vertexEnd, uint32_t indexBegin, uint32_t indexEnd, Vertex* vertexBuffer, uint32_t* indexBuffer, uint32_t fileLoadingFlags) const;
+		void optimizePrimitive(Primitive& primitive, Vertex* vertexBuffer, uint32_t* indexBuffer, vks::meshoptimizer::VertexCacheStatistics& before, vks::meshoptimizer::VertexCacheStatistics& after) const;
+		void optimizeMeshes(const std::vector<PrimitiveLoadInfo>& primitives, std::vector<Vertex>& vertexBuffer, std::vector<uint32_t>& indexBuffer, vks::JobSystem& jobSystem);
+		void generateLODs(const std::vector<PrimitiveLoadInfo>& primitives, const std::vector<Vertex>& vertexBuffer, std::vector<uint32_t>& indexBuffer, bool optimize, vks::JobSystem& jobSystem);
 	public:
 		vks::VulkanDevice* device;
 		VkDescriptorPool descriptorPool;
@@ -259,6 +487,9 @@ namespace vkglTF
 			int count;
 			VkBuffer buffer;
 			VkDeviceMemory memory;
+			/** @brief Tightly packed positions, only created with VertexPackingFlags::SeparatePositions */
+			VkBuffer positionBuffer = VK_NULL_HANDLE;
+			VkDeviceMemory positionMemory = VK_NULL_HANDLE;
 		} vertices;
 		struct Indices {
 			int count;
@@ -283,24 +514,118 @@ namespace vkglTF
 			float radius;
 		} dimensions;
 
+		/** @brief World transforms of all nodes, updated by updateAnimation and updateTransforms */
+		TransformHierarchy transforms;
+
+		/**
+		* @brief Resources of the GPU driven render path set up by prepareIndirectDraw
+		* @note The descriptor set (for the graphics pipelines) contains the world matrices (binding 0, dynamic), the per draw data (binding 1), the materials (binding 2) and all textures as a bindless array (binding 3)
+		* @note Matrices and culling parameters change while earlier frames may still read them, so there's one copy of them per frame in flight (selected with setIndirectFrame)
+		*/
+		struct IndirectDraw {
+			bool prepared = false;
+			uint32_t drawCount = 0;
+			uint32_t frameCount = 1;
+			/** @brief Copy of the per frame data written by updateTransforms and updateIndirectCulling */
+			uint32_t frameIndex = 0;
+			/** @brief Aligned size of one frame's copy in the matrices and culling parameter buffers */
+			VkDeviceSize matricesFrameSize = 0;
+			VkDeviceSize cullParamsFrameSize = 0;
+			/** @brief Copies that are out of date are refreshed when they're selected, as matrices are only written if they changed */
+			std::vector<uint64_t> matricesVersions;
+			uint64_t matricesVersion = 0;
+			IndirectCullParams cullParamsData{};
+			/** @brief Range of draw commands of each IndirectDrawGroup */
+			uint32_t groupOffsets[IndirectDrawGroupCount]{};
+			uint32_t groupSizes[IndirectDrawGroupCount]{};
+			vks::Buffer drawData;
+			vks::Buffer materialData;
+			vks::Buffer matrices;
+			vks::Buffer commands;
+			vks::Buffer drawCounts;
+			vks::Buffer cullParams;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			VkDescriptorSetLayout cullDescriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorSet cullDescriptorSet = VK_NULL_HANDLE;
+			VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+			VkPipeline cullPipeline = VK_NULL_HANDLE;
+			/** @brief Only available if VK_KHR_draw_indirect_count has been enabled, otherwise all commands of a group are drawn with culled ones set to zero indices */
+			PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR = nullptr;
+		} indirect;
+
+		/** @brief Parameters of the LOD chains generated with FileLoadingFlags::GenerateLODs, have to be set before loading the model */
+		struct LODSettings {
+			/** @brief Maximum number of levels including the full detail level */
+			uint32_t levelCount = 4;
+			/** @brief Target index count of each level relative to the previous level */
+			float reduction = 0.5f;
+			/** @brief Maximum geometric error of a level relative to the size of the primitive, the chain ends early once it's reached */
+			float maxError = 0.05f;
+			/** @brief Weight of normal and UV differences when ranking edge collapses */
+			float normalWeight = 0.05f;
+			float uvWeight = 0.05f;
+		} lodSettings;
+
+		/** @brief Components and compression of the vertex data, has to be set before loading the model */
+		VertexLayout vertexLayout;
+		/** @brief Size of a vertex in the vertex buffer */
+		uint32_t vertexStride = sizeof(Vertex);
+		/** @brief Bytes of vertex buffer memory saved by the vertex layout compared to the default float layout */
+		VkDeviceSize vertexBytesSaved = 0;
+
 		bool metallicRoughnessWorkflow = true;
 		bool buffersBound = false;
 		std::string path;
 
+		/** @brief Optional callback invoked from the loading thread when loadFromFile enters a new stage, progress is the fraction of the stages completed (0..1) */
+		std::function<void(LoadStage stage, float progress)> progressCallback;
+
+		/** @brief Wall clock time in milliseconds spent in the stages of the last loadFromFile call */
+		struct LoadTimings {
+			double parsing = 0.0;
+			/** @brief Creating the node hierarchy and converting the vertices and indices of all primitives */
+			double meshes = 0.0;
+			/** @brief Waiting for image decoding and uploads that didn't finish while the meshes were converted */
+			double images = 0.0;
+			double upload = 0.0;
+			double descriptors = 0.0;
+			double total = 0.0;
+		} loadTimings;
+
+		/** @brief Vertex cache efficiency of the index data before and after FileLoadingFlags::OptimizeMeshes, not available if the model was loaded from the mesh cache */
+		struct MeshOptimizationStatistics {
+			vks::meshoptimizer::VertexCacheStatistics before;
+			vks::meshoptimizer::VertexCacheStatistics after;
+			uint32_t verticesRemoved = 0;
+		} meshOptimizationStatistics;
+
 		Model() {};
 		~Model();
-		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
+		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<PrimitiveLoadInfo>& primitives, uint32_t& indexCount, uint32_t& vertexCount, float globalscale);
 		void loadSkins(tinygltf::Model& gltfModel);
 		void loadImages(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue);
 		void loadMaterials(tinygltf::Model& gltfModel);
 		void loadAnimations(tinygltf::Model& gltfModel);
-		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
-		void bindBuffers(VkCommandBuffer commandBuffer);
+		/** @param jobSystem Job system used to convert and optimize the meshes in parallel (must be called from the thread that created it), if not set the device's shared job system is used */
+		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f, vks::JobSystem* jobSystem = nullptr);
+		void bindBuffers(VkCommandBuffer commandBuffer, bool positionsOnly = false);
+		VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
+		VkPipelineVertexInputStateCreateInfo* getPositionVertexInputState();
 		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
 		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
 		void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
+		void evaluateAnimations(AnimationInstance* instances, uint32_t count, vks::JobSystem* jobSystem = nullptr) const;
+		uint32_t getJointMatrices(const AnimationInstance& instance, const Node* node, glm::mat4* jointMatrices) const;
+		void updateTransforms(bool force = false);
+		void prepareIndirectDraw(VkQueue transferQueue, VkPipelineShaderStageCreateInfo cullShader, VkPipelineCache pipelineCache = VK_NULL_HANDLE, uint32_t frameCount = 1);
+		void setIndirectFrame(uint32_t frameIndex);
+		void updateIndirectCulling(const glm::mat4& viewProjection, bool cullingEnabled = true);
+		void cullIndirect(VkCommandBuffer commandBuffer, uint32_t frameIndex = 0);
+		void drawIndirect(VkCommandBuffer commandBuffer, IndirectDrawGroup group, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindSet = 1, uint32_t frameIndex = 0);
 		Node* findNode(Node* parent, uint32_t index);
 		Node* nodeFromIndex(uint32_t index);
 		void prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout);
@@ -13,6 +13,13 @@
 #include <functional>
 #include <chrono>
 #include <iomanip>
+#include <iterator>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <numeric>
+
+#include "VulkanProfiler.h"
 
 namespace vks
 {
@@ -26,11 +33,104 @@ namespace vks
 		int outputFrames = -1; // -1 means no frames limit
 		uint32_t warmup = 1;
 		uint32_t duration = 10;
+		/** @brief Highest frame rate storage for the measured frames is reserved for, a run without a frame limit ends early once duration * maxFrameRate frames have been measured */
+		uint32_t maxFrameRate = 10000;
 		std::vector<double> frameTimes;
 		std::string filename = "";
 
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
+		/** @brief Number of frames the sample kept in flight during the run */
+		uint32_t framesInFlight = 1;
+		/** @brief Frame rate of a previous run the current run is compared against (0 if there is none) */
+		double baselineFps = 0.0;
+		/** @brief JSON results of a previous run to compare against, empty to disable the comparison */
+		std::string compareFilename = "";
+		/** @brief Frame time statistic used for the comparison (avg, p50, p90, p95, p99 or p99.9) */
+		std::string compareStatistic = "p95";
+		/** @brief Allowed increase of the compared frame time statistic in percent */
+		double compareThreshold = 5.0;
+		/** @brief Exit code for the process, non-zero if the comparison detected a regression */
+		int exitCode = 0;
+
+		/** @brief Frame time statistics of a run (all times in ms) */
+		struct Statistics {
+			double min = 0.0;
+			double max = 0.0;
+			double avg = 0.0;
+			double stddev = 0.0;
+			double p50 = 0.0;
+			double p90 = 0.0;
+			double p95 = 0.0;
+			double p99 = 0.0;
+			double p999 = 0.0;
+			/** @brief Frame rate calculated from the average of the slowest 1% of all frames */
+			double onePercentLowFps = 0.0;
+			/** @brief Frames slower than this are counted as outliers (upper quartile + 3 * inter quartile range) */
+			double outlierThreshold = 0.0;
+			uint32_t outlierCount = 0;
+			/** @brief Frame time histogram from min to p99.9, slower frames are counted in the last bucket */
+			double histogramStart = 0.0;
+			double histogramBucketSize = 0.0;
+			std::vector<uint32_t> histogram;
+		};
+
+		/** @brief Optional GPU profiler, the times of its scopes are collected for every frame */
+		const GpuProfiler* gpuProfiler = nullptr;
+
+		/** @brief GPU times of a profiled pass for every benchmarked frame (negative if the pass wasn't available for a frame) */
+		struct PassTimes {
+			std::string name;
+			std::vector<double> times;
+		};
+		std::vector<PassTimes> passTimes;
+
+		/**
+		* Set up the passes to collect GPU times for from the profiler's current results and reserve their storage
+		*
+		* @param frameBudget Maximum number of measured frames
+		*
+		* @note Called once before the measured frames, passes that show up only after that aren't collected
+		*/
+		void preparePassTimes(size_t frameBudget) {
+			if (!gpuProfiler) {
+				return;
+			}
+			for (const auto& result : gpuProfiler->getResults()) {
+				auto pass = std::find_if(passTimes.begin(), passTimes.end(), [&result](const PassTimes& p) { return p.name == result.name; });
+				if (pass == passTimes.end()) {
+					passTimes.push_back({ result.name, std::vector<double>(frameCount, -1.0) });
+					pass = std::prev(passTimes.end());
+				}
+				pass->times.reserve(pass->times.size() + frameBudget);
+			}
+		}
+
+		/** @brief Store the latest GPU profiler results for the current frame, only writes into storage reserved by preparePassTimes */
+		void collectPassTimes() {
+			if (!gpuProfiler) {
+				return;
+			}
+			const std::vector<GpuProfiler::Result>& results = gpuProfiler->getResults();
+			for (auto& pass : passTimes) {
+				auto result = std::find_if(results.begin(), results.end(), [&pass](const GpuProfiler::Result& r) { return pass.name == r.name; });
+				// Negative if the pass has not been resolved for this frame
+				pass.times.push_back((result != results.end()) ? result->time : -1.0);
+			}
+		}
+
+		/** @brief Average GPU time of a pass over all frames it has been resolved for */
+		double averagePassTime(const PassTimes& pass) const {
+			double sum = 0.0;
+			uint32_t count = 0;
+			for (double time : pass.times) {
+				if (time >= 0.0) {
+					sum += time;
+					count++;
+				}
+			}
+			return (count > 0) ? sum / count : 0.0;
+		}
 
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
@@ -53,23 +153,114 @@ namespace vks
 				};
 			}
 
+			// Reserve storage for a fixed frame budget up front, so collecting the frame and pass times doesn't allocate during the benchmark phase
+			const size_t frameBudget = (outputFrames != -1) ? static_cast<size_t>(outputFrames) : static_cast<size_t>(duration) * std::max(maxFrameRate, 1u);
+			frameTimes.reserve(frameTimes.size() + frameBudget);
+			preparePassTimes(frameBudget);
+
 			// Benchmark phase
 			{
+				bool budgetExceeded = false;
 				while (runtime < (duration * 1000.0)) {
+					if (frameCount == frameBudget) {
+						budgetExceeded = (outputFrames == -1);
+						break;
+					}
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 					runtime += tDiff;
 					frameTimes.push_back(tDiff);
+					collectPassTimes();
 					frameCount++;
 					if (outputFrames != -1 && outputFrames == frameCount) break;
 				};
 				std::cout << "Benchmark finished" << "\n";
+				if (budgetExceeded) {
+					std::cout << "Stopped after " << frameBudget << " frames (more than " << maxFrameRate << " fps), the runtime is shorter than requested" << "\n";
+				}
 				std::cout << "device : " << deviceProps.deviceName << " (driver version: " << deviceProps.driverVersion << ")" << "\n";
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				std::cout << "frames in flight: " << framesInFlight << "\n";
+				if (baselineFps > 0.0) {
+					std::cout << "speedup: " << (frameCount / (runtime / 1000.0)) / baselineFps << "x (vs. " << baselineFps << " fps with the queue idle after each frame)" << "\n";
+				}
+				for (const auto& pass : passTimes) {
+					std::cout << "gpu    : " << pass.name << " " << averagePassTime(pass) << " ms" << "\n";
+				}
+				if (!frameTimes.empty()) {
+					const Statistics stats = getStatistics();
+					std::cout << "best   : " << (1000.0 / stats.min) << " fps (" << stats.min << " ms)" << "\n";
+					std::cout << "worst  : " << (1000.0 / stats.max) << " fps (" << stats.max << " ms)" << "\n";
+					std::cout << "avg    : " << (1000.0 / stats.avg) << " fps (" << stats.avg << " ms, stddev " << stats.stddev << " ms)" << "\n";
+					std::cout << "p50/p90/p95/p99/p99.9: " << stats.p50 << " / " << stats.p90 << " / " << stats.p95 << " / " << stats.p99 << " / " << stats.p999 << " ms" << "\n";
+					std::cout << "1% low : " << stats.onePercentLowFps << " fps" << "\n";
+					std::cout << "outliers: " << stats.outlierCount << " frames above " << stats.outlierThreshold << " ms" << "\n";
+					std::cout << "\n";
+				}
+			}
+		}
+
+		/** @brief Calculate the frame time statistics of the current run */
+		Statistics getStatistics() const {
+			Statistics stats;
+			if (frameTimes.empty()) {
+				return stats;
 			}
+			std::vector<double> sorted(frameTimes);
+			std::sort(sorted.begin(), sorted.end());
+			const size_t count = sorted.size();
+			// Percentiles are interpolated linearly between the two closest ranks
+			auto percentile = [&sorted, count](double p) {
+				const double rank = p * (count - 1);
+				const size_t lower = static_cast<size_t>(rank);
+				const size_t upper = std::min(lower + 1, count - 1);
+				return sorted[lower] + (sorted[upper] - sorted[lower]) * (rank - lower);
+			};
+
+			stats.min = sorted.front();
+			stats.max = sorted.back();
+			stats.avg = std::accumulate(sorted.begin(), sorted.end(), 0.0) / count;
+			double variance = 0.0;
+			for (double t : sorted) {
+				variance += (t - stats.avg) * (t - stats.avg);
+			}
+			stats.stddev = std::sqrt(variance / count);
+			stats.p50 = percentile(0.5);
+			stats.p90 = percentile(0.9);
+			stats.p95 = percentile(0.95);
+			stats.p99 = percentile(0.99);
+			stats.p999 = percentile(0.999);
+
+			const size_t lowCount = std::max<size_t>(count / 100, 1);
+			const double lowAvg = std::accumulate(sorted.end() - lowCount, sorted.end(), 0.0) / lowCount;
+			stats.onePercentLowFps = 1000.0 / lowAvg;
+
+			const double q1 = percentile(0.25);
+			const double q3 = percentile(0.75);
+			stats.outlierThreshold = q3 + 3.0 * (q3 - q1);
+			stats.outlierCount = static_cast<uint32_t>(sorted.end() - std::upper_bound(sorted.begin(), sorted.end(), stats.outlierThreshold));
+
+			const uint32_t bucketCount = 20;
+			stats.histogram.resize(bucketCount, 0);
+			stats.histogramStart = stats.min;
+			stats.histogramBucketSize = std::max((stats.p999 - stats.min) / bucketCount, 0.001);
+			for (double t : sorted) {
+				const size_t bucket = std::min(static_cast<size_t>((t - stats.histogramStart) / stats.histogramBucketSize), static_cast<size_t>(bucketCount - 1));
+				stats.histogram[bucket]++;
+			}
+			return stats;
+		}
+
+		/** @brief Keep the frame rate of the last run as the baseline for the next run and reset all measurements */
+		void storeBaseline() {
+			baselineFps = frameCount / (runtime / 1000.0);
+			runtime = 0.0;
+			frameCount = 0;
+			frameTimes.clear();
+			passTimes.clear();
 		}
 
 		void saveResults() {
@@ -77,28 +268,176 @@ namespace vks
 			if (result.is_open()) {
 				result << std::fixed << std::setprecision(4);
 
-				result << "device,driverversion,duration (ms),frames,fps" << "\n";
-				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
+				result << "device,driverversion,duration (ms),frames,fps,frames in flight,baseline fps" << "\n";
+				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "," << framesInFlight << "," << baselineFps << "\n";
+
+				const Statistics stats = getStatistics();
+				result << "\n" << "min (ms),max (ms),avg (ms),stddev (ms),p50 (ms),p90 (ms),p95 (ms),p99 (ms),p99.9 (ms),1% low fps,outlier threshold (ms),outliers" << "\n";
+				result << stats.min << "," << stats.max << "," << stats.avg << "," << stats.stddev << "," << stats.p50 << "," << stats.p90 << "," << stats.p95 << "," << stats.p99 << "," << stats.p999 << "," << stats.onePercentLowFps << "," << stats.outlierThreshold << "," << stats.outlierCount << "\n";
+
+				result << "\n" << "histogram from (ms),frames" << "\n";
+				for (size_t i = 0; i < stats.histogram.size(); i++) {
+					result << stats.histogramStart + i * stats.histogramBucketSize << "," << stats.histogram[i] << "\n";
+				}
+
+				if (!passTimes.empty()) {
+					result << "\n" << "pass,avg gpu (ms)" << "\n";
+					for (const auto& pass : passTimes) {
+						result << pass.name << "," << averagePassTime(pass) << "\n";
+					}
+				}
 
 				if (outputFrameTimes) {
-					result << "\n" << "frame,ms" << "\n";
+					result << "\n" << "frame,ms";
+					for (const auto& pass : passTimes) {
+						result << "," << pass.name << " gpu (ms)";
+					}
+					result << "\n";
 					for (size_t i = 0; i < frameTimes.size(); i++) {
-						result << i << "," << frameTimes[i] << "\n";
+						result << i << "," << frameTimes[i];
+						// Leave the cell empty for frames where the pass timing wasn't available yet
+						for (const auto& pass : passTimes) {
+							result << ",";
+							if (pass.times[i] >= 0.0) {
+								result << pass.times[i];
+							}
+						}
+						result << "\n";
 					}
-					double tMin = *std::min_element(frameTimes.begin(), frameTimes.end());
-					double tMax = *std::max_element(frameTimes.begin(), frameTimes.end());
-					double tAvg = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / (double)frameTimes.size();
-					std::cout << "best   : " << (1000.0 / tMin) << " fps (" << tMin << " ms)" << "\n";
-					std::cout << "worst  : " << (1000.0 / tMax) << " fps (" << tMax << " ms)" << "\n";
-					std::cout << "avg    : " << (1000.0 / tAvg) << " fps (" << tAvg << " ms)" << "\n";
-					std::cout << "\n";
 				}
 
 				result.flush();
+			}
+			saveJson(getJsonFilename());
 #if defined(_WIN32)
-				FreeConsole();
+			FreeConsole();
 #endif
+		}
+
+		/** @brief Name of the JSON results file written next to the CSV file */
+		std::string getJsonFilename() const {
+			const size_t extension = filename.find_last_of('.');
+			if ((extension != std::string::npos) && (filename.find_first_of("/\\", extension) == std::string::npos)) {
+				return filename.substr(0, extension) + ".json";
+			}
+			return filename + ".json";
+		}
+
+		/** @brief Write the results and statistics of the run as JSON */
+		void saveJson(const std::string& jsonFilename) const {
+			std::ofstream result(jsonFilename, std::ios::out);
+			if (!result.is_open()) {
+				return;
+			}
+			const Statistics stats = getStatistics();
+			result << std::fixed << std::setprecision(4);
+			result << "{\n";
+			result << "\t\"device\": \"" << escapeJson(deviceProps.deviceName) << "\",\n";
+			result << "\t\"driverVersion\": " << deviceProps.driverVersion << ",\n";
+			result << "\t\"runtime\": " << runtime << ",\n";
+			result << "\t\"frames\": " << frameCount << ",\n";
+			result << "\t\"fps\": " << frameCount / (runtime / 1000.0) << ",\n";
+			result << "\t\"framesInFlight\": " << framesInFlight << ",\n";
+			result << "\t\"frameTime\": {\n";
+			result << "\t\t\"min\": " << stats.min << ",\n";
+			result << "\t\t\"max\": " << stats.max << ",\n";
+			result << "\t\t\"avg\": " << stats.avg << ",\n";
+			result << "\t\t\"stddev\": " << stats.stddev << ",\n";
+			result << "\t\t\"p50\": " << stats.p50 << ",\n";
+			result << "\t\t\"p90\": " << stats.p90 << ",\n";
+			result << "\t\t\"p95\": " << stats.p95 << ",\n";
+			result << "\t\t\"p99\": " << stats.p99 << ",\n";
+			result << "\t\t\"p99.9\": " << stats.p999 << "\n";
+			result << "\t},\n";
+			result << "\t\"onePercentLowFps\": " << stats.onePercentLowFps << ",\n";
+			result << "\t\"outliers\": { \"threshold\": " << stats.outlierThreshold << ", \"count\": " << stats.outlierCount << " },\n";
+			result << "\t\"histogram\": { \"start\": " << stats.histogramStart << ", \"bucketSize\": " << stats.histogramBucketSize << ", \"counts\": [";
+			for (size_t i = 0; i < stats.histogram.size(); i++) {
+				result << (i > 0 ? ", " : "") << stats.histogram[i];
+			}
+			result << "] },\n";
+			result << "\t\"passes\": [";
+			for (size_t i = 0; i < passTimes.size(); i++) {
+				result << (i > 0 ? "," : "") << "\n\t\t{ \"name\": \"" << escapeJson(passTimes[i].name) << "\", \"avgGpuTime\": " << averagePassTime(passTimes[i]) << " }";
+			}
+			result << (passTimes.empty() ? "]\n" : "\n\t]\n");
+			result << "}\n";
+		}
+
+		/**
+		* @brief Compare the frame times of the run against the results of a previous run stored in compareFilename
+		* @return False (and sets a non-zero exit code) if the compared statistic regressed by more than compareThreshold percent
+		*/
+		bool compare() {
+			std::ifstream file(compareFilename);
+			if (!file.is_open()) {
+				std::cerr << "Could not open benchmark baseline \"" << compareFilename << "\"" << "\n";
+				exitCode = 1;
+				return false;
+			}
+			std::stringstream buffer;
+			buffer << file.rdbuf();
+			double baseline = 0.0;
+			double current = 0.0;
+			if (!readJsonNumber(buffer.str(), "frameTime", compareStatistic, baseline) || !getStatistic(getStatistics(), compareStatistic, current)) {
+				std::cerr << "Benchmark baseline \"" << compareFilename << "\" has no frame time statistic \"" << compareStatistic << "\"" << "\n";
+				exitCode = 1;
+				return false;
+			}
+			const double change = (baseline > 0.0) ? (current - baseline) / baseline * 100.0 : 0.0;
+			std::cout << "compare: " << compareStatistic << " " << current << " ms vs. " << baseline << " ms baseline (" << std::showpos << change << std::noshowpos << "%)" << "\n";
+			if (change > compareThreshold) {
+				std::cout << "REGRESSION: " << compareStatistic << " frame time exceeds the baseline by more than " << compareThreshold << "%" << "\n";
+				exitCode = 1;
+				return false;
+			}
+			return true;
+		}
+
+	private:
+		static std::string escapeJson(const std::string& value) {
+			std::string escaped;
+			for (char c : value) {
+				if ((c == '"') || (c == '\\')) {
+					escaped += '\\';
+				}
+				escaped += c;
+			}
+			return escaped;
+		}
+
+		static bool getStatistic(const Statistics& stats, const std::string& name, double& value) {
+			const std::vector<std::pair<std::string, double>> values = {
+				{ "min", stats.min }, { "max", stats.max }, { "avg", stats.avg },
+				{ "p50", stats.p50 }, { "p90", stats.p90 }, { "p95", stats.p95 }, { "p99", stats.p99 }, { "p99.9", stats.p999 }
+			};
+			for (const auto& entry : values) {
+				if (entry.first == name) {
+					value = entry.second;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/** @brief Minimal lookup of a numeric member of an object in the JSON files written by saveJson */
+		static bool readJsonNumber(const std::string& json, const std::string& object, const std::string& key, double& value) {
+			size_t pos = json.find("\"" + object + "\"");
+			if (pos == std::string::npos) {
+				return false;
+			}
+			const size_t objectEnd = json.find('}', pos);
+			pos = json.find("\"" + key + "\"", pos);
+			if ((pos == std::string::npos) || (pos > objectEnd)) {
+				return false;
+			}
+			pos = json.find(':', pos);
+			if (pos == std::string::npos) {
+				return false;
 			}
+			char* end = nullptr;
+			value = strtod(json.c_str() + pos + 1, &end);
+			return end != json.c_str() + pos + 1;
 		}
 	};
 }
\ No newline at end of file
@@ -1,15 +1,37 @@
 /*
 * View frustum culling class
 *
+* Batched culling of sphere and box arrays uses SSE/AVX2 (x64) or NEON (ARM) kernels selected at runtime, with a scalar fallback
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <array>
 #include <math.h>
+#include <stdint.h>
 #include <glm/glm.hpp>
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define VKS_FRUSTUM_X64 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define VKS_FRUSTUM_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(VKS_FRUSTUM_X64) && (defined(__GNUC__) || defined(__clang__))
+#define VKS_FRUSTUM_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define VKS_FRUSTUM_TARGET_AVX2
+#endif
+
 namespace vks
 {
 	class Frustum
@@ -57,7 +79,7 @@ namespace vks
 			}
 		}
 		
-		bool checkSphere(glm::vec3 pos, float radius)
+		bool checkSphere(glm::vec3 pos, float radius) const
 		{
 			for (auto i = 0; i < planes.size(); i++)
 			{
@@ -68,5 +90,334 @@ namespace vks
 			}
 			return true;
 		}
+
+		/**
+		* Check if an axis aligned bounding box is (partially) inside the frustum
+		*
+		* @param min Minimum corner of the box (e.g. vkglTF::Primitive::dimensions.min)
+		* @param max Maximum corner of the box (e.g. vkglTF::Primitive::dimensions.max)
+		*
+		* @return False if the box is completely outside of one of the frustum planes
+		*/
+		bool checkAABB(glm::vec3 min, glm::vec3 max) const
+		{
+			const glm::vec3 center = (min + max) * 0.5f;
+			const glm::vec3 extent = (max - min) * 0.5f;
+			for (size_t i = 0; i < planes.size(); i++)
+			{
+				// Distance of the box corner furthest along the plane normal
+				const float distance = planes[i].x * center.x + planes[i].y * center.y + planes[i].z * center.z + planes[i].w;
+				const float projectedExtent = fabsf(planes[i].x) * extent.x + fabsf(planes[i].y) * extent.y + fabsf(planes[i].z) * extent.z;
+				if (distance + projectedExtent <= 0.0f)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/** @brief Instruction set used by the batched culling functions */
+		enum class CullingPath { Scalar, SSE, AVX2, NEON };
+
+		/** @return Instruction set the batched culling functions use on this CPU */
+		static CullingPath getCullingPath()
+		{
+			static const CullingPath path = detectCullingPath();
+			return path;
+		}
+
+		/**
+		* Cull an array of spheres stored as structure of arrays
+		*
+		* @param x, y, z Sphere centers
+		* @param radius Sphere radii
+		* @param count Number of spheres
+		* @param visibilityMask Receives one bit per sphere (bit i % 32 of word i / 32) that is set for visible spheres, must hold (count + 31) / 32 words
+		*/
+		void cullSpheres(const float* x, const float* y, const float* z, const float* radius, uint32_t count, uint32_t* visibilityMask) const
+		{
+			cull<false>(x, y, z, radius, nullptr, nullptr, count, visibilityMask);
+		}
+
+		/**
+		* Cull an array of spheres stored as structure of arrays
+		*
+		* @param visibleIndices Receives the indices of the visible spheres in ascending order, must hold count entries
+		* @param visibilityMask Scratch memory for (count + 31) / 32 words
+		*
+		* @return Number of visible spheres
+		*/
+		uint32_t cullSpheres(const float* x, const float* y, const float* z, const float* radius, uint32_t count, uint32_t* visibleIndices, uint32_t* visibilityMask) const
+		{
+			cullSpheres(x, y, z, radius, count, visibilityMask);
+			return compact(visibilityMask, count, visibleIndices);
+		}
+
+		/**
+		* Cull an array of axis aligned bounding boxes stored as structure of arrays
+		*
+		* @param centerX, centerY, centerZ Box centers (e.g. vkglTF::Primitive::dimensions.center)
+		* @param extentX, extentY, extentZ Box half sizes (e.g. vkglTF::Primitive::dimensions.size * 0.5)
+		* @param count Number of boxes
+		* @param visibilityMask Receives one bit per box (bit i % 32 of word i / 32) that is set for visible boxes, must hold (count + 31) / 32 words
+		*/
+		void cullAABBs(const float* centerX, const float* centerY, const float* centerZ, const float* extentX, const float* extentY, const float* extentZ, uint32_t count, uint32_t* visibilityMask) const
+		{
+			cull<true>(centerX, centerY, centerZ, extentX, extentY, extentZ, count, visibilityMask);
+		}
+
+		/**
+		* Cull an array of axis aligned bounding boxes stored as structure of arrays
+		*
+		* @param visibleIndices Receives the indices of the visible boxes in ascending order, must hold count entries
+		* @param visibilityMask Scratch memory for (count + 31) / 32 words
+		*
+		* @return Number of visible boxes
+		*/
+		uint32_t cullAABBs(const float* centerX, const float* centerY, const float* centerZ, const float* extentX, const float* extentY, const float* extentZ, uint32_t count, uint32_t* visibleIndices, uint32_t* visibilityMask) const
+		{
+			cullAABBs(centerX, centerY, centerZ, extentX, extentY, extentZ, count, visibilityMask);
+			return compact(visibilityMask, count, visibleIndices);
+		}
+
+		/**
+		* Convert a visibility mask into a list of visible indices
+		*
+		* @return Number of visible indices written to visibleIndices
+		*/
+		static uint32_t compact(const uint32_t* visibilityMask, uint32_t count, uint32_t* visibleIndices)
+		{
+			uint32_t visibleCount = 0;
+			const uint32_t wordCount = (count + 31) / 32;
+			for (uint32_t word = 0; word < wordCount; word++)
+			{
+				uint32_t bits = visibilityMask[word];
+				while (bits != 0)
+				{
+					visibleIndices[visibleCount++] = word * 32 + countTrailingZeros(bits);
+					bits &= bits - 1;
+				}
+			}
+			return visibleCount;
+		}
+
+	private:
+		static uint32_t countTrailingZeros(uint32_t value)
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			unsigned long index;
+			_BitScanForward(&index, value);
+			return index;
+#else
+			return __builtin_ctz(value);
+#endif
+		}
+
+		static CullingPath detectCullingPath()
+		{
+#if defined(VKS_FRUSTUM_X64)
+#if defined(_MSC_VER) && !defined(__clang__)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] >= 7)
+			{
+				__cpuid(info, 1);
+				const bool fma = (info[2] & (1 << 12)) != 0;
+				// OS has to save the AVX registers on context switches
+				const bool osxsave = (info[2] & (1 << 27)) != 0;
+				__cpuidex(info, 7, 0);
+				const bool avx2 = (info[1] & (1 << 5)) != 0;
+				if (fma && osxsave && avx2 && ((_xgetbv(0) & 0x6) == 0x6))
+				{
+					return CullingPath::AVX2;
+				}
+			}
+#else
+			if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			{
+				return CullingPath::AVX2;
+			}
+#endif
+			// SSE2 is part of the x64 baseline
+			return CullingPath::SSE;
+#elif defined(VKS_FRUSTUM_NEON)
+			return CullingPath::NEON;
+#else
+			return CullingPath::Scalar;
+#endif
+		}
+
+		// Spheres pass their radius as extentX, boxes are tested with the extent projected onto the plane normal
+		template<bool Boxes>
+		void cull(const float* x, const float* y, const float* z, const float* extentX, const float* extentY, const float* extentZ, uint32_t count, uint32_t* visibilityMask) const
+		{
+			for (uint32_t word = 0; word < (count + 31) / 32; word++)
+			{
+				visibilityMask[word] = 0;
+			}
+			uint32_t first = 0;
+			switch (getCullingPath())
+			{
+#if defined(VKS_FRUSTUM_X64)
+			case CullingPath::AVX2:
+				first = cullAVX2<Boxes>(x, y, z, extentX, extentY, extentZ, count, visibilityMask);
+				break;
+			case CullingPath::SSE:
+				first = cullSSE<Boxes>(x, y, z, extentX, extentY, extentZ, count, visibilityMask);
+				break;
+#elif defined(VKS_FRUSTUM_NEON)
+			case CullingPath::NEON:
+				first = cullNEON<Boxes>(x, y, z, extentX, extentY, extentZ, count, visibilityMask);
+				break;
+#endif
+			default:
+				break;
+			}
+			// Scalar fallback, also handles the elements that don't fill a whole vector
+			for (uint32_t i = first; i < count; i++)
+			{
+				bool visible = true;
+				for (size_t p = 0; (p < planes.size()) && visible; p++)
+				{
+					const glm::vec4& plane = planes[p];
+					const float distance = plane.x * x[i] + plane.y * y[i] + plane.z * z[i] + plane.w;
+					const float projectedExtent = Boxes ? fabsf(plane.x) * extentX[i] + fabsf(plane.y) * extentY[i] + fabsf(plane.z) * extentZ[i] : extentX[i];
+					visible = distance + projectedExtent > 0.0f;
+				}
+				if (visible)
+				{
+					visibilityMask[i / 32] |= 1u << (i % 32);
+				}
+			}
+		}
+
+#if defined(VKS_FRUSTUM_X64)
+		/** @return Number of elements processed */
+		template<bool Boxes>
+		uint32_t cullSSE(const float* x, const float* y, const float* z, const float* extentX, const float* extentY, const float* extentZ, uint32_t count, uint32_t* visibilityMask) const
+		{
+			const __m128 signMask = _mm_set1_ps(-0.0f);
+			const __m128 zero = _mm_setzero_ps();
+			uint32_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				const __m128 px = _mm_loadu_ps(x + i);
+				const __m128 py = _mm_loadu_ps(y + i);
+				const __m128 pz = _mm_loadu_ps(z + i);
+				const __m128 ex = _mm_loadu_ps(extentX + i);
+				const __m128 ey = Boxes ? _mm_loadu_ps(extentY + i) : zero;
+				const __m128 ez = Boxes ? _mm_loadu_ps(extentZ + i) : zero;
+				__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				for (size_t p = 0; p < planes.size(); p++)
+				{
+					const __m128 nx = _mm_set1_ps(planes[p].x);
+					const __m128 ny = _mm_set1_ps(planes[p].y);
+					const __m128 nz = _mm_set1_ps(planes[p].z);
+					__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, px), _mm_mul_ps(ny, py)), _mm_add_ps(_mm_mul_ps(nz, pz), _mm_set1_ps(planes[p].w)));
+					if (Boxes)
+					{
+						distance = _mm_add_ps(distance, _mm_mul_ps(_mm_andnot_ps(signMask, nx), ex));
+						distance = _mm_add_ps(distance, _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey));
+						distance = _mm_add_ps(distance, _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+					}
+					else
+					{
+						distance = _mm_add_ps(distance, ex);
+					}
+					visible = _mm_and_ps(visible, _mm_cmpgt_ps(distance, zero));
+				}
+				visibilityMask[i / 32] |= static_cast<uint32_t>(_mm_movemask_ps(visible)) << (i % 32);
+			}
+			return i;
+		}
+
+		/** @return Number of elements processed */
+		template<bool Boxes>
+		VKS_FRUSTUM_TARGET_AVX2 uint32_t cullAVX2(const float* x, const float* y, const float* z, const float* extentX, const float* extentY, const float* extentZ, uint32_t count, uint32_t* visibilityMask) const
+		{
+			const __m256 signMask = _mm256_set1_ps(-0.0f);
+			const __m256 zero = _mm256_setzero_ps();
+			uint32_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				const __m256 px = _mm256_loadu_ps(x + i);
+				const __m256 py = _mm256_loadu_ps(y + i);
+				const __m256 pz = _mm256_loadu_ps(z + i);
+				const __m256 ex = _mm256_loadu_ps(extentX + i);
+				const __m256 ey = Boxes ? _mm256_loadu_ps(extentY + i) : zero;
+				const __m256 ez = Boxes ? _mm256_loadu_ps(extentZ + i) : zero;
+				__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+				for (size_t p = 0; p < planes.size(); p++)
+				{
+					const __m256 nx = _mm256_set1_ps(planes[p].x);
+					const __m256 ny = _mm256_set1_ps(planes[p].y);
+					const __m256 nz = _mm256_set1_ps(planes[p].z);
+					__m256 distance = _mm256_fmadd_ps(nx, px, _mm256_fmadd_ps(ny, py, _mm256_fmadd_ps(nz, pz, _mm256_set1_ps(planes[p].w))));
+					if (Boxes)
+					{
+						distance = _mm256_fmadd_ps(_mm256_andnot_ps(signMask, nx), ex, distance);
+						distance = _mm256_fmadd_ps(_mm256_andnot_ps(signMask, ny), ey, distance);
+						distance = _mm256_fmadd_ps(_mm256_andnot_ps(signMask, nz), ez, distance);
+					}
+					else
+					{
+						distance = _mm256_add_ps(distance, ex);
+					}
+					visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, zero, _CMP_GT_OQ));
+				}
+				visibilityMask[i / 32] |= static_cast<uint32_t>(_mm256_movemask_ps(visible)) << (i % 32);
+			}
+			return i;
+		}
+#endif
+
+#if defined(VKS_FRUSTUM_NEON)
+		/** @return Number of elements processed */
+		template<bool Boxes>
+		uint32_t cullNEON(const float* x, const float* y, const float* z, const float* extentX, const float* extentY, const float* extentZ, uint32_t count, uint32_t* visibilityMask) const
+		{
+			const uint32_t laneBits[4] = { 1, 2, 4, 8 };
+			const uint32x4_t laneBitsVector = vld1q_u32(laneBits);
+			const float32x4_t zero = vdupq_n_f32(0.0f);
+			uint32_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				const float32x4_t px = vld1q_f32(x + i);
+				const float32x4_t py = vld1q_f32(y + i);
+				const float32x4_t pz = vld1q_f32(z + i);
+				const float32x4_t ex = vld1q_f32(extentX + i);
+				const float32x4_t ey = Boxes ? vld1q_f32(extentY + i) : zero;
+				const float32x4_t ez = Boxes ? vld1q_f32(extentZ + i) : zero;
+				uint32x4_t visible = vdupq_n_u32(0xFFFFFFFF);
+				for (size_t p = 0; p < planes.size(); p++)
+				{
+					float32x4_t distance = vdupq_n_f32(planes[p].w);
+					distance = vmlaq_n_f32(distance, px, planes[p].x);
+					distance = vmlaq_n_f32(distance, py, planes[p].y);
+					distance = vmlaq_n_f32(distance, pz, planes[p].z);
+					if (Boxes)
+					{
+						distance = vmlaq_n_f32(distance, ex, fabsf(planes[p].x));
+						distance = vmlaq_n_f32(distance, ey, fabsf(planes[p].y));
+						distance = vmlaq_n_f32(distance, ez, fabsf(planes[p].z));
+					}
+					else
+					{
+						distance = vaddq_f32(distance, ex);
+					}
+					visible = vandq_u32(visible, vcgtq_f32(distance, zero));
+				}
+				const uint32x4_t bits = vandq_u32(visible, laneBitsVector);
+#if defined(__aarch64__) || defined(_M_ARM64)
+				const uint32_t mask = vaddvq_u32(bits);
+#else
+				const uint32x2_t sum = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+				const uint32_t mask = vget_lane_u32(vpadd_u32(sum, sum), 0);
+#endif
+				visibilityMask[i / 32] |= mask << (i % 32);
+			}
+			return i;
+		}
+#endif
 	};
 }
@@ -0,0 +1,675 @@
+/*
+* Image file output for rendered frames
+*
+* Encodes 8 bit RGBA/BGRA pixel data to PNG, QOI or PPM with a single buffered file write
+* ImageWriter moves encoding to a job system, so rendering can continue while previous images are compressed
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "jobsystem.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define VKS_IMAGE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VKS_IMAGE_NEON 1
+#endif
+
+namespace vks
+{
+	namespace image
+	{
+		enum class FileFormat { PPM, PNG, QOI };
+
+		/** @brief Tightly packed 8 bit per channel pixels with four channels (e.g. read back from a color attachment) */
+		struct ImageData
+		{
+			uint32_t width = 0;
+			uint32_t height = 0;
+			/** @brief Pixels are stored as BGRA instead of RGBA (e.g. from a B8G8R8A8 swapchain image) */
+			bool bgra = false;
+			std::vector<uint8_t> pixels;
+		};
+
+		/** @brief Get the file format from the file name's extension, defaults to PNG */
+		inline FileFormat getFileFormat(const std::string& filename)
+		{
+			const size_t dot = filename.find_last_of('.');
+			if (dot == std::string::npos) {
+				return FileFormat::PNG;
+			}
+			std::string extension = filename.substr(dot + 1);
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			if (extension == "ppm") {
+				return FileFormat::PPM;
+			}
+			if (extension == "qoi") {
+				return FileFormat::QOI;
+			}
+			return FileFormat::PNG;
+		}
+
+		/**
+		* Convert a row of four channel pixels to RGB(A), optionally swapping the red and blue channels
+		*
+		* @param src Source pixels with four channels
+		* @param dst Destination, pixelCount * channels bytes
+		* @param pixelCount Number of pixels to convert
+		* @param channels Number of destination channels (3 drops alpha, 4 keeps it)
+		* @param swapRedBlue Swap the first and third channel (BGRA <-> RGBA)
+		*/
+		inline void swizzleRow(const uint8_t* src, uint8_t* dst, size_t pixelCount, uint32_t channels, bool swapRedBlue)
+		{
+			if ((channels == 4) && !swapRedBlue) {
+				memcpy(dst, src, pixelCount * 4);
+				return;
+			}
+			size_t x = 0;
+#if defined(VKS_IMAGE_SSE2)
+			// Four pixels per iteration, red and blue are swapped with masks and shifts within each 32 bit pixel
+			const __m128i redBlue = _mm_set1_epi32(0x00FF00FF);
+			if (channels == 4) {
+				for (; x + 4 <= pixelCount; x += 4) {
+					const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+					const __m128i swapped = _mm_and_si128(_mm_or_si128(_mm_slli_epi32(pixels, 16), _mm_srli_epi32(pixels, 16)), redBlue);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_or_si128(_mm_andnot_si128(redBlue, pixels), swapped));
+				}
+			} else {
+				// Three channel pixels are stored with overlapping four byte writes, so stop one pixel early to stay inside the row
+				for (; x + 5 <= pixelCount; x += 4) {
+					__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+					if (swapRedBlue) {
+						const __m128i swapped = _mm_and_si128(_mm_or_si128(_mm_slli_epi32(pixels, 16), _mm_srli_epi32(pixels, 16)), redBlue);
+						pixels = _mm_or_si128(_mm_andnot_si128(redBlue, pixels), swapped);
+					}
+					for (uint32_t i = 0; i < 4; i++) {
+						const int32_t pixel = _mm_cvtsi128_si32(pixels);
+						memcpy(dst + (x + i) * 3, &pixel, 4);
+						pixels = _mm_srli_si128(pixels, 4);
+					}
+				}
+			}
+#elif defined(VKS_IMAGE_NEON)
+			// Sixteen pixels per iteration, de-interleaved by the structured loads and stores
+			for (; x + 16 <= pixelCount; x += 16) {
+				uint8x16x4_t pixels = vld4q_u8(src + x * 4);
+				if (swapRedBlue) {
+					std::swap(pixels.val[0], pixels.val[2]);
+				}
+				if (channels == 3) {
+					uint8x16x3_t rgb;
+					rgb.val[0] = pixels.val[0];
+					rgb.val[1] = pixels.val[1];
+					rgb.val[2] = pixels.val[2];
+					vst3q_u8(dst + x * 3, rgb);
+				} else {
+					vst4q_u8(dst + x * 4, pixels);
+				}
+			}
+#endif
+			const uint32_t r = swapRedBlue ? 2 : 0;
+			const uint32_t b = swapRedBlue ? 0 : 2;
+			for (; x < pixelCount; x++) {
+				const uint8_t* s = src + x * 4;
+				uint8_t* d = dst + x * channels;
+				d[0] = s[r];
+				d[1] = s[1];
+				d[2] = s[b];
+				if (channels == 4) {
+					d[3] = s[3];
+				}
+			}
+		}
+
+		/** @brief Binary PPM (always RGB) */
+		inline void encodePPM(const ImageData& image, std::vector<uint8_t>& out)
+		{
+			const std::string header = "P6\n" + std::to_string(image.width) + "\n" + std::to_string(image.height) + "\n255\n";
+			const size_t rowSize = static_cast<size_t>(image.width) * 3;
+			out.resize(header.size() + rowSize * image.height);
+			memcpy(out.data(), header.data(), header.size());
+			uint8_t* dst = out.data() + header.size();
+			for (uint32_t y = 0; y < image.height; y++) {
+				swizzleRow(image.pixels.data() + static_cast<size_t>(y) * image.width * 4, dst, image.width, 3, image.bgra);
+				dst += rowSize;
+			}
+		}
+
+		namespace detail
+		{
+			inline void writeBigEndian(uint8_t* dst, uint32_t value)
+			{
+				dst[0] = static_cast<uint8_t>(value >> 24);
+				dst[1] = static_cast<uint8_t>(value >> 16);
+				dst[2] = static_cast<uint8_t>(value >> 8);
+				dst[3] = static_cast<uint8_t>(value);
+			}
+
+			inline uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+			{
+				struct Table
+				{
+					uint32_t values[256];
+					Table()
+					{
+						for (uint32_t i = 0; i < 256; i++) {
+							uint32_t c = i;
+							for (uint32_t k = 0; k < 8; k++) {
+								c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+							}
+							values[i] = c;
+						}
+					}
+				};
+				static const Table table;
+				crc = ~crc;
+				for (size_t i = 0; i < size; i++) {
+					crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+				}
+				return ~crc;
+			}
+
+			inline uint32_t adler32(const uint8_t* data, size_t size)
+			{
+				// Largest number of bytes that can be summed before the 32 bit sums have to be reduced
+				const size_t blockSize = 5552;
+				uint32_t a = 1, b = 0;
+				while (size > 0) {
+					const size_t count = std::min(size, blockSize);
+					for (size_t i = 0; i < count; i++) {
+						a += data[i];
+						b += a;
+					}
+					a %= 65521;
+					b %= 65521;
+					data += count;
+					size -= count;
+				}
+				return (b << 16) | a;
+			}
+
+			/** @brief Deflate symbol tables for the fixed Huffman codes */
+			struct DeflateTables
+			{
+				// Codes are stored bit reversed, as Huffman codes are packed starting with the most significant bit
+				uint16_t literalCode[288];
+				uint8_t literalBits[288];
+				uint16_t distanceCode[30];
+				// Symbol (257..285), extra bit count and extra bit value for each match length (3..258)
+				uint16_t lengthSymbol[259];
+				uint8_t lengthExtraBits[259];
+				uint16_t lengthExtra[259];
+				uint8_t distanceSymbol[512];
+				uint16_t distanceBase[30];
+				uint8_t distanceExtraBits[30];
+
+				static uint16_t reverse(uint32_t code, uint32_t bits)
+				{
+					uint32_t result = 0;
+					for (uint32_t i = 0; i < bits; i++) {
+						result = (result << 1) | ((code >> i) & 1);
+					}
+					return static_cast<uint16_t>(result);
+				}
+
+				DeflateTables()
+				{
+					for (uint32_t i = 0; i < 288; i++) {
+						uint32_t code, bits;
+						if (i < 144) {
+							code = 0x30 + i; bits = 8;
+						} else if (i < 256) {
+							code = 0x190 + i - 144; bits = 9;
+						} else if (i < 280) {
+							code = i - 256; bits = 7;
+						} else {
+							code = 0xC0 + i - 280; bits = 8;
+						}
+						literalCode[i] = reverse(code, bits);
+						literalBits[i] = static_cast<uint8_t>(bits);
+					}
+					for (uint32_t i = 0; i < 30; i++) {
+						distanceCode[i] = reverse(i, 5);
+					}
+					const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+					const uint8_t lengthBits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+					for (uint32_t s = 0; s < 29; s++) {
+						const uint32_t end = (s == 28) ? 259 : lengthBase[s + 1];
+						for (uint32_t length = lengthBase[s]; length < end; length++) {
+							lengthSymbol[length] = static_cast<uint16_t>(257 + s);
+							lengthExtraBits[length] = lengthBits[s];
+							lengthExtra[length] = static_cast<uint16_t>(length - lengthBase[s]);
+						}
+					}
+					// Length 258 has its own symbol without extra bits
+					lengthSymbol[258] = 285;
+					lengthExtraBits[258] = 0;
+					lengthExtra[258] = 0;
+					const uint16_t base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+					for (uint32_t s = 0; s < 30; s++) {
+						distanceBase[s] = base[s];
+						distanceExtraBits[s] = static_cast<uint8_t>((s < 4) ? 0 : (s / 2 - 1));
+					}
+					// Distances up to 256 are looked up directly, larger ones by their upper bits (see zlib's _dist_code)
+					uint32_t s = 0;
+					for (uint32_t d = 1; d <= 256; d++) {
+						while ((s < 29) && (base[s + 1] <= d)) s++;
+						distanceSymbol[d - 1] = static_cast<uint8_t>(s);
+					}
+					s = 0;
+					for (uint32_t i = 2; i < 256; i++) {
+						const uint32_t d = (i << 7) + 1;
+						while ((s < 29) && (base[s + 1] <= d)) s++;
+						distanceSymbol[256 + i] = static_cast<uint8_t>(s);
+					}
+				}
+
+				uint32_t getDistanceSymbol(uint32_t distance) const
+				{
+					return (distance <= 256) ? distanceSymbol[distance - 1] : distanceSymbol[256 + ((distance - 1) >> 7)];
+				}
+			};
+
+			/** @brief Writes a little endian bit stream into a preallocated buffer */
+			struct BitWriter
+			{
+				uint8_t* dst;
+				uint64_t bits = 0;
+				uint32_t count = 0;
+
+				explicit BitWriter(uint8_t* dst) : dst(dst) {}
+
+				void put(uint32_t value, uint32_t bitCount)
+				{
+					bits |= static_cast<uint64_t>(value) << count;
+					count += bitCount;
+					if (count >= 32) {
+						const uint32_t word = static_cast<uint32_t>(bits);
+						dst[0] = static_cast<uint8_t>(word);
+						dst[1] = static_cast<uint8_t>(word >> 8);
+						dst[2] = static_cast<uint8_t>(word >> 16);
+						dst[3] = static_cast<uint8_t>(word >> 24);
+						dst += 4;
+						bits >>= 32;
+						count -= 32;
+					}
+				}
+
+				uint8_t* finish()
+				{
+					while (count > 0) {
+						*dst++ = static_cast<uint8_t>(bits);
+						bits >>= 8;
+						count = (count > 8) ? count - 8 : 0;
+					}
+					return dst;
+				}
+			};
+
+			/**
+			* Compress data into a zlib stream with a single fixed Huffman deflate block
+			* Greedy LZ77 with a single candidate per hash bucket, trades some compression ratio for speed
+			*/
+			inline void zlibCompress(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+			{
+				static const DeflateTables tables;
+				const uint32_t hashBits = 15;
+				const uint32_t windowSize = 32768;
+				const uint32_t minMatch = 3;
+				const uint32_t maxMatch = 258;
+
+				// Worst case is 9 bits per literal, plus header, block end and checksum
+				const size_t start = out.size();
+				out.resize(start + size + size / 8 + 64);
+				uint8_t* dst = out.data() + start;
+				// CMF/FLG: deflate with 32k window, fastest compression level
+				*dst++ = 0x78;
+				*dst++ = 0x01;
+
+				BitWriter writer(dst);
+				// BFINAL = 1, BTYPE = 01 (fixed Huffman codes)
+				writer.put(1, 1);
+				writer.put(1, 2);
+
+				std::vector<int64_t> head(size_t(1) << hashBits, -1);
+				auto read24 = [data](size_t pos) {
+					return static_cast<uint32_t>(data[pos]) | (static_cast<uint32_t>(data[pos + 1]) << 8) | (static_cast<uint32_t>(data[pos + 2]) << 16);
+				};
+				size_t pos = 0;
+				while (pos + minMatch <= size) {
+					const uint32_t value = read24(pos);
+					const uint32_t hash = (value * 2654435761u) >> (32 - hashBits);
+					const int64_t candidate = head[hash];
+					head[hash] = static_cast<int64_t>(pos);
+					if ((candidate >= 0) && (pos - static_cast<size_t>(candidate) <= windowSize) && (read24(static_cast<size_t>(candidate)) == value)) {
+						const size_t maxLength = std::min<size_t>(maxMatch, size - pos);
+						const uint8_t* a = data + candidate;
+						const uint8_t* b = data + pos;
+						uint32_t length = minMatch;
+						while ((length < maxLength) && (a[length] == b[length])) {
+							length++;
+						}
+						const uint32_t distance = static_cast<uint32_t>(pos - static_cast<size_t>(candidate));
+						const uint32_t lengthSymbol = tables.lengthSymbol[length];
+						writer.put(tables.literalCode[lengthSymbol], tables.literalBits[lengthSymbol]);
+						writer.put(tables.lengthExtra[length], tables.lengthExtraBits[length]);
+						const uint32_t distanceSymbol = tables.getDistanceSymbol(distance);
+						writer.put(tables.distanceCode[distanceSymbol], 5);
+						writer.put(distance - tables.distanceBase[distanceSymbol], tables.distanceExtraBits[distanceSymbol]);
+						pos += length;
+					} else {
+						writer.put(tables.literalCode[data[pos]], tables.literalBits[data[pos]]);
+						pos++;
+					}
+				}
+				for (; pos < size; pos++) {
+					writer.put(tables.literalCode[data[pos]], tables.literalBits[data[pos]]);
+				}
+				// End of block
+				writer.put(tables.literalCode[256], tables.literalBits[256]);
+				dst = writer.finish();
+				writeBigEndian(dst, adler32(data, size));
+				dst += 4;
+				out.resize(static_cast<size_t>(dst - out.data()));
+			}
+
+			inline void appendPngChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+			{
+				const size_t offset = out.size();
+				out.resize(offset + 12 + size);
+				uint8_t* chunk = out.data() + offset;
+				writeBigEndian(chunk, static_cast<uint32_t>(size));
+				memcpy(chunk + 4, type, 4);
+				if (size > 0) {
+					memcpy(chunk + 8, data, size);
+				}
+				writeBigEndian(chunk + 8 + size, crc32(chunk + 4, size + 4));
+			}
+		}
+
+		/**
+		* PNG with 8 bit RGB or RGBA color
+		*
+		* @param channels 3 to drop the alpha channel, 4 to keep it
+		*/
+		inline void encodePNG(const ImageData& image, std::vector<uint8_t>& out, uint32_t channels = 3)
+		{
+			// Rows are Paeth filtered (Sub for the first row, as the row above counts as zero), each prefixed with its filter type
+			const size_t rowSize = static_cast<size_t>(image.width) * channels;
+			std::vector<uint8_t> filtered((rowSize + 1) * image.height);
+			std::vector<uint8_t> rows[2] = { std::vector<uint8_t>(rowSize, 0), std::vector<uint8_t>(rowSize, 0) };
+			for (uint32_t y = 0; y < image.height; y++) {
+				std::vector<uint8_t>& current = rows[y & 1];
+				const std::vector<uint8_t>& previous = rows[(y + 1) & 1];
+				swizzleRow(image.pixels.data() + static_cast<size_t>(y) * image.width * 4, current.data(), image.width, channels, image.bgra);
+				uint8_t* dst = filtered.data() + y * (rowSize + 1);
+				*dst++ = 4;
+				for (size_t x = 0; x < rowSize; x++) {
+					const int32_t a = (x >= channels) ? current[x - channels] : 0;
+					const int32_t b = previous[x];
+					const int32_t c = (x >= channels) ? previous[x - channels] : 0;
+					const int32_t p = a + b - c;
+					const int32_t pa = std::abs(p - a);
+					const int32_t pb = std::abs(p - b);
+					const int32_t pc = std::abs(p - c);
+					const int32_t predictor = ((pa <= pb) && (pa <= pc)) ? a : ((pb <= pc) ? b : c);
+					dst[x] = static_cast<uint8_t>(current[x] - predictor);
+				}
+			}
+
+			const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			out.assign(signature, signature + 8);
+
+			uint8_t header[13];
+			detail::writeBigEndian(header, image.width);
+			detail::writeBigEndian(header + 4, image.height);
+			header[8] = 8;								// Bit depth
+			header[9] = (channels == 4) ? 6 : 2;		// Color type (RGBA or RGB)
+			header[10] = 0;								// Compression method
+			header[11] = 0;								// Filter method
+			header[12] = 0;								// No interlacing
+			detail::appendPngChunk(out, "IHDR", header, sizeof(header));
+
+			std::vector<uint8_t> compressed;
+			detail::zlibCompress(filtered.data(), filtered.size(), compressed);
+			detail::appendPngChunk(out, "IDAT", compressed.data(), compressed.size());
+			detail::appendPngChunk(out, "IEND", nullptr, 0);
+		}
+
+		/**
+		* QOI ("Quite OK Image" format), lossless and considerably faster to encode than PNG
+		*
+		* @param channels 3 to drop the alpha channel, 4 to keep it
+		*/
+		inline void encodeQOI(const ImageData& image, std::vector<uint8_t>& out, uint32_t channels = 3)
+		{
+			const uint8_t opIndex = 0x00;
+			const uint8_t opDiff = 0x40;
+			const uint8_t opLuma = 0x80;
+			const uint8_t opRun = 0xC0;
+			const uint8_t opRGB = 0xFE;
+			const uint8_t opRGBA = 0xFF;
+
+			const size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+			// Worst case is one tag byte plus all channels per pixel
+			out.resize(14 + pixelCount * (channels + 1) + 8);
+			uint8_t* dst = out.data();
+			memcpy(dst, "qoif", 4);
+			detail::writeBigEndian(dst + 4, image.width);
+			detail::writeBigEndian(dst + 8, image.height);
+			dst[12] = static_cast<uint8_t>(channels);
+			dst[13] = 0;	// sRGB with linear alpha
+			dst += 14;
+
+			uint8_t index[64][4] = {};
+			uint8_t previous[4] = { 0, 0, 0, 255 };
+			uint32_t run = 0;
+			std::vector<uint8_t> row(static_cast<size_t>(image.width) * 4);
+			for (uint32_t y = 0; y < image.height; y++) {
+				swizzleRow(image.pixels.data() + static_cast<size_t>(y) * image.width * 4, row.data(), image.width, 4, image.bgra);
+				for (uint32_t x = 0; x < image.width; x++) {
+					uint8_t* px = row.data() + x * 4;
+					if (channels == 3) {
+						px[3] = 255;
+					}
+					if (memcmp(px, previous, 4) == 0) {
+						run++;
+						if (run == 62) {
+							*dst++ = static_cast<uint8_t>(opRun | (run - 1));
+							run = 0;
+						}
+						continue;
+					}
+					if (run > 0) {
+						*dst++ = static_cast<uint8_t>(opRun | (run - 1));
+						run = 0;
+					}
+					const uint32_t hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+					if (memcmp(index[hash], px, 4) == 0) {
+						*dst++ = static_cast<uint8_t>(opIndex | hash);
+					} else {
+						memcpy(index[hash], px, 4);
+						if (px[3] == previous[3]) {
+							const int8_t dr = static_cast<int8_t>(px[0] - previous[0]);
+							const int8_t dg = static_cast<int8_t>(px[1] - previous[1]);
+							const int8_t db = static_cast<int8_t>(px[2] - previous[2]);
+							const int8_t drg = static_cast<int8_t>(dr - dg);
+							const int8_t dbg = static_cast<int8_t>(db - dg);
+							if ((dr > -3) && (dr < 2) && (dg > -3) && (dg < 2) && (db > -3) && (db < 2)) {
+								*dst++ = static_cast<uint8_t>(opDiff | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+							} else if ((drg > -9) && (drg < 8) && (dg > -33) && (dg < 32) && (dbg > -9) && (dbg < 8)) {
+								*dst++ = static_cast<uint8_t>(opLuma | (dg + 32));
+								*dst++ = static_cast<uint8_t>(((drg + 8) << 4) | (dbg + 8));
+							} else {
+								*dst++ = opRGB;
+								*dst++ = px[0];
+								*dst++ = px[1];
+								*dst++ = px[2];
+							}
+						} else {
+							*dst++ = opRGBA;
+							memcpy(dst, px, 4);
+							dst += 4;
+						}
+					}
+					memcpy(previous, px, 4);
+				}
+			}
+			if (run > 0) {
+				*dst++ = static_cast<uint8_t>(opRun | (run - 1));
+			}
+			const uint8_t end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+			memcpy(dst, end, sizeof(end));
+			dst += sizeof(end);
+			out.resize(static_cast<size_t>(dst - out.data()));
+		}
+
+		/** @brief Encode the image in the given format */
+		inline void encode(const ImageData& image, FileFormat format, std::vector<uint8_t>& out)
+		{
+			switch (format) {
+			case FileFormat::PPM:
+				encodePPM(image, out);
+				break;
+			case FileFormat::QOI:
+				encodeQOI(image, out);
+				break;
+			default:
+				encodePNG(image, out);
+			}
+		}
+
+		/** @return False if the file could not be written */
+		inline bool writeFile(const std::string& filename, const std::vector<uint8_t>& data)
+		{
+			std::ofstream file(filename, std::ios::out | std::ios::binary);
+			if (!file.is_open()) {
+				return false;
+			}
+			file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+			return file.good();
+		}
+
+		/** @brief Encode the image in the format matching the file name and write it with a single write call */
+		inline bool writeImageFile(const std::string& filename, const ImageData& image)
+		{
+			std::vector<uint8_t> encoded;
+			encode(image, getFileFormat(filename), encoded);
+			return writeFile(filename, encoded);
+		}
+	}
+
+	/**
+	* @brief Encodes and writes images as jobs on a job system
+	* @note write() blocks if maxPending images are already waiting to be written, limiting the memory held by the queue
+	* @note Images have to be queued and flushed from the thread that created the job system
+	*/
+	class ImageWriter
+	{
+	public:
+		/**
+		* @param jobSystem Job system the images are encoded on (e.g. the device's shared one), nullptr to create one with a single worker thread that is owned by the writer
+		* @param maxPending Number of images that may wait to be written before write() blocks
+		*/
+		explicit ImageWriter(JobSystem* jobSystem = nullptr, uint32_t maxPending = 4) : jobSystem(jobSystem), maxPending(std::max(maxPending, 1u))
+		{
+			if (this->jobSystem == nullptr) {
+				ownedJobSystem.reset(new JobSystem(1));
+				this->jobSystem = ownedJobSystem.get();
+			}
+		}
+
+		~ImageWriter()
+		{
+			flush();
+		}
+
+		ImageWriter(const ImageWriter&) = delete;
+		ImageWriter& operator=(const ImageWriter&) = delete;
+
+		/** @brief Queue the image for encoding, the format is selected by the file name's extension */
+		void write(const std::string& filename, image::ImageData&& image)
+		{
+			while (!jobs.empty() && jobSystem->isDone(jobs.front())) {
+				jobs.pop_front();
+			}
+			// Each job writes the oldest queued image, so waiting for the oldest job frees a place in the queue
+			while (jobs.size() >= maxPending) {
+				jobSystem->wait(jobs.front());
+				jobs.pop_front();
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				queue.push_back({ filename, std::move(image) });
+			}
+			jobs.push_back(jobSystem->schedule([this]() { writeNext(); }));
+		}
+
+		/** @brief Wait until all queued images have been written, the calling thread helps encoding meanwhile */
+		void flush()
+		{
+			for (const JobHandle& job : jobs) {
+				jobSystem->wait(job);
+			}
+			jobs.clear();
+		}
+
+		/** @return Number of images that could not be written */
+		uint32_t getFailedCount()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return failed;
+		}
+
+	private:
+		struct Request
+		{
+			std::string filename;
+			image::ImageData image;
+		};
+
+		std::unique_ptr<JobSystem> ownedJobSystem;
+		JobSystem* jobSystem;
+		/** @brief Jobs of the queued images, only accessed by the thread that queues images */
+		std::deque<JobHandle> jobs;
+		std::deque<Request> queue;
+		std::mutex mutex;
+		uint32_t maxPending;
+		uint32_t failed = 0;
+
+		void writeNext()
+		{
+			Request request;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				request = std::move(queue.front());
+				queue.pop_front();
+			}
+			if (!image::writeImageFile(request.filename, request.image)) {
+				std::cerr << "Could not write image file \"" << request.filename << "\"" << std::endl;
+				std::lock_guard<std::mutex> lock(mutex);
+				failed++;
+			}
+		}
+	};
+}
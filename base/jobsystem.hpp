@@ -0,0 +1,552 @@
+/*
+* Work stealing job system
+*
+* Each thread owns a lock-free deque of jobs, idle threads steal jobs from the other threads' deques
+* Jobs store their function inline, so scheduling a job never allocates memory
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace vks
+{
+	/** @brief Unit of work executed by the job system */
+	struct Job
+	{
+		/** @brief Size of the inline storage for the job's function (including its captures) */
+		static const size_t storageSize = 64;
+		/** @brief Maximum number of jobs that can depend on a single job */
+		static const uint32_t maxContinuations = 8;
+
+		typename std::aligned_storage<storageSize, alignof(std::max_align_t)>::type storage;
+		void (*invoke)(void* function) = nullptr;
+		void (*destroy)(void* function) = nullptr;
+		/** @brief Job that waits for this job to finish (fork/join), may be null */
+		Job* parent = nullptr;
+		/** @brief The job itself plus its unfinished child jobs, the job has finished once this reaches zero */
+		std::atomic<int32_t> unfinished{ 0 };
+		/** @brief Number of unfinished dependencies, the job is pushed to a deque once this reaches zero */
+		std::atomic<int32_t> pendingDependencies{ 0 };
+		/** @brief Incremented each time the job slot is reused, so handles to a previous job of the slot report it as finished */
+		std::atomic<uint32_t> generation{ 0 };
+		/** @brief Set once the job has finished and notified its continuations and parent, the slot may then be reused */
+		std::atomic<bool> released{ true };
+		/** @brief Spin lock protecting completed and the continuations */
+		std::atomic<bool> locked{ false };
+		bool completed = true;
+		uint32_t continuationCount = 0;
+		/** @brief Jobs waiting for this job to finish */
+		Job* continuations[maxContinuations];
+	};
+
+	/** @brief Reference to a scheduled job, can be waited on or used as a dependency */
+	struct JobHandle
+	{
+		Job* job = nullptr;
+		uint32_t generation = 0;
+	};
+
+	/**
+	* @brief Fixed size lock-free work stealing deque (Chase-Lev)
+	* @note Only the owning thread may push and pop (at the bottom), all other threads steal from the top
+	*/
+	class JobDeque
+	{
+	public:
+		static const int64_t capacity = 4096;
+
+		/** @return False if the deque is full */
+		bool push(Job* job)
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed);
+			const int64_t t = top.load(std::memory_order_acquire);
+			if (b - t >= capacity) {
+				return false;
+			}
+			jobs[b & (capacity - 1)].store(job, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		/** @return Most recently pushed job, or null if the deque is empty */
+		Job* pop()
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+			if (t > b) {
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			Job* job = jobs[b & (capacity - 1)].load(std::memory_order_relaxed);
+			if (t == b) {
+				// Last job in the deque, race against concurrent steals
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					job = nullptr;
+				}
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		/** @return Oldest job, or null if the deque is empty or another thread won the race for it */
+		Job* steal()
+		{
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t b = bottom.load(std::memory_order_acquire);
+			if (t >= b) {
+				return nullptr;
+			}
+			Job* job = jobs[t & (capacity - 1)].load(std::memory_order_relaxed);
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				return nullptr;
+			}
+			return job;
+		}
+
+	private:
+		// Padding keeps top (written by thieves) and bottom (written by the owner) on separate cache lines
+		std::atomic<int64_t> top{ 0 };
+		char paddingTop[64 - sizeof(std::atomic<int64_t>)];
+		std::atomic<int64_t> bottom{ 0 };
+		char paddingBottom[64 - sizeof(std::atomic<int64_t>)];
+		std::atomic<Job*> jobs[capacity];
+	};
+
+	/**
+	* @brief Work stealing job system replacing a fixed thread per job queue setup
+	* @note The thread creating the job system takes part in executing jobs while it waits, it has thread index 0, worker threads use 1 .. getThreadCount() - 1
+	* @note Jobs may only be scheduled from the creating thread or from within jobs
+	* @note All scheduled jobs must have been waited for before the job system is destroyed
+	* @note Job systems may be nested and used in any order from the thread that created them (e.g. a long-lived loader job system next to one owned by a sample), each one has to be destroyed on the thread that created it
+	*/
+	class JobSystem
+	{
+	public:
+		/** @brief Number of job slots per thread, slots are reused round robin once their job has finished */
+		static const uint32_t jobPoolSize = 4096;
+
+		/** @param workerCount Number of worker threads to start in addition to the calling thread */
+		explicit JobSystem(uint32_t workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1)
+		{
+			threads.resize(workerCount + 1);
+			for (uint32_t i = 0; i < threads.size(); i++) {
+				threads[i].reset(new ThreadState());
+				threads[i]->jobs.reset(new Job[jobPoolSize]);
+				threads[i]->randomState = 0x9E3779B9u * (i + 1);
+			}
+			// Job systems may be nested (e.g. a loader creating its own), the creating thread's previous context is restored on destruction
+			ownerStack().push_back({ this, threadContext() });
+			threadContext() = { this, 0, nullptr };
+			creatorThread = std::this_thread::get_id();
+			for (uint32_t i = 1; i < threads.size(); i++) {
+				threads[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+			}
+		}
+
+		~JobSystem()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				stopping = true;
+			}
+			wakeCondition.notify_all();
+			for (uint32_t i = 1; i < threads.size(); i++) {
+				threads[i]->thread.join();
+			}
+			// Unlink this system from the creating thread's stack, if it isn't the innermost one the system created after it inherits its previous context
+			std::vector<Owner>& owners = ownerStack();
+			auto owner = std::find_if(owners.begin(), owners.end(), [this](const Owner& entry) { return entry.system == this; });
+			assert(owner != owners.end());
+			if (owner + 1 == owners.end()) {
+				threadContext() = owner->previous;
+			}
+			else {
+				(owner + 1)->previous = owner->previous;
+			}
+			owners.erase(owner);
+		}
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		/** @return Number of threads executing jobs, including the thread that created the job system */
+		uint32_t getThreadCount() const
+		{
+			return static_cast<uint32_t>(threads.size());
+		}
+
+		/**
+		* Get the index of the calling thread, e.g. to select per-thread resources like command pools from within a job
+		*
+		* @return Index in the range 0 .. getThreadCount() - 1
+		*/
+		uint32_t getThreadIndex() const
+		{
+			const ThreadContext& context = threadContext();
+			if (context.system == this) {
+				return context.index;
+			}
+			// The creating thread may have created other job systems since, it keeps index 0 in this one
+			assert(std::this_thread::get_id() == creatorThread);
+			return 0;
+		}
+
+		/**
+		* Schedule a job
+		*
+		* @param function Callable without arguments, its size must not exceed Job::storageSize
+		* @param dependencies Jobs that have to finish before this job is started
+		*
+		* @return Handle that can be waited on or passed as a dependency to other jobs
+		*/
+		template<typename F>
+		JobHandle schedule(F&& function, std::initializer_list<JobHandle> dependencies = {})
+		{
+			Job* job = allocate(std::forward<F>(function));
+			const JobHandle handle{ job, job->generation.load() };
+			for (const JobHandle& dependency : dependencies) {
+				// Count the dependency first, as it may finish and decrement the counter as soon as the continuation has been added
+				job->pendingDependencies.fetch_add(1);
+				if (!addContinuation(dependency, job)) {
+					job->pendingDependencies.fetch_sub(1);
+				}
+			}
+			// Drop the reference that kept the job from starting while its dependencies were added
+			if (job->pendingDependencies.fetch_sub(1) == 1) {
+				submit(job);
+			}
+			return handle;
+		}
+
+		/** @return True if the job (including all child jobs it has spawned) has finished */
+		bool isDone(JobHandle handle) const
+		{
+			if (handle.job == nullptr) {
+				return true;
+			}
+			// Generation is incremented before a slot is reused, so checking it after reading the counter detects reuse in between
+			const int32_t unfinished = handle.job->unfinished.load();
+			return (unfinished == 0) || (handle.job->generation.load() != handle.generation);
+		}
+
+		/** @brief Wait for a job to finish, the calling thread executes other jobs while waiting */
+		void wait(JobHandle handle)
+		{
+			const uint32_t index = getThreadIndex();
+			while (!isDone(handle)) {
+				if (!executeNext(index)) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		/**
+		* Call a function for all indices in [0, count) in parallel and wait for it to finish
+		*
+		* @param count Number of indices
+		* @param grainSize Ranges are split in halves until they contain no more than this many indices
+		* @param function Callable taking a range as (uint32_t begin, uint32_t end)
+		*
+		* @note Halves are split off recursively, so idle threads steal large ranges first and the work is spread without a central queue
+		*/
+		template<typename F>
+		void parallelFor(uint32_t count, uint32_t grainSize, const F& function)
+		{
+			if (count == 0) {
+				return;
+			}
+			wait(schedule(RangeJob<F>{ this, &function, 0, count, std::max(grainSize, 1u) }));
+		}
+
+	private:
+		struct ThreadState
+		{
+			JobDeque deque;
+			std::unique_ptr<Job[]> jobs;
+			uint32_t nextJob = 0;
+			uint32_t randomState = 1;
+			std::thread thread;
+		};
+
+		struct ThreadContext
+		{
+			JobSystem* system = nullptr;
+			uint32_t index = 0;
+			/** @brief Job currently executed by the thread, parent for jobs spawned by parallelFor */
+			Job* job = nullptr;
+		};
+
+		/** @brief Job system created on a thread along with the thread's context before it was created */
+		struct Owner
+		{
+			JobSystem* system = nullptr;
+			ThreadContext previous;
+		};
+
+		template<typename F>
+		struct RangeJob
+		{
+			JobSystem* system;
+			const F* function;
+			uint32_t begin;
+			uint32_t end;
+			uint32_t grainSize;
+
+			void operator()() const
+			{
+				uint32_t rangeEnd = end;
+				// Split off the upper half until the remaining range fits into the grain size
+				while (rangeEnd - begin > grainSize) {
+					const uint32_t mid = begin + (rangeEnd - begin) / 2;
+					system->spawnChild(RangeJob<F>{ system, function, mid, rangeEnd, grainSize });
+					rangeEnd = mid;
+				}
+				(*function)(begin, rangeEnd);
+			}
+		};
+
+		std::vector<std::unique_ptr<ThreadState>> threads;
+		/** @brief Number of jobs in all deques, workers go to sleep if there are none */
+		std::atomic<int32_t> queuedJobs{ 0 };
+		std::atomic<uint32_t> sleepingWorkers{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable wakeCondition;
+		bool stopping = false;
+		std::thread::id creatorThread;
+
+		static ThreadContext& threadContext()
+		{
+			thread_local ThreadContext context;
+			return context;
+		}
+
+		/** @brief Job systems created on the calling thread that haven't been destroyed yet, in order of creation */
+		static std::vector<Owner>& ownerStack()
+		{
+			thread_local std::vector<Owner> owners;
+			return owners;
+		}
+
+		template<typename Function>
+		static void invokeFunction(void* function)
+		{
+			(*static_cast<Function*>(function))();
+		}
+
+		template<typename Function>
+		static void destroyFunction(void* function)
+		{
+			static_cast<Function*>(function)->~Function();
+		}
+
+		static void lockJob(Job* job)
+		{
+			while (job->locked.exchange(true, std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+		}
+
+		static void unlockJob(Job* job)
+		{
+			job->locked.store(false, std::memory_order_release);
+		}
+
+		template<typename F>
+		Job* allocate(F&& function)
+		{
+			typedef typename std::decay<F>::type Function;
+			static_assert(sizeof(Function) <= Job::storageSize, "Job function exceeds the inline job storage, capture less or capture by reference");
+			static_assert(alignof(Function) <= alignof(std::max_align_t), "Job function alignment not supported");
+
+			const uint32_t index = getThreadIndex();
+			ThreadState& state = *threads[index];
+			// Skip slots of jobs that are still running (e.g. a job waiting further up this thread's stack)
+			Job* job = nullptr;
+			while (job == nullptr) {
+				for (uint32_t i = 0; (i < jobPoolSize) && (job == nullptr); i++) {
+					Job* slot = &state.jobs[state.nextJob++ & (jobPoolSize - 1)];
+					if (slot->released.load(std::memory_order_acquire)) {
+						job = slot;
+					}
+				}
+				// All slots in use, help finishing other jobs until one has been released
+				if ((job == nullptr) && !executeNext(index)) {
+					std::this_thread::yield();
+				}
+			}
+			job->released.store(false, std::memory_order_relaxed);
+			job->generation.fetch_add(1);
+			lockJob(job);
+			job->completed = false;
+			job->continuationCount = 0;
+			unlockJob(job);
+			job->parent = nullptr;
+			job->unfinished.store(1);
+			job->pendingDependencies.store(1);
+			new (&job->storage) Function(std::forward<F>(function));
+			job->invoke = &invokeFunction<Function>;
+			job->destroy = &destroyFunction<Function>;
+			return job;
+		}
+
+		/** @return False if the dependency has already finished */
+		bool addContinuation(JobHandle dependency, Job* job)
+		{
+			if (dependency.job == nullptr) {
+				return false;
+			}
+			Job* target = dependency.job;
+			lockJob(target);
+			if ((target->generation.load() != dependency.generation) || target->completed) {
+				unlockJob(target);
+				return false;
+			}
+			if (target->continuationCount < Job::maxContinuations) {
+				target->continuations[target->continuationCount++] = job;
+				unlockJob(target);
+				return true;
+			}
+			unlockJob(target);
+			// Continuation list is full, resolve the dependency right away
+			wait(dependency);
+			return false;
+		}
+
+		/** @brief Start a child job of the job currently executed by the calling thread, the parent doesn't finish before its children */
+		template<typename F>
+		void spawnChild(F&& function)
+		{
+			Job* parent = threadContext().job;
+			Job* job = allocate(std::forward<F>(function));
+			if (parent != nullptr) {
+				parent->unfinished.fetch_add(1);
+				job->parent = parent;
+			}
+			job->pendingDependencies.store(0);
+			submit(job);
+		}
+
+		void submit(Job* job)
+		{
+			const uint32_t index = getThreadIndex();
+			queuedJobs.fetch_add(1);
+			if (!threads[index]->deque.push(job)) {
+				// Deque is full, run the job right away instead
+				queuedJobs.fetch_sub(1);
+				execute(job);
+				return;
+			}
+			if (sleepingWorkers.load() > 0) {
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				wakeCondition.notify_one();
+			}
+		}
+
+		void execute(Job* job)
+		{
+			ThreadContext& context = threadContext();
+			Job* previous = context.job;
+			context.job = job;
+			job->invoke(&job->storage);
+			job->destroy(&job->storage);
+			context.job = previous;
+			finish(job);
+		}
+
+		void finish(Job* job)
+		{
+			while (job != nullptr) {
+				if (job->unfinished.fetch_sub(1) != 1) {
+					return;
+				}
+				Job* continuations[Job::maxContinuations];
+				lockJob(job);
+				job->completed = true;
+				const uint32_t continuationCount = job->continuationCount;
+				std::copy(job->continuations, job->continuations + continuationCount, continuations);
+				unlockJob(job);
+				for (uint32_t i = 0; i < continuationCount; i++) {
+					if (continuations[i]->pendingDependencies.fetch_sub(1) == 1) {
+						submit(continuations[i]);
+					}
+				}
+				Job* parent = job->parent;
+				job->released.store(true, std::memory_order_release);
+				job = parent;
+			}
+		}
+
+		/** @brief Execute a job from the thread's own deque or steal one from another thread */
+		bool executeNext(uint32_t index)
+		{
+			Job* job = threads[index]->deque.pop();
+			if (job == nullptr) {
+				// Start at a random victim so thieves spread across the other threads
+				uint32_t& random = threads[index]->randomState;
+				random ^= random << 13;
+				random ^= random >> 17;
+				random ^= random << 5;
+				const uint32_t count = getThreadCount();
+				for (uint32_t i = 0; (i < count) && (job == nullptr); i++) {
+					const uint32_t victim = (random + i) % count;
+					if (victim != index) {
+						job = threads[victim]->deque.steal();
+					}
+				}
+			}
+			if (job == nullptr) {
+				return false;
+			}
+			queuedJobs.fetch_sub(1);
+			execute(job);
+			return true;
+		}
+
+		void workerLoop(uint32_t index)
+		{
+			threadContext() = { this, index, nullptr };
+			while (true) {
+				// Spin for a while before going to sleep, new jobs usually arrive in bursts
+				bool executed = false;
+				for (uint32_t i = 0; (i < 64) && !executed; i++) {
+					executed = executeNext(index);
+					if (!executed) {
+						std::this_thread::yield();
+					}
+				}
+				if (executed) {
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				sleepingWorkers.fetch_add(1);
+				wakeCondition.wait(lock, [this] { return stopping || (queuedJobs.load() > 0); });
+				sleepingWorkers.fetch_sub(1);
+				if (stopping) {
+					return;
+				}
+			}
+		}
+	};
+}
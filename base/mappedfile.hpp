@@ -0,0 +1,140 @@
+/*
+* Read-only memory mapped file
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vks
+{
+	/**
+	* @brief Maps a whole file into the address space for reading, so its contents can be used (e.g. copied to a staging buffer) without reading them into an intermediate buffer first
+	* @note Only works for regular files, not for assets packed into an Android apk
+	*/
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile()
+		{
+			close();
+		}
+
+		/** @return False if the file doesn't exist, is empty or can't be mapped */
+		bool open(const std::string& filename)
+		{
+			close();
+#if defined(_WIN32)
+			file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || (fileSize.QuadPart == 0)) {
+				close();
+				return false;
+			}
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!mapping) {
+				close();
+				return false;
+			}
+			mapped = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			if (!mapped) {
+				close();
+				return false;
+			}
+			mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+			file = ::open(filename.c_str(), O_RDONLY);
+			if (file < 0) {
+				return false;
+			}
+			struct stat fileStat;
+			if ((fstat(file, &fileStat) != 0) || (fileStat.st_size == 0)) {
+				close();
+				return false;
+			}
+			void* address = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			if (address == MAP_FAILED) {
+				close();
+				return false;
+			}
+			mapped = static_cast<const uint8_t*>(address);
+			mappedSize = static_cast<size_t>(fileStat.st_size);
+			// Contents are usually read front to back
+			madvise(address, mappedSize, MADV_SEQUENTIAL);
+#endif
+			return true;
+		}
+
+		void close()
+		{
+#if defined(_WIN32)
+			if (mapped) {
+				UnmapViewOfFile(mapped);
+			}
+			if (mapping) {
+				CloseHandle(mapping);
+			}
+			if (file != INVALID_HANDLE_VALUE) {
+				CloseHandle(file);
+			}
+			mapping = nullptr;
+			file = INVALID_HANDLE_VALUE;
+#else
+			if (mapped) {
+				munmap(const_cast<uint8_t*>(mapped), mappedSize);
+			}
+			if (file >= 0) {
+				::close(file);
+			}
+			file = -1;
+#endif
+			mapped = nullptr;
+			mappedSize = 0;
+		}
+
+		const uint8_t* data() const
+		{
+			return mapped;
+		}
+
+		size_t size() const
+		{
+			return mappedSize;
+		}
+
+	private:
+		const uint8_t* mapped = nullptr;
+		size_t mappedSize = 0;
+#if defined(_WIN32)
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#else
+		int file = -1;
+#endif
+	};
+}
@@ -0,0 +1,421 @@
+/*
+* Mesh optimization
+*
+* CPU only functions for reordering indexed triangle lists: vertex deduplication, post-transform vertex cache
+* optimization (Tom Forsyth's linear-speed algorithm), overdraw optimization (clustering based on Sander et al.,
+* "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw") and vertex fetch reordering
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace vks
+{
+	namespace meshoptimizer
+	{
+		/** @brief Marks vertices that are not referenced by the index data in a remap table */
+		const uint32_t unusedVertex = ~0u;
+
+		struct VertexCacheStatistics
+		{
+			uint32_t verticesTransformed = 0;
+			/** @brief Average cache miss ratio, transformed vertices per triangle (3.0 = no reuse, ~0.5 = optimal for regular meshes) */
+			float acmr = 0.0f;
+			/** @brief Average transform to vertex ratio, transformed vertices per vertex (1.0 = optimal) */
+			float atvr = 0.0f;
+		};
+
+		/**
+		* @brief Simulates a FIFO post-transform vertex cache for the given triangle list
+		* @param cacheSize Number of vertices in the simulated cache
+		*/
+		inline VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16)
+		{
+			VertexCacheStatistics result;
+			// A vertex is in the cache if less than cacheSize vertices have been transformed since it was transformed
+			std::vector<uint32_t> timestamps(vertexCount, 0);
+			uint32_t timestamp = cacheSize + 1;
+			for (size_t i = 0; i < indexCount; i++) {
+				const uint32_t index = indices[i];
+				if (timestamp - timestamps[index] > cacheSize) {
+					timestamps[index] = timestamp++;
+					result.verticesTransformed++;
+				}
+			}
+			if (indexCount >= 3) {
+				result.acmr = static_cast<float>(result.verticesTransformed) / static_cast<float>(indexCount / 3);
+			}
+			if (vertexCount > 0) {
+				result.atvr = static_cast<float>(result.verticesTransformed) / static_cast<float>(vertexCount);
+			}
+			return result;
+		}
+
+		/**
+		* @brief Generates a remap table that maps binary identical vertices to the same new index
+		* @param remap Receives the new index of each vertex (unusedVertex for vertices not referenced by the indices), has to hold vertexCount entries
+		* @return Number of unique vertices
+		*/
+		inline size_t generateVertexRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize)
+		{
+			std::fill(remap, remap + vertexCount, unusedVertex);
+			const unsigned char* vertexData = static_cast<const unsigned char*>(vertices);
+			// Open addressing hash table storing the first vertex of each unique value
+			size_t tableSize = 16;
+			while (tableSize < vertexCount * 2) {
+				tableSize *= 2;
+			}
+			const size_t tableMask = tableSize - 1;
+			std::vector<uint32_t> table(tableSize, unusedVertex);
+			size_t uniqueCount = 0;
+			for (size_t i = 0; i < indexCount; i++) {
+				const uint32_t index = indices[i];
+				if (remap[index] != unusedVertex) {
+					continue;
+				}
+				const unsigned char* vertex = vertexData + index * vertexSize;
+				// FNV-1a
+				uint32_t hash = 2166136261u;
+				for (size_t b = 0; b < vertexSize; b++) {
+					hash = (hash ^ vertex[b]) * 16777619u;
+				}
+				size_t slot = hash & tableMask;
+				while ((table[slot] != unusedVertex) && (memcmp(vertexData + table[slot] * vertexSize, vertex, vertexSize) != 0)) {
+					slot = (slot + 1) & tableMask;
+				}
+				if (table[slot] == unusedVertex) {
+					table[slot] = index;
+					remap[index] = static_cast<uint32_t>(uniqueCount++);
+				} else {
+					remap[index] = remap[table[slot]];
+				}
+			}
+			return uniqueCount;
+		}
+
+		/** @brief Generates a remap table that orders vertices by their first use in the index data, so vertex fetches access memory (mostly) sequentially */
+		inline size_t optimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+		{
+			std::fill(remap, remap + vertexCount, unusedVertex);
+			size_t nextVertex = 0;
+			for (size_t i = 0; i < indexCount; i++) {
+				if (remap[indices[i]] == unusedVertex) {
+					remap[indices[i]] = static_cast<uint32_t>(nextVertex++);
+				}
+			}
+			return nextVertex;
+		}
+
+		/** @brief Moves the vertices to the positions given by a remap table, unused vertices are dropped */
+		inline void remapVertexBuffer(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize, const uint32_t* remap)
+		{
+			unsigned char* dst = static_cast<unsigned char*>(destination);
+			const unsigned char* src = static_cast<const unsigned char*>(vertices);
+			for (size_t i = 0; i < vertexCount; i++) {
+				if (remap[i] != unusedVertex) {
+					memcpy(dst + remap[i] * vertexSize, src + i * vertexSize, vertexSize);
+				}
+			}
+		}
+
+		/** @brief Rewrites the indices using a remap table, destination may be the same as indices */
+		inline void remapIndexBuffer(uint32_t* destination, const uint32_t* indices, size_t indexCount, const uint32_t* remap)
+		{
+			for (size_t i = 0; i < indexCount; i++) {
+				destination[i] = remap[indices[i]];
+			}
+		}
+
+		namespace detail
+		{
+			const uint32_t forsythCacheSize = 32;
+
+			inline float forsythVertexScore(int32_t cachePosition, uint32_t remainingTriangles)
+			{
+				if (remainingTriangles == 0) {
+					return -1.0f;
+				}
+				float score = 0.0f;
+				if (cachePosition >= 0) {
+					if (cachePosition < 3) {
+						// Vertices of the last triangle get a fixed score, so the next triangle doesn't simply reuse the same edge
+						score = 0.75f;
+					} else {
+						score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / static_cast<float>(forsythCacheSize - 3), 1.5f);
+					}
+				}
+				// Prefer vertices with few remaining triangles, so no lone triangles are left behind
+				score += 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+				return score;
+			}
+		}
+
+		/**
+		* @brief Reorders the triangles for post-transform vertex cache locality
+		* @note The algorithm doesn't depend on the exact cache size of the hardware, destination must not be the same as indices
+		*/
+		inline void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+		{
+			const size_t triangleCount = indexCount / 3;
+			if (triangleCount == 0) {
+				return;
+			}
+
+			// Triangles using each vertex, the first remainingTriangles[v] entries of a vertex are the triangles not emitted yet
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			for (size_t i = 0; i < triangleCount * 3; i++) {
+				adjacencyOffsets[indices[i] + 1]++;
+			}
+			for (size_t v = 0; v < vertexCount; v++) {
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+			}
+			std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+			std::vector<uint32_t> adjacency(triangleCount * 3);
+			for (size_t i = 0; i < triangleCount * 3; i++) {
+				const uint32_t v = indices[i];
+				adjacency[adjacencyOffsets[v] + remainingTriangles[v]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			std::vector<int32_t> cachePositions(vertexCount, -1);
+			std::vector<float> vertexScores(vertexCount);
+			for (size_t v = 0; v < vertexCount; v++) {
+				vertexScores[v] = detail::forsythVertexScore(-1, remainingTriangles[v]);
+			}
+			std::vector<float> triangleScores(triangleCount);
+			for (size_t t = 0; t < triangleCount; t++) {
+				triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+			}
+			std::vector<bool> emitted(triangleCount, false);
+
+			// Updates the score of a vertex and the triangles still using it
+			auto updateScore = [&](uint32_t v) {
+				const float score = detail::forsythVertexScore(cachePositions[v], remainingTriangles[v]);
+				const float delta = score - vertexScores[v];
+				vertexScores[v] = score;
+				for (uint32_t i = 0; i < remainingTriangles[v]; i++) {
+					triangleScores[adjacency[adjacencyOffsets[v] + i]] += delta;
+				}
+			};
+
+			uint32_t cache[detail::forsythCacheSize + 3];
+			uint32_t newCache[detail::forsythCacheSize + 3];
+			uint32_t cacheCount = 0;
+			// Triangles in input order are used as a fallback if no triangle uses a vertex in the cache
+			size_t inputCursor = 0;
+			int64_t bestTriangle = 0;
+			for (size_t t = 1; t < triangleCount; t++) {
+				if (triangleScores[t] > triangleScores[bestTriangle]) {
+					bestTriangle = static_cast<int64_t>(t);
+				}
+			}
+
+			for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+				if (bestTriangle < 0) {
+					while (emitted[inputCursor]) {
+						inputCursor++;
+					}
+					bestTriangle = static_cast<int64_t>(inputCursor);
+				}
+				const uint32_t triangle = static_cast<uint32_t>(bestTriangle);
+				const uint32_t* triangleIndices = &indices[triangle * 3];
+				memcpy(&destination[emittedCount * 3], triangleIndices, sizeof(uint32_t) * 3);
+				emitted[triangle] = true;
+
+				// Remove the triangle from the adjacency of its vertices
+				for (uint32_t k = 0; k < 3; k++) {
+					const uint32_t v = triangleIndices[k];
+					uint32_t* vertexTriangles = &adjacency[adjacencyOffsets[v]];
+					for (uint32_t i = 0; i < remainingTriangles[v]; i++) {
+						if (vertexTriangles[i] == triangle) {
+							std::swap(vertexTriangles[i], vertexTriangles[remainingTriangles[v] - 1]);
+							remainingTriangles[v]--;
+							break;
+						}
+					}
+				}
+
+				// The triangle's vertices move to the front of the LRU cache
+				uint32_t newCacheCount = 0;
+				for (uint32_t k = 0; k < 3; k++) {
+					const uint32_t v = triangleIndices[k];
+					if (std::find(newCache, newCache + newCacheCount, v) == newCache + newCacheCount) {
+						newCache[newCacheCount++] = v;
+					}
+				}
+				for (uint32_t i = 0; i < cacheCount; i++) {
+					const uint32_t v = cache[i];
+					if ((v != triangleIndices[0]) && (v != triangleIndices[1]) && (v != triangleIndices[2])) {
+						newCache[newCacheCount++] = v;
+					}
+				}
+				// Vertices pushed out of the cache
+				for (uint32_t i = detail::forsythCacheSize; i < newCacheCount; i++) {
+					cachePositions[newCache[i]] = -1;
+					updateScore(newCache[i]);
+				}
+				cacheCount = std::min(newCacheCount, detail::forsythCacheSize);
+				memcpy(cache, newCache, sizeof(uint32_t) * cacheCount);
+
+				for (uint32_t i = 0; i < cacheCount; i++) {
+					cachePositions[cache[i]] = static_cast<int32_t>(i);
+					updateScore(cache[i]);
+				}
+
+				// Only triangles using a vertex in the cache changed their score
+				bestTriangle = -1;
+				float bestScore = -1.0f;
+				for (uint32_t i = 0; i < cacheCount; i++) {
+					const uint32_t v = cache[i];
+					for (uint32_t j = 0; j < remainingTriangles[v]; j++) {
+						const uint32_t candidate = adjacency[adjacencyOffsets[v] + j];
+						if (triangleScores[candidate] > bestScore) {
+							bestScore = triangleScores[candidate];
+							bestTriangle = candidate;
+						}
+					}
+				}
+			}
+		}
+
+		/**
+		* @brief Reorders clusters of triangles so outward facing parts of the mesh are drawn first, reducing overdraw
+		* @note Expects triangles already optimized for the vertex cache (optimizeVertexCache), clusters keep that order internally
+		* @param positions Pointer to the first vertex position (three floats), positionStride is the distance between two vertices in bytes
+		* @param threshold Allowed increase of the cache miss ratio (1.05 = 5% worse), larger values create smaller clusters
+		*/
+		inline void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, float threshold = 1.05f)
+		{
+			const size_t triangleCount = indexCount / 3;
+			if (triangleCount == 0) {
+				return;
+			}
+			const uint32_t cacheSize = 16;
+			std::vector<uint32_t> timestamps(vertexCount, 0);
+			uint32_t timestamp = cacheSize + 1;
+			auto cacheMisses = [&](size_t triangle) {
+				uint32_t misses = 0;
+				for (uint32_t k = 0; k < 3; k++) {
+					const uint32_t index = indices[triangle * 3 + k];
+					if (timestamp - timestamps[index] > cacheSize) {
+						timestamps[index] = timestamp++;
+						misses++;
+					}
+				}
+				return misses;
+			};
+			auto flushCache = [&]() {
+				timestamp += cacheSize + 1;
+			};
+
+			// Hard boundaries, the cache optimizer started over (all vertices of the triangle missed the cache)
+			std::vector<uint32_t> hardBoundaries;
+			for (size_t t = 0; t < triangleCount; t++) {
+				if ((cacheMisses(t) == 3) || (t == 0)) {
+					hardBoundaries.push_back(static_cast<uint32_t>(t));
+				}
+			}
+			hardBoundaries.push_back(static_cast<uint32_t>(triangleCount));
+
+			// Soft boundaries, split the hard clusters further as long as the cache miss ratio of each part stays close to the cluster's
+			std::vector<uint32_t> clusters;
+			for (size_t c = 0; c + 1 < hardBoundaries.size(); c++) {
+				const uint32_t start = hardBoundaries[c];
+				const uint32_t end = hardBoundaries[c + 1];
+				flushCache();
+				uint32_t misses = 0;
+				for (uint32_t t = start; t < end; t++) {
+					misses += cacheMisses(t);
+				}
+				const float clusterThreshold = threshold * static_cast<float>(misses) / static_cast<float>(end - start);
+				flushCache();
+				clusters.push_back(start);
+				uint32_t partStart = start;
+				uint32_t partMisses = 0;
+				for (uint32_t t = start; t < end; t++) {
+					partMisses += cacheMisses(t);
+					if ((t + 1 < end) && (static_cast<float>(partMisses) / static_cast<float>(t - partStart + 1) <= clusterThreshold)) {
+						clusters.push_back(t + 1);
+						partStart = t + 1;
+						partMisses = 0;
+						flushCache();
+					}
+				}
+			}
+			clusters.push_back(static_cast<uint32_t>(triangleCount));
+
+			auto position = [&](uint32_t index) {
+				return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + index * positionStride);
+			};
+
+			// Area weighted centroid and normal of each cluster
+			const size_t clusterCount = clusters.size() - 1;
+			std::vector<float> clusterData(clusterCount * 6, 0.0f);
+			float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+			float meshArea = 0.0f;
+			for (size_t c = 0; c < clusterCount; c++) {
+				float* centroid = &clusterData[c * 6];
+				float* normal = &clusterData[c * 6 + 3];
+				float clusterArea = 0.0f;
+				for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++) {
+					const float* p0 = position(indices[t * 3]);
+					const float* p1 = position(indices[t * 3 + 1]);
+					const float* p2 = position(indices[t * 3 + 2]);
+					const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+					const float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+					const float n[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+					const float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					for (uint32_t k = 0; k < 3; k++) {
+						centroid[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * area;
+						normal[k] += n[k];
+					}
+					clusterArea += area;
+				}
+				for (uint32_t k = 0; k < 3; k++) {
+					meshCentroid[k] += centroid[k];
+					centroid[k] = (clusterArea > 0.0f) ? centroid[k] / clusterArea : 0.0f;
+				}
+				meshArea += clusterArea;
+			}
+			for (uint32_t k = 0; k < 3; k++) {
+				meshCentroid[k] = (meshArea > 0.0f) ? meshCentroid[k] / meshArea : 0.0f;
+			}
+
+			// Clusters facing away from the mesh center are likely to occlude other parts of the mesh
+			std::vector<float> sortKeys(clusterCount);
+			for (size_t c = 0; c < clusterCount; c++) {
+				const float* centroid = &clusterData[c * 6];
+				const float* normal = &clusterData[c * 6 + 3];
+				const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+				float key = 0.0f;
+				if (length > 0.0f) {
+					for (uint32_t k = 0; k < 3; k++) {
+						key += (centroid[k] - meshCentroid[k]) * normal[k] / length;
+					}
+				}
+				sortKeys[c] = key;
+			}
+			std::vector<uint32_t> clusterOrder(clusterCount);
+			for (size_t c = 0; c < clusterCount; c++) {
+				clusterOrder[c] = static_cast<uint32_t>(c);
+			}
+			std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+			size_t offset = 0;
+			for (uint32_t c : clusterOrder) {
+				const size_t clusterIndexCount = (clusters[c + 1] - clusters[c]) * 3;
+				memcpy(&destination[offset], &indices[clusters[c] * 3], clusterIndexCount * sizeof(uint32_t));
+				offset += clusterIndexCount;
+			}
+		}
+	}
+}
@@ -0,0 +1,348 @@
+/*
+* Mesh simplification
+*
+* Reduces the triangle count of an indexed triangle list with quadric error metric (Garland and Heckbert) half edge collapses
+* Vertices are never moved or created, so all levels of detail of a mesh can share its vertex data
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace vks
+{
+	namespace meshoptimizer
+	{
+		namespace detail
+		{
+			/** @brief Symmetric 4x4 matrix of the summed squared distances to a set of planes, weighted by triangle area */
+			struct Quadric
+			{
+				double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+				double b2 = 0.0, bc = 0.0, bd = 0.0;
+				double c2 = 0.0, cd = 0.0;
+				double d2 = 0.0;
+				double weight = 0.0;
+
+				void addPlane(double a, double b, double c, double d, double w)
+				{
+					a2 += a * a * w; ab += a * b * w; ac += a * c * w; ad += a * d * w;
+					b2 += b * b * w; bc += b * c * w; bd += b * d * w;
+					c2 += c * c * w; cd += c * d * w;
+					d2 += d * d * w;
+					weight += w;
+				}
+
+				void add(const Quadric& q)
+				{
+					a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+					b2 += q.b2; bc += q.bc; bd += q.bd;
+					c2 += q.c2; cd += q.cd;
+					d2 += q.d2;
+					weight += q.weight;
+				}
+
+				/** @brief Weighted sum of the squared distances of p to the planes (not normalized) */
+				double evaluate(const float* p) const
+				{
+					const double x = p[0], y = p[1], z = p[2];
+					const double r = a2 * x * x + b2 * y * y + c2 * z * z + 2.0 * (ab * x * y + ac * x * z + bc * y * z) + 2.0 * (ad * x + bd * y + cd * z) + d2;
+					return std::abs(r);
+				}
+			};
+
+			/** @brief Mean squared distance of p to the planes of both quadrics */
+			inline double collapseError(const Quadric& a, const Quadric& b, const float* p)
+			{
+				const double weight = a.weight + b.weight;
+				return (weight > 0.0) ? (a.evaluate(p) + b.evaluate(p)) / weight : 0.0;
+			}
+
+			inline void triangleNormal(const float* p0, const float* p1, const float* p2, float* n)
+			{
+				const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				const float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+				n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+				n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+			}
+		}
+
+		/**
+		* @brief Simplifies a triangle list until it reaches the target index count or no collapse stays below the target error
+		* @note Vertices on open borders and on attribute seams (vertices sharing a position) are locked and never removed
+		* @param destination Receives the simplified indices, has to hold indexCount entries, may be the same as indices
+		* @param positions Pointer to the first vertex position (three floats), positionStride is the distance between two vertices in bytes
+		* @param targetError Maximum geometric error (distance to the original surface) in the units of the positions
+		* @param resultError Optionally receives the geometric error of the simplified mesh
+		* @param attributes Optional per vertex attributes (e.g. normals and UVs, attributeCount floats each) that penalize collapses between differing vertices
+		* @param attributeWeights Weight of each attribute, relative to the size of the mesh
+		* @return Number of indices written to destination
+		*/
+		inline size_t simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, size_t targetIndexCount, float targetError,
+			float* resultError = nullptr, const float* attributes = nullptr, size_t attributeStride = 0, const float* attributeWeights = nullptr, size_t attributeCount = 0)
+		{
+			auto position = [&](uint32_t v) {
+				return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + v * positionStride);
+			};
+			auto attribute = [&](uint32_t v) {
+				return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(attributes) + v * attributeStride);
+			};
+
+			memmove(destination, indices, indexCount * sizeof(uint32_t));
+			size_t resultCount = indexCount - indexCount % 3;
+			if (resultError) {
+				*resultError = 0.0f;
+			}
+			if ((resultCount <= targetIndexCount) || (vertexCount == 0)) {
+				return resultCount;
+			}
+
+			// Vertices sharing a position (attribute seams) are mapped to the first one
+			std::vector<uint32_t> positionRemap(vertexCount);
+			{
+				size_t tableSize = 16;
+				while (tableSize < vertexCount * 2) {
+					tableSize *= 2;
+				}
+				std::vector<uint32_t> table(tableSize, ~0u);
+				for (uint32_t v = 0; v < vertexCount; v++) {
+					const float* p = position(v);
+					uint32_t hash = 2166136261u;
+					const unsigned char* bytes = reinterpret_cast<const unsigned char*>(p);
+					for (size_t b = 0; b < sizeof(float) * 3; b++) {
+						hash = (hash ^ bytes[b]) * 16777619u;
+					}
+					size_t slot = hash & (tableSize - 1);
+					while ((table[slot] != ~0u) && (memcmp(position(table[slot]), p, sizeof(float) * 3) != 0)) {
+						slot = (slot + 1) & (tableSize - 1);
+					}
+					if (table[slot] == ~0u) {
+						table[slot] = v;
+					}
+					positionRemap[v] = table[slot];
+				}
+			}
+			// Lock vertices on borders (edges with a single triangle) and seams
+			std::vector<uint8_t> locked(vertexCount, 0);
+			{
+				std::unordered_map<uint64_t, uint32_t> edgeTriangles;
+				edgeTriangles.reserve(resultCount);
+				for (size_t i = 0; i < resultCount; i += 3) {
+					for (uint32_t k = 0; k < 3; k++) {
+						uint64_t a = positionRemap[destination[i + k]];
+						uint64_t b = positionRemap[destination[i + (k + 1) % 3]];
+						edgeTriangles[(std::min(a, b) << 32) | std::max(a, b)]++;
+					}
+				}
+				std::vector<uint8_t> border(vertexCount, 0);
+				for (auto& edge : edgeTriangles) {
+					if (edge.second == 1) {
+						border[static_cast<uint32_t>(edge.first >> 32)] = 1;
+						border[static_cast<uint32_t>(edge.first & 0xffffffffu)] = 1;
+					}
+				}
+				std::vector<uint32_t> wedgeCounts(vertexCount, 0);
+				std::vector<uint8_t> referenced(vertexCount, 0);
+				for (size_t i = 0; i < resultCount; i++) {
+					if (!referenced[destination[i]]) {
+						referenced[destination[i]] = 1;
+						wedgeCounts[positionRemap[destination[i]]]++;
+					}
+				}
+				for (uint32_t v = 0; v < vertexCount; v++) {
+					const uint32_t p = positionRemap[v];
+					locked[v] = border[p] || (wedgeCounts[p] > 1);
+				}
+			}
+
+			// Plane quadrics of the triangles around each vertex
+			std::vector<detail::Quadric> quadrics(vertexCount);
+			float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (size_t i = 0; i < resultCount; i += 3) {
+				const float* p0 = position(destination[i]);
+				float n[3];
+				detail::triangleNormal(p0, position(destination[i + 1]), position(destination[i + 2]), n);
+				const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				for (uint32_t k = 0; k < 3; k++) {
+					const float* p = position(destination[i + k]);
+					for (uint32_t c = 0; c < 3; c++) {
+						boundsMin[c] = std::min(boundsMin[c], p[c]);
+						boundsMax[c] = std::max(boundsMax[c], p[c]);
+					}
+				}
+				if (length == 0.0f) {
+					continue;
+				}
+				const double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+				const double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+				for (uint32_t k = 0; k < 3; k++) {
+					quadrics[destination[i + k]].addPlane(a, b, c, d, length * 0.5);
+				}
+			}
+			const double extent = std::max(std::max(boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1]), boundsMax[2] - boundsMin[2]);
+			const double attributeScale = extent * extent;
+			const double errorLimit = static_cast<double>(targetError) * static_cast<double>(targetError);
+
+			struct Collapse
+			{
+				uint32_t from;
+				uint32_t to;
+				double cost;
+				double geometricError;
+			};
+			std::vector<Collapse> collapses;
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+			std::vector<uint32_t> adjacency;
+			std::vector<uint8_t> passLocked(vertexCount);
+			double maxError = 0.0;
+
+			while (resultCount > targetIndexCount) {
+				// Triangles using each vertex
+				std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+				for (size_t i = 0; i < resultCount; i++) {
+					adjacencyOffsets[destination[i] + 1]++;
+				}
+				for (size_t v = 0; v < vertexCount; v++) {
+					adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+				}
+				adjacency.resize(resultCount);
+				{
+					std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+					for (size_t i = 0; i < resultCount; i++) {
+						adjacency[fill[destination[i]]++] = static_cast<uint32_t>(i / 3);
+					}
+				}
+
+				// Rank all possible collapses of the current mesh
+				collapses.clear();
+				for (size_t i = 0; i < resultCount; i += 3) {
+					for (uint32_t k = 0; k < 3; k++) {
+						const uint32_t a = destination[i + k];
+						const uint32_t b = destination[i + (k + 1) % 3];
+						for (uint32_t direction = 0; direction < 2; direction++) {
+							const uint32_t from = direction ? b : a;
+							const uint32_t to = direction ? a : b;
+							if (locked[from] || (from == to)) {
+								continue;
+							}
+							Collapse collapse{ from, to, 0.0, detail::collapseError(quadrics[from], quadrics[to], position(to)) };
+							collapse.cost = collapse.geometricError;
+							if (attributes) {
+								const float* fromAttributes = attribute(from);
+								const float* toAttributes = attribute(to);
+								for (size_t j = 0; j < attributeCount; j++) {
+									const double delta = fromAttributes[j] - toAttributes[j];
+									collapse.cost += attributeWeights[j] * delta * delta * attributeScale;
+								}
+							}
+							collapses.push_back(collapse);
+						}
+					}
+				}
+				if (collapses.empty()) {
+					break;
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+				// Apply the cheapest collapses that don't interfere with each other
+				std::fill(passLocked.begin(), passLocked.end(), 0);
+				std::vector<uint32_t> collapseRemap;
+				const size_t trianglesToRemove = (resultCount - targetIndexCount + 2) / 3;
+				size_t trianglesRemoved = 0;
+				size_t applied = 0;
+				for (const Collapse& collapse : collapses) {
+					if (collapse.cost > errorLimit) {
+						break;
+					}
+					if (passLocked[collapse.from] || passLocked[collapse.to]) {
+						continue;
+					}
+					// Reject collapses that flip triangles
+					const float* target = position(collapse.to);
+					bool flipped = false;
+					uint32_t removed = 0;
+					for (uint32_t j = adjacencyOffsets[collapse.from]; j < adjacencyOffsets[collapse.from + 1]; j++) {
+						const uint32_t* triangle = &destination[adjacency[j] * 3];
+						if ((triangle[0] == collapse.to) || (triangle[1] == collapse.to) || (triangle[2] == collapse.to)) {
+							removed++;
+							continue;
+						}
+						const float* p[3];
+						const float* q[3];
+						for (uint32_t k = 0; k < 3; k++) {
+							p[k] = position(triangle[k]);
+							q[k] = (triangle[k] == collapse.from) ? target : p[k];
+						}
+						float before[3], after[3];
+						detail::triangleNormal(p[0], p[1], p[2], before);
+						detail::triangleNormal(q[0], q[1], q[2], after);
+						const float dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+						const float lengths = std::sqrt(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) * std::sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+						if (dot <= 0.25f * lengths) {
+							flipped = true;
+							break;
+						}
+					}
+					if (flipped) {
+						continue;
+					}
+
+					if (collapseRemap.empty()) {
+						collapseRemap.resize(vertexCount);
+						for (uint32_t v = 0; v < vertexCount; v++) {
+							collapseRemap[v] = v;
+						}
+					}
+					collapseRemap[collapse.from] = collapse.to;
+					quadrics[collapse.to].add(quadrics[collapse.from]);
+					maxError = std::max(maxError, collapse.geometricError);
+					// The triangles around the removed vertex change, so their vertices can't be part of another collapse in this pass
+					for (uint32_t j = adjacencyOffsets[collapse.from]; j < adjacencyOffsets[collapse.from + 1]; j++) {
+						const uint32_t* triangle = &destination[adjacency[j] * 3];
+						passLocked[triangle[0]] = passLocked[triangle[1]] = passLocked[triangle[2]] = 1;
+					}
+					trianglesRemoved += removed;
+					applied++;
+					if (trianglesRemoved >= trianglesToRemove) {
+						break;
+					}
+				}
+				if (applied == 0) {
+					break;
+				}
+
+				// Rewrite the indices and drop the triangles that became degenerate
+				size_t writeCount = 0;
+				for (size_t i = 0; i < resultCount; i += 3) {
+					const uint32_t a = collapseRemap[destination[i]];
+					const uint32_t b = collapseRemap[destination[i + 1]];
+					const uint32_t c = collapseRemap[destination[i + 2]];
+					if ((a != b) && (b != c) && (c != a)) {
+						destination[writeCount++] = a;
+						destination[writeCount++] = b;
+						destination[writeCount++] = c;
+					}
+				}
+				resultCount = writeCount;
+			}
+
+			if (resultError) {
+				*resultError = static_cast<float>(std::sqrt(maxError));
+			}
+			return resultCount;
+		}
+	}
+}
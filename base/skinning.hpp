@@ -0,0 +1,152 @@
+/*
+* Vertex skinning
+*
+* CPU only node hierarchy, joint matrix and animation update functions used for glTF vertex skinning
+* These don't depend on Vulkan, so the per-frame update can be run (and tested) without a GPU
+*
+* Copyright (C) 2020-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace vks
+{
+	namespace skinning
+	{
+		/** @brief Transform part of a node that is animated and used to build the world and joint matrices */
+		struct Node
+		{
+			Node*     parent = nullptr;
+			glm::vec3 translation{};
+			glm::vec3 scale{ 1.0f };
+			glm::quat rotation{};
+			glm::mat4 matrix{ 1.0f };
+			/** @brief World matrix of the current animation frame, updated by updateWorldMatrices */
+			glm::mat4 worldMatrix{ 1.0f };
+
+			/** @brief Local matrix from the current (animated) translation, rotation and scale values */
+			glm::mat4 getLocalMatrix() const
+			{
+				return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
+			}
+		};
+
+		struct Skin
+		{
+			std::vector<glm::mat4> inverseBindMatrices;
+			std::vector<Node*>     joints;
+		};
+
+		/** @brief Animation sampler interpolation types, only linear interpolation is applied by updateAnimation */
+		enum class Interpolation { Linear, Step, CubicSpline };
+
+		/** @brief Node property targeted by an animation channel */
+		enum class Path { Translation, Rotation, Scale, Weights };
+
+		struct AnimationSampler
+		{
+			Interpolation          interpolation = Interpolation::Linear;
+			std::vector<float>     inputs;
+			std::vector<glm::vec4> outputsVec4;
+		};
+
+		struct AnimationChannel
+		{
+			Path     path = Path::Translation;
+			Node*    node = nullptr;
+			uint32_t samplerIndex = 0;
+		};
+
+		struct Animation
+		{
+			std::vector<AnimationSampler> samplers;
+			std::vector<AnimationChannel> channels;
+			float                         start = std::numeric_limits<float>::max();
+			float                         end = std::numeric_limits<float>::min();
+			float                         currentTime = 0.0f;
+		};
+
+		/**
+		* Calculate the world matrices of all nodes from their current translation, rotation and scale values
+		*
+		* @param linearNodes Pointers to all nodes with parents stored before their children, so each parent's matrix is already up-to-date when its children are visited
+		*/
+		template <typename NodeType>
+		void updateWorldMatrices(const std::vector<NodeType*>& linearNodes)
+		{
+			for (Node* node : linearNodes) {
+				node->worldMatrix = node->parent ? node->parent->worldMatrix * node->getLocalMatrix() : node->getLocalMatrix();
+			}
+		}
+
+		/**
+		* Calculate the joint matrices of a skinned node from the current world matrices
+		*
+		* @param node Node the skin is attached to
+		* @param skin Skin with the joints and inverse bind matrices
+		* @param jointMatrices Destination for the joint matrices (e.g. a mapped storage buffer), must have room for one matrix per joint
+		*/
+		inline void updateJointMatrices(const Node& node, const Skin& skin, glm::mat4* jointMatrices)
+		{
+			const glm::mat4 inverseTransform = glm::inverse(node.worldMatrix);
+			const size_t numJoints = std::min(skin.joints.size(), skin.inverseBindMatrices.size());
+			for (size_t i = 0; i < numJoints; i++) {
+				jointMatrices[i] = inverseTransform * skin.joints[i]->worldMatrix * skin.inverseBindMatrices[i];
+			}
+		}
+
+		/**
+		* Advance an animation and apply its channels to the target nodes' translation, rotation and scale
+		*
+		* @note Samplers not using linear interpolation are skipped, check the interpolation types at load time
+		*/
+		inline void updateAnimation(Animation& animation, float deltaTime)
+		{
+			animation.currentTime += deltaTime;
+			if (animation.currentTime > animation.end) {
+				animation.currentTime -= animation.end;
+			}
+
+			for (const AnimationChannel& channel : animation.channels) {
+				const AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
+				if (sampler.interpolation != Interpolation::Linear) {
+					continue;
+				}
+				for (size_t i = 0; i + 1 < sampler.inputs.size(); i++) {
+					// Get the input keyframe values for the current time stamp
+					if ((animation.currentTime < sampler.inputs[i]) || (animation.currentTime > sampler.inputs[i + 1])) {
+						continue;
+					}
+					const float a = (animation.currentTime - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
+					const glm::vec4& v1 = sampler.outputsVec4[i];
+					const glm::vec4& v2 = sampler.outputsVec4[i + 1];
+					switch (channel.path) {
+					case Path::Translation:
+						channel.node->translation = glm::mix(v1, v2, a);
+						break;
+					case Path::Rotation:
+						channel.node->rotation = glm::normalize(glm::slerp(glm::quat(v1.w, v1.x, v1.y, v1.z), glm::quat(v2.w, v2.x, v2.y, v2.z), a));
+						break;
+					case Path::Scale:
+						channel.node->scale = glm::mix(v1, v2, a);
+						break;
+					case Path::Weights:
+						break;
+					}
+				}
+			}
+		}
+	}
+}
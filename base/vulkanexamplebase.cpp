@@ -152,10 +152,18 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 
 void VulkanExampleBase::renderFrame()
 {
-	VulkanExampleBase::prepareFrame();
+	if (!VulkanExampleBase::prepareFrame()) {
+		return;
+	}
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	if (useFramesInFlight) {
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentFrame];
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, waitFences[currentFrame]));
+	}
+	else {
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	}
 	VulkanExampleBase::submitFrame();
 }
 
@@ -173,7 +181,8 @@ std::string VulkanExampleBase::getWindowTitle()
 void VulkanExampleBase::createCommandBuffers()
 {
 	// Create one command buffer for each swap chain image and reuse for rendering
-	drawCmdBuffers.resize(swapChain.imageCount);
+	// With frames in flight there is one command buffer per frame instead, which is re-recorded every frame
+	drawCmdBuffers.resize(useFramesInFlight ? maxFramesInFlight : swapChain.imageCount);
 
 	VkCommandBufferAllocateInfo cmdBufAllocateInfo =
 		vks::initializers::commandBufferAllocateInfo(
@@ -182,10 +191,14 @@ void VulkanExampleBase::createCommandBuffers()
 			static_cast<uint32_t>(drawCmdBuffers.size()));
 
 	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, drawCmdBuffers.data()));
+
+	// Timestamps of each command buffer are read back independently
+	gpuProfiler.create(vulkanDevice, queue, static_cast<uint32_t>(drawCmdBuffers.size()));
 }
 
 void VulkanExampleBase::destroyCommandBuffers()
 {
+	gpuProfiler.destroy();
 	vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(drawCmdBuffers.size()), drawCmdBuffers.data());
 }
 
@@ -196,9 +209,23 @@ std::string VulkanExampleBase::getShadersPath() const
 
 void VulkanExampleBase::createPipelineCache()
 {
-	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
-	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+	if (settings.pipelineCache && pipelineCacheFile.filename.empty()) {
+		// Default to a cache file named after the executable
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+		pipelineCacheFile.filename = std::string(androidApp->activity->internalDataPath) + "/pipelinecache.bin";
+#else
+		std::string executableName = args.empty() ? name : args[0];
+		executableName = executableName.substr(executableName.find_last_of("/\\") + 1);
+		if ((executableName.size() > 4) && (executableName.substr(executableName.size() - 4) == ".exe")) {
+			executableName.resize(executableName.size() - 4);
+		}
+		pipelineCacheFile.filename = executableName + ".pipelinecache";
+#endif
+	}
+	if (!settings.pipelineCache) {
+		pipelineCacheFile.filename.clear();
+	}
+	VK_CHECK_RESULT(pipelineCacheFile.create(device, deviceProperties, &pipelineCache));
 }
 
 void VulkanExampleBase::prepare()
@@ -211,6 +238,9 @@ void VulkanExampleBase::prepare()
 	setupDepthStencil();
 	setupRenderPass();
 	createPipelineCache();
+	// Only sets up the builder, its caches are created once an example queues a pipeline
+	// Pipelines built by the builder are created from shader module identifiers if the example enabled them
+	pipelineBuilder.create(vulkanDevice, pipelineCache, &shaderRegistry);
 	setupFrameBuffer();
 	settings.overlay = settings.overlay && (!benchmark.active);
 	if (settings.overlay) {
@@ -221,7 +251,18 @@ void VulkanExampleBase::prepare()
 			loadShader(getShadersPath() + "base/uioverlay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
 		};
 		UIOverlay.prepareResources();
-		UIOverlay.preparePipeline(pipelineCache, renderPass, swapChain.colorFormat, depthFormat);
+		if (useFramesInFlight) {
+			// Command buffers are recorded every frame, so the overlay is drawn within the example's render pass into the per-frame buffers
+			UIOverlay.setFrameCount(maxFramesInFlight);
+			UIOverlay.preparePipeline(pipelineCache, renderPass, swapChain.colorFormat, depthFormat);
+		}
+		else {
+			// The overlay is drawn on top of the resolved swap chain image in a render pass of its own
+			setupOverlayPass();
+			UIOverlay.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+			UIOverlay.subpass = 0;
+			UIOverlay.preparePipeline(pipelineCache, overlayPass.renderPass, swapChain.colorFormat, depthFormat);
+		}
 	}
 }
 
@@ -230,11 +271,8 @@ VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileNa
 	VkPipelineShaderStageCreateInfo shaderStage = {};
 	shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStage.stage = stage;
-#if defined(VK_USE_PLATFORM_ANDROID_KHR)
-	shaderStage.module = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
-#else
-	shaderStage.module = vks::tools::loadShader(fileName.c_str(), device);
-#endif
+	// Files that have been loaded before (e.g. for other pipeline variants) share their module
+	shaderStage.module = shaderRegistry.acquire(fileName);
 	shaderStage.pName = "main";
 	assert(shaderStage.module != VK_NULL_HANDLE);
 	shaderModules.push_back(shaderStage.module);
@@ -289,21 +327,40 @@ void VulkanExampleBase::nextFrame()
 	}
 	tPrevEnd = tEnd;
 	
-	// TODO: Cap UI overlay update rates
+	// Updated outside of the timed frame, so the overlay doesn't add to the measured frame time
 	updateOverlay();
 }
 
+void VulkanExampleBase::runBenchmark()
+{
+	benchmark.gpuProfiler = &gpuProfiler;
+	if (useFramesInFlight && (maxFramesInFlight > 1)) {
+		// Run a first pass with the queue being idle after each frame to report the throughput gained by overlapping frames
+		waitIdleAfterFrame = true;
+		benchmark.framesInFlight = 1;
+		benchmark.run([=] { render(); }, vulkanDevice->properties);
+		vkDeviceWaitIdle(device);
+		benchmark.storeBaseline();
+		waitIdleAfterFrame = false;
+	}
+	benchmark.framesInFlight = useFramesInFlight ? maxFramesInFlight : 1;
+	benchmark.run([=] { render(); }, vulkanDevice->properties);
+	vkDeviceWaitIdle(device);
+	if (benchmark.compareFilename != "") {
+		benchmark.compare();
+	}
+	if (benchmark.filename != "") {
+		benchmark.saveResults();
+	}
+}
+
 void VulkanExampleBase::renderLoop()
 {
 // SRS - for non-apple plaforms, handle benchmarking here within VulkanExampleBase::renderLoop()
 //     - for macOS, handle benchmarking within NSApp rendering loop via displayLinkOutputCb()
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 	if (benchmark.active) {
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
-		vkDeviceWaitIdle(device);
-		if (benchmark.filename != "") {
-			benchmark.saveResults();
-		}
+		runBenchmark();
 		return;
 	}
 #endif
@@ -387,7 +444,6 @@ void VulkanExampleBase::renderLoop()
 				lastTimestamp = tEnd;
 			}
 
-			// TODO: Cap UI overlay update rates/only issue when update requested
 			updateOverlay();
 
 			bool updateView = false;
@@ -668,10 +724,38 @@ void VulkanExampleBase::updateOverlay()
 	if (!settings.overlay)
 		return;
 
+	// The UI is rebuilt at a fixed rate independent of the frame rate, unless input requires an immediate update
+	const auto now = std::chrono::high_resolution_clock::now();
+	const uint32_t overlayMouseButtons = (mouseButtons.left ? 1 : 0) | (mouseButtons.right ? 2 : 0) | (mouseButtons.middle ? 4 : 0);
+	const double elapsed = std::chrono::duration<double>(now - lastOverlayUpdate).count();
+	const bool due = (settings.overlayUpdateRate == 0) || (elapsed >= 1.0 / settings.overlayUpdateRate);
+	if (!due && !overlayUpdatePending && !UIOverlay.updated && (overlayMouseButtons == lastOverlayMouseButtons))
+		return;
+
+	ImGui::GetIO().DeltaTime = overlayUpdatePending ? std::max(frameTimer, 0.001f) : std::max((float)elapsed, 0.001f);
+	lastOverlayUpdate = now;
+	lastOverlayMouseButtons = overlayMouseButtons;
+	overlayUpdatePending = false;
+	updateOverlayFrame();
+
+	if (UIOverlay.updated) {
+		// Widgets may have changed state that is baked into the draw command buffers (with frames in flight, command buffers are recorded every frame anyway)
+		if (!useFramesInFlight) {
+			buildCommandBuffers();
+		}
+		UIOverlay.updated = false;
+	}
+	// With frames in flight the geometry is copied from prepareFrame, once the GPU no longer reads the overlay buffers of the current frame
+	if (!useFramesInFlight) {
+		UIOverlay.update();
+	}
+}
+
+void VulkanExampleBase::updateOverlayFrame()
+{
 	ImGuiIO& io = ImGui::GetIO();
 
 	io.DisplaySize = ImVec2((float)width, (float)height);
-	io.DeltaTime = frameTimer;
 
 	io.MousePos = ImVec2(mousePos.x, mousePos.y);
 	io.MouseDown[0] = mouseButtons.left && UIOverlay.visible;
@@ -687,6 +771,18 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::TextUnformatted(title.c_str());
 	ImGui::TextUnformatted(deviceProperties.deviceName);
 	ImGui::Text("%.2f ms/frame (%.1d fps)", (1000.0f / lastFPS), lastFPS);
+	// Framework statistics are only shown on request, so the samples' UI stays as it is by default
+	if (settings.statistics) {
+		const vks::MemoryArena::Stats memoryStats = vulkanDevice->memoryArena.getStats();
+		ImGui::Text("%.1f / %.1f MB in %u allocations (%u device)", memoryStats.bytesUsed / (1024.0f * 1024.0f), memoryStats.bytesReserved / (1024.0f * 1024.0f), memoryStats.allocationCount, memoryStats.deviceAllocationCount);
+		const vks::ShaderModuleRegistry::Statistics shaderStats = shaderRegistry.getStatistics();
+		ImGui::Text("%u shader modules for %u loads (%u file reads)", shaderStats.moduleCreations, shaderStats.requests, shaderStats.fileReads);
+		const vks::UploadManager::Statistics uploadStats = vulkanDevice->uploadManager.getStatistics();
+		ImGui::Text("%u uploads in %u submits (%.1f MB staged)", uploadStats.stagedUploads, uploadStats.submissions, uploadStats.stagedBytes / (1024.0f * 1024.0f));
+		for (const auto& result : gpuProfiler.getResults()) {
+			ImGui::Text("%s: %.3f ms (GPU)", result.name, result.time);
+		}
+	}
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 5.0f * UIOverlay.scale));
@@ -702,11 +798,6 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::PopStyleVar();
 	ImGui::Render();
 
-	if (UIOverlay.update() || UIOverlay.updated) {
-		buildCommandBuffers();
-		UIOverlay.updated = false;
-	}
-
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	if (mouseButtons.left) {
 		mouseButtons.left = false;
@@ -716,6 +807,9 @@ void VulkanExampleBase::updateOverlay()
 
 void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 {
+	// Drawn by submitFrame instead
+	if (overlayPass.renderPass != VK_NULL_HANDLE)
+		return;
 	if (settings.overlay && UIOverlay.visible) {
 		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 		const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
@@ -726,26 +820,154 @@ void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 	}
 }
 
-void VulkanExampleBase::prepareFrame()
+void VulkanExampleBase::setupOverlayPass()
+{
+	// Single color attachment that keeps the contents of the presentable image, no depth is needed for the overlay
+	VkAttachmentDescription attachment{};
+	attachment.format = swapChain.colorFormat;
+	attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+	VkSubpassDescription subpassDescription{};
+	subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.colorAttachmentCount = 1;
+	subpassDescription.pColorAttachments = &colorReference;
+
+	// The image has been written by the frame's submission, which the overlay submission waits for at the color attachment output stage
+	VkSubpassDependency dependency{};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments = &attachment;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpassDescription;
+	renderPassInfo.dependencyCount = 1;
+	renderPassInfo.pDependencies = &dependency;
+	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &overlayPass.renderPass));
+
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &overlayPass.commandBuffer));
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &overlayPass.complete));
+
+	setupOverlayFrameBuffers();
+}
+
+void VulkanExampleBase::setupOverlayFrameBuffers()
+{
+	VkFramebufferCreateInfo frameBufferCreateInfo = vks::initializers::framebufferCreateInfo();
+	frameBufferCreateInfo.renderPass = overlayPass.renderPass;
+	frameBufferCreateInfo.attachmentCount = 1;
+	frameBufferCreateInfo.width = width;
+	frameBufferCreateInfo.height = height;
+	frameBufferCreateInfo.layers = 1;
+	overlayPass.frameBuffers.resize(swapChain.imageCount);
+	for (uint32_t i = 0; i < overlayPass.frameBuffers.size(); i++) {
+		frameBufferCreateInfo.pAttachments = &swapChain.buffers[i].view;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &overlayPass.frameBuffers[i]));
+	}
+}
+
+void VulkanExampleBase::destroyOverlayFrameBuffers()
+{
+	for (auto& frameBuffer : overlayPass.frameBuffers) {
+		vkDestroyFramebuffer(device, frameBuffer, nullptr);
+	}
+	overlayPass.frameBuffers.clear();
+}
+
+VkSemaphore VulkanExampleBase::submitOverlay(VkSemaphore waitSemaphore)
+{
+	ImDrawData* imDrawData = ImGui::GetDrawData();
+	if ((!imDrawData) || (imDrawData->CmdListsCount == 0)) {
+		return waitSemaphore;
+	}
+
+	// Recorded every frame, as it's tiny and the queue is idle after each frame without frames in flight
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_CHECK_RESULT(vkBeginCommandBuffer(overlayPass.commandBuffer, &cmdBufInfo));
+	VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+	renderPassBeginInfo.renderPass = overlayPass.renderPass;
+	renderPassBeginInfo.framebuffer = overlayPass.frameBuffers[currentBuffer];
+	renderPassBeginInfo.renderArea.extent.width = width;
+	renderPassBeginInfo.renderArea.extent.height = height;
+	vkCmdBeginRenderPass(overlayPass.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+	const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+	vkCmdSetViewport(overlayPass.commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(overlayPass.commandBuffer, 0, 1, &scissor);
+	UIOverlay.draw(overlayPass.commandBuffer);
+	vkCmdEndRenderPass(overlayPass.commandBuffer);
+	VK_CHECK_RESULT(vkEndCommandBuffer(overlayPass.commandBuffer));
+
+	const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	VkSubmitInfo overlaySubmitInfo = vks::initializers::submitInfo();
+	overlaySubmitInfo.waitSemaphoreCount = 1;
+	overlaySubmitInfo.pWaitSemaphores = &waitSemaphore;
+	overlaySubmitInfo.pWaitDstStageMask = &waitStageMask;
+	overlaySubmitInfo.commandBufferCount = 1;
+	overlaySubmitInfo.pCommandBuffers = &overlayPass.commandBuffer;
+	overlaySubmitInfo.signalSemaphoreCount = 1;
+	overlaySubmitInfo.pSignalSemaphores = &overlayPass.complete;
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &overlaySubmitInfo, VK_NULL_HANDLE));
+	return overlayPass.complete;
+}
+
+bool VulkanExampleBase::prepareFrame()
 {
+	if (useFramesInFlight) {
+		// Wait until the GPU has finished the last frame that used the resources of this frame (command buffer, uniform buffers, etc.)
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentFrame], VK_TRUE, UINT64_MAX));
+		gpuProfiler.resolve(currentFrame);
+	}
 	// Acquire the next image from the swap chain
-	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
+	VkResult result = swapChain.acquireNextImage(useFramesInFlight ? frameSemaphores.presentComplete[currentFrame] : semaphores.presentComplete, &currentBuffer);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE)
 	// SRS - If no longer optimal (VK_SUBOPTIMAL_KHR), wait until submitFrame() in case number of swapchain images will change on resize
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			// No image has been acquired, so nothing may be submitted or presented for this frame
 			windowResize();
+			return false;
 		}
-		return;
 	}
 	else {
 		VK_CHECK_RESULT(result);
 	}
+	if (useFramesInFlight) {
+		// The fence is only reset once an image has been acquired, so a failed acquire can't leave it unsignaled
+		VK_CHECK_RESULT(vkResetFences(device, 1, &waitFences[currentFrame]));
+		submitInfo.pWaitSemaphores = &frameSemaphores.presentComplete[currentFrame];
+		submitInfo.pSignalSemaphores = &frameSemaphores.renderComplete[currentBuffer];
+		UIOverlay.currentFrame = currentFrame;
+		if (settings.overlay) {
+			UIOverlay.update();
+		}
+	}
+	return true;
 }
 
 void VulkanExampleBase::submitFrame()
 {
-	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	VkSemaphore waitSemaphore = useFramesInFlight ? frameSemaphores.renderComplete[currentBuffer] : semaphores.renderComplete;
+	if ((overlayPass.renderPass != VK_NULL_HANDLE) && UIOverlay.visible) {
+		waitSemaphore = submitOverlay(waitSemaphore);
+	}
+	VkResult result = swapChain.queuePresent(queue, currentBuffer, waitSemaphore);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -756,7 +978,18 @@ void VulkanExampleBase::submitFrame()
 	else {
 		VK_CHECK_RESULT(result);
 	}
+	if (useFramesInFlight) {
+		// Don't wait for the GPU, the next frame uses a different set of resources
+		currentFrame = (currentFrame + 1) % maxFramesInFlight;
+		if (!waitIdleAfterFrame) {
+			return;
+		}
+	}
 	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	// With frames in flight timestamps are read back in prepareFrame, once the frame's fence has been signaled
+	if (!useFramesInFlight) {
+		gpuProfiler.resolve(currentBuffer);
+	}
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -794,6 +1027,14 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
 	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.add("benchmarkcompare", { "-bc", "--benchcompare" }, 1, "Compare benchmark results against a JSON results file and exit with an error on regression");
+	commandLineParser.add("benchmarkcomparestat", { "-bcs", "--benchcomparestat" }, 1, "Frame time statistic used for the benchmark comparison (avg, p50, p90, p95, p99 or p99.9)");
+	commandLineParser.add("benchmarkcomparethreshold", { "-bct", "--benchcomparethreshold" }, 1, "Allowed frame time regression for the benchmark comparison in percent");
+	commandLineParser.add("pipelinecache", { "-pc", "--pipelinecache" }, 1, "Set file name for the persistent pipeline cache");
+	commandLineParser.add("nopipelinecache", { "-npc", "--nopipelinecache" }, 0, "Don't load or save the persistent pipeline cache");
+	commandLineParser.add("framesinflight", { "-fif", "--framesinflight" }, 1, "Set the number of frames in flight for examples that support it");
+	commandLineParser.add("overlayrate", { "-or", "--overlayrate" }, 1, "Set the maximum number of UI overlay updates per second (0 to update every frame)");
+	commandLineParser.add("stats", { "-st", "--stats" }, 0, "Show memory, shader, upload and GPU timing statistics in the UI overlay");
 
 	commandLineParser.parse(args);
 	if (commandLineParser.isSet("help")) {
@@ -847,6 +1088,30 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("benchmarkcompare")) {
+		benchmark.compareFilename = commandLineParser.getValueAsString("benchmarkcompare", benchmark.compareFilename);
+	}
+	if (commandLineParser.isSet("benchmarkcomparestat")) {
+		benchmark.compareStatistic = commandLineParser.getValueAsString("benchmarkcomparestat", benchmark.compareStatistic);
+	}
+	if (commandLineParser.isSet("benchmarkcomparethreshold")) {
+		benchmark.compareThreshold = atof(commandLineParser.getValueAsString("benchmarkcomparethreshold", "5").c_str());
+	}
+	if (commandLineParser.isSet("pipelinecache")) {
+		pipelineCacheFile.filename = commandLineParser.getValueAsString("pipelinecache", pipelineCacheFile.filename);
+	}
+	if (commandLineParser.isSet("framesinflight")) {
+		maxFramesInFlight = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("framesinflight", maxFramesInFlight), 1));
+	}
+	if (commandLineParser.isSet("nopipelinecache")) {
+		settings.pipelineCache = false;
+	}
+	if (commandLineParser.isSet("overlayrate")) {
+		settings.overlayUpdateRate = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("overlayrate", settings.overlayUpdateRate), 0));
+	}
+	if (commandLineParser.isSet("stats")) {
+		settings.statistics = true;
+	}
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Vulkan library is loaded dynamically on Android
@@ -872,6 +1137,8 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	// Finishes pending pipelines and merges the per-thread caches into the pipeline cache before it's saved
+	pipelineBuilder.destroy();
 	// Clean up Vulkan resources
 	swapChain.cleanup();
 	if (descriptorPool != VK_NULL_HANDLE)
@@ -887,24 +1154,34 @@ VulkanExampleBase::~VulkanExampleBase()
 	{
 		vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
 	}
+	if (overlayPass.renderPass != VK_NULL_HANDLE) {
+		destroyOverlayFrameBuffers();
+		vkFreeCommandBuffers(device, cmdPool, 1, &overlayPass.commandBuffer);
+		vkDestroySemaphore(device, overlayPass.complete, nullptr);
+		vkDestroyRenderPass(device, overlayPass.renderPass, nullptr);
+	}
 
+	// Every loadShader call holds a reference to its module
 	for (auto& shaderModule : shaderModules)
 	{
-		vkDestroyShaderModule(device, shaderModule, nullptr);
+		shaderRegistry.release(shaderModule);
 	}
+	shaderModules.clear();
+	shaderRegistry.destroy();
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
 	vkFreeMemory(device, depthStencil.mem, nullptr);
 
+	if (settings.pipelineCache) {
+		pipelineCacheFile.save(device, deviceProperties, pipelineCache);
+	}
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
 	vkDestroyCommandPool(device, cmdPool, nullptr);
 
 	vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
 	vkDestroySemaphore(device, semaphores.renderComplete, nullptr);
-	for (auto& fence : waitFences) {
-		vkDestroyFence(device, fence, nullptr);
-	}
+	destroySynchronizationPrimitives();
 
 	if (settings.overlay) {
 		UIOverlay.freeResources();
@@ -1037,13 +1314,21 @@ bool VulkanExampleBase::initVulkan()
 	// Derived examples can enable extensions based on the list of supported extensions read from the physical device
 	getEnabledExtensions();
 
-	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
+	// A dedicated transfer queue (if present) is used by the texture streamer for asynchronous uploads
+	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain, true, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
 		return false;
 	}
 	device = vulkanDevice->logicalDevice;
 
+	// Module identifiers are only queried if the example enabled the extension (along with its feature)
+	const bool moduleIdentifiers = std::find_if(enabledDeviceExtensions.begin(), enabledDeviceExtensions.end(), [](const char* extension) { return strcmp(extension, VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME) == 0; }) != enabledDeviceExtensions.end();
+	shaderRegistry.create(device, moduleIdentifiers);
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+	shaderRegistry.setAssetManager(androidApp->activity->assetManager);
+#endif
+
 	// Get a graphics queue from the device
 	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
 
@@ -1876,10 +2161,7 @@ void VulkanExampleBase::displayLinkOutputCb()
 {
 #if defined(VK_EXAMPLE_XCODE_GENERATED)
 	if (benchmark.active) {
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
-		if (benchmark.filename != "") {
-			benchmark.saveResults();
-		}
+		runBenchmark();
 		quit = true;	// SRS - quit NSApp rendering loop when benchmarking complete
 		return;
 	}
@@ -2674,6 +2956,34 @@ void VulkanExampleBase::createSynchronizationPrimitives()
 	for (auto& fence : waitFences) {
 		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
 	}
+	if (useFramesInFlight) {
+		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+		frameSemaphores.presentComplete.resize(maxFramesInFlight);
+		for (auto& semaphore : frameSemaphores.presentComplete) {
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+		}
+		frameSemaphores.renderComplete.resize(swapChain.imageCount);
+		for (auto& semaphore : frameSemaphores.renderComplete) {
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+		}
+	}
+	currentFrame = 0;
+}
+
+void VulkanExampleBase::destroySynchronizationPrimitives()
+{
+	for (auto& fence : waitFences) {
+		vkDestroyFence(device, fence, nullptr);
+	}
+	for (auto& semaphore : frameSemaphores.presentComplete) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	for (auto& semaphore : frameSemaphores.renderComplete) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	waitFences.clear();
+	frameSemaphores.presentComplete.clear();
+	frameSemaphores.renderComplete.clear();
 }
 
 void VulkanExampleBase::createCommandPool()
@@ -2855,9 +3165,15 @@ void VulkanExampleBase::windowResize()
 	}
 	setupFrameBuffer();
 
+	if (overlayPass.renderPass != VK_NULL_HANDLE) {
+		destroyOverlayFrameBuffers();
+		setupOverlayFrameBuffers();
+	}
+
 	if ((width > 0.0f) && (height > 0.0f)) {
 		if (settings.overlay) {
 			UIOverlay.resize(width, height);
+			overlayUpdatePending = true;
 		}
 	}
 
@@ -2868,9 +3184,7 @@ void VulkanExampleBase::windowResize()
 	buildCommandBuffers();
 	
 	// SRS - Recreate fences in case number of swapchain images has changed on resize
-	for (auto& fence : waitFences) {
-		vkDestroyFence(device, fence, nullptr);
-	}
+	destroySynchronizationPrimitives();
 	createSynchronizationPrimitives();
 
 	vkDeviceWaitIdle(device);
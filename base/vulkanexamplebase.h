@@ -68,6 +68,10 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTexture.h"
+#include "VulkanPipelineCache.h"
+#include "VulkanProfiler.h"
+#include "VulkanShaderRegistry.h"
+#include "VulkanPipelineBuilder.h"
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
@@ -84,9 +88,30 @@ private:
 	void handleMouseMove(int32_t x, int32_t y);
 	void nextFrame();
 	void updateOverlay();
+	void updateOverlayFrame();
+	void setupOverlayPass();
+	void setupOverlayFrameBuffers();
+	void destroyOverlayFrameBuffers();
+	VkSemaphore submitOverlay(VkSemaphore waitSemaphore);
+	/** @brief Time and mouse button state of the last UI overlay update, used to limit the overlay update rate */
+	std::chrono::time_point<std::chrono::high_resolution_clock> lastOverlayUpdate;
+	uint32_t lastOverlayMouseButtons = 0;
+	bool overlayUpdatePending = true;
+	/**
+	* @brief Render pass that draws the UI overlay on top of the presented image with its own command buffer
+	* @note Only used without frames in flight, so overlay changes don't require the (static) draw command buffers to be rebuilt and the overlay isn't part of the profiled frame
+	*/
+	struct {
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		std::vector<VkFramebuffer> frameBuffers;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkSemaphore complete = VK_NULL_HANDLE;
+	} overlayPass;
 	void createPipelineCache();
 	void createCommandPool();
 	void createSynchronizationPrimitives();
+	void destroySynchronizationPrimitives();
+	void runBenchmark();
 	void initSwapchain();
 	void setupSwapChain();
 	void createCommandBuffers();
@@ -130,7 +155,7 @@ protected:
 	VkPipelineStageFlags submitPipelineStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	// Contains command buffers and semaphores to be presented to the queue
 	VkSubmitInfo submitInfo;
-	// Command buffers used for rendering
+	// Command buffers used for rendering (one per swap chain image, or one per frame in flight if useFramesInFlight is set)
 	std::vector<VkCommandBuffer> drawCmdBuffers;
 	// Global render pass for frame buffer writes
 	VkRenderPass renderPass = VK_NULL_HANDLE;
@@ -140,10 +165,19 @@ protected:
 	uint32_t currentBuffer = 0;
 	// Descriptor set pool
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
-	// List of shader modules created (stored for cleanup)
+	// Shader modules returned by loadShader, one reference to the registry's module per call (released at cleanup)
 	std::vector<VkShaderModule> shaderModules;
+	/** @brief Shares shader modules between loadShader calls for the same file, loadShader's statistics are shown in the UI overlay */
+	vks::ShaderModuleRegistry shaderRegistry;
 	// Pipeline cache object
-	VkPipelineCache pipelineCache;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	// Loads the pipeline cache from disk at startup and writes it back on shutdown
+	vks::PipelineCacheFile pipelineCacheFile;
+	/**
+	* @brief Compiles pipelines on worker threads, the workers' caches are merged into pipelineCache before it's written to disk
+	* @note Examples have to wait() for pending pipelines before destroying the resources they reference (or the pipelines themselves)
+	*/
+	vks::PipelineBuilder pipelineBuilder;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	VulkanSwapChain swapChain;
 	// Synchronization semaphores
@@ -154,6 +188,21 @@ protected:
 		VkSemaphore renderComplete;
 	} semaphores;
 	std::vector<VkFence> waitFences;
+	/** @brief Set in the derived constructor to let the CPU record the next frame while the GPU is still executing previous ones instead of waiting for the queue to become idle after each frame */
+	bool useFramesInFlight = false;
+	/** @brief Number of frames that may be in flight at once if useFramesInFlight is set (can be changed with the --framesinflight command line argument) */
+	uint32_t maxFramesInFlight = 2;
+	/** @brief Index of the frame in flight that is currently recorded, selects the per-frame command buffer, fence, semaphores and uniform buffers */
+	uint32_t currentFrame = 0;
+	// Synchronization semaphores used if frames in flight are enabled
+	struct {
+		// Swap chain image acquisition (one per frame in flight)
+		std::vector<VkSemaphore> presentComplete;
+		// Command buffer execution (one per swap chain image, as the presentation engine holds on to it until the image is reused)
+		std::vector<VkSemaphore> renderComplete;
+	} frameSemaphores;
+	// Set during the serialized benchmark pass to wait for the queue to become idle after each frame despite frames in flight being enabled
+	bool waitIdleAfterFrame = false;
 	bool requiresStencil{ false };
 public:
 	bool prepared = false;
@@ -170,6 +219,9 @@ public:
 
 	vks::Benchmark benchmark;
 
+	/** @brief GPU timestamp profiler with one query pool per draw command buffer, samples add scopes while recording their command buffers */
+	vks::GpuProfiler gpuProfiler;
+
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice;
 
@@ -183,6 +235,12 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief Maximum number of UI overlay updates per second (0 to update with every frame), mouse button changes always trigger an update */
+		uint32_t overlayUpdateRate = 30;
+		/** @brief Persist the pipeline cache between runs */
+		bool pipelineCache = true;
+		/** @brief Show memory, shader, upload and GPU profiler statistics in the UI overlay */
+		bool statistics = false;
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
@@ -380,12 +438,15 @@ public:
 	/** @brief Entry point for the main render loop */
 	void renderLoop();
 
-	/** @brief Adds the drawing commands for the ImGui overlay to the given command buffer */
+	/** @brief Adds the drawing commands for the ImGui overlay to the given command buffer (does nothing if the overlay is drawn in a separate render pass) */
 	void drawUI(const VkCommandBuffer commandBuffer);
 
-	/** Prepare the next frame for workload submission by acquiring the next swap chain image */
-	void prepareFrame();
-	/** @brief Presents the current image to the swap chain */
+	/**
+	* Prepare the next frame for workload submission by acquiring the next swap chain image (with frames in flight enabled this also waits until the resources of the current frame are no longer in use)
+	* @return False if no image could be acquired (e.g. the swap chain had to be recreated), the frame must then not be recorded, submitted or presented
+	*/
+	bool prepareFrame();
+	/** @brief Presents the current image to the swap chain (with frames in flight enabled this advances to the next frame instead of waiting for the queue to become idle) */
 	void submitFrame();
 	/** @brief (Virtual) Default image acquire + submission and command buffer submission function */
 	virtual void renderFrame();
@@ -419,8 +480,9 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)									\
 	vulkanExample->setupWindow(hInstance, WndProc);													\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
+	int exitCode = vulkanExample->benchmark.exitCode;												\
 	delete(vulkanExample);																			\
-	return 0;																						\
+	return exitCode;																				\
 }
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
 // Android entry point
@@ -451,8 +513,9 @@ int main(const int argc, const char *argv[])													    \
 	vulkanExample->initVulkan();																	\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
+	int exitCode = vulkanExample->benchmark.exitCode;												\
 	delete(vulkanExample);																			\
-	return 0;																						\
+	return exitCode;																				\
 }
 #elif defined(VK_USE_PLATFORM_DIRECTFB_EXT)
 #define VULKAN_EXAMPLE_MAIN()																		\
@@ -472,8 +535,9 @@ int main(const int argc, const char *argv[])													    \
 	vulkanExample->setupWindow();					 												\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
+	int exitCode = vulkanExample->benchmark.exitCode;												\
 	delete(vulkanExample);																			\
-	return 0;																						\
+	return exitCode;																				\
 }
 #elif (defined(VK_USE_PLATFORM_WAYLAND_KHR) || defined(VK_USE_PLATFORM_HEADLESS_EXT))
 #define VULKAN_EXAMPLE_MAIN()																		\
@@ -486,8 +550,9 @@ int main(const int argc, const char *argv[])													    \
 	vulkanExample->setupWindow();					 												\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
+	int exitCode = vulkanExample->benchmark.exitCode;												\
 	delete(vulkanExample);																			\
-	return 0;																						\
+	return exitCode;																				\
 }
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
 #define VULKAN_EXAMPLE_MAIN()																		\
@@ -507,8 +572,9 @@ int main(const int argc, const char *argv[])													    \
 	vulkanExample->setupWindow();					 												\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
+	int exitCode = vulkanExample->benchmark.exitCode;												\
 	delete(vulkanExample);																			\
-	return 0;																						\
+	return exitCode;																				\
 }
 #elif (defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 #if defined(VK_EXAMPLE_XCODE_GENERATED)
@@ -516,6 +582,7 @@ int main(const int argc, const char *argv[])													    \
 VulkanExample *vulkanExample;																		\
 int main(const int argc, const char *argv[])														\
 {																									\
+	int exitCode = 0;																				\
 	@autoreleasepool																				\
 	{																								\
 		for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };				\
@@ -524,9 +591,10 @@ int main(const int argc, const char *argv[])														\
 		vulkanExample->setupWindow(nullptr);														\
 		vulkanExample->prepare();																	\
 		vulkanExample->renderLoop();																\
+		exitCode = vulkanExample->benchmark.exitCode;												\
 		delete(vulkanExample);																		\
 	}																								\
-	return 0;																						\
+	return exitCode;																				\
 }
 #else
 #define VULKAN_EXAMPLE_MAIN()
@@ -701,6 +701,11 @@ public:
 
 	void draw()
 	{
+		// Acquire the next image first, so nothing is submitted if the swap chain has to be recreated
+		if (!VulkanExampleBase::prepareFrame()) {
+			return;
+		}
+
 		static bool firstDraw = true;
 		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
 		// FIXME find a better way to do this (without using fences, which is much slower)
@@ -720,8 +725,6 @@ public:
 		VK_CHECK_RESULT( vkQueueSubmit( compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE) );
 
 		// Submit graphics commands
-		VulkanExampleBase::prepareFrame();
-
 		VkPipelineStageFlags waitDstStageMask[2] = {
 			submitPipelineStages, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
 		};
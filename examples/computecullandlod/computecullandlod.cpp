@@ -29,8 +29,22 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool fixedFrustum = false;
 
-	// The model contains multiple versions of a single object with different levels of detail
+	// The levels of detail of the model are generated by the glTF loader
 	vkglTF::Model lodModel;
+	// Index ranges of the levels of detail
+	std::vector<vkglTF::Primitive::LOD> lods;
+	// Maximum projected error (in pixels) of the selected level of detail
+	float lodPixelError = 1.0f;
+	// Scale applied to the model of each instance (in the vertex shader)
+	float instanceScale = 2.0f;
+
+	// Index range and switch distance of a level of detail as read by the culling shader
+	struct LOD {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float distance;
+		float _pad0;
+	};
 
 	// Per-instance data block
 	struct InstanceData {
@@ -242,8 +256,17 @@ public:
 
 	void loadAssets()
 	{
-		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
-		lodModel.loadFromFile(getAssetPath() + "models/suzanne_lods.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::OptimizeMeshes | vkglTF::FileLoadingFlags::GenerateLODs;
+		// The loader generates the levels of detail by simplifying the full detail mesh
+		lodModel.lodSettings.levelCount = MAX_LOD_LEVEL + 1;
+		lodModel.lodSettings.maxError = 0.1f;
+		lodModel.loadFromFile(getAssetPath() + "models/suzanne.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		for (auto node : lodModel.linearNodes) {
+			if (node->mesh && !node->mesh->primitives.empty()) {
+				lods = node->mesh->primitives[0]->lods;
+				break;
+			}
+		}
 	}
 
 	void buildComputeCommandBuffer()
@@ -494,7 +517,7 @@ public:
 				{
 					uint32_t index = x + y * OBJECT_COUNT + z * OBJECT_COUNT * OBJECT_COUNT;
 					instanceData[index].pos = glm::vec3((float)x, (float)y, (float)z) - glm::vec3((float)OBJECT_COUNT / 2.0f);
-					instanceData[index].scale = 2.0f;
+					instanceData[index].scale = instanceScale;
 				}
 			}
 		}
@@ -548,41 +571,12 @@ public:
 		stagingBuffer.destroy();
 
 		// Shader storage buffer containing index offsets and counts for the LODs
-		struct LOD
-		{
-			uint32_t firstIndex;
-			uint32_t indexCount;
-			float distance;
-			float _pad0;
-		};
-		std::vector<LOD> LODLevels;
-		uint32_t n = 0;
-		for (auto node : lodModel.nodes)
-		{
-			LOD lod;
-			lod.firstIndex = node->mesh->primitives[0]->firstIndex;	// First index for this LOD
-			lod.indexCount = node->mesh->primitives[0]->indexCount;	// Index count for this LOD
-			lod.distance = 5.0f + n * 5.0f;							// Starting distance (to viewer) for this LOD
-			n++;
-			LODLevels.push_back(lod);
-		}
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			LODLevels.size() * sizeof(LOD),
-			LODLevels.data()));
-
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			&compute.lodLevelsBuffers,
-			stagingBuffer.size));
-
-		vulkanDevice->copyBuffer(&stagingBuffer, &compute.lodLevelsBuffers, queue);
-
-		stagingBuffer.destroy();
+			lods.size() * sizeof(LOD)));
+		updateLODLevels();
 
 		// Scene uniform buffer
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
@@ -596,6 +590,33 @@ public:
 		updateUniformBuffer(true);
 	}
 
+	// The switch distances depend on the projection, so they need to be updated if the viewport changes
+	void updateLODLevels()
+	{
+		std::vector<LOD> LODLevels;
+		// The next level is used from the distance at which its projected error drops below lodPixelError
+		// The simplification error is in model space, so it's scaled like the instances are
+		const float errorToDistance = instanceScale * static_cast<float>(height) * fabsf(camera.matrices.perspective[1][1]) / (2.0f * lodPixelError);
+		for (size_t i = 0; i < lods.size(); i++)
+		{
+			LOD lod;
+			lod.firstIndex = lods[i].firstIndex;	// First index for this LOD
+			lod.indexCount = lods[i].indexCount;	// Index count for this LOD
+			lod.distance = (i + 1 < lods.size()) ? lods[i + 1].error * errorToDistance : FLT_MAX;	// Distance (to viewer) up to which this LOD is used
+			LODLevels.push_back(lod);
+		}
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			LODLevels.size() * sizeof(LOD),
+			LODLevels.data()));
+		vulkanDevice->copyBuffer(&stagingBuffer, &compute.lodLevelsBuffers, queue);
+		stagingBuffer.destroy();
+	}
+
 	void prepareCompute()
 	{
 		// Get a compute capable device queue
@@ -700,7 +721,7 @@ public:
 		specializationEntry.offset = 0;
 		specializationEntry.size = sizeof(uint32_t);
 
-		uint32_t specializationData = static_cast<uint32_t>(lodModel.nodes.size()) - 1;
+		uint32_t specializationData = static_cast<uint32_t>(lods.size()) - 1;
 
 		VkSpecializationInfo specializationInfo;
 		specializationInfo.mapEntryCount = 1;
@@ -758,7 +779,9 @@ public:
 
 	void draw()
 	{
-		VulkanExampleBase::prepareFrame();
+		if (!VulkanExampleBase::prepareFrame()) {
+			return;
+		}
 
 		// Submit compute shader for frustum culling
 
@@ -834,6 +857,12 @@ public:
 		updateUniformBuffer(true);
 	}
 
+	virtual void windowResized()
+	{
+		// The device is idle during a resize, so the levels can be overwritten in place
+		updateLODLevels();
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
@@ -843,8 +872,8 @@ public:
 		}
 		if (overlay->header("Statistics")) {
 			overlay->text("Visible objects: %d", indirectStats.drawCount);
-			for (uint32_t i = 0; i < MAX_LOD_LEVEL + 1; i++) {
-				overlay->text("LOD %d: %d", i, indirectStats.lodCount[i]);
+			for (uint32_t i = 0; i < static_cast<uint32_t>(lods.size()); i++) {
+				overlay->text("LOD %d: %d (%d triangles)", i, indirectStats.lodCount[i], lods[i].indexCount / 3);
 			}
 		}
 	}
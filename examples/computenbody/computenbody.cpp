@@ -844,6 +844,11 @@ public:
 
 	void draw()
 	{
+		// Acquire the next image first, so nothing is submitted if the swap chain has to be recreated
+		if (!VulkanExampleBase::prepareFrame()) {
+			return;
+		}
+
 		// Wait for rendering finished
 		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
@@ -858,8 +863,6 @@ public:
 		computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
 		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
 
-		VulkanExampleBase::prepareFrame();
-
 		VkPipelineStageFlags graphicsWaitStageMasks[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 		VkSemaphore graphicsWaitSemaphores[] = { compute.semaphore, semaphores.presentComplete };
 		VkSemaphore graphicsSignalSemaphores[] = { graphics.semaphore, semaphores.renderComplete };
@@ -784,7 +784,9 @@ public:
 
 		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, compute.fence));
 		
-		VulkanExampleBase::prepareFrame();
+		if (!VulkanExampleBase::prepareFrame()) {
+			return;
+		}
 
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
@@ -659,7 +659,9 @@ public:
 
 	void draw()
 	{
-		VulkanExampleBase::prepareFrame();
+		if (!VulkanExampleBase::prepareFrame()) {
+			return;
+		}
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
@@ -606,7 +606,9 @@ public:
 
 	void draw()
 	{
-		VulkanExampleBase::prepareFrame();
+		if (!VulkanExampleBase::prepareFrame()) {
+			return;
+		}
 
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
@@ -29,16 +29,26 @@ VulkanglTFScene::~VulkanglTFScene()
 	vkDestroyBuffer(vulkanDevice->logicalDevice, indices.buffer, nullptr);
 	vkFreeMemory(vulkanDevice->logicalDevice, indices.memory, nullptr);
 	for (Image image : images) {
-		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
+		image.texture.destroy();
 	}
 	for (Material material : materials) {
 		vkDestroyPipeline(vulkanDevice->logicalDevice, material.pipeline, nullptr);
 	}
 }
 
+/*
+	File read callback for tinyglTF that skips image files
+	The images are loaded from their ktx files by loadImages, so tinyglTF only needs to keep their uri
+*/
+static bool readWholeFileSkippingImages(std::vector<unsigned char>* out, std::string* err, const std::string& filepath, void* userData)
+{
+	const std::string extension = filepath.substr(filepath.find_last_of('.') + 1);
+	if ((extension == "ktx") || (extension == "ktx2") || (extension == "png") || (extension == "jpg") || (extension == "jpeg")) {
+		return false;
+	}
+	return tinygltf::ReadWholeFile(out, err, filepath, userData);
+}
+
 /*
 	glTF loading functions
 
@@ -292,6 +302,8 @@ VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	camera.setPosition(glm::vec3(0.0f, 1.0f, 0.0f));
 	camera.setRotation(glm::vec3(0.0f, -90.0f, 0.0f));
 	camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+	// Required to enable the descriptor indexing features used by the GPU driven render path
+	enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 }
 
 VulkanExample::~VulkanExample()
@@ -300,11 +312,38 @@ VulkanExample::~VulkanExample()
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.matrices, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.textures, nullptr);
 	shaderData.buffer.destroy();
+	for (auto pipeline : gpuDriven.pipelines) {
+		vkDestroyPipeline(device, pipeline, nullptr);
+	}
+	vkDestroyPipelineLayout(device, gpuDriven.pipelineLayout, nullptr);
+	delete gpuDriven.model;
 }
 
 void VulkanExample::getEnabledFeatures()
 {
 	enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+	// POI: The GPU driven render path passes the draw index as the first instance of the indirect draws, and draws multiple commands at once if supported
+	enabledFeatures.drawIndirectFirstInstance = deviceFeatures.drawIndirectFirstInstance;
+	enabledFeatures.multiDrawIndirect = deviceFeatures.multiDrawIndirect;
+}
+
+void VulkanExample::getEnabledExtensions()
+{
+	// POI: The GPU driven render path selects textures from a bindless array, which requires descriptor indexing
+	const bool descriptorIndexing = vulkanDevice->extensionSupported(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) && vulkanDevice->extensionSupported(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+	if (descriptorIndexing) {
+		enabledDeviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+		enabledDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		physicalDeviceDescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		physicalDeviceDescriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		physicalDeviceDescriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		deviceCreatepNextChain = &physicalDeviceDescriptorIndexingFeatures;
+	}
+	// Lets the GPU skip culled draws, without it the culled commands are drawn with zero indices
+	if (vulkanDevice->extensionSupported(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+		enabledDeviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	}
+	gpuDriven.supported = descriptorIndexing && deviceFeatures.drawIndirectFirstInstance;
 }
 
 void VulkanExample::buildCommandBuffers()
@@ -332,14 +371,28 @@ void VulkanExample::buildCommandBuffers()
 	{
 		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		if (gpuDriven.enabled) {
+			// POI: The culling compute pass writes the draw commands for the visible primitives, this has to be done outside of the render pass
+			gpuDriven.model->cullIndirect(drawCmdBuffers[i], i);
+		}
 		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-		// Bind scene matrices descriptor to set 0
-		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 
-		// POI: Draw the glTF scene
-		glTFScene.draw(drawCmdBuffers[i], pipelineLayout);
+		if (gpuDriven.enabled) {
+			// POI: Draw the whole glTF scene with one indirect draw per pipeline
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, gpuDriven.pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			for (uint32_t group = 0; group < vkglTF::IndirectDrawGroupCount; group++) {
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, gpuDriven.pipelines[group]);
+				gpuDriven.model->drawIndirect(drawCmdBuffers[i], static_cast<vkglTF::IndirectDrawGroup>(group), gpuDriven.pipelineLayout, 1, i);
+			}
+		} else {
+			// Bind scene matrices descriptor to set 0
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+			// POI: Draw the glTF scene
+			glTFScene.draw(drawCmdBuffers[i], pipelineLayout);
+		}
 
 		drawUI(drawCmdBuffers[i]);
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
@@ -360,6 +413,10 @@ void VulkanExample::loadglTFFile(std::string filename)
 	// We let tinygltf handle this, by passing the asset manager of our app
 	tinygltf::asset_manager = androidApp->activity->assetManager;
 #endif
+	// Images are loaded from the ktx files referenced by the glTF file, so tinyglTF doesn't need to read or decode them
+	// Image files it can't read are only reported as a warning, their uri is still stored
+	gltfContext.SetFsCallbacks({ &tinygltf::FileExists, &tinygltf::ExpandFilePath, &readWholeFileSkippingImages, &tinygltf::WriteWholeFile, nullptr });
+	gltfContext.SetImageLoader([](tinygltf::Image*, const int, std::string*, std::string*, int, int, const unsigned char*, int, void*) { return true; }, nullptr);
 	bool fileLoaded = gltfContext.LoadASCIIFromFile(&glTFInput, &error, &warning, filename);
 
 	// Pass some Vulkan resources required for setup and rendering to the glTF model loading class
@@ -597,6 +654,65 @@ void VulkanExample::preparePipelines()
 	}
 }
 
+// POI: Load the scene with the base glTF loader and set up the GPU driven render path
+void VulkanExample::prepareGPUDriven()
+{
+	gpuDriven.model = new vkglTF::Model();
+	// POI: Only store the vertex components used by the shaders and compress them, this reduces the size of a vertex from 96 to 28 bytes
+	gpuDriven.model->vertexLayout = { { vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Tangent }, vkglTF::PackNormals | vkglTF::PackUVs | vkglTF::PackColors };
+	gpuDriven.model->loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::OptimizeMeshes);
+	// Command buffers are recorded once per swap chain image, each of them reads its own copy of the model's matrices and culling parameters
+	gpuDriven.model->prepareIndirectDraw(queue, loadShader(getShadersPath() + "base/gltfindirectcull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache, static_cast<uint32_t>(drawCmdBuffers.size()));
+
+	// Set 0 = scene matrices, set 1 = matrices, per draw data, materials and textures of the model
+	std::array<VkDescriptorSetLayout, 2> setLayouts = { descriptorSetLayouts.matrices, gpuDriven.model->indirect.descriptorSetLayout };
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &gpuDriven.pipelineLayout));
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+	VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+	VkPipelineColorBlendAttachmentState blendAttachmentStateCI = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+	VkPipelineColorBlendStateCreateInfo colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentStateCI);
+	VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+	VkPipelineViewportStateCreateInfo viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+	VkPipelineMultisampleStateCreateInfo multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+	const std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables.data(), static_cast<uint32_t>(dynamicStateEnables.size()), 0);
+	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {
+		loadShader(getShadersPath() + "gltfscenerendering/sceneindirect.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+		loadShader(getShadersPath() + "gltfscenerendering/sceneindirect.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
+	};
+
+	VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(gpuDriven.pipelineLayout, renderPass, 0);
+	// The vertex input state has to match the packed vertex layout of the model
+	pipelineCI.pVertexInputState = gpuDriven.model->getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Tangent });
+	pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+	pipelineCI.pRasterizationState = &rasterizationStateCI;
+	pipelineCI.pColorBlendState = &colorBlendStateCI;
+	pipelineCI.pMultisampleState = &multisampleStateCI;
+	pipelineCI.pViewportState = &viewportStateCI;
+	pipelineCI.pDepthStencilState = &depthStencilStateCI;
+	pipelineCI.pDynamicState = &dynamicStateCI;
+	pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+	pipelineCI.pStages = shaderStages.data();
+
+	// POI: Instead of one pipeline per material, there is one pipeline per group of primitives, material parameters are read from a storage buffer
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &gpuDriven.pipelines[vkglTF::IndirectDrawOpaque]));
+	rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &gpuDriven.pipelines[vkglTF::IndirectDrawDoubleSided]));
+	blendAttachmentStateCI.blendEnable = VK_TRUE;
+	blendAttachmentStateCI.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	blendAttachmentStateCI.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	blendAttachmentStateCI.colorBlendOp = VK_BLEND_OP_ADD;
+	blendAttachmentStateCI.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	blendAttachmentStateCI.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	blendAttachmentStateCI.alphaBlendOp = VK_BLEND_OP_ADD;
+	depthStencilStateCI.depthWriteEnable = VK_FALSE;
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &gpuDriven.pipelines[vkglTF::IndirectDrawAlphaBlend]));
+
+	updateUniformBuffers();
+}
+
 void VulkanExample::prepareUniformBuffers()
 {
 	VK_CHECK_RESULT(vulkanDevice->createBuffer(
@@ -614,6 +730,9 @@ void VulkanExample::updateUniformBuffers()
 	shaderData.values.view = camera.matrices.view;
 	shaderData.values.viewPos = camera.viewPos;
 	memcpy(shaderData.buffer.mapped, &shaderData.values, sizeof(shaderData.values));
+	if (gpuDriven.model) {
+		gpuDriven.model->updateIndirectCulling(camera.matrices.perspective * camera.matrices.view, gpuDriven.frustumCulling);
+	}
 }
 
 void VulkanExample::prepare()
@@ -629,10 +748,20 @@ void VulkanExample::prepare()
 
 void VulkanExample::render()
 {
-	renderFrame();
+	if (!VulkanExampleBase::prepareFrame()) {
+		return;
+	}
+	if (gpuDriven.enabled) {
+		// POI: Updates to the model's matrices and culling parameters go to the copy read by the command buffer that is submitted next
+		gpuDriven.model->setIndirectFrame(currentBuffer);
+	}
 	if (camera.updated) {
 		updateUniformBuffers();
 	}
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	VulkanExampleBase::submitFrame();
 }
 
 void VulkanExample::viewChanged()
@@ -642,7 +771,22 @@ void VulkanExample::viewChanged()
 
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 {
-	if (overlay->header("Visibility")) {
+	if (gpuDriven.supported && overlay->header("GPU driven rendering")) {
+		if (overlay->checkBox("Enabled", &gpuDriven.enabled)) {
+			if (gpuDriven.enabled && !gpuDriven.model) {
+				prepareGPUDriven();
+			}
+			buildCommandBuffers();
+		}
+		if (gpuDriven.enabled) {
+			if (overlay->checkBox("Frustum culling", &gpuDriven.frustumCulling)) {
+				updateUniformBuffers();
+			}
+			overlay->text("%d primitives", gpuDriven.model->indirect.drawCount);
+			overlay->text("%d bytes per vertex (%d KB saved)", gpuDriven.model->vertexStride, static_cast<int>(gpuDriven.model->vertexBytesSaved / 1024));
+		}
+	}
+	if (!gpuDriven.enabled && overlay->header("Visibility")) {
 
 		if (overlay->button("All")) {
 			std::for_each(glTFScene.nodes.begin(), glTFScene.nodes.end(), [](VulkanglTFScene::Node* node) { node->visible = true; });
@@ -12,15 +12,8 @@
 * This sample comes with a tutorial, see the README.md in this folder
 */
 
-#define TINYGLTF_IMPLEMENTATION
-#define STB_IMAGE_IMPLEMENTATION
-#define TINYGLTF_NO_STB_IMAGE_WRITE
-#define TINYGLTF_NO_STB_IMAGE
-#define TINYGLTF_NO_EXTERNAL_IMAGE
-#ifdef VK_USE_PLATFORM_ANDROID_KHR
-#define TINYGLTF_ANDROID_LOAD_FROM_ASSETS
-#endif
-#include "tiny_gltf.h"
+// The tinyglTF implementation is part of the base library's glTF loader, which is also used for the GPU driven render path
+#include "VulkanglTFModel.h"
 
 #include "vulkanexamplebase.h"
 
@@ -155,14 +148,28 @@ public:
 		VkDescriptorSetLayout textures;
 	} descriptorSetLayouts;
 
+	// POI: Alternative render path that draws the scene with a few indirect draws using the base glTF loader
+	struct GPUDriven {
+		bool supported = false;
+		bool enabled = false;
+		bool frustumCulling = true;
+		// Loaded on first use
+		vkglTF::Model* model = nullptr;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		std::array<VkPipeline, vkglTF::IndirectDrawGroupCount> pipelines{};
+	} gpuDriven;
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT physicalDeviceDescriptorIndexingFeatures{};
+
 	VulkanExample();
 	~VulkanExample();
 	virtual void getEnabledFeatures();
+	virtual void getEnabledExtensions();
 	void buildCommandBuffers();
 	void loadglTFFile(std::string filename);
 	void loadAssets();
 	void setupDescriptors();
 	void preparePipelines();
+	void prepareGPUDriven();
 	void prepareUniformBuffers();
 	void updateUniformBuffers();
 	void prepare();
@@ -26,15 +26,6 @@
 
  */
 
-/*
-	 Get a node's local matrix from the current translation, rotation and scale values
-	 These are calculated from the current animation an need to be calculated dynamically
- */
-glm::mat4 VulkanglTFModel::Node::getLocalMatrix()
-{
-	return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
-}
-
 /*
 	Release all Vulkan resources acquired for the model
 */
@@ -46,12 +37,9 @@ VulkanglTFModel::~VulkanglTFModel()
 	vkFreeMemory(vulkanDevice->logicalDevice, indices.memory, nullptr);
 	for (Image image : images)
 	{
-		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
+		image.texture.destroy();
 	}
-	for (Skin skin : skins)
+	for (Skin &skin : skins)
 	{
 		skin.ssbo.destroy();
 	}
@@ -228,7 +216,19 @@ void VulkanglTFModel::loadAnimations(tinygltf::Model &input)
 		{
 			tinygltf::AnimationSampler glTFSampler = glTFAnimation.samplers[j];
 			AnimationSampler &         dstSampler  = animations[i].samplers[j];
-			dstSampler.interpolation               = glTFSampler.interpolation;
+			// Interpolation types are resolved at load time, so the per-frame update doesn't have to compare strings
+			if (glTFSampler.interpolation == "STEP")
+			{
+				dstSampler.interpolation = vks::skinning::Interpolation::Step;
+			}
+			else if (glTFSampler.interpolation == "CUBICSPLINE")
+			{
+				dstSampler.interpolation = vks::skinning::Interpolation::CubicSpline;
+			}
+			if (dstSampler.interpolation != vks::skinning::Interpolation::Linear)
+			{
+				std::cout << "This sample only supports linear interpolations, sampler " << j << " of animation " << i << " is ignored\n";
+			}
 
 			// Read sampler keyframe input time values
 			{
@@ -293,7 +293,18 @@ void VulkanglTFModel::loadAnimations(tinygltf::Model &input)
 		{
 			tinygltf::AnimationChannel glTFChannel = glTFAnimation.channels[j];
 			AnimationChannel &         dstChannel  = animations[i].channels[j];
-			dstChannel.path                        = glTFChannel.target_path;
+			if (glTFChannel.target_path == "rotation")
+			{
+				dstChannel.path = vks::skinning::Path::Rotation;
+			}
+			else if (glTFChannel.target_path == "scale")
+			{
+				dstChannel.path = vks::skinning::Path::Scale;
+			}
+			else if (glTFChannel.target_path == "weights")
+			{
+				dstChannel.path = vks::skinning::Path::Weights;
+			}
 			dstChannel.samplerIndex                = glTFChannel.sampler;
 			dstChannel.node                        = nodeFromIndex(glTFChannel.target_node);
 		}
@@ -476,41 +487,62 @@ void VulkanglTFModel::loadNode(const tinygltf::Node &inputNode, const tinygltf::
 	glTF vertex skinning functions
 */
 
-// POI: Traverse the node hierarchy to the top-most parent to get the local matrix of the given node
-glm::mat4 VulkanglTFModel::getNodeMatrix(VulkanglTFModel::Node *node)
+// Store all nodes parent first, so world matrices can be calculated in a single pass without walking up the hierarchy for every node
+void VulkanglTFModel::linearizeNodes()
 {
-	glm::mat4              nodeMatrix    = node->getLocalMatrix();
-	VulkanglTFModel::Node *currentParent = node->parent;
-	while (currentParent)
+	linearNodes.clear();
+	std::vector<Node *> stack(nodes.rbegin(), nodes.rend());
+	while (!stack.empty())
 	{
-		nodeMatrix    = currentParent->getLocalMatrix() * nodeMatrix;
-		currentParent = currentParent->parent;
+		Node *node = stack.back();
+		stack.pop_back();
+		linearNodes.push_back(node);
+		stack.insert(stack.end(), node->children.rbegin(), node->children.rend());
 	}
-	return nodeMatrix;
 }
 
-// POI: Update the joint matrices from the current animation frame and pass them to the GPU
-void VulkanglTFModel::updateJoints(VulkanglTFModel::Node *node)
+// Flatten all nodes with mesh data into a list of draws
+// The push constant matrix only depends on the nodes' static matrices, so it can be calculated once at load time
+void VulkanglTFModel::buildDrawList()
 {
-	if (node->skin > -1)
-	{
-		// Update the joint matrices
-		glm::mat4              inverseTransform = glm::inverse(getNodeMatrix(node));
-		Skin                   skin             = skins[node->skin];
-		size_t                 numJoints        = (uint32_t) skin.joints.size();
-		std::vector<glm::mat4> jointMatrices(numJoints);
-		for (size_t i = 0; i < numJoints; i++)
+	drawItems.clear();
+	for (Node *node : linearNodes)
+	{
+		if (node->mesh.primitives.empty())
 		{
-			jointMatrices[i] = getNodeMatrix(skin.joints[i]) * skin.inverseBindMatrices[i];
-			jointMatrices[i] = inverseTransform * jointMatrices[i];
+			continue;
 		}
-		// Update ssbo
-		skin.ssbo.copyTo(jointMatrices.data(), jointMatrices.size() * sizeof(glm::mat4));
+		DrawItem item{};
+		item.matrix          = node->matrix;
+		const vks::skinning::Node *currentParent = node->parent;
+		while (currentParent)
+		{
+			item.matrix   = currentParent->matrix * item.matrix;
+			currentParent = currentParent->parent;
+		}
+		item.skin = node->skin;
+		item.mesh = &node->mesh;
+		drawItems.push_back(item);
 	}
+}
 
-	for (auto &child : node->children)
+// POI: Update the joint matrices from the current animation frame and pass them to the GPU
+// World and joint matrices are calculated by the GPU independent functions in base/skinning.hpp, see there for details
+// Joint matrices are written straight into the persistently mapped shader storage buffer instead of going through a temporary copy
+void VulkanglTFModel::updateJoints()
+{
+	vks::skinning::updateWorldMatrices(linearNodes);
+	for (Node *node : linearNodes)
 	{
-		updateJoints(child);
+		if (node->skin < 0)
+		{
+			continue;
+		}
+		const Skin &skin = skins[node->skin];
+		if (skin.ssbo.mapped)
+		{
+			vks::skinning::updateJointMatrices(*node, skin, static_cast<glm::mat4 *>(skin.ssbo.mapped));
+		}
 	}
 }
 
@@ -522,113 +554,39 @@ void VulkanglTFModel::updateAnimation(float deltaTime)
 		std::cout << "No animation with index " << activeAnimation << std::endl;
 		return;
 	}
-	Animation &animation = animations[activeAnimation];
-	animation.currentTime += deltaTime;
-	if (animation.currentTime > animation.end)
-	{
-		animation.currentTime -= animation.end;
-	}
-
-	for (auto &channel : animation.channels)
-	{
-		AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-		for (size_t i = 0; i < sampler.inputs.size() - 1; i++)
-		{
-			if (sampler.interpolation != "LINEAR")
-			{
-				std::cout << "This sample only supports linear interpolations\n";
-				continue;
-			}
-
-			// Get the input keyframe values for the current time stamp
-			if ((animation.currentTime >= sampler.inputs[i]) && (animation.currentTime <= sampler.inputs[i + 1]))
-			{
-				float a = (animation.currentTime - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-				if (channel.path == "translation")
-				{
-					channel.node->translation = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], a);
-				}
-				if (channel.path == "rotation")
-				{
-					glm::quat q1;
-					q1.x = sampler.outputsVec4[i].x;
-					q1.y = sampler.outputsVec4[i].y;
-					q1.z = sampler.outputsVec4[i].z;
-					q1.w = sampler.outputsVec4[i].w;
-
-					glm::quat q2;
-					q2.x = sampler.outputsVec4[i + 1].x;
-					q2.y = sampler.outputsVec4[i + 1].y;
-					q2.z = sampler.outputsVec4[i + 1].z;
-					q2.w = sampler.outputsVec4[i + 1].w;
-
-					channel.node->rotation = glm::normalize(glm::slerp(q1, q2, a));
-				}
-				if (channel.path == "scale")
-				{
-					channel.node->scale = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], a);
-				}
-			}
-		}
-	}
-	for (auto &node : nodes)
-	{
-		updateJoints(node);
-	}
+	vks::skinning::updateAnimation(animations[activeAnimation], deltaTime);
+	updateJoints();
 }
 
 /*
 	glTF rendering functions
 */
 
-// Draw a single node including child nodes (if present)
-void VulkanglTFModel::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node node)
+// Draw the glTF scene using the flattened draw list
+void VulkanglTFModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
 {
-	if (node.mesh.primitives.size() > 0)
+	// All vertices and indices are stored in single buffers, so we only need to bind once
+	VkDeviceSize offsets[1] = {0};
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	for (const DrawItem &item : drawItems)
 	{
-		// Pass the node's matrix via push constants
-		// Traverse the node hierarchy to the top-most parent to get the final matrix of the current node
-		glm::mat4              nodeMatrix    = node.matrix;
-		VulkanglTFModel::Node *currentParent = node.parent;
-		while (currentParent)
-		{
-			nodeMatrix    = currentParent->matrix * nodeMatrix;
-			currentParent = currentParent->parent;
-		}
 		// Pass the final matrix to the vertex shader using push constants
-		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &nodeMatrix);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &item.matrix);
 		// Bind SSBO with skin data for this node to set 1
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &skins[node.skin].descriptorSet, 0, nullptr);
-		for (VulkanglTFModel::Primitive &primitive : node.mesh.primitives)
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &skins[item.skin].descriptorSet, 0, nullptr);
+		for (const VulkanglTFModel::Primitive &primitive : item.mesh->primitives)
 		{
 			if (primitive.indexCount > 0)
 			{
 				// Get the texture index for this primitive
-				VulkanglTFModel::Texture texture = textures[materials[primitive.materialIndex].baseColorTextureIndex];
+				const VulkanglTFModel::Texture &texture = textures[materials[primitive.materialIndex].baseColorTextureIndex];
 				// Bind the descriptor for the current primitive's texture to set 2
 				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1, &images[texture.imageIndex].descriptorSet, 0, nullptr);
 				vkCmdDrawIndexed(commandBuffer, primitive.indexCount, 1, primitive.firstIndex, 0, 0);
 			}
 		}
 	}
-	for (auto &child : node.children)
-	{
-		drawNode(commandBuffer, pipelineLayout, *child);
-	}
-}
-
-// Draw the glTF scene starting at the top-level-nodes
-void VulkanglTFModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
-{
-	// All vertices and indices are stored in single buffers, so we only need to bind once
-	VkDeviceSize offsets[1] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-	// Render all nodes at top-level
-	for (auto &node : nodes)
-	{
-		drawNode(commandBuffer, pipelineLayout, *node);
-	}
 }
 
 /*
@@ -744,13 +702,12 @@ void VulkanExample::loadglTFFile(std::string filename)
 			const tinygltf::Node node = glTFInput.nodes[scene.nodes[i]];
 			glTFModel.loadNode(node, glTFInput, nullptr, scene.nodes[i], indexBuffer, vertexBuffer);
 		}
+		glTFModel.linearizeNodes();
+		glTFModel.buildDrawList();
 		glTFModel.loadSkins(glTFInput);
 		glTFModel.loadAnimations(glTFInput);
 		// Calculate initial pose
-		for (auto node : glTFModel.nodes)
-		{
-			glTFModel.updateJoints(node);
-		}
+		glTFModel.updateJoints();
 	}
 	else
 	{
@@ -36,6 +36,7 @@
 #include "tiny_gltf.h"
 
 #include "vulkanexamplebase.h"
+#include "skinning.hpp"
 #include <vulkan/vulkan.h>
 
 #define ENABLE_VALIDATION false
@@ -96,18 +97,24 @@ class VulkanglTFModel
 		std::vector<Primitive> primitives;
 	};
 
-	struct Node
+	// The animated transform (translation, rotation, scale and world matrix) is stored in the GPU independent vks::skinning::Node
+	struct Node : vks::skinning::Node
 	{
-		Node *              parent;
 		uint32_t            index;
 		std::vector<Node *> children;
 		Mesh                mesh;
-		glm::vec3           translation{};
-		glm::vec3           scale{1.0f};
-		glm::quat           rotation{};
 		int32_t             skin = -1;
-		glm::mat4           matrix;
-		glm::mat4           getLocalMatrix();
+	};
+
+	/*
+		Flattened draw list entry, built once after loading so drawing doesn't need to traverse the node hierarchy
+	*/
+
+	struct DrawItem
+	{
+		glm::mat4   matrix;
+		int32_t     skin;
+		const Mesh *mesh;
 	};
 
 	struct Vertex
@@ -124,48 +131,34 @@ class VulkanglTFModel
 		Skin structure
 	*/
 
-	struct Skin
+	struct Skin : vks::skinning::Skin
 	{
-		std::string            name;
-		Node *                 skeletonRoot = nullptr;
-		std::vector<glm::mat4> inverseBindMatrices;
-		std::vector<Node *>    joints;
-		vks::Buffer            ssbo;
-		VkDescriptorSet        descriptorSet;
+		std::string     name;
+		Node *          skeletonRoot = nullptr;
+		vks::Buffer     ssbo;
+		VkDescriptorSet descriptorSet;
 	};
 
 	/*
 		Animation related structures
+		Samplers and channels are the GPU independent ones from base/skinning.hpp, so the per-frame update doesn't depend on Vulkan
 	*/
 
-	struct AnimationSampler
-	{
-		std::string            interpolation;
-		std::vector<float>     inputs;
-		std::vector<glm::vec4> outputsVec4;
-	};
-
-	struct AnimationChannel
-	{
-		std::string path;
-		Node *      node;
-		uint32_t    samplerIndex;
-	};
+	using AnimationSampler = vks::skinning::AnimationSampler;
+	using AnimationChannel = vks::skinning::AnimationChannel;
 
-	struct Animation
+	struct Animation : vks::skinning::Animation
 	{
-		std::string                   name;
-		std::vector<AnimationSampler> samplers;
-		std::vector<AnimationChannel> channels;
-		float                         start       = std::numeric_limits<float>::max();
-		float                         end         = std::numeric_limits<float>::min();
-		float                         currentTime = 0.0f;
+		std::string name;
 	};
 
 	std::vector<Image>     images;
 	std::vector<Texture>   textures;
 	std::vector<Material>  materials;
 	std::vector<Node *>    nodes;
+	// All nodes with parents stored before their children, so world matrices can be updated in a single pass
+	std::vector<Node *>    linearNodes;
+	std::vector<DrawItem>  drawItems;
 	std::vector<Skin>      skins;
 	std::vector<Animation> animations;
 
@@ -180,10 +173,10 @@ class VulkanglTFModel
 	void      loadSkins(tinygltf::Model &input);
 	void      loadAnimations(tinygltf::Model &input);
 	void      loadNode(const tinygltf::Node &inputNode, const tinygltf::Model &input, VulkanglTFModel::Node *parent, uint32_t nodeIndex, std::vector<uint32_t> &indexBuffer, std::vector<VulkanglTFModel::Vertex> &vertexBuffer);
-	glm::mat4 getNodeMatrix(VulkanglTFModel::Node *node);
-	void      updateJoints(VulkanglTFModel::Node *node);
+	void      linearizeNodes();
+	void      buildDrawList();
+	void      updateJoints();
 	void      updateAnimation(float deltaTime);
-	void      drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node node);
 	void      draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
 };
 
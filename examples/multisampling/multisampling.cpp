@@ -507,7 +507,9 @@ public:
 
 	void draw()
 	{
-		VulkanExampleBase::prepareFrame();
+		if (!VulkanExampleBase::prepareFrame()) {
+			return;
+		}
 
 		// Command buffer to be sumitted to the queue
 		submitInfo.commandBufferCount = 1;
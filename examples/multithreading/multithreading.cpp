@@ -8,7 +8,7 @@
 
 #include "vulkanexamplebase.h"
 
-#include "threadpool.hpp"
+#include "jobsystem.hpp"
 #include "frustum.hpp"
 
 #include "VulkanglTFModel.h"
@@ -46,12 +46,14 @@ public:
 		VkCommandBuffer ui;
 	} secondaryCommandBuffers;
 
-	// Number of animated objects to be renderer
+	// Number of animated objects to be rendered
 	// by using threads and secondary command buffers
-	uint32_t numObjectsPerThread;
+	uint32_t numObjects = 512;
+	// Number of objects per job, ranges are split until they fit into this size
+	uint32_t objectsPerJob = 16;
 
 	// Multi threaded stuff
-	// Max. number of concurrent threads
+	// Number of threads executing jobs (including the main thread)
 	uint32_t numThreads;
 
 	// Use push constants to update shader
@@ -70,21 +72,36 @@ public:
 		float scale;
 		float deltaT;
 		float stateT = 0;
-		bool visible = true;
 	};
 
+	// Per object information (position, rotation, etc.)
+	std::vector<ObjectData> objectData;
+	// One push constant block per render object
+	std::vector<ThreadPushConstantBlock> pushConstBlock;
+	// Secondary command buffers recorded for the visible objects in the current frame
+	std::vector<VkCommandBuffer> objectCommandBuffers;
+
+	// Bounding spheres of the objects stored as structure of arrays for batched frustum culling
+	struct {
+		std::vector<float> x, y, z, radius;
+	} boundingSpheres;
+	// Indices of the objects inside the view frustum
+	std::vector<uint32_t> visibleObjects;
+	uint32_t visibleObjectCount = 0;
+	std::vector<uint32_t> visibilityMask;
+
+	// Command buffers must not be recorded from different threads at the same time if they come from the same pool,
+	// so each thread of the job system gets its own pool and takes command buffers from that for the objects it processes
 	struct ThreadData {
 		VkCommandPool commandPool;
-		// One command buffer per render object
-		std::vector<VkCommandBuffer> commandBuffer;
-		// One push constant block per render object
-		std::vector<ThreadPushConstantBlock> pushConstBlock;
-		// Per object information (position, rotation, etc.)
-		std::vector<ObjectData> objectData;
+		// Secondary command buffers allocated from the thread's pool, grows on demand
+		std::vector<VkCommandBuffer> commandBuffers;
+		// Number of command buffers used in the current frame
+		uint32_t used = 0;
 	};
 	std::vector<ThreadData> threadData;
 
-	vks::ThreadPool threadPool;
+	vks::JobSystem jobSystem;
 
 	// Fence to wait for all command buffers to finish before
 	// presenting to the swap chain
@@ -103,16 +120,13 @@ public:
 		camera.setRotation(glm::vec3(0.0f));
 		camera.setRotationSpeed(0.5f);
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
-		// Get number of max. concurrent threads
-		numThreads = std::thread::hardware_concurrency();
-		assert(numThreads > 0);
+		// Jobs are executed by one worker per additional core and the main thread
+		numThreads = jobSystem.getThreadCount();
 #if defined(__ANDROID__)
 		LOGD("numThreads = %d", numThreads);
 #else
 		std::cout << "numThreads = " << numThreads << std::endl;
 #endif
-		threadPool.setThreadCount(numThreads);
-		numObjectsPerThread = 512 / numThreads;
 		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
 	}
 
@@ -126,7 +140,9 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
 		for (auto& thread : threadData) {
-			vkFreeCommandBuffers(device, thread.commandPool, thread.commandBuffer.size(), thread.commandBuffer.data());
+			if (!thread.commandBuffers.empty()) {
+				vkFreeCommandBuffers(device, thread.commandPool, static_cast<uint32_t>(thread.commandBuffers.size()), thread.commandBuffers.data());
+			}
 			vkDestroyCommandPool(device, thread.commandPool, nullptr);
 		}
 
@@ -158,69 +174,73 @@ public:
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.ui));
 
 		threadData.resize(numThreads);
-
-		float maxX = std::floor(std::sqrt(numThreads * numObjectsPerThread));
-		uint32_t posX = 0;
-		uint32_t posZ = 0;
-
-		for (uint32_t i = 0; i < numThreads; i++) {
-			ThreadData *thread = &threadData[i];
-
+		for (auto& thread : threadData) {
 			// Create one command pool for each thread
 			VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
 			cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
 			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread->commandPool));
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread.commandPool));
+		}
 
-			// One secondary command buffer per object that is updated by this thread
-			thread->commandBuffer.resize(numObjectsPerThread);
-			// Generate secondary command buffers for each thread
+		objectData.resize(numObjects);
+		pushConstBlock.resize(numObjects);
+		objectCommandBuffers.resize(numObjects);
+		visibleObjects.resize(numObjects);
+		visibilityMask.resize((numObjects + 31) / 32);
+		boundingSpheres.x.resize(numObjects);
+		boundingSpheres.y.resize(numObjects);
+		boundingSpheres.z.resize(numObjects);
+		// Use a simple sphere check based on the radius of the mesh
+		boundingSpheres.radius.assign(numObjects, models.ufo.dimensions.radius * 0.5f);
+
+		for (uint32_t i = 0; i < numObjects; i++) {
+			float theta = 2.0f * float(M_PI) * rnd(1.0f);
+			float phi = acos(1.0f - 2.0f * rnd(1.0f));
+			objectData[i].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
+
+			objectData[i].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
+			objectData[i].deltaT = rnd(1.0f);
+			objectData[i].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
+			objectData[i].rotationSpeed = (2.0f + rnd(4.0f)) * objectData[i].rotationDir;
+			objectData[i].scale = 0.75f + rnd(0.5f);
+
+			pushConstBlock[i].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
+
+			boundingSpheres.x[i] = objectData[i].pos.x;
+			boundingSpheres.y[i] = objectData[i].pos.y;
+			boundingSpheres.z[i] = objectData[i].pos.z;
+		}
+	}
+
+	// Get an unused secondary command buffer from the calling thread's pool
+	VkCommandBuffer getThreadCommandBuffer(uint32_t threadIndex)
+	{
+		ThreadData *thread = &threadData[threadIndex];
+		if (thread->used == thread->commandBuffers.size()) {
+			// Grow in chunks so allocations stop after the first frames
+			const uint32_t first = static_cast<uint32_t>(thread->commandBuffers.size());
+			const uint32_t count = std::max(first, objectsPerJob);
+			thread->commandBuffers.resize(first + count);
 			VkCommandBufferAllocateInfo secondaryCmdBufAllocateInfo =
 				vks::initializers::commandBufferAllocateInfo(
 					thread->commandPool,
 					VK_COMMAND_BUFFER_LEVEL_SECONDARY,
-					thread->commandBuffer.size());
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &secondaryCmdBufAllocateInfo, thread->commandBuffer.data()));
-
-			thread->pushConstBlock.resize(numObjectsPerThread);
-			thread->objectData.resize(numObjectsPerThread);
-
-			for (uint32_t j = 0; j < numObjectsPerThread; j++) {
-				float theta = 2.0f * float(M_PI) * rnd(1.0f);
-				float phi = acos(1.0f - 2.0f * rnd(1.0f));
-				thread->objectData[j].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
-
-				thread->objectData[j].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
-				thread->objectData[j].deltaT = rnd(1.0f);
-				thread->objectData[j].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
-				thread->objectData[j].rotationSpeed = (2.0f + rnd(4.0f)) * thread->objectData[j].rotationDir;
-				thread->objectData[j].scale = 0.75f + rnd(0.5f);
-
-				thread->pushConstBlock[j].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
-			}
+					count);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &secondaryCmdBufAllocateInfo, &thread->commandBuffers[first]));
 		}
-
+		return thread->commandBuffers[thread->used++];
 	}
 
-	// Builds the secondary command buffer for each thread
-	void threadRenderCode(uint32_t threadIndex, uint32_t cmdBufferIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
+	// Builds the secondary command buffer for a visible object
+	VkCommandBuffer threadRenderCode(uint32_t threadIndex, uint32_t objectIndex, const VkCommandBufferInheritanceInfo& inheritanceInfo)
 	{
-		ThreadData *thread = &threadData[threadIndex];
-		ObjectData *objectData = &thread->objectData[cmdBufferIndex];
-
-		// Check visibility against view frustum using a simple sphere check based on the radius of the mesh
-		objectData->visible = frustum.checkSphere(objectData->pos, models.ufo.dimensions.radius * 0.5f);
-
-		if (!objectData->visible)
-		{
-			return;
-		}
+		ObjectData *objectData = &this->objectData[objectIndex];
 
 		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
 		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
 		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
 
-		VkCommandBuffer cmdBuffer = thread->commandBuffer[cmdBufferIndex];
+		VkCommandBuffer cmdBuffer = getThreadCommandBuffer(threadIndex);
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &commandBufferBeginInfo));
 
@@ -242,6 +262,7 @@ public:
 			if (objectData->deltaT > 1.0f)
 				objectData->deltaT -= 1.0f;
 			objectData->pos.y = sin(glm::radians(objectData->deltaT * 360.0f)) * 2.5f;
+			boundingSpheres.y[objectIndex] = objectData->pos.y;
 		}
 
 		objectData->model = glm::translate(glm::mat4(1.0f), objectData->pos);
@@ -250,7 +271,7 @@ public:
 		objectData->model = glm::rotate(objectData->model, glm::radians(objectData->deltaT * 360.0f), glm::vec3(0.0f, objectData->rotationDir, 0.0f));
 		objectData->model = glm::scale(objectData->model, glm::vec3(objectData->scale));
 
-		thread->pushConstBlock[cmdBufferIndex].mvp = matrices.projection * matrices.view * objectData->model;
+		pushConstBlock[objectIndex].mvp = matrices.projection * matrices.view * objectData->model;
 
 		// Update shader push constant block
 		// Contains model view matrix
@@ -260,7 +281,7 @@ public:
 			VK_SHADER_STAGE_VERTEX_BIT,
 			0,
 			sizeof(ThreadPushConstantBlock),
-			&thread->pushConstBlock[cmdBufferIndex]);
+			&pushConstBlock[objectIndex]);
 
 		VkDeviceSize offsets[1] = { 0 };
 		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &models.ufo.vertices.buffer, offsets);
@@ -268,6 +289,8 @@ public:
 		vkCmdDrawIndexed(cmdBuffer, models.ufo.indices.count, 1, 0, 0, 0);
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+
+		return cmdBuffer;
 	}
 
 	void updateSecondaryCommandBuffers(VkCommandBufferInheritanceInfo inheritanceInfo)
@@ -326,9 +349,9 @@ public:
 		VK_CHECK_RESULT(vkEndCommandBuffer(secondaryCommandBuffers.ui));
 	}
 
-	// Updates the secondary command buffers using a thread pool
+	// Updates the secondary command buffers using the job system
 	// and puts them into the primary command buffer that's
-	// lat submitted to the queue for rendering
+	// later submitted to the queue for rendering
 	void updateCommandBuffers(VkFramebuffer frameBuffer)
 	{
 		// Contains the list of secondary command buffers to be submitted
@@ -371,28 +394,23 @@ public:
 			commandBuffers.push_back(secondaryCommandBuffers.background);
 		}
 
-		// Add a job to the thread's queue for each object to be rendered
-		for (uint32_t t = 0; t < numThreads; t++)
-		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
-			{
-				threadPool.threads[t]->addJob([=] { threadRenderCode(t, i, inheritanceInfo); });
-			}
+		// The command buffers of the last frame are no longer in use (see renderFence)
+		for (auto& thread : threadData) {
+			thread.used = 0;
 		}
 
-		threadPool.wait();
+		// Cull all objects against the view frustum at once, only visible objects get a command buffer
+		visibleObjectCount = frustum.cullSpheres(boundingSpheres.x.data(), boundingSpheres.y.data(), boundingSpheres.z.data(), boundingSpheres.radius.data(), numObjects, visibleObjects.data(), visibilityMask.data());
 
-		// Only submit if object is within the current view frustum
-		for (uint32_t t = 0; t < numThreads; t++)
-		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
-			{
-				if (threadData[t].objectData[i].visible)
-				{
-					commandBuffers.push_back(threadData[t].commandBuffer[i]);
-				}
+		// Split the visible objects into ranges that are distributed across all threads, idle threads steal ranges from busy ones
+		jobSystem.parallelFor(visibleObjectCount, objectsPerJob, [&](uint32_t begin, uint32_t end) {
+			const uint32_t threadIndex = jobSystem.getThreadIndex();
+			for (uint32_t i = begin; i < end; i++) {
+				objectCommandBuffers[i] = threadRenderCode(threadIndex, visibleObjects[i], inheritanceInfo);
 			}
-		}
+		});
+
+		commandBuffers.insert(commandBuffers.end(), objectCommandBuffers.begin(), objectCommandBuffers.begin() + visibleObjectCount);
 
 		// Render ui last
 		if (UIOverlay.visible) {
@@ -410,8 +428,9 @@ public:
 	void loadAssets()
 	{
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
-		models.ufo.loadFromFile(getAssetPath() + "models/retroufo_red_lowpoly.gltf",vulkanDevice, queue,glTFLoadingFlags);
-		models.starSphere.loadFromFile(getAssetPath() + "models/sphere.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		// The loader shares the sample's job system instead of starting its own threads
+		models.ufo.loadFromFile(getAssetPath() + "models/retroufo_red_lowpoly.gltf",vulkanDevice, queue,glTFLoadingFlags, 1.0f, &jobSystem);
+		models.starSphere.loadFromFile(getAssetPath() + "models/sphere.gltf", vulkanDevice, queue, glTFLoadingFlags, 1.0f, &jobSystem);
 	}
 
 	void setupPipelineLayout()
@@ -480,6 +499,11 @@ public:
 
 	void draw()
 	{
+		// Acquire the next image first, so nothing is submitted if the swap chain has to be recreated
+		if (!VulkanExampleBase::prepareFrame()) {
+			return;
+		}
+
 		// Wait for fence to signal that all command buffers are ready
 		VkResult fenceRes;
 		do {
@@ -488,8 +512,6 @@ public:
 		VK_CHECK_RESULT(fenceRes);
 		vkResetFences(device, 1, &renderFence);
 
-		VulkanExampleBase::prepareFrame();
-
 		updateCommandBuffers(frameBuffers[currentBuffer]);
 
 		submitInfo.commandBufferCount = 1;
@@ -534,6 +556,7 @@ public:
 	{
 		if (overlay->header("Statistics")) {
 			overlay->text("Active threads: %d", numThreads);
+			overlay->text("Visible objects: %d / %d", visibleObjectCount, numObjects);
 		}
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Stars", &displayStarSphere);
@@ -16,7 +16,8 @@ class VulkanExample: public VulkanExampleBase
 public:
 	vkglTF::Model scene;
 
-	vks::Buffer uniformBuffer;
+	// One uniform buffer per frame in flight, so the CPU can update the buffer of the next frame while the GPU still reads the one of the current frame
+	std::vector<vks::Buffer> uniformBuffers;
 
 	// Same uniform buffer layout as shader
 	struct UBOVS {
@@ -26,7 +27,7 @@ public:
 	} uboVS;
 
 	VkPipelineLayout pipelineLayout;
-	VkDescriptorSet descriptorSet;
+	std::vector<VkDescriptorSet> descriptorSets;
 	VkDescriptorSetLayout descriptorSetLayout;
 
 	struct {
@@ -35,6 +36,17 @@ public:
 		VkPipeline toon;
 	} pipelines;
 
+	// The toon and wireframe pipelines are compiled on the device's job system, the phong pipeline is used in their place until they are done
+	struct {
+		vks::PipelineBuilder::Future wireframe;
+		vks::PipelineBuilder::Future toon;
+	} pipelineFutures;
+
+	// Shader module identifiers let the driver create pipelines that are already in the pipeline cache (loaded from disk) without the SPIR-V
+	bool moduleIdentifiers = false;
+	VkPhysicalDevicePipelineCreationCacheControlFeaturesEXT pipelineCreationCacheControlFeatures{};
+	VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT shaderModuleIdentifierFeatures{};
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Pipeline state objects";
@@ -43,23 +55,34 @@ public:
 		camera.setRotation(glm::vec3(-25.0f, 15.0f, 0.0f));
 		camera.setRotationSpeed(0.5f);
 		camera.setPerspective(60.0f, (float)(width / 3.0f) / (float)height, 0.1f, 256.0f);
+		// Record the next frame on the CPU while the GPU is still busy with the previous one
+		useFramesInFlight = true;
+		// Required to query the features of the shader module identifier extension
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 	}
 
 	~VulkanExample()
 	{
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
+		// Pipelines may still be compiling if the example is closed right after startup
+		pipelineBuilder.wait();
 		vkDestroyPipeline(device, pipelines.phong, nullptr);
-		if (enabledFeatures.fillModeNonSolid)
+		if (pipelineFutures.wireframe.valid())
+		{
+			vkDestroyPipeline(device, pipelineFutures.wireframe.get(), nullptr);
+		}
+		if (pipelineFutures.toon.valid())
 		{
-			vkDestroyPipeline(device, pipelines.wireframe, nullptr);
+			vkDestroyPipeline(device, pipelineFutures.toon.get(), nullptr);
 		}
-		vkDestroyPipeline(device, pipelines.toon, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		uniformBuffer.destroy();
+		for (auto& uniformBuffer : uniformBuffers) {
+			uniformBuffer.destroy();
+		}
 	}
 
 	// Enable physical device features required for this example
@@ -76,7 +99,31 @@ public:
 		}
 	}
 
-	void buildCommandBuffers()
+	// Enable shader module identifiers if supported, the base's shader registry then passes identifiers instead of modules when creating pipelines
+	virtual void getEnabledExtensions()
+	{
+		if (!vulkanDevice->extensionSupported(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME) || !vulkanDevice->extensionSupported(VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME)) {
+			return;
+		}
+		pipelineCreationCacheControlFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES_EXT;
+		pipelineCreationCacheControlFeatures.pNext = &shaderModuleIdentifierFeatures;
+		shaderModuleIdentifierFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2KHR deviceFeatures2{};
+		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		deviceFeatures2.pNext = &pipelineCreationCacheControlFeatures;
+		PFN_vkGetPhysicalDeviceFeatures2KHR vkGetPhysicalDeviceFeatures2KHR = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+		vkGetPhysicalDeviceFeatures2KHR(physicalDevice, &deviceFeatures2);
+		moduleIdentifiers = pipelineCreationCacheControlFeatures.pipelineCreationCacheControl && shaderModuleIdentifierFeatures.shaderModuleIdentifier;
+		if (moduleIdentifiers) {
+			enabledDeviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME);
+			enabledDeviceExtensions.push_back(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME);
+			// Both structures only hold the feature we need, so the queried chain can be passed to device creation as is
+			deviceCreatepNextChain = &pipelineCreationCacheControlFeatures;
+		}
+	}
+
+	// Command buffers are recorded every frame, into the command buffer of the current frame in flight targeting the acquired swap chain image
+	void buildCommandBuffer()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -93,56 +140,58 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
+		VkCommandBuffer cmdBuffer = drawCmdBuffers[currentFrame];
+		// Target the frame buffer of the acquired swap chain image
+		renderPassBeginInfo.framebuffer = frameBuffers[currentBuffer];
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// Command buffers are recorded every frame, so variants are picked up as soon as they have been compiled
+		pipelines.toon = vks::PipelineBuilder::getOr(pipelineFutures.toon, pipelines.phong);
+		pipelines.wireframe = vks::PipelineBuilder::getOr(pipelineFutures.wireframe, pipelines.phong);
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height,	0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-			scene.bindBuffers(drawCmdBuffers[i]);
+		VkRect2D scissor = vks::initializers::rect2D(width, height,	0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-			// Left : Solid colored
-			viewport.width = (float)width / 3.0;
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
-			vkCmdSetLineWidth(drawCmdBuffers[i], 1.0f);
-			scene.draw(drawCmdBuffers[i]);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, NULL);
+		scene.bindBuffers(cmdBuffer);
 
-			// Center : Toon
-			viewport.x = (float)width / 3.0;
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.toon);
-			// Line width > 1.0f only if wide lines feature is supported
-			if (enabledFeatures.wideLines) {
-				vkCmdSetLineWidth(drawCmdBuffers[i], 2.0f);
-			}
-			scene.draw(drawCmdBuffers[i]);
+		// Left : Solid colored
+		viewport.width = (float)width / 3.0;
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
+		vkCmdSetLineWidth(cmdBuffer, 1.0f);
+		scene.draw(cmdBuffer);
 
-			if (enabledFeatures.fillModeNonSolid)
-			{
-				// Right : Wireframe
-				viewport.x = (float)width / 3.0 + (float)width / 3.0;
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.wireframe);
-				scene.draw(drawCmdBuffers[i]);
-			}
+		// Center : Toon
+		viewport.x = (float)width / 3.0;
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.toon);
+		// Line width > 1.0f only if wide lines feature is supported
+		if (enabledFeatures.wideLines) {
+			vkCmdSetLineWidth(cmdBuffer, 2.0f);
+		}
+		scene.draw(cmdBuffer);
 
-			drawUI(drawCmdBuffers[i]);
+		if (enabledFeatures.fillModeNonSolid)
+		{
+			// Right : Wireframe
+			viewport.x = (float)width / 3.0 + (float)width / 3.0;
+			vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.wireframe);
+			scene.draw(cmdBuffer);
+		}
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		drawUI(cmdBuffer);
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
+		vkCmdEndRenderPass(cmdBuffer);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 	}
 
 	void loadAssets()
@@ -155,14 +204,14 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxFramesInFlight)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				poolSizes.size(),
 				poolSizes.data(),
-				2);
+				maxFramesInFlight);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -193,27 +242,32 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
-	void setupDescriptorSet()
+	void setupDescriptorSets()
 	{
-		VkDescriptorSetAllocateInfo allocInfo =
-			vks::initializers::descriptorSetAllocateInfo(
-				descriptorPool,
-				&descriptorSetLayout,
-				1);
-
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
-
-		std::vector<VkWriteDescriptorSet> writeDescriptorSets =
+		// One descriptor set per frame in flight, each pointing to the uniform buffer of that frame
+		descriptorSets.resize(maxFramesInFlight);
+		for (uint32_t i = 0; i < maxFramesInFlight; i++)
 		{
-			// Binding 0 : Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(
-				descriptorSet,
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				0,
-				&uniformBuffer.descriptor)
-		};
+			VkDescriptorSetAllocateInfo allocInfo =
+				vks::initializers::descriptorSetAllocateInfo(
+					descriptorPool,
+					&descriptorSetLayout,
+					1);
 
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i]));
+
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets =
+			{
+				// Binding 0 : Vertex shader uniform buffer
+				vks::initializers::writeDescriptorSet(
+					descriptorSets[i],
+					VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+					0,
+					&uniformBuffers[i].descriptor)
+			};
+
+			vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+		}
 	}
 
 	void preparePipelines()
@@ -253,7 +307,8 @@ public:
 		// Phong shading pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "pipelines/phong.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "pipelines/phong.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phong));
+		// Created through the shader registry, which tries the pipeline cache with the shader module identifiers first
+		VK_CHECK_RESULT(shaderRegistry.createGraphicsPipeline(pipelineCache, pipelineCI, &pipelines.phong));
 
 		// All pipelines created after the base pipeline will be derivatives
 		pipelineCI.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
@@ -263,10 +318,12 @@ public:
 		// As we use the handle, we must set the index to -1 (see section 9.5 of the specification)
 		pipelineCI.basePipelineIndex = -1;
 
+		// The remaining pipelines are compiled in parallel as jobs, the builder copies the create info so it can be changed for the next pipeline right away
+
 		// Toon shading pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "pipelines/toon.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "pipelines/toon.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.toon));
+		pipelineFutures.toon = pipelineBuilder.build(pipelineCI);
 
 		// Pipeline for wire frame rendering
 		// Non solid rendering is not a mandatory Vulkan feature
@@ -275,40 +332,49 @@ public:
 			rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
 			shaderStages[0] = loadShader(getShadersPath() + "pipelines/wireframe.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 			shaderStages[1] = loadShader(getShadersPath() + "pipelines/wireframe.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
+			pipelineFutures.wireframe = pipelineBuilder.build(pipelineCI);
 		}
 	}
 
-	// Prepare and initialize uniform buffer containing shader uniforms
+	// Prepare and initialize uniform buffers containing shader uniforms
 	void prepareUniformBuffers()
 	{
-		// Create the vertex shader uniform buffer block
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffer,
-			sizeof(uboVS)));
-
-		// Map persistent
-		VK_CHECK_RESULT(uniformBuffer.map());
-
-		updateUniformBuffers();
+		uniformBuffers.resize(maxFramesInFlight);
+		for (auto& uniformBuffer : uniformBuffers)
+		{
+			// Create the vertex shader uniform buffer block
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&uniformBuffer,
+				sizeof(uboVS)));
+
+			// Map persistent
+			VK_CHECK_RESULT(uniformBuffer.map());
+		}
 	}
 
+	// Only the uniform buffer of the current frame may be written, the others may still be read by the GPU
 	void updateUniformBuffers()
 	{
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.modelView = camera.matrices.view;
-		memcpy(uniformBuffer.mapped, &uboVS, sizeof(uboVS));
+		memcpy(uniformBuffers[currentFrame].mapped, &uboVS, sizeof(uboVS));
 	}
 
 	void draw()
 	{
-		VulkanExampleBase::prepareFrame();
+		// Waits for the fence of the current frame, after that its uniform buffer and command buffer can be reused
+		if (!VulkanExampleBase::prepareFrame()) {
+			return;
+		}
+
+		updateUniformBuffers();
+		buildCommandBuffer();
 
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentFrame];
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, waitFences[currentFrame]));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -321,8 +387,7 @@ public:
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
-		setupDescriptorSet();
-		buildCommandBuffers();
+		setupDescriptorSets();
 		prepared = true;
 	}
 
@@ -331,19 +396,23 @@ public:
 		if (!prepared)
 			return;
 		draw();
-		if (camera.updated) {
-			updateUniformBuffers();
-		}
 	}
 
 	virtual void viewChanged()
 	{
 		camera.setPerspective(60.0f, (float)(width / 3.0f) / (float)height, 0.1f, 256.0f);
-		updateUniformBuffers();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
+		if (overlay->header("Pipeline builds")) {
+			const vks::PipelineBuilder::Statistics stats = pipelineBuilder.getStatistics();
+			overlay->text("%u built on %u threads (%.1f ms)", stats.built, pipelineBuilder.getThreadCount(), stats.buildTime);
+			overlay->text("%u pending", pipelineBuilder.getPendingCount());
+			if (moduleIdentifiers) {
+				overlay->text("%u created from module identifiers", shaderRegistry.getStatistics().identifierPipelines);
+			}
+		}
 		if (!enabledFeatures.fillModeNonSolid) {
 			if (overlay->header("Info")) {
 				overlay->text("Non solid fill modes not supported!");
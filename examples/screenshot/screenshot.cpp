@@ -8,6 +8,8 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanReadback.h"
+#include "imagewriter.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -30,6 +32,18 @@ public:
 	VkDescriptorSet descriptorSet;
 
 	bool screenshotSaved = false;
+	bool screenshotRequested = false;
+	// Capture every frame as an image sequence
+	bool captureFrames = false;
+	uint32_t sequenceFrame = 0;
+
+	// Should be larger than the number of frames the GPU can be behind, otherwise captures are dropped
+	const uint32_t readbackSlotCount = 4;
+	vks::ReadbackRing readback;
+	// One command buffer per readback slot, recorded when a capture is started
+	std::vector<VkCommandBuffer> captureCmdBuffers;
+	// Created once the device's job system is available
+	std::unique_ptr<vks::ImageWriter> imageWriter;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -46,6 +60,10 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		uniformBuffer.destroy();
+		readback.flush();
+		readback.destroy();
+		// Finishes writing the captures before the device's job system is destroyed
+		imageWriter.reset();
 	}
 
 	void loadAssets()
@@ -179,226 +197,95 @@ public:
 		uniformBuffer.copyTo(&uboVS, sizeof(uboVS));
 	}
 
-	// Take a screenshot from the current swapchain image
-	// This is done using a blit from the swapchain image to a linear image whose memory content is then saved as a ppm image
-	// Getting the image date directly from a swapchain image wouldn't work as they're usually stored in an implementation dependent optimal tiling format
+	// Captures are copied from the swapchain image into a ring of host visible buffers at the end of the frame's submission
+	// The readback ring hands the data over once the copy has finished on the GPU (usually one or more frames later), so capturing never waits for the queue
+	// Encoding and writing the image files is done as jobs on the device's job system
 	// Note: This requires the swapchain images to be created with the VK_IMAGE_USAGE_TRANSFER_SRC_BIT flag (see VulkanSwapChain::create)
-	void saveScreenshot(const char *filename)
+	// Note: The readback copies the swapchain image as is, so only formats with 8 bits per channel are supported
+	void prepareReadback()
 	{
-		screenshotSaved = false;
-		bool supportsBlit = true;
-
-		// Check blit support for source and destination
-		VkFormatProperties formatProps;
-
-		// Check if the device supports blitting from optimal images (the swapchain images are in optimal format)
-		vkGetPhysicalDeviceFormatProperties(physicalDevice, swapChain.colorFormat, &formatProps);
-		if (!(formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT)) {
-			std::cerr << "Device does not support blitting from optimal tiled images, using copy instead of blit!" << std::endl;
-			supportsBlit = false;
-		}
-
-		// Check if the device supports blitting to linear images
-		vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProps);
-		if (!(formatProps.linearTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT)) {
-			std::cerr << "Device does not support blitting to linear tiled images, using copy instead of blit!" << std::endl;
-			supportsBlit = false;
+		// Nothing can be captured while the window is minimized, captures are dropped until it's restored
+		if ((width > 0) && (height > 0)) {
+			readback.create(physicalDevice, device, width, height, swapChain.colorFormat, readbackSlotCount);
 		}
-
-		// Source for the copy is the last rendered swapchain image
-		VkImage srcImage = swapChain.images[currentBuffer];
-
-		// Create the linear tiled destination image to copy to and to read the memory from
-		VkImageCreateInfo imageCreateCI(vks::initializers::imageCreateInfo());
-		imageCreateCI.imageType = VK_IMAGE_TYPE_2D;
-		// Note that vkCmdBlitImage (if supported) will also do format conversions if the swapchain color format would differ
-		imageCreateCI.format = VK_FORMAT_R8G8B8A8_UNORM;
-		imageCreateCI.extent.width = width;
-		imageCreateCI.extent.height = height;
-		imageCreateCI.extent.depth = 1;
-		imageCreateCI.arrayLayers = 1;
-		imageCreateCI.mipLevels = 1;
-		imageCreateCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateCI.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCreateCI.tiling = VK_IMAGE_TILING_LINEAR;
-		imageCreateCI.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-		// Create the image
-		VkImage dstImage;
-		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateCI, nullptr, &dstImage));
-		// Create memory to back up the image
-		VkMemoryRequirements memRequirements;
-		VkMemoryAllocateInfo memAllocInfo(vks::initializers::memoryAllocateInfo());
-		VkDeviceMemory dstImageMemory;
-		vkGetImageMemoryRequirements(device, dstImage, &memRequirements);
-		memAllocInfo.allocationSize = memRequirements.size;
-		// Memory must be host visible to copy from
-		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &dstImageMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device, dstImage, dstImageMemory, 0));
-
-		// Do the actual blit from the swapchain image to our host visible destination image
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		// Transition destination image to transfer destination layout
-		vks::tools::insertImageMemoryBarrier(
-			copyCmd,
-			dstImage,
-			0,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-		// Transition swapchain image from present to transfer source layout
-		vks::tools::insertImageMemoryBarrier(
-			copyCmd,
-			srcImage,
-			VK_ACCESS_MEMORY_READ_BIT,
-			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-		// If source and destination support blit we'll blit as this also does automatic format conversion (e.g. from BGR to RGB)
-		if (supportsBlit)
-		{
-			// Define the region to blit (we will blit the whole swapchain image)
-			VkOffset3D blitSize;
-			blitSize.x = width;
-			blitSize.y = height;
-			blitSize.z = 1;
-			VkImageBlit imageBlitRegion{};
-			imageBlitRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlitRegion.srcSubresource.layerCount = 1;
-			imageBlitRegion.srcOffsets[1] = blitSize;
-			imageBlitRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlitRegion.dstSubresource.layerCount = 1;
-			imageBlitRegion.dstOffsets[1] = blitSize;
-
-			// Issue the blit command
-			vkCmdBlitImage(
-				copyCmd,
-				srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1,
-				&imageBlitRegion,
-				VK_FILTER_NEAREST);
-		}
-		else
-		{
-			// Otherwise use image copy (requires us to manually flip components)
-			VkImageCopy imageCopyRegion{};
-			imageCopyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageCopyRegion.srcSubresource.layerCount = 1;
-			imageCopyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageCopyRegion.dstSubresource.layerCount = 1;
-			imageCopyRegion.extent.width = width;
-			imageCopyRegion.extent.height = height;
-			imageCopyRegion.extent.depth = 1;
-
-			// Issue the copy command
-			vkCmdCopyImage(
-				copyCmd,
-				srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1,
-				&imageCopyRegion);
+		if (captureCmdBuffers.empty()) {
+			captureCmdBuffers.resize(readbackSlotCount);
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, readbackSlotCount);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, captureCmdBuffers.data()));
 		}
+	}
 
-		// Transition destination image to general layout, which is the required layout for mapping the image memory later on
-		vks::tools::insertImageMemoryBarrier(
-			copyCmd,
-			dstImage,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_MEMORY_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_GENERAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-		// Transition back the swap chain image after the blit is done
-		vks::tools::insertImageMemoryBarrier(
-			copyCmd,
-			srcImage,
-			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_ACCESS_MEMORY_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-		vulkanDevice->flushCommandBuffer(copyCmd, queue);
-
-		// Get layout of the image (including row pitch)
-		VkImageSubresource subResource { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
-		VkSubresourceLayout subResourceLayout;
-		vkGetImageSubresourceLayout(device, dstImage, &subResource, &subResourceLayout);
-
-		// Map image memory so we can start copying from it
-		const char* data;
-		vkMapMemory(device, dstImageMemory, 0, VK_WHOLE_SIZE, 0, (void**)&data);
-		data += subResourceLayout.offset;
-
-		std::ofstream file(filename, std::ios::out | std::ios::binary);
-
-		// ppm header
-		file << "P6\n" << width << "\n" << height << "\n" << 255 << "\n";
-
-		// If source is BGR (destination is always RGB) and we can't use blit (which does automatic conversion), we'll have to manually swizzle color components
-		bool colorSwizzle = false;
-		// Check if source is BGR
+	// Called by the readback ring once the copy of a captured frame has finished
+	void saveCapture(const vks::ReadbackRing::Frame& frame, const std::string& filename)
+	{
+		vks::image::ImageData image;
+		image.width = frame.width;
+		image.height = frame.height;
+		// If source is BGR (destination is always RGB) the image writer swizzles the color components
 		// Note: Not complete, only contains most common and basic BGR surface formats for demonstration purposes
-		if (!supportsBlit)
-		{
-			std::vector<VkFormat> formatsBGR = { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM };
-			colorSwizzle = (std::find(formatsBGR.begin(), formatsBGR.end(), swapChain.colorFormat) != formatsBGR.end());
-		}
+		std::vector<VkFormat> formatsBGR = { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM };
+		image.bgra = (std::find(formatsBGR.begin(), formatsBGR.end(), frame.format) != formatsBGR.end());
+		image.pixels.assign(frame.data, frame.data + static_cast<size_t>(frame.rowPitch) * frame.height);
+		imageWriter->write(filename, std::move(image));
+	}
 
-		// ppm binary pixel data
-		for (uint32_t y = 0; y < height; y++)
-		{
-			unsigned int *row = (unsigned int*)data;
-			for (uint32_t x = 0; x < width; x++)
-			{
-				if (colorSwizzle)
-				{
-					file.write((char*)row+2, 1);
-					file.write((char*)row+1, 1);
-					file.write((char*)row, 1);
-				}
-				else
-				{
-					file.write((char*)row, 3);
-				}
-				row++;
+	// Records the copy of the current swapchain image if a screenshot has been requested or all frames are captured
+	// Returns the command buffer to submit after the frame's command buffer, or VK_NULL_HANDLE if nothing is captured this frame
+	VkCommandBuffer recordCapture(int32_t& slot)
+	{
+		slot = -1;
+		if (!screenshotRequested && !captureFrames) {
+			return VK_NULL_HANDLE;
+		}
+		const bool screenshot = screenshotRequested;
+		std::string filename = "screenshot.png";
+		if (!screenshot) {
+			// Image sequence, QOI is much faster to encode than PNG and keeps up with the frame rate
+			char name[32];
+			snprintf(name, sizeof(name), "capture_%05u.qoi", sequenceFrame);
+			filename = name;
+		}
+		slot = readback.beginCapture([this, filename, screenshot](const vks::ReadbackRing::Frame& frame) {
+			saveCapture(frame, filename);
+			if (screenshot) {
+				screenshotSaved = true;
+				std::cout << "Screenshot saved to disk" << std::endl;
 			}
-			data += subResourceLayout.rowPitch;
+		});
+		if (slot < 0) {
+			// All slots are still in flight, the frame is skipped instead of stalling
+			return VK_NULL_HANDLE;
 		}
-		file.close();
-
-		std::cout << "Screenshot saved to disk" << std::endl;
-
-		// Clean up resources
-		vkUnmapMemory(device, dstImageMemory);
-		vkFreeMemory(device, dstImageMemory, nullptr);
-		vkDestroyImage(device, dstImage, nullptr);
-
-		screenshotSaved = true;
+		if (screenshot) {
+			screenshotRequested = false;
+		} else {
+			sequenceFrame++;
+		}
+		// The slot's previous capture has been delivered, so its command buffer is no longer in use
+		VkCommandBuffer cmdBuffer = captureCmdBuffers[slot];
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+		// The render pass leaves the swapchain image in present layout, it's transitioned back after the copy
+		readback.recordCopy(slot, cmdBuffer, swapChain.images[currentBuffer], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+		return cmdBuffer;
 	}
 
 	void draw()
 	{
-		VulkanExampleBase::prepareFrame();
+		if (!VulkanExampleBase::prepareFrame()) {
+			return;
+		}
 
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		// The capture copy is part of the same submission, so it's finished before the image is presented
+		int32_t captureSlot;
+		std::array<VkCommandBuffer, 2> cmdBuffers = { drawCmdBuffers[currentBuffer], recordCapture(captureSlot) };
+		submitInfo.commandBufferCount = (captureSlot >= 0) ? 2 : 1;
+		submitInfo.pCommandBuffers = cmdBuffers.data();
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		if (captureSlot >= 0) {
+			readback.endCapture(captureSlot, queue);
+		}
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -413,6 +300,8 @@ public:
 		setupDescriptorPool();
 		setupDescriptorSet();
 		buildCommandBuffers();
+		imageWriter.reset(new vks::ImageWriter(&vulkanDevice->getJobSystem(), 8));
+		prepareReadback();
 		prepared = true;
 	}
 
@@ -420,9 +309,19 @@ public:
 	{
 		if (!prepared)
 			return;
+		// Hand finished captures to the image writer
+		readback.poll();
 		draw();
 	}
 
+	virtual void windowResized()
+	{
+		// The readback buffers have to match the new swapchain size
+		readback.flush();
+		readback.destroy();
+		prepareReadback();
+	}
+
 	virtual void viewChanged()
 	{
 		updateUniformBuffers();
@@ -432,10 +331,16 @@ public:
 	{
 		if (overlay->header("Functions")) {
 			if (overlay->button("Take screenshot")) {
-				saveScreenshot("screenshot.ppm");
+				screenshotSaved = false;
+				screenshotRequested = true;
 			}
 			if (screenshotSaved) {
-				overlay->text("Screenshot saved as screenshot.ppm");
+				overlay->text("Screenshot saved as screenshot.png");
+			}
+			overlay->checkBox("Capture all frames", &captureFrames);
+			if (sequenceFrame > 0) {
+				overlay->text("Captured frames: %u", sequenceFrame);
+				overlay->text("Dropped frames: %u", static_cast<uint32_t>(readback.getDroppedCount()));
 			}
 		}
 	}
@@ -9,6 +9,7 @@
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 #include "frustum.hpp"
+#include "VulkanTerrain.h"
 #include <ktx.h>
 #include <ktxvulkan.h>
 
@@ -19,6 +20,8 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool wireframe = false;
 	bool tessellation = true;
+	// Render a streamed 16k x 16k heightfield made of quadtree chunks instead of the tessellated patch grid
+	bool streamed = false;
 
 	// Holds the buffers for rendering the tessellated terrain
 	struct {
@@ -33,6 +36,10 @@ public:
 		} indices;
 	} terrain;
 
+	// Virtual 16k heightfield upsampled from the heightmap, the source has to outlive the chunked terrain
+	std::unique_ptr<vks::TerrainHeightMapSource> chunkedTerrainSource;
+	vks::ChunkedTerrain chunkedTerrain;
+
 	struct {
 		vks::Texture2D heightMap;
 		vks::Texture2D skySphere;
@@ -69,6 +76,8 @@ public:
 	struct Pipelines {
 		VkPipeline terrain;
 		VkPipeline wireframe = VK_NULL_HANDLE;
+		VkPipeline chunks = VK_NULL_HANDLE;
+		VkPipeline chunksWireframe = VK_NULL_HANDLE;
 		VkPipeline skysphere;
 	} pipelines;
 
@@ -116,6 +125,12 @@ public:
 		if (pipelines.wireframe != VK_NULL_HANDLE) {
 			vkDestroyPipeline(device, pipelines.wireframe, nullptr);
 		}
+		if (pipelines.chunks != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.chunks, nullptr);
+		}
+		if (pipelines.chunksWireframe != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.chunksWireframe, nullptr);
+		}
 		vkDestroyPipeline(device, pipelines.skysphere, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.skysphere, nullptr);
@@ -135,6 +150,7 @@ public:
 		vkFreeMemory(device, terrain.vertices.memory, nullptr);
 		vkDestroyBuffer(device, terrain.indices.buffer, nullptr);
 		vkFreeMemory(device, terrain.indices.memory, nullptr);
+		chunkedTerrain.destroy();
 
 		if (queryPool != VK_NULL_HANDLE) {
 			vkDestroyQueryPool(device, queryPool, nullptr);
@@ -227,6 +243,7 @@ public:
 
 	void loadAssets()
 	{
+		vulkanDevice->uploadManager.begin(queue);
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
 		models.skysphere.loadFromFile(getAssetPath() + "models/sphere.gltf", vulkanDevice, queue, glTFLoadingFlags);
 
@@ -274,9 +291,18 @@ public:
 		}
 		VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &textures.terrainArray.sampler));
 		textures.terrainArray.descriptor.sampler = textures.terrainArray.sampler;
+		vulkanDevice->uploadManager.end();
 	}
 
 	void buildCommandBuffers()
+	{
+		for (uint32_t i = 0; i < drawCmdBuffers.size(); ++i)
+		{
+			buildCommandBuffer(i);
+		}
+	}
+
+	void buildCommandBuffer(uint32_t i)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -293,55 +319,64 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
+		renderPassBeginInfo.framebuffer = frameBuffers[i];
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			if (deviceFeatures.pipelineStatisticsQuery) {
-				vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 2);
-			}
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 2);
+		}
+
+		if (streamed) {
+			// Copy chunks finished since the last frame into their vertex buffer slots
+			chunkedTerrain.recordUploads(drawCmdBuffers[i]);
+		}
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			vkCmdSetLineWidth(drawCmdBuffers[i], 1.0f);
+		vkCmdSetLineWidth(drawCmdBuffers[i], 1.0f);
 
-			VkDeviceSize offsets[1] = { 0 };
+		VkDeviceSize offsets[1] = { 0 };
 
-			// Skysphere
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skysphere);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.skysphere, 0, 1, &descriptorSets.skysphere, 0, nullptr);
-			models.skysphere.draw(drawCmdBuffers[i]);
+		// Skysphere
+		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skysphere);
+		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.skysphere, 0, 1, &descriptorSets.skysphere, 0, nullptr);
+		models.skysphere.draw(drawCmdBuffers[i]);
 
-			// Tessellated terrain
-			if (deviceFeatures.pipelineStatisticsQuery) {
-				// Begin pipeline statistics query
-				vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, 0);
-			}
-			// Render
+		// Tessellated terrain
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// Begin pipeline statistics query
+			vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, 0);
+		}
+		// Render
+		if (streamed) {
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.chunksWireframe : pipelines.chunks);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.terrain, 0, 1, &descriptorSets.terrain, 0, nullptr);
+			chunkedTerrain.draw(drawCmdBuffers[i]);
+		}
+		else {
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.terrain);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.terrain, 0, 1, &descriptorSets.terrain, 0, nullptr);
 			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &terrain.vertices.buffer, offsets);
 			vkCmdBindIndexBuffer(drawCmdBuffers[i], terrain.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 			vkCmdDrawIndexed(drawCmdBuffers[i], terrain.indices.count, 1, 0, 0, 0);
-			if (deviceFeatures.pipelineStatisticsQuery) {
-				// End pipeline statistics query
-				vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
-			}
+		}
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// End pipeline statistics query
+			vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
+		}
 
-			drawUI(drawCmdBuffers[i]);
+		drawUI(drawCmdBuffers[i]);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		vkCmdEndRenderPass(drawCmdBuffers[i]);
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
 
 	// Encapsulate height map data for easy sampling
@@ -547,6 +582,72 @@ public:
 		delete[] indices;
 	}
 
+	// Set up the chunked terrain for a 16k x 16k heightfield, the heightmap is upsampled with some procedural detail added
+	// This is only done once the streamed terrain gets enabled, as the virtual heightfield and the chunk streaming aren't needed otherwise
+	void prepareChunkedTerrain()
+	{
+		if (chunkedTerrainSource) {
+			return;
+		}
+		chunkedTerrainSource.reset(new vks::TerrainHeightMapSource(getAssetPath() + "textures/terrain_heightmap_r16.ktx", 16384, 0.004f));
+		vks::ChunkedTerrain::Settings settings;
+		settings.tileSize = 2048;
+		settings.chunkResolution = 32;
+		// 1024 x 1024 units with the same relief as the tessellated terrain, heights are displaced along -y
+		settings.scale = glm::vec3(1.0f / 16.0f, -256.0f, 1.0f / 16.0f);
+		settings.memoryBudget = 96 * 1024 * 1024;
+		settings.pixelError = 1.5f;
+		settings.frameCount = static_cast<uint32_t>(drawCmdBuffers.size());
+		chunkedTerrain.create(vulkanDevice, queue, chunkedTerrainSource.get(), settings);
+		prepareChunkedTerrainPipelines();
+	}
+
+	void prepareChunkedTerrainPipelines()
+	{
+		// Chunks are plain triangle lists with heights already applied, culling is disabled as the skirts are seen from both sides
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_LINE_WIDTH };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+		shaderStages[0] = loadShader(getShadersPath() + "terraintessellation/terrainchunk.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "terraintessellation/terrain.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		VkVertexInputBindingDescription chunkVertexInputBinding = vks::initializers::vertexInputBindingDescription(0, sizeof(vks::ChunkedTerrain::Vertex), VK_VERTEX_INPUT_RATE_VERTEX);
+		std::array<VkVertexInputAttributeDescription, 3> chunkVertexInputAttributes = {
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vks::ChunkedTerrain::Vertex, pos)),
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vks::ChunkedTerrain::Vertex, normal)),
+			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32G32_SFLOAT, offsetof(vks::ChunkedTerrain::Vertex, uv)),
+		};
+		VkPipelineVertexInputStateCreateInfo chunkVertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		chunkVertexInputState.vertexBindingDescriptionCount = 1;
+		chunkVertexInputState.pVertexBindingDescriptions = &chunkVertexInputBinding;
+		chunkVertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(chunkVertexInputAttributes.size());
+		chunkVertexInputState.pVertexAttributeDescriptions = chunkVertexInputAttributes.data();
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayouts.terrain, renderPass);
+		pipelineCI.pVertexInputState = &chunkVertexInputState;
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.chunks));
+		if (deviceFeatures.fillModeNonSolid) {
+			rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.chunksWireframe));
+		}
+	}
+
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
@@ -573,10 +674,10 @@ public:
 		// Terrain
 		setLayoutBindings =
 		{
-			// Binding 0 : Shared Tessellation shader ubo
+			// Binding 0 : Shared Tessellation shader ubo (also used by the vertex shader of the streamed terrain chunks)
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
 				0),
 			// Binding 1 : Height map
 			vks::initializers::descriptorSetLayoutBinding(
@@ -712,6 +813,7 @@ public:
 		};
 
 		// Skysphere pipeline
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV });
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
 		// Revert to triangle list topology
@@ -784,7 +886,15 @@ public:
 
 	void draw()
 	{
-		VulkanExampleBase::prepareFrame();
+		if (!VulkanExampleBase::prepareFrame()) {
+			return;
+		}
+
+		if (streamed) {
+			// The selected chunks change with the camera, so the command buffer is recorded every frame
+			chunkedTerrain.update(camera.matrices.perspective, camera.matrices.view, (float)height, currentBuffer);
+			buildCommandBuffer(currentBuffer);
+		}
 
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
@@ -837,6 +947,16 @@ public:
 	{
 		if (overlay->header("Settings")) {
 
+			if (overlay->checkBox("Streamed 16k terrain", &streamed)) {
+				if (streamed) {
+					prepareChunkedTerrain();
+				}
+				// The streamed terrain is much larger than the tessellated one
+				camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, streamed ? 2048.0f : 512.0f);
+				camera.movementSpeed = streamed ? 40.0f : 10.0f;
+				updateUniformBuffers();
+				buildCommandBuffers();
+			}
 			if (overlay->checkBox("Tessellation", &tessellation)) {
 				updateUniformBuffers();
 			}
@@ -855,6 +975,16 @@ public:
 				overlay->text("TE invocations: %d", pipelineStats[1]);
 			}
 		}
+		if (streamed) {
+			if (overlay->header("Terrain streaming")) {
+				const vks::ChunkedTerrain::Statistics& stats = chunkedTerrain.getStatistics();
+				overlay->text("Chunks drawn: %d", stats.drawnChunks);
+				overlay->text("Chunks resident: %d / %d", stats.residentChunks, stats.chunkCapacity);
+				overlay->text("Chunks pending: %d", stats.pendingChunks);
+				overlay->text("Chunks evicted: %d", (uint32_t)stats.evictedChunks);
+				overlay->text("Quadtree nodes: %d", stats.nodeCount);
+			}
+		}
 	}
 };
 
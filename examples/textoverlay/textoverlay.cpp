@@ -853,7 +853,9 @@ public:
 
 	void draw()
 	{
-		VulkanExampleBase::prepareFrame();
+		if (!VulkanExampleBase::prepareFrame()) {
+			return;
+		}
 
 		std::vector<VkCommandBuffer> commandBuffers = {
 			drawCmdBuffers[currentBuffer]
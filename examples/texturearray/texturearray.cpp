@@ -497,16 +497,13 @@ public:
 			uboVS.instance[i].arrayIndex.x = (float)i;
 		}
 
+		// Map persistent
+		VK_CHECK_RESULT(uniformBufferVS.map());
+
 		// Update instanced part of the uniform buffer
-		uint8_t *pData;
 		uint32_t dataOffset = sizeof(uboVS.matrices);
 		uint32_t dataSize = layerCount * sizeof(UboInstanceData);
-		VK_CHECK_RESULT(vkMapMemory(device, uniformBufferVS.memory, dataOffset, dataSize, 0, (void **)&pData));
-		memcpy(pData, uboVS.instance, dataSize);
-		vkUnmapMemory(device, uniformBufferVS.memory);
-
-		// Map persistent
-		VK_CHECK_RESULT(uniformBufferVS.map());
+		memcpy(static_cast<uint8_t*>(uniformBufferVS.mapped) + dataOffset, uboVS.instance, dataSize);
 
 		updateUniformBuffersCamera();
 	}
@@ -520,7 +517,9 @@ public:
 
 	void draw()
 	{
-		VulkanExampleBase::prepareFrame();
+		if (!VulkanExampleBase::prepareFrame()) {
+			return;
+		}
 
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
@@ -58,9 +58,7 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugMessageCallback(
 
 namespace vra::test {
 	
-RenderImage::RenderImage(int32_t width_, int32_t height_, 
-						 std::string output_filename, 
-						 bool use_texture_) :
+RenderImage::RenderImage(int32_t width_, int32_t height_, bool use_texture_) :
 		width(width_),
 		height(height_),
 		use_texture(use_texture_) {
@@ -74,36 +72,73 @@ RenderImage::RenderImage(int32_t width_, int32_t height_,
 	createCommandPool();
 
 	if (use_texture) {
-		Camera camera;
-		camera.type = Camera::CameraType::lookat;
-		camera.setPosition(glm::vec3(0.0f, 0.0f, -2.5f));
-		camera.setRotation(glm::vec3(0.0f, 15.0f, 0.0f));
-		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
-
-		// Set ubo for texture vertex shader
-		ubo_scene.projection = camera.matrices.perspective;
-		ubo_scene.modelView = camera.matrices.view;
-		ubo_scene.viewPos = camera.viewPos;
-		ubo_scene.lodBias = 0.0f;
-
-		loadTextureFromFile("textures/statue.jpg");
+		// The default texture is written to the descriptor set when the pipeline is set up, 
+		// requests for other textures load them on first use
+		bound_texture = RenderRequest().texture_filename;
+		getTexture(bound_texture);
 		prepareTextureVertexAndIndexBuffers();
-
 	} else {
 		prepareSimpleVertexAndIndexBuffers();
 	}
 
-
 	createFramebufferAttachments();
 	createRenderPass();
 	if (use_texture) {
 		prepareGraphicsPipelineTexture();
-		createCommandBufferTexture();
 	} else {
 		prepareGraphicsPipelineSimple();
-		createCommandBuffer();
 	}
-	saveFramebufferImage(output_filename);
+	// One slot is enough, render() waits for each image before recording the next one
+	readback.create(physical_device, device, width, height, color_format, 1);
+	createRenderCommandBuffer();
+}
+
+RenderedImage RenderImage::render(const RenderRequest& request) {
+	if (use_texture) {
+		bindTexture(request.texture_filename);
+		updateUniformBuffer(request);
+	}
+
+	// Rows are tightly packed in the readback buffer, so they can be copied as a whole
+	RenderedImage image;
+	const int32_t slot = readback.beginCapture([&image](const vks::ReadbackRing::Frame& frame) {
+		image.width = frame.width;
+		image.height = frame.height;
+		image.pixels.assign(frame.data, frame.data + static_cast<size_t>(frame.rowPitch) * frame.height);
+	});
+	assert(slot >= 0);
+
+	// The previous render has been flushed, so the command buffer is no longer in use
+	VK_CHECK_RESULT(vkResetCommandBuffer(command_buffer, 0));
+	recordCommandBuffer(request, slot);
+
+	VkSubmitInfo submit_info = vks::initializers::submitInfo();
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &command_buffer;
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+	readback.endCapture(slot, queue);
+	// Waits for the submission and hands the image to the consumer above
+	readback.flush();
+
+	if (!request.output_filename.empty()) {
+		saveFramebufferImage(image, request.output_filename);
+	}
+	return image;
+}
+
+void RenderImage::enqueue(RenderRequest request) {
+	request_queue.push_back(std::move(request));
+}
+
+size_t RenderImage::processQueue() {
+	size_t count = 0;
+	while (!request_queue.empty()) {
+		RenderRequest request = std::move(request_queue.front());
+		request_queue.pop_front();
+		render(request);
+		count++;
+	}
+	return count;
 }
 
 void RenderImage::createInstance() {
@@ -241,91 +276,51 @@ void RenderImage::createCommandPool() {
 	VK_CHECK_RESULT(vkCreateCommandPool(device, &cmd_pool_info, nullptr, &command_pool));
 }
 
-void RenderImage::createCommandBuffer() {
-	VkCommandBuffer command_buffer;
+void RenderImage::createRenderCommandBuffer() {
+	// A single command buffer is reused for every request
 	VkCommandBufferAllocateInfo cmd_buf_allocate_info =
 		vks::initializers::commandBufferAllocateInfo(command_pool, 
 													 VK_COMMAND_BUFFER_LEVEL_PRIMARY, 
 													 1);
 	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmd_buf_allocate_info, &command_buffer));
+}
 
-	VkCommandBufferBeginInfo cmd_buf_info =
-		vks::initializers::commandBufferBeginInfo();
-
-	VK_CHECK_RESULT(vkBeginCommandBuffer(command_buffer, &cmd_buf_info));
-
-	VkClearValue clear_values[2];
-	clear_values[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };	// Very light blue
-	clear_values[1].depthStencil = { 1.0f, 0 };
-
-	VkRenderPassBeginInfo render_pass_begin_info = {};
-	render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	render_pass_begin_info.renderArea.extent.width = width;
-	render_pass_begin_info.renderArea.extent.height = height;
-	render_pass_begin_info.clearValueCount = 2;
-	render_pass_begin_info.pClearValues = clear_values;
-	render_pass_begin_info.renderPass = render_pass;
-	render_pass_begin_info.framebuffer = framebuffer;
-
-	vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-
-	VkViewport viewport = {};
-	viewport.height = (float)height;
-	viewport.width = (float)width;
-	viewport.minDepth = (float)0.0f;
-	viewport.maxDepth = (float)1.0f;
-	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
-
-	// Update dynamic scissor state
-	VkRect2D scissor = {};
-	scissor.extent.width = width;
-	scissor.extent.height = height;
-	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
-
-	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-
-	// Render scene
-	VkDeviceSize offsets[1] = { 0 };
-	vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, offsets);
-	vkCmdBindIndexBuffer(command_buffer, index_buffer, 0, VK_INDEX_TYPE_UINT32);
-
-	std::vector<glm::vec3> pos = {
-		glm::vec3(-1.5f, 0.0f, -4.0f),
-		glm::vec3( 0.0f, 0.0f, -2.5f),
-		glm::vec3( 1.5f, 0.0f, -4.0f),
-	};
+void RenderImage::updateUniformBuffer(const RenderRequest& request) {
+	Camera camera;
+	camera.type = Camera::CameraType::lookat;
+	camera.setPosition(request.camera_position);
+	camera.setRotation(request.camera_rotation);
+	camera.setPerspective(request.fov, (float)width / (float)height, request.znear, request.zfar);
+
+	// Set ubo for texture vertex shader
+	ubo_scene.projection = camera.matrices.perspective;
+	ubo_scene.modelView = camera.matrices.view;
+	ubo_scene.viewPos = camera.viewPos;
+	ubo_scene.lodBias = request.lod_bias;
+	memcpy(uniform_buffer_mapped, &ubo_scene, sizeof(UniformBufferObject));
+}
 
-	for (auto v : pos) {
-		glm::mat4 mvpMatrix = glm::perspective(glm::radians(60.0f), 
-											   (float)width / (float)height, 
-											   0.1f, 256.0f) * glm::translate(glm::mat4(1.0f), v);
-		vkCmdPushConstants(command_buffer, 
-						   pipeline_layout, 
-						   VK_SHADER_STAGE_VERTEX_BIT, 
-						   0, 
-						   sizeof(mvpMatrix), 
-						   &mvpMatrix);
-		vkCmdDrawIndexed(command_buffer, 3, 1, 0, 0, 0);
+void RenderImage::bindTexture(const std::string& fname) {
+	if (fname == bound_texture) {
+		return;
 	}
+	vks::Texture2D& texture = getTexture(fname);
 
-	vkCmdEndRenderPass(command_buffer);
-
-	VK_CHECK_RESULT(vkEndCommandBuffer(command_buffer));
-
-	submitWork(command_buffer, queue);
-
-	vkDeviceWaitIdle(device);
+	// Safe to update, the previous render has finished executing
+	VkDescriptorImageInfo texture_descriptor;
+	texture_descriptor.imageView = texture.view;
+	texture_descriptor.sampler = texture.sampler;
+	texture_descriptor.imageLayout = texture.imageLayout;
+	VkWriteDescriptorSet write_descriptor_set = 
+			vks::initializers::writeDescriptorSet(descriptor_set, 
+												  VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 
+												  1, 
+												  &texture_descriptor);
+	vkUpdateDescriptorSets(device, 1, &write_descriptor_set, 0, nullptr);
+	bound_texture = fname;
 }
 
-void RenderImage::createCommandBufferTexture() {
-	// buildCommandBuffers()
-	VkCommandBuffer command_buffer;
-	VkCommandBufferAllocateInfo cmd_buf_allocate_info =
-		vks::initializers::commandBufferAllocateInfo(command_pool, 
-													 VK_COMMAND_BUFFER_LEVEL_PRIMARY, 
-													 1);
-	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmd_buf_allocate_info, &command_buffer));
-
+void RenderImage::recordCommandBuffer(const RenderRequest& request, int32_t readback_slot) {
 	VkCommandBufferBeginInfo cmd_buf_info =
 		vks::initializers::commandBufferBeginInfo();
 
@@ -358,14 +353,17 @@ void RenderImage::createCommandBufferTexture() {
 	scissor.extent.width = width;
 	scissor.extent.height = height;
 	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
-	vkCmdBindDescriptorSets(command_buffer, 
-							VK_PIPELINE_BIND_POINT_GRAPHICS, 
-							pipeline_layout, 
-							0, 
-							1, 
-							&descriptor_set, 
-							0, 
-							NULL);
+
+	if (use_texture) {
+		vkCmdBindDescriptorSets(command_buffer, 
+								VK_PIPELINE_BIND_POINT_GRAPHICS, 
+								pipeline_layout, 
+								0, 
+								1, 
+								&descriptor_set, 
+								0, 
+								NULL);
+	}
 	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
 	// Render scene
@@ -373,157 +371,59 @@ void RenderImage::createCommandBufferTexture() {
 	vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, offsets);
 	vkCmdBindIndexBuffer(command_buffer, index_buffer, 0, VK_INDEX_TYPE_UINT32);
 
-	vkCmdDrawIndexed(command_buffer, index_buffer_count, 1, 0, 0, 0);
-	
-	vkCmdEndRenderPass(command_buffer);
+	if (use_texture) {
+		vkCmdDrawIndexed(command_buffer, index_buffer_count, 1, 0, 0, 0);
+	} else {
+		std::vector<glm::vec3> pos = {
+			glm::vec3(-1.5f, 0.0f, -4.0f),
+			glm::vec3( 0.0f, 0.0f, -2.5f),
+			glm::vec3( 1.5f, 0.0f, -4.0f),
+		};
 
-	VK_CHECK_RESULT(vkEndCommandBuffer(command_buffer));
+		for (auto v : pos) {
+			glm::mat4 mvpMatrix = glm::perspective(glm::radians(request.fov), 
+												   (float)width / (float)height, 
+												   request.znear, request.zfar) * glm::translate(glm::mat4(1.0f), v);
+			vkCmdPushConstants(command_buffer, 
+							   pipeline_layout, 
+							   VK_SHADER_STAGE_VERTEX_BIT, 
+							   0, 
+							   sizeof(mvpMatrix), 
+							   &mvpMatrix);
+			vkCmdDrawIndexed(command_buffer, 3, 1, 0, 0, 0);
+		}
+	}
 
-	submitWork(command_buffer, queue);
+	vkCmdEndRenderPass(command_buffer);
 
-	vkDeviceWaitIdle(device);
-}
+	// Copy the color attachment to the readback buffer in the same submission
+	// The render pass already leaves it in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+	readback.recordCopy(readback_slot, 
+						command_buffer, 
+						color_attachment.image, 
+						VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 
+						VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
 
-void RenderImage::saveFramebufferImage(std::string fname) {
-
-	// Create the linear tiled destination image to copy to and to read the memory from
-	VkImageCreateInfo img_create_info(vks::initializers::imageCreateInfo());
-	img_create_info.imageType = VK_IMAGE_TYPE_2D;
-	img_create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
-	img_create_info.extent.width = width;
-	img_create_info.extent.height = height;
-	img_create_info.extent.depth = 1;
-	img_create_info.arrayLayers = 1;
-	img_create_info.mipLevels = 1;
-	img_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	img_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
-	img_create_info.tiling = VK_IMAGE_TILING_LINEAR;
-	img_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-
-	// Create the image
-	VkImage dst_image;
-	VK_CHECK_RESULT(vkCreateImage(device, &img_create_info, nullptr, &dst_image));
-
-	// Create memory to back up the image
-	VkMemoryRequirements mem_requirements;
-	VkMemoryAllocateInfo mem_alloc_info(vks::initializers::memoryAllocateInfo());
-	VkDeviceMemory dst_image_memory;
-	vkGetImageMemoryRequirements(device, dst_image, &mem_requirements);
-	mem_alloc_info.allocationSize = mem_requirements.size;
-	// Memory must be host visible to copy from
-	mem_alloc_info.memoryTypeIndex = getMemoryTypeIndex(mem_requirements.memoryTypeBits, 
-														VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
-														VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device, &mem_alloc_info, nullptr, &dst_image_memory));
-	VK_CHECK_RESULT(vkBindImageMemory(device, dst_image, dst_image_memory, 0));
-
-	// Do the actual blit from the offscreen image to our host visible destination image
-	VkCommandBufferAllocateInfo cmd_buf_allocate_info = 
-			vks::initializers::commandBufferAllocateInfo(command_pool, 
-														 VK_COMMAND_BUFFER_LEVEL_PRIMARY, 
-														 1);
-	VkCommandBuffer copy_cmd;
-	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmd_buf_allocate_info, &copy_cmd));
-	VkCommandBufferBeginInfo cmd_buf_info = vks::initializers::commandBufferBeginInfo();
-	VK_CHECK_RESULT(vkBeginCommandBuffer(copy_cmd, &cmd_buf_info));
-
-	// Transition destination image to transfer destination layout
-	vks::tools::insertImageMemoryBarrier(
-		copy_cmd,
-		dst_image,
-		0,
-		VK_ACCESS_TRANSFER_WRITE_BIT,
-		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-	// colorAttachment.image is already in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, and does not need to be transitioned
-
-	VkImageCopy image_copy_region{};
-	image_copy_region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	image_copy_region.srcSubresource.layerCount = 1;
-	image_copy_region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	image_copy_region.dstSubresource.layerCount = 1;
-	image_copy_region.extent.width = width;
-	image_copy_region.extent.height = height;
-	image_copy_region.extent.depth = 1;
-
-	vkCmdCopyImage(
-		copy_cmd,
-		color_attachment.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-		dst_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		1,
-		&image_copy_region);
-
-	// Transition destination image to general layout, which is the required layout for mapping the image memory later on
-	vks::tools::insertImageMemoryBarrier(
-		copy_cmd,
-		dst_image,
-		VK_ACCESS_TRANSFER_WRITE_BIT,
-		VK_ACCESS_MEMORY_READ_BIT,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		VK_IMAGE_LAYOUT_GENERAL,
-		VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-	VK_CHECK_RESULT(vkEndCommandBuffer(copy_cmd));
-
-	submitWork(copy_cmd, queue);
-
-	// Get layout of the image (including row pitch)
-	VkImageSubresource sub_resource{};
-	sub_resource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	VkSubresourceLayout sub_resource_layout;
-	vkGetImageSubresourceLayout(device, dst_image, &sub_resource, &sub_resource_layout);
-
-	// Map image memory so we can start copying from it
-	vkMapMemory(device, dst_image_memory, 0, VK_WHOLE_SIZE, 0, (void**)&imagedata);
-	imagedata += sub_resource_layout.offset;	// Point to start of first row of image data
+	VK_CHECK_RESULT(vkEndCommandBuffer(command_buffer));
+}
 
+void RenderImage::saveFramebufferImage(const RenderedImage& image, std::string fname) {
 	/*
-		Save host visible framebuffer image to disk (ppm format)
+		Encoding and writing happens on the image writer's thread, so the next request can be rendered in the meantime
+		The file format (png, qoi or ppm) is selected by the file name's extension
 	*/
-	std::ofstream file(fname, std::ios::out | std::ios::binary);
-
-	// ppm header
-	file << "P6\n" << width << "\n" << height << "\n" << 255 << "\n";
-
-	// If source is BGR (destination is always RGB) and we can't use blit (which does automatic conversion), we'll have to manually swizzle color components
-	// Check if source is BGR and needs swizzle
+	vks::image::ImageData image_data;
+	image_data.width = image.width;
+	image_data.height = image.height;
+	// If source is BGR (destination is always RGB) the writer swizzles the color components
 	std::vector<VkFormat> formatsBGR = { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM };
-	const bool color_swizzle = (std::find(formatsBGR.begin(), 
-										  formatsBGR.end(), 
-										  VK_FORMAT_R8G8B8A8_UNORM) != formatsBGR.end());
-
-	// ppm binary pixel data
-	for (int32_t y = 0; y < height; y++) {
-		unsigned int *row = (unsigned int*)imagedata;
-		for (int32_t x = 0; x < width; x++) {
-			if (color_swizzle) {
-				file.write((char*)row + 2, 1);
-				file.write((char*)row + 1, 1);
-				file.write((char*)row, 1);
-			}
-			else {
-				file.write((char*)row, 3);
-			}
-			row++;
-		}
-		imagedata += sub_resource_layout.rowPitch;
-	}
-	file.close();
-
-	LOG("Framebuffer image saved to %s\n", fname.c_str());
-
-	// Clean up resources
-	vkUnmapMemory(device, dst_image_memory);
-	vkFreeMemory(device, dst_image_memory, nullptr);
-	vkDestroyImage(device, dst_image, nullptr);
+	image_data.bgra = (std::find(formatsBGR.begin(), 
+								 formatsBGR.end(), 
+								 color_format) != formatsBGR.end());
+	image_data.pixels = image.pixels;
+	image_writer.write(fname, std::move(image_data));
 
-	vkQueueWaitIdle(queue);
+	LOG("Framebuffer image queued for writing to %s\n", fname.c_str());
 }
 
 void RenderImage::prepareSimpleVertexAndIndexBuffers() {
@@ -1000,8 +900,9 @@ void RenderImage::prepareGraphicsPipelineTexture() {
 								 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 								 &uniform_buffer_modelview,
 								 &uniform_buffer_memory,
-								 sizeof(UniformBufferObject),
-								 &uniform_buffer_modelview));
+								 sizeof(UniformBufferObject)));
+	// Kept mapped, the matrices are updated for every request
+	VK_CHECK_RESULT(vkMapMemory(device, uniform_buffer_memory, 0, VK_WHOLE_SIZE, 0, &uniform_buffer_mapped));
 
 
 	// setupDescriptorSetLayout()
@@ -1226,6 +1127,7 @@ void RenderImage::prepareGraphicsPipelineTexture() {
 
 	// Setup a descriptor image info for the current texture to be used 
 	// as a combined image sampler
+	const vks::Texture2D& texture = getTexture(bound_texture);
 	VkDescriptorImageInfo texture_descriptor;
 	texture_descriptor.imageView = texture.view;			// The image's view (images are never directly accessed by the shader, but rather through views defining subresources)
 	texture_descriptor.sampler = texture.sampler;			// The sampler (Telling the pipeline how to sample the texture, including repeat, border, etc.)
@@ -1261,7 +1163,24 @@ void RenderImage::prepareGraphicsPipelineTexture() {
 
 }
 
-void RenderImage::loadTextureFromFile(std::string fname) {
+vks::Texture2D& RenderImage::getTexture(const std::string& fname) {
+	auto it = textures.find(fname);
+	if (it == textures.end()) {
+		it = textures.emplace(fname, vks::Texture2D()).first;
+		loadTextureFromFile(it->second, fname);
+	}
+	return it->second;
+}
+
+void RenderImage::destroyTexture(vks::Texture2D& texture) {
+	// The texture has no vks::VulkanDevice attached, so Texture::destroy() can't be used
+	vkDestroyImageView(device, texture.view, nullptr);
+	vkDestroyImage(device, texture.image, nullptr);
+	vkDestroySampler(device, texture.sampler, nullptr);
+	vkFreeMemory(device, texture.deviceMemory, nullptr);
+}
+
+void RenderImage::loadTextureFromFile(vks::Texture2D& texture, std::string fname) {
 	std::string texture_filename = getAssetPath() + fname;
 
 	int tex_width, tex_height, tex_channels;
@@ -1542,6 +1461,17 @@ void RenderImage::loadTextureFromFile(std::string fname) {
 }
 
 RenderImage::~RenderImage()	{
+	vkDeviceWaitIdle(device);
+	for (auto& texture : textures) {
+		destroyTexture(texture.second);
+	}
+	if (uniform_buffer_mapped) {
+		vkUnmapMemory(device, uniform_buffer_memory);
+	}
+	vkDestroyBuffer(device, uniform_buffer_modelview, nullptr);
+	vkFreeMemory(device, uniform_buffer_memory, nullptr);
+	vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+	readback.destroy();
 	vkDestroyBuffer(device, vertex_buffer, nullptr);
 	vkFreeMemory(device, vertex_memory, nullptr);
 	vkDestroyBuffer(device, index_buffer, nullptr);
@@ -1679,6 +1609,8 @@ int main(int argc, char* argv[]) {
 	command_line_parser.add("help", { "--help" }, 0, "Show help");
 	command_line_parser.add("shaders", { "-s", "--shaders" }, 1, "Select shader type to use (glsl or hlsl)");
 	command_line_parser.add("use_vertex", { "-v", "--use_vertex" }, 0, "Select to use vertex rendering.");
+	command_line_parser.add("count", { "-n", "--count" }, 1, "Number of images to render, the camera orbits the scene (default 1)");
+	command_line_parser.add("format", { "-f", "--format" }, 1, "Image file format (png, qoi or ppm, default png)");
 	command_line_parser.parse(argc, argv);
 	if (command_line_parser.isSet("help")) {
 		command_line_parser.printHelp();
@@ -1686,10 +1618,21 @@ int main(int argc, char* argv[]) {
 		return 0;
 	}	
 
+	// Device, pipeline and attachments are set up once and reused for all images
 	unique_ptr<RenderImage> render_tool = make_unique<RenderImage>(640, 512, 
-																   "headless.png", 
 																   !command_line_parser.isSet("use_vertex"));
 
+	const int32_t count = std::max(command_line_parser.getValueAsInt("count", 1), 1);
+	const std::string extension = "." + command_line_parser.getValueAsString("format", "png");
+	for (int32_t i = 0; i < count; i++) {
+		vra::test::RenderRequest request;
+		request.camera_rotation.y += 360.0f * (float)i / (float)count;
+		request.output_filename = ((count == 1) ? "headless" : "headless_" + std::to_string(i)) + extension;
+		render_tool->enqueue(request);
+	}
+	const size_t rendered = render_tool->processQueue();
+	LOG("Rendered %zu images\n", rendered);
+
 	std::cout << "Finished.  Have a great day ...\n";
 	return 0;
 }
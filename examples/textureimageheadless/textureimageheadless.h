@@ -5,18 +5,67 @@
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
 #include "VulkanTexture.h"
+#include "VulkanReadback.h"
 
 #include "CommandLineParser.hpp"
+#include "imagewriter.hpp"
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace vra::test {
 
+/*
+	Parameters for a single image rendered by RenderImage::render()
+	The size of the image is fixed by the renderer, everything else can change per request
+*/
+struct RenderRequest {
+    // Camera (lookat type, same conventions as the Camera class)
+    glm::vec3 camera_position = glm::vec3(0.0f, 0.0f, -2.5f);
+    glm::vec3 camera_rotation = glm::vec3(0.0f, 15.0f, 0.0f);
+    float fov = 60.0f;
+    float znear = 0.1f;
+    float zfar = 256.0f;
+    float lod_bias = 0.0f;
+    // Texture relative to the asset path, loaded once and cached by the renderer (texture pipeline only)
+    std::string texture_filename = "textures/statue.jpg";
+    // If not empty, the rendered image is also written to this file
+    std::string output_filename;
+};
+
+/*
+	Tightly packed RGBA8 pixels read back from the color attachment
+*/
+struct RenderedImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+/*
+	Long lived headless renderer
+	Instance, device, pipeline, descriptors, attachments and the readback image are created once
+	in the constructor and reused for every request, so a process can render any number of images
+*/
 class RenderImage {
 public:
-    RenderImage(int32_t width, int32_t height, 
-                std::string output_filename, 
-                bool use_texture);
+    RenderImage(int32_t width, int32_t height, bool use_texture);
     ~RenderImage();
 
+    /*
+		Render a single image and wait for it to be read back
+		Writes the image to request.output_filename if set
+	*/
+    RenderedImage render(const RenderRequest& request);
+
+    /* Add a request to the queue, rendered by the next call to processQueue() */
+    void enqueue(RenderRequest request);
+
+    /* Render all queued requests in order, returns the number of images rendered */
+    size_t processQueue();
+
     VkInstance instance;
 	VkPhysicalDevice physical_device;
     VkPhysicalDeviceProperties device_properties;
@@ -28,8 +77,8 @@ public:
 	VkCommandPool command_pool;
 	VkCommandBuffer command_buffer;
 	VkDescriptorSetLayout descriptor_set_layout;
-    VkDescriptorSet descriptor_set;
-    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet descriptor_set{ VK_NULL_HANDLE };
+    VkDescriptorPool descriptor_pool{ VK_NULL_HANDLE };
 	VkPipelineLayout pipeline_layout;
 	VkPipeline pipeline;
 	std::vector<VkShaderModule> shader_modules;
@@ -41,8 +90,9 @@ public:
     VkFormat color_format;
 	VkFormat depth_format;
 
-    VkBuffer uniform_buffer_modelview;
-    VkDeviceMemory  uniform_buffer_memory;
+    VkBuffer uniform_buffer_modelview{ VK_NULL_HANDLE };
+    VkDeviceMemory  uniform_buffer_memory{ VK_NULL_HANDLE };
+    void* uniform_buffer_mapped{ nullptr };
 
     struct UniformBufferObject {
         glm::mat4 projection;
@@ -67,6 +117,9 @@ public:
 	FrameBufferAttachment color_attachment, depth_attachment;
 	VkRenderPass render_pass;
 
+	// Host cached buffer the color attachment is copied to at the end of each render
+	vks::ReadbackRing readback;
+
     struct SimpleVertex {
         float position[3];
         float color[3];
@@ -76,11 +129,16 @@ public:
         float uv[2];
         float normal[3];
     };
-    vks::Texture2D  texture;
+    // Textures loaded by requests, keyed by file name
+    std::unordered_map<std::string, vks::Texture2D> textures;
+    // Texture currently written to the descriptor set
+    std::string bound_texture;
 
-	VkDebugReportCallbackEXT debug_report_callback{};
+    std::deque<RenderRequest> request_queue;
+    // Encodes and writes output images on a job system with a single background thread
+    vks::ImageWriter image_writer;
 
-    const char* imagedata;  // Pointer to imagedata buffer
+	VkDebugReportCallbackEXT debug_report_callback{};
 
     void createInstance();
     void setupDebugMessenger();
@@ -96,14 +154,18 @@ public:
     void createRenderPass();
     void prepareGraphicsPipelineSimple();
     void prepareGraphicsPipelineTexture();
-    void createCommandBuffer();
-    void createCommandBufferTexture();
-    void saveFramebufferImage(std::string fname);
+    void createRenderCommandBuffer();
+    void updateUniformBuffer(const RenderRequest& request);
+    void bindTexture(const std::string& fname);
+    void recordCommandBuffer(const RenderRequest& request, int32_t readback_slot);
+    void saveFramebufferImage(const RenderedImage& image, std::string fname);
 
     void createSwapChain(); // Not necessary for headless
     void createImageViews();    // Not necessary for headless
 
-    void loadTextureFromFile(std::string fname = "textures/statue.jpg");
+    vks::Texture2D& getTexture(const std::string& fname);
+    void loadTextureFromFile(vks::Texture2D& texture, std::string fname = "textures/statue.jpg");
+    void destroyTexture(vks::Texture2D& texture);
 
     /**
 	* Allocate a command buffer from the command pool
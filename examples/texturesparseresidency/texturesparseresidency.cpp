@@ -531,7 +531,9 @@ void VulkanExample::buildCommandBuffers()
 
 void VulkanExample::draw()
 {
-	VulkanExampleBase::prepareFrame();
+	if (!VulkanExampleBase::prepareFrame()) {
+		return;
+	}
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
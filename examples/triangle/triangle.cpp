@@ -337,7 +337,9 @@ public:
 #if defined(VK_USE_PLATFORM_MACOS_MVK)
 		// SRS - on macOS use swapchain helper function with common semaphores/fences for proper resize handling
 		// Get next image in the swap chain (back/front buffer)
-		prepareFrame();
+		if (!prepareFrame()) {
+			return;
+		}
 
 		// Use a fence to wait until the command buffer has finished execution before using it again
 		VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentBuffer], VK_TRUE, UINT64_MAX));
@@ -0,0 +1,72 @@
+#version 450
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+struct Material
+{
+	vec4 baseColorFactor;
+	float alphaCutoff;
+	uint alphaMode;
+	float metallicFactor;
+	float roughnessFactor;
+	int baseColorTexture;
+	int metallicRoughnessTexture;
+	int normalTexture;
+	int occlusionTexture;
+	int emissiveTexture;
+	uint _pad0;
+	uint _pad1;
+	uint _pad2;
+};
+
+layout (set = 1, binding = 2, std430) readonly buffer Materials
+{
+	Material materials[ ];
+};
+
+// Bindless array with all textures of the model
+layout (set = 1, binding = 3) uniform sampler2D textures[];
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inViewVec;
+layout (location = 4) in vec3 inLightVec;
+layout (location = 5) in vec4 inTangent;
+layout (location = 6) flat in uint inMaterialIndex;
+
+layout (location = 0) out vec4 outFragColor;
+
+const uint ALPHAMODE_MASK = 1;
+
+void main() 
+{
+	Material material = materials[inMaterialIndex];
+
+	vec4 color = material.baseColorFactor * vec4(inColor, 1.0);
+	if (material.baseColorTexture > -1) {
+		color *= texture(textures[nonuniformEXT(material.baseColorTexture)], inUV);
+	}
+
+	if (material.alphaMode == ALPHAMODE_MASK) {
+		if (color.a < material.alphaCutoff) {
+			discard;
+		}
+	}
+
+	vec3 N = normalize(inNormal);
+	if (material.normalTexture > -1) {
+		vec3 T = normalize(inTangent.xyz);
+		vec3 B = cross(inNormal, inTangent.xyz) * inTangent.w;
+		mat3 TBN = mat3(T, B, N);
+		N = TBN * normalize(texture(textures[nonuniformEXT(material.normalTexture)], inUV).xyz * 2.0 - vec3(1.0));
+	}
+
+	const float ambient = 0.1;
+	vec3 L = normalize(inLightVec);
+	vec3 V = normalize(inViewVec);
+	vec3 R = reflect(-L, N);
+	vec3 diffuse = max(dot(N, L), ambient).rrr;
+	float specular = pow(max(dot(R, V), 0.0), 32.0);
+	outFragColor = vec4(diffuse * color.rgb + specular, color.a);
+}
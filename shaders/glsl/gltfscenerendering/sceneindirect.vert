@@ -0,0 +1,75 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+// Normals and tangents are octahedral encoded (vkglTF::VertexPackingFlags::PackNormals)
+layout (location = 1) in vec2 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec4 inColor;
+layout (location = 4) in vec4 inTangent;
+
+layout (set = 0, binding = 0) uniform UBOScene 
+{
+	mat4 projection;
+	mat4 view;
+	vec4 lightPos;
+	vec4 viewPos;
+} uboScene;
+
+struct DrawData
+{
+	vec4 boundsMin;
+	vec4 boundsMax;
+	uint firstIndex;
+	uint indexCount;
+	uint matrixIndex;
+	uint materialIndex;
+	uint group;
+	uint commandOffset;
+	uint _pad0;
+	uint _pad1;
+};
+
+layout (set = 1, binding = 0, std430) readonly buffer Matrices
+{
+	mat4 matrices[ ];
+};
+
+layout (set = 1, binding = 1, std430) readonly buffer Draws
+{
+	DrawData draws[ ];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec3 outLightVec;
+layout (location = 5) out vec4 outTangent;
+layout (location = 6) flat out uint outMaterialIndex;
+
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main() 
+{
+	// The culling pass stores the draw index in the first instance of the draw command
+	DrawData draw = draws[gl_InstanceIndex];
+	mat4 model = matrices[draw.matrixIndex];
+
+	outColor = inColor.rgb;
+	outUV = inUV;
+	outTangent = vec4(mat3(model) * octDecode(inTangent.xy), inTangent.w);
+	outMaterialIndex = draw.materialIndex;
+	gl_Position = uboScene.projection * uboScene.view * model * vec4(inPos.xyz, 1.0);
+	
+	outNormal = mat3(model) * octDecode(inNormal);
+	vec4 pos = model * vec4(inPos, 1.0);
+	outLightVec = uboScene.lightPos.xyz - pos.xyz;
+	outViewVec = uboScene.viewPos.xyz - pos.xyz;
+}
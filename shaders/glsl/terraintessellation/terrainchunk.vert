@@ -0,0 +1,41 @@
+#version 450
+
+layout (set = 0, binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 modelview;
+	vec4 lightPos;
+	vec4 frustumPlanes[6];
+	float displacementFactor;
+	float tessellationFactor;
+	vec2 viewportDim;
+	float tessellatedEdgeSize;
+} ubo; 
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec2 outUV;
+layout (location = 2) out vec3 outViewVec;
+layout (location = 3) out vec3 outLightVec;
+layout (location = 4) out vec3 outEyePos;
+layout (location = 5) out vec3 outWorldPos;
+
+void main()
+{
+	// Chunk vertices are already displaced (along -y), so no tessellation or height map lookup is required
+	vec4 pos = vec4(inPos, 1.0);
+	gl_Position = ubo.projection * ubo.modelview * pos;
+
+	outUV = inUV;
+	// Chunk normals point along the displacement (-y), the tessellated terrain's normals along +y
+	outNormal = inNormal * vec3(1.0, -1.0, 1.0);
+
+	// Calculate vectors for lighting like the tessellation evaluation shader
+	outViewVec = -pos.xyz;
+	outLightVec = normalize(ubo.lightPos.xyz + outViewVec);
+	outWorldPos = pos.xyz;
+	outEyePos = vec3(ubo.modelview * pos);
+}
@@ -0,0 +1,70 @@
+// Copyright 2023 Sascha Willems
+// Non-uniform access is enabled at compile time via SPV_EXT_descriptor_indexing (see compile.py)
+
+struct Material
+{
+	float4 baseColorFactor;
+	float alphaCutoff;
+	uint alphaMode;
+	float metallicFactor;
+	float roughnessFactor;
+	int baseColorTexture;
+	int metallicRoughnessTexture;
+	int normalTexture;
+	int occlusionTexture;
+	int emissiveTexture;
+	uint _pad0;
+	uint _pad1;
+	uint _pad2;
+};
+
+StructuredBuffer<Material> materials : register(t2, space1);
+
+// Bindless array with all textures of the model
+Texture2D textures[] : register(t3, space1);
+SamplerState samplerTextures : register(s3, space1);
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+[[vk::location(5)]] float4 Tangent : TEXCOORD3;
+[[vk::location(6)]] nointerpolation uint MaterialIndex : TEXCOORD4;
+};
+
+#define ALPHAMODE_MASK 1
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	Material material = materials[input.MaterialIndex];
+
+	float4 color = material.baseColorFactor * float4(input.Color, 1.0);
+	if (material.baseColorTexture > -1) {
+		color *= textures[NonUniformResourceIndex(material.baseColorTexture)].Sample(samplerTextures, input.UV);
+	}
+
+	if (material.alphaMode == ALPHAMODE_MASK) {
+		if (color.a < material.alphaCutoff) {
+			discard;
+		}
+	}
+
+	float3 N = normalize(input.Normal);
+	if (material.normalTexture > -1) {
+		float3 T = normalize(input.Tangent.xyz);
+		float3 B = cross(input.Normal, input.Tangent.xyz) * input.Tangent.w;
+		float3x3 TBN = float3x3(T, B, N);
+		N = mul(normalize(textures[NonUniformResourceIndex(material.normalTexture)].Sample(samplerTextures, input.UV).xyz * 2.0 - float3(1.0, 1.0, 1.0)), TBN);
+	}
+
+	const float ambient = 0.1;
+	float3 L = normalize(input.LightVec);
+	float3 V = normalize(input.ViewVec);
+	float3 R = reflect(-L, N);
+	float3 diffuse = max(dot(N, L), ambient).rrr;
+	float3 specular = pow(max(dot(R, V), 0.0), 32.0);
+	return float4(diffuse * color.rgb + specular, color.a);
+}
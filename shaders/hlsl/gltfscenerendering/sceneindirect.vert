@@ -0,0 +1,79 @@
+// Copyright 2023 Sascha Willems
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+// Normals and tangents are octahedral encoded (vkglTF::VertexPackingFlags::PackNormals)
+[[vk::location(1)]] float2 Normal : NORMAL0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float4 Color : COLOR0;
+[[vk::location(4)]] float4 Tangent : TEXCOORD1;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4 lightPos;
+	float4 viewPos;
+};
+cbuffer ubo : register(b0) { UBO ubo; };
+
+struct DrawData
+{
+	float4 boundsMin;
+	float4 boundsMax;
+	uint firstIndex;
+	uint indexCount;
+	uint matrixIndex;
+	uint materialIndex;
+	uint group;
+	uint commandOffset;
+	uint _pad0;
+	uint _pad1;
+};
+
+StructuredBuffer<float4x4> matrices : register(t0, space1);
+StructuredBuffer<DrawData> draws : register(t1, space1);
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+[[vk::location(5)]] float4 Tangent : TEXCOORD3;
+[[vk::location(6)]] nointerpolation uint MaterialIndex : TEXCOORD4;
+};
+
+float3 octDecode(float2 e)
+{
+	float3 n = float3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+VSOutput main(VSInput input, uint InstanceIndex : SV_InstanceID)
+{
+	VSOutput output = (VSOutput)0;
+	// The culling pass stores the draw index in the first instance of the draw command
+	DrawData draw = draws[InstanceIndex];
+	float4x4 model = matrices[draw.matrixIndex];
+
+	output.Color = input.Color.rgb;
+	output.UV = input.UV;
+	output.Tangent = float4(mul((float3x3)model, octDecode(input.Tangent.xy)), input.Tangent.w);
+	output.MaterialIndex = draw.materialIndex;
+
+	float4 pos = mul(model, float4(input.Pos, 1.0));
+	output.Pos = mul(ubo.projection, mul(ubo.view, pos));
+
+	output.Normal = mul((float3x3)model, octDecode(input.Normal));
+	output.LightVec = ubo.lightPos.xyz - pos.xyz;
+	output.ViewVec = ubo.viewPos.xyz - pos.xyz;
+	return output;
+}
@@ -0,0 +1,325 @@
+/*
+* Tests for the CPU side mesh optimization and simplification functions (base/meshoptimizer.hpp, base/meshsimplifier.hpp)
+*
+* Copyright (C) 2016-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "meshoptimizer.hpp"
+#include "meshsimplifier.hpp"
+
+namespace
+{
+	int failures = 0;
+
+	void check(bool condition, const char* description)
+	{
+		if (!condition) {
+			fprintf(stderr, "FAILED: %s\n", description);
+			failures++;
+		}
+	}
+
+	struct Vertex {
+		float pos[3];
+		float uv[2];
+	};
+
+	struct Mesh {
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	// Regular grid of size x size quads with shared vertices, triangles in row order
+	Mesh createGrid(uint32_t size)
+	{
+		Mesh mesh;
+		for (uint32_t y = 0; y <= size; y++) {
+			for (uint32_t x = 0; x <= size; x++) {
+				Vertex vertex = { { (float)x, 0.0f, (float)y }, { (float)x / (float)size, (float)y / (float)size } };
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				const uint32_t i0 = y * (size + 1) + x;
+				const uint32_t i1 = i0 + 1;
+				const uint32_t i2 = i0 + size + 1;
+				const uint32_t i3 = i2 + 1;
+				mesh.indices.insert(mesh.indices.end(), { i0, i2, i1, i1, i2, i3 });
+			}
+		}
+		return mesh;
+	}
+
+	// Same grid with three unique vertices per triangle, as an unindexed glTF primitive would be loaded
+	Mesh createUnindexedGrid(uint32_t size)
+	{
+		const Mesh grid = createGrid(size);
+		Mesh mesh;
+		for (uint32_t index : grid.indices) {
+			mesh.indices.push_back(static_cast<uint32_t>(mesh.vertices.size()));
+			mesh.vertices.push_back(grid.vertices[index]);
+		}
+		return mesh;
+	}
+
+	// Deterministic shuffle of the triangle order, destroys any vertex reuse the original order had
+	void shuffleTriangles(std::vector<uint32_t>& indices)
+	{
+		uint32_t state = 0x12345678u;
+		const size_t triangleCount = indices.size() / 3;
+		for (size_t i = triangleCount - 1; i > 0; i--) {
+			state = state * 1664525u + 1013904223u;
+			const size_t j = state % (i + 1);
+			for (size_t k = 0; k < 3; k++) {
+				std::swap(indices[i * 3 + k], indices[j * 3 + k]);
+			}
+		}
+	}
+
+	// Grid with two UV islands, the vertices of the middle column are duplicated with different texture coordinates
+	Mesh createSeamGrid(uint32_t size)
+	{
+		Mesh mesh = createGrid(size);
+		const uint32_t seam = size / 2;
+		std::vector<uint32_t> duplicates(mesh.vertices.size(), ~0u);
+		for (uint32_t y = 0; y <= size; y++) {
+			const uint32_t index = y * (size + 1) + seam;
+			Vertex vertex = mesh.vertices[index];
+			vertex.uv[0] += 1.0f;
+			duplicates[index] = static_cast<uint32_t>(mesh.vertices.size());
+			mesh.vertices.push_back(vertex);
+		}
+		// Triangles right of the seam use the duplicates
+		for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+			bool right = false;
+			for (uint32_t k = 0; k < 3; k++) {
+				right |= (mesh.vertices[mesh.indices[i + k]].pos[0] > (float)seam);
+			}
+			for (uint32_t k = 0; right && (k < 3); k++) {
+				if (duplicates[mesh.indices[i + k]] != ~0u) {
+					mesh.indices[i + k] = duplicates[mesh.indices[i + k]];
+				}
+			}
+		}
+		return mesh;
+	}
+
+	bool sameVertex(const Vertex& a, const Vertex& b)
+	{
+		return memcmp(&a, &b, sizeof(Vertex)) == 0;
+	}
+
+	// Deduplicating vertices has to keep every triangle's vertex data and only produce indices into the new vertex buffer
+	void testRemapKeepsIndicesValid()
+	{
+		const uint32_t size = 16;
+		const Mesh mesh = createUnindexedGrid(size);
+
+		std::vector<uint32_t> remap(mesh.vertices.size());
+		const size_t uniqueCount = vks::meshoptimizer::generateVertexRemap(remap.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex));
+		check(uniqueCount == (size + 1) * (size + 1), "generateVertexRemap finds all shared grid vertices");
+
+		std::vector<uint32_t> indices(mesh.indices.size());
+		vks::meshoptimizer::remapIndexBuffer(indices.data(), mesh.indices.data(), mesh.indices.size(), remap.data());
+		std::vector<Vertex> vertices(uniqueCount);
+		vks::meshoptimizer::remapVertexBuffer(vertices.data(), mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex), remap.data());
+
+		bool indicesValid = true;
+		bool verticesPreserved = true;
+		for (size_t i = 0; i < indices.size(); i++) {
+			if (indices[i] >= uniqueCount) {
+				indicesValid = false;
+				continue;
+			}
+			verticesPreserved &= sameVertex(vertices[indices[i]], mesh.vertices[mesh.indices[i]]);
+		}
+		check(indicesValid, "remapped indices are within the deduplicated vertex buffer");
+		check(verticesPreserved, "remapped indices reference the original vertex data");
+
+		// Vertex fetch reordering after cache optimization has to keep the same guarantees
+		std::vector<uint32_t> optimized(indices.size());
+		vks::meshoptimizer::optimizeVertexCache(optimized.data(), indices.data(), indices.size(), uniqueCount);
+		std::vector<uint32_t> fetchRemap(uniqueCount);
+		const size_t fetchCount = vks::meshoptimizer::optimizeVertexFetchRemap(fetchRemap.data(), optimized.data(), optimized.size(), uniqueCount);
+		check(fetchCount == uniqueCount, "optimizeVertexFetchRemap keeps all referenced vertices");
+		std::vector<uint32_t> fetchIndices(optimized.size());
+		vks::meshoptimizer::remapIndexBuffer(fetchIndices.data(), optimized.data(), optimized.size(), fetchRemap.data());
+		std::vector<Vertex> fetchVertices(fetchCount);
+		vks::meshoptimizer::remapVertexBuffer(fetchVertices.data(), vertices.data(), uniqueCount, sizeof(Vertex), fetchRemap.data());
+		bool fetchValid = true;
+		for (size_t i = 0; i < fetchIndices.size(); i++) {
+			fetchValid &= (fetchIndices[i] < fetchCount) && sameVertex(fetchVertices[fetchIndices[i]], vertices[optimized[i]]);
+		}
+		check(fetchValid, "vertex fetch remap keeps indices valid and vertex data intact");
+	}
+
+	// Vertex cache optimization of a grid with randomly ordered triangles has to lower the cache miss ratio considerably
+	void testVertexCacheImprovesACMR()
+	{
+		Mesh mesh = createGrid(32);
+		shuffleTriangles(mesh.indices);
+
+		const vks::meshoptimizer::VertexCacheStatistics before = vks::meshoptimizer::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+		std::vector<uint32_t> optimized(mesh.indices.size());
+		vks::meshoptimizer::optimizeVertexCache(optimized.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+		const vks::meshoptimizer::VertexCacheStatistics after = vks::meshoptimizer::analyzeVertexCache(optimized.data(), optimized.size(), mesh.vertices.size());
+
+		printf("ACMR of shuffled 32x32 grid: %.3f before, %.3f after vertex cache optimization\n", before.acmr, after.acmr);
+		check(after.acmr < before.acmr, "optimizeVertexCache lowers the ACMR");
+		// Each grid vertex is shared by up to six triangles, a good ordering needs clearly less than one transform per triangle
+		check(after.acmr < 0.8f, "optimizeVertexCache reaches an ACMR below 0.8 on a regular grid");
+
+		// The optimized index list has to contain the same triangles
+		std::vector<uint32_t> triangleUses(mesh.vertices.size(), 0);
+		std::vector<uint32_t> optimizedUses(mesh.vertices.size(), 0);
+		for (size_t i = 0; i < mesh.indices.size(); i++) {
+			triangleUses[mesh.indices[i]]++;
+			optimizedUses[optimized[i]]++;
+		}
+		check(triangleUses == optimizedUses, "optimizeVertexCache keeps every vertex's triangle count");
+	}
+
+	// Deduplicating already deduplicated data must not change it
+	void testDeduplicationIsIdempotent()
+	{
+		const Mesh mesh = createUnindexedGrid(8);
+
+		std::vector<uint32_t> remap(mesh.vertices.size());
+		const size_t uniqueCount = vks::meshoptimizer::generateVertexRemap(remap.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex));
+		std::vector<uint32_t> indices(mesh.indices.size());
+		vks::meshoptimizer::remapIndexBuffer(indices.data(), mesh.indices.data(), mesh.indices.size(), remap.data());
+		std::vector<Vertex> vertices(uniqueCount);
+		vks::meshoptimizer::remapVertexBuffer(vertices.data(), mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex), remap.data());
+
+		std::vector<uint32_t> secondRemap(vertices.size());
+		const size_t secondCount = vks::meshoptimizer::generateVertexRemap(secondRemap.data(), indices.data(), indices.size(), vertices.data(), vertices.size(), sizeof(Vertex));
+		check(secondCount == uniqueCount, "a second deduplication pass finds no further duplicates");
+		bool identity = true;
+		for (size_t i = 0; i < secondRemap.size(); i++) {
+			identity &= (secondRemap[i] == i);
+		}
+		check(identity, "a second deduplication pass leaves the vertex order unchanged");
+	}
+
+	size_t simplifyMesh(const Mesh& mesh, std::vector<uint32_t>& result, size_t targetIndexCount, float targetError, float* resultError)
+	{
+		result.resize(mesh.indices.size());
+		const size_t count = vks::meshoptimizer::simplify(result.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices[0].pos, sizeof(Vertex), mesh.vertices.size(), targetIndexCount, targetError, resultError);
+		result.resize(count);
+		return count;
+	}
+
+	bool indicesInRange(const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		for (uint32_t index : indices) {
+			if (index >= vertexCount) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// A flat, densely subdivided grid can lose almost all of its interior vertices without any error
+	void testSimplifyReducesGrid()
+	{
+		const Mesh mesh = createGrid(16);
+		std::vector<uint32_t> result;
+		float error = -1.0f;
+		const size_t targetIndexCount = mesh.indices.size() / 4;
+		const size_t count = simplifyMesh(mesh, result, targetIndexCount, 0.01f, &error);
+
+		printf("Simplified 16x16 grid from %zu to %zu indices (target %zu), error %f\n", mesh.indices.size(), count, targetIndexCount, error);
+		check(count < mesh.indices.size(), "simplify lowers the index count of a subdivided grid");
+		check(count <= targetIndexCount, "simplify reaches the target index count on a flat grid");
+		check(count % 3 == 0, "simplify returns whole triangles");
+		check(indicesInRange(result, mesh.vertices.size()), "simplified indices are within the vertex buffer");
+		check((error >= 0.0f) && (error <= 0.01f), "simplify reports an error within the target error");
+	}
+
+	// Border vertices and vertices on attribute seams are locked, so the outline and the UV split stay in place
+	void testSimplifyKeepsBordersAndSeams()
+	{
+		const uint32_t size = 16;
+		const Mesh mesh = createSeamGrid(size);
+		std::vector<uint32_t> result;
+		simplifyMesh(mesh, result, 0, 0.01f, nullptr);
+		check(indicesInRange(result, mesh.vertices.size()), "simplified seam grid indices are within the vertex buffer");
+
+		std::vector<uint8_t> referenced(mesh.vertices.size(), 0);
+		for (uint32_t index : result) {
+			referenced[index] = 1;
+		}
+		bool bordersKept = true;
+		bool seamsKept = true;
+		for (size_t v = 0; v < mesh.vertices.size(); v++) {
+			const float x = mesh.vertices[v].pos[0];
+			const float z = mesh.vertices[v].pos[2];
+			if ((x == 0.0f) || (z == 0.0f) || (x == (float)size) || (z == (float)size)) {
+				bordersKept &= (referenced[v] == 1);
+			} else if (x == (float)(size / 2)) {
+				seamsKept &= (referenced[v] == 1);
+			}
+		}
+		check(bordersKept, "simplify keeps all border vertices");
+		check(seamsKept, "simplify keeps the vertices on both sides of an attribute seam");
+	}
+
+	// On a curved surface the reported error must stay within the target error, even if that stops short of the target index count
+	void testSimplifyRespectsMaxError()
+	{
+		Mesh mesh = createGrid(24);
+		for (Vertex& vertex : mesh.vertices) {
+			vertex.pos[1] = std::sin(vertex.pos[0] * 0.5f) * std::cos(vertex.pos[2] * 0.5f);
+		}
+		const float maxErrors[] = { 0.001f, 0.05f, 0.5f };
+		size_t previousCount = mesh.indices.size() + 1;
+		for (float maxError : maxErrors) {
+			std::vector<uint32_t> result;
+			float error = -1.0f;
+			const size_t count = simplifyMesh(mesh, result, 0, maxError, &error);
+			check((error >= 0.0f) && (error <= maxError), "the reported error is within the requested maximum error");
+			check(indicesInRange(result, mesh.vertices.size()), "simplified curved grid indices are within the vertex buffer");
+			check(count <= previousCount, "a larger maximum error never gives more indices");
+			previousCount = count;
+		}
+	}
+
+	// Nothing to do if the mesh already is at or below the target
+	void testSimplifyNoOpAtTarget()
+	{
+		const Mesh mesh = createGrid(8);
+		for (size_t targetIndexCount : { mesh.indices.size(), mesh.indices.size() * 2 }) {
+			std::vector<uint32_t> result;
+			float error = -1.0f;
+			simplifyMesh(mesh, result, targetIndexCount, 1.0f, &error);
+			check(result == mesh.indices, "simplify returns the input unchanged if the target is not below the index count");
+			check(error == 0.0f, "simplify reports no error if it leaves the input unchanged");
+		}
+	}
+}
+
+int main()
+{
+	testRemapKeepsIndicesValid();
+	testVertexCacheImprovesACMR();
+	testDeduplicationIsIdempotent();
+	testSimplifyReducesGrid();
+	testSimplifyKeepsBordersAndSeams();
+	testSimplifyRespectsMaxError();
+	testSimplifyNoOpAtTarget();
+	if (failures > 0) {
+		fprintf(stderr, "%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("All mesh optimizer tests passed\n");
+	return 0;
+}
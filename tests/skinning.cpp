@@ -0,0 +1,174 @@
+/*
+* Tests for the CPU side vertex skinning functions (base/skinning.hpp)
+*
+* Copyright (C) 2020-2023 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "skinning.hpp"
+
+// Replace the global allocation functions to count heap allocations made by the update functions
+static std::atomic<size_t> allocationCount{ 0 };
+
+void* operator new(size_t size)
+{
+	allocationCount++;
+	void* ptr = malloc(size > 0 ? size : 1);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+namespace
+{
+	int failures = 0;
+
+	void check(bool condition, const char* description)
+	{
+		if (!condition) {
+			fprintf(stderr, "FAILED: %s\n", description);
+			failures++;
+		}
+	}
+
+	bool equal(const glm::mat4& a, const glm::mat4& b)
+	{
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				if (std::abs(a[c][r] - b[c][r]) > 1e-4f) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// Skinned mesh node with a chain of three joints below it, animated by one translation, one rotation and one scale channel
+	struct Model {
+		std::vector<vks::skinning::Node> nodes;
+		std::vector<vks::skinning::Node*> linearNodes;
+		vks::skinning::Skin skin;
+		vks::skinning::Animation animation;
+		std::vector<glm::mat4> jointMatrices;
+
+		Model() : nodes(4)
+		{
+			for (size_t i = 0; i < nodes.size(); i++) {
+				nodes[i].parent = (i > 0) ? &nodes[i - 1] : nullptr;
+				linearNodes.push_back(&nodes[i]);
+			}
+			nodes[0].translation = glm::vec3(0.0f, 1.0f, 0.0f);
+			for (size_t i = 1; i < nodes.size(); i++) {
+				skin.joints.push_back(&nodes[i]);
+				skin.inverseBindMatrices.push_back(glm::mat4(1.0f));
+			}
+			jointMatrices.resize(skin.joints.size());
+
+			const std::vector<float> times = { 0.0f, 0.5f, 1.0f };
+			const glm::vec4 rotationStart(0.0f, 0.0f, 0.0f, 1.0f);
+			const glm::vec4 rotationEnd(0.0f, std::sqrt(0.5f), 0.0f, std::sqrt(0.5f));
+			animation.samplers.resize(3);
+			animation.samplers[0].inputs = times;
+			animation.samplers[0].outputsVec4 = { glm::vec4(0.0f), glm::vec4(2.0f, 0.0f, 0.0f, 0.0f), glm::vec4(0.0f) };
+			animation.samplers[1].inputs = times;
+			animation.samplers[1].outputsVec4 = { rotationStart, rotationEnd, rotationStart };
+			animation.samplers[2].inputs = times;
+			animation.samplers[2].outputsVec4 = { glm::vec4(1.0f), glm::vec4(2.0f), glm::vec4(1.0f) };
+			animation.channels = {
+				{ vks::skinning::Path::Translation, &nodes[1], 0 },
+				{ vks::skinning::Path::Rotation, &nodes[2], 1 },
+				{ vks::skinning::Path::Scale, &nodes[3], 2 },
+			};
+			animation.start = times.front();
+			animation.end = times.back();
+		}
+
+		// Same steps as the glTF skinning sample's per-frame update
+		void update(float deltaTime)
+		{
+			vks::skinning::updateAnimation(animation, deltaTime);
+			vks::skinning::updateWorldMatrices(linearNodes);
+			vks::skinning::updateJointMatrices(nodes[0], skin, jointMatrices.data());
+		}
+	};
+
+	// Joint matrices need to be relative to the skinned node and follow the animated channels
+	void testJointMatricesFollowAnimation()
+	{
+		Model model;
+		model.update(0.25f);
+		check(std::abs(model.nodes[1].translation.x - 1.0f) < 1e-4f, "linear translation channel is interpolated between keyframes");
+		check(equal(model.jointMatrices[0], glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.0f))), "joint matrix is relative to the skinned node");
+		check(equal(model.nodes[3].worldMatrix, model.nodes[2].worldMatrix * model.nodes[3].getLocalMatrix()), "world matrices include the parent's animated transform");
+
+		model.update(0.25f);
+		const glm::vec3 x = glm::vec3(model.nodes[2].getLocalMatrix() * glm::vec4(1.0f, 0.0f, 0.0f, 0.0f));
+		check(std::abs(x.z + 1.0f) < 1e-4f, "rotation channel reaches the keyframe rotation");
+		check(std::abs(model.nodes[3].scale.y - 2.0f) < 1e-4f, "scale channel reaches the keyframe scale");
+	}
+
+	// Once loaded, updating the animation and joint matrices must not touch the heap, including when the animation loops
+	void testSteadyStateUpdateDoesNotAllocate()
+	{
+		Model model;
+		const float deltaTime = 1.0f / 60.0f;
+		for (uint32_t i = 0; i < 10; i++) {
+			model.update(deltaTime);
+		}
+		const size_t allocationsBefore = allocationCount.load();
+		for (uint32_t i = 0; i < 600; i++) {
+			model.update(deltaTime);
+		}
+		const size_t allocations = allocationCount.load() - allocationsBefore;
+		if (allocations > 0) {
+			fprintf(stderr, "%zu heap allocation(s) in 600 frames\n", allocations);
+		}
+		check(allocations == 0, "steady state animation updates don't allocate");
+	}
+}
+
+int main()
+{
+	testJointMatricesFollowAnimation();
+	testSteadyStateUpdateDoesNotAllocate();
+	if (failures > 0) {
+		fprintf(stderr, "%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("All skinning tests passed\n");
+	return 0;
+}